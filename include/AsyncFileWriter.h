@@ -0,0 +1,160 @@
+/**
+ * -==== AsyncFileWriter.h
+ *
+ *                Mart Multi-Language LLVM Mutation Framework
+ *
+ * This file is distributed under the University of Illinois Open Source
+ * License. See LICENSE.TXT for details.
+ *
+ * \brief     Define the class AsyncFileWriter, a pool of writer threads that
+ * create the output directories and write the files from in-memory buffers.
+ * The data (e.g. the mutants' serialized bitcode) is produced by the caller
+ * thread, so that no LLVM object is shared with the writer threads; only the
+ * file system latency is moved off the caller thread. Each file has a fixed
+ * path, so the output layout is the same as with serial writes.
+ */
+
+#ifndef AsyncFileWriter_h__
+#define AsyncFileWriter_h__
+
+#include <cerrno>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <sys/stat.h>  //mkdir
+#include <sys/types.h> //mkdir
+#include <thread>
+#include <vector>
+
+#include "llvm/Support/raw_ostream.h"
+
+namespace mart {
+
+class AsyncFileWriter {
+  struct WriteJob {
+    std::string dirPath; // directory to create before the write, if not empty
+    std::string filename;
+    std::string data;
+  };
+
+  std::vector<std::thread> writers;
+  std::deque<WriteJob> jobs;
+  std::mutex lock;
+  std::condition_variable jobsAvailable;
+  std::condition_variable jobsDone;
+
+  // Number of jobs queued or being written, and their data size
+  size_t pendingJobs;
+  size_t pendingBytes;
+  // The submission blocks while the data pending exceeds this (memory bound)
+  size_t maxPendingBytes;
+
+  bool stopping;
+  // Errors of the writes since the last drain, reported by drain()
+  std::vector<std::string> errorMsgs;
+
+  static bool writeJob(WriteJob const &job, std::string &errorMsg) {
+    if (!job.dirPath.empty() && mkdir(job.dirPath.c_str(), 0777) != 0) {
+      errorMsg = "Failed to create output directory " + job.dirPath + ": " +
+                 std::strerror(errno);
+      return false;
+    }
+    std::ofstream out(job.filename, std::ios::binary | std::ios::trunc);
+    if (!out.is_open() || !out.write(job.data.data(), job.data.size())) {
+      errorMsg = "Failed to write file " + job.filename;
+      return false;
+    }
+    out.close();
+    if (out.fail()) {
+      errorMsg = "Failed to close file " + job.filename;
+      return false;
+    }
+    return true;
+  }
+
+  void writerLoop() {
+    std::unique_lock<std::mutex> guard(lock);
+    while (true) {
+      jobsAvailable.wait(guard, [this] { return stopping || !jobs.empty(); });
+      if (jobs.empty())
+        return; // stopping
+      WriteJob job(std::move(jobs.front()));
+      jobs.pop_front();
+
+      guard.unlock();
+      std::string errorMsg;
+      bool ok = writeJob(job, errorMsg);
+      guard.lock();
+
+      if (!ok)
+        errorMsgs.push_back(errorMsg);
+      pendingBytes -= job.data.size();
+      --pendingJobs;
+      jobsDone.notify_all();
+    }
+  }
+
+public:
+  /// With 0 'numThreads', the files are written synchronously by submit()
+  AsyncFileWriter(unsigned numThreads,
+                  size_t maxPendingBytes_ = 256 * 1024 * 1024)
+      : pendingJobs(0), pendingBytes(0), maxPendingBytes(maxPendingBytes_),
+        stopping(false) {
+    for (unsigned i = 0; i < numThreads; ++i)
+      writers.emplace_back(&AsyncFileWriter::writerLoop, this);
+  }
+
+  ~AsyncFileWriter() {
+    {
+      std::lock_guard<std::mutex> guard(lock);
+      stopping = true;
+    }
+    jobsAvailable.notify_all();
+    for (auto &th : writers)
+      th.join();
+  }
+
+  /// \brief queue the write of 'data' into 'filename', after the creation of
+  /// the directory 'dirPath' (if not empty). 'data' is moved from.
+  void submit(std::string const &dirPath, std::string const &filename,
+              std::string &data) {
+    WriteJob job;
+    job.dirPath = dirPath;
+    job.filename = filename;
+    job.data.swap(data);
+    if (writers.empty()) {
+      std::string errorMsg;
+      if (!writeJob(job, errorMsg))
+        errorMsgs.push_back(errorMsg);
+      return;
+    }
+    std::unique_lock<std::mutex> guard(lock);
+    jobsDone.wait(guard, [this] {
+      return pendingJobs == 0 || pendingBytes < maxPendingBytes;
+    });
+    pendingBytes += job.data.size();
+    ++pendingJobs;
+    jobs.push_back(std::move(job));
+    guard.unlock();
+    jobsAvailable.notify_one();
+  }
+
+  /// \brief wait for all the writes submitted to be done.
+  /// \return false if any of them failed (the errors are printed).
+  bool drain() {
+    std::unique_lock<std::mutex> guard(lock);
+    jobsDone.wait(guard, [this] { return pendingJobs == 0; });
+    for (auto &msg : errorMsgs)
+      llvm::errs() << msg << "\n";
+    bool ok = errorMsgs.empty();
+    errorMsgs.clear();
+    return ok;
+  }
+}; // class AsyncFileWriter
+
+} // namespace mart
+
+#endif //#ifndef AsyncFileWriter_h__
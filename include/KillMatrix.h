@@ -0,0 +1,835 @@
+/**
+ * -==== KillMatrix.h
+ *
+ *                Mart Multi-Language LLVM Mutation Framework
+ *
+ * This file is distributed under the University of Illinois Open Source
+ * License. See LICENSE.TXT for details.
+ *
+ * \brief     Define the classes CompressedBitmap, a roaring-style compressed
+ * bitmap of unsigned integers, and KillMatrix, the store of the mutants
+ * execution results (which test kills which mutant) with the analyses on it:
+ * mutation score, subsuming mutants, minimal test set and the labels of
+ * Mart-Training ('Y' CSV).
+ *
+ * The kill matrix is kept both per test (mutants IDs killed by the test) and
+ * per mutant (indexes of the tests killing the mutant). It is loaded from a
+ * text file with one line per test:
+ *      <test name> <killed mutant ID> <killed mutant ID> ...
+ * or from its binary store file: the magic string, the number of mutants and
+ * of tests, then for each test its name and its killed mutants bitmap.
+ */
+
+#ifndef KillMatrix_h__
+#define KillMatrix_h__
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <queue>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "llvm/Support/raw_ostream.h"
+
+namespace mart {
+
+/// Set of 32 bits unsigned integers split, by their 16 high bits, into
+/// containers of the 16 low bits: a sorted array for sparse containers and a
+/// 2^16 bits bitmap for dense ones. The operations on the bitmap containers
+/// are loops over the 64 bits words, vectorized by the compiler.
+class CompressedBitmap {
+public:
+  static const unsigned kBitmapWords = (1 << 16) / 64;
+  /// a container with more values is stored as bitmap
+  static const unsigned kArrayMaxCard = 4096;
+
+private:
+  struct Container {
+    uint16_t key;
+    uint32_t card;
+    std::vector<uint16_t> values; // sorted (array container)
+    std::vector<uint64_t> words;  // non empty for a bitmap container
+
+    Container(uint16_t k = 0) : key(k), card(0) {}
+    bool isBitmap() const { return !words.empty(); }
+    bool operator==(Container const &other) const {
+      return key == other.key && card == other.card &&
+             values == other.values && words == other.words;
+    }
+  };
+
+  /// sorted by key, none is empty
+  std::vector<Container> containers;
+
+  static uint32_t wordsCard(uint64_t const *words) {
+    uint32_t card = 0;
+    for (unsigned i = 0; i < kBitmapWords; ++i)
+      card += __builtin_popcountll(words[i]);
+    return card;
+  }
+
+  static void toBitmap(Container &c) {
+    c.words.assign(kBitmapWords, 0);
+    for (uint16_t v : c.values)
+      c.words[v >> 6] |= (uint64_t)1 << (v & 63);
+    std::vector<uint16_t>().swap(c.values);
+  }
+
+  static void toArray(Container &c) {
+    c.values.clear();
+    c.values.reserve(c.card);
+    for (unsigned i = 0; i < kBitmapWords; ++i)
+      for (uint64_t w = c.words[i]; w != 0; w &= w - 1)
+        c.values.push_back(i * 64 + __builtin_ctzll(w));
+    std::vector<uint64_t>().swap(c.words);
+  }
+
+  /// make the representation of 'c' the canonical one for its cardinality
+  static void normalize(Container &c) {
+    if (c.isBitmap() && c.card <= kArrayMaxCard)
+      toArray(c);
+    else if (!c.isBitmap() && c.card > kArrayMaxCard)
+      toBitmap(c);
+  }
+
+  static bool bitmapHas(Container const &c, uint16_t v) {
+    return (c.words[v >> 6] >> (v & 63)) & 1;
+  }
+
+  static void containerAnd(Container const &a, Container const &b,
+                           Container &out) {
+    if (a.isBitmap() && b.isBitmap()) {
+      out.words.resize(kBitmapWords);
+      uint64_t const *wa = a.words.data(), *wb = b.words.data();
+      uint64_t *wo = out.words.data();
+      for (unsigned i = 0; i < kBitmapWords; ++i)
+        wo[i] = wa[i] & wb[i];
+      out.card = wordsCard(wo);
+    } else if (a.isBitmap() || b.isBitmap()) {
+      Container const &arr = a.isBitmap() ? b : a;
+      Container const &bmp = a.isBitmap() ? a : b;
+      for (uint16_t v : arr.values)
+        if (bitmapHas(bmp, v))
+          out.values.push_back(v);
+      out.card = out.values.size();
+    } else {
+      std::set_intersection(a.values.begin(), a.values.end(),
+                            b.values.begin(), b.values.end(),
+                            std::back_inserter(out.values));
+      out.card = out.values.size();
+    }
+    normalize(out);
+  }
+
+  static void containerOr(Container const &a, Container const &b,
+                          Container &out) {
+    if (a.isBitmap() && b.isBitmap()) {
+      out.words.resize(kBitmapWords);
+      uint64_t const *wa = a.words.data(), *wb = b.words.data();
+      uint64_t *wo = out.words.data();
+      for (unsigned i = 0; i < kBitmapWords; ++i)
+        wo[i] = wa[i] | wb[i];
+      out.card = wordsCard(wo);
+    } else if (a.isBitmap() || b.isBitmap()) {
+      Container const &arr = a.isBitmap() ? b : a;
+      Container const &bmp = a.isBitmap() ? a : b;
+      out.words = bmp.words;
+      out.card = bmp.card;
+      for (uint16_t v : arr.values) {
+        uint64_t bit = (uint64_t)1 << (v & 63);
+        out.card += (out.words[v >> 6] & bit) == 0;
+        out.words[v >> 6] |= bit;
+      }
+    } else {
+      std::set_union(a.values.begin(), a.values.end(), b.values.begin(),
+                     b.values.end(), std::back_inserter(out.values));
+      out.card = out.values.size();
+    }
+    normalize(out);
+  }
+
+  static void containerAndNot(Container const &a, Container const &b,
+                              Container &out) {
+    if (a.isBitmap() && b.isBitmap()) {
+      out.words.resize(kBitmapWords);
+      uint64_t const *wa = a.words.data(), *wb = b.words.data();
+      uint64_t *wo = out.words.data();
+      for (unsigned i = 0; i < kBitmapWords; ++i)
+        wo[i] = wa[i] & ~wb[i];
+      out.card = wordsCard(wo);
+    } else if (a.isBitmap()) {
+      out.words = a.words;
+      out.card = a.card;
+      for (uint16_t v : b.values) {
+        uint64_t bit = (uint64_t)1 << (v & 63);
+        out.card -= (out.words[v >> 6] & bit) != 0;
+        out.words[v >> 6] &= ~bit;
+      }
+    } else if (b.isBitmap()) {
+      for (uint16_t v : a.values)
+        if (!bitmapHas(b, v))
+          out.values.push_back(v);
+      out.card = out.values.size();
+    } else {
+      std::set_difference(a.values.begin(), a.values.end(), b.values.begin(),
+                          b.values.end(), std::back_inserter(out.values));
+      out.card = out.values.size();
+    }
+    normalize(out);
+  }
+
+  static uint32_t containerAndCard(Container const &a, Container const &b) {
+    uint32_t card = 0;
+    if (a.isBitmap() && b.isBitmap()) {
+      uint64_t const *wa = a.words.data(), *wb = b.words.data();
+      for (unsigned i = 0; i < kBitmapWords; ++i)
+        card += __builtin_popcountll(wa[i] & wb[i]);
+    } else if (a.isBitmap() || b.isBitmap()) {
+      Container const &arr = a.isBitmap() ? b : a;
+      Container const &bmp = a.isBitmap() ? a : b;
+      for (uint16_t v : arr.values)
+        card += bitmapHas(bmp, v);
+    } else {
+      auto ia = a.values.begin(), ea = a.values.end();
+      auto ib = b.values.begin(), eb = b.values.end();
+      while (ia != ea && ib != eb) {
+        if (*ia < *ib) {
+          ++ia;
+        } else if (*ib < *ia) {
+          ++ib;
+        } else {
+          ++card;
+          ++ia;
+          ++ib;
+        }
+      }
+    }
+    return card;
+  }
+
+  /// apply the container operation 'op' on the containers of same key of
+  /// this and 'other'. The containers present in only one of the bitmaps are
+  /// kept if 'keepThis' (resp. 'keepOther')
+  void combine(CompressedBitmap const &other,
+               void (*op)(Container const &, Container const &, Container &),
+               bool keepThis, bool keepOther) {
+    std::vector<Container> result;
+    auto it = containers.begin(), ie = containers.end();
+    auto io = other.containers.begin(), eo = other.containers.end();
+    while (it != ie || io != eo) {
+      if (io == eo || (it != ie && it->key < io->key)) {
+        if (keepThis)
+          result.push_back(std::move(*it));
+        ++it;
+      } else if (it == ie || io->key < it->key) {
+        if (keepOther)
+          result.push_back(*io);
+        ++io;
+      } else {
+        Container out(it->key);
+        op(*it, *io, out);
+        if (out.card > 0)
+          result.push_back(std::move(out));
+        ++it;
+        ++io;
+      }
+    }
+    containers.swap(result);
+  }
+
+  template <typename T>
+  static void writeRaw(std::ostream &out, T const &val) {
+    out.write(reinterpret_cast<char const *>(&val), sizeof(T));
+  }
+  template <typename T> static void readRaw(std::istream &in, T &val) {
+    in.read(reinterpret_cast<char *>(&val), sizeof(T));
+  }
+
+public:
+  CompressedBitmap() {}
+
+  /// \brief build the bitmap of the values 'sortedValues', sorted in
+  /// increasing order (duplicates allowed)
+  static CompressedBitmap
+  fromSorted(std::vector<uint32_t> const &sortedValues) {
+    CompressedBitmap bm;
+    for (uint32_t v : sortedValues) {
+      uint16_t key = v >> 16, low = v & 0xFFFF;
+      if (bm.containers.empty() || bm.containers.back().key != key) {
+        if (!bm.containers.empty())
+          normalize(bm.containers.back());
+        bm.containers.emplace_back(key);
+      }
+      Container &c = bm.containers.back();
+      if (!c.values.empty() && c.values.back() == low)
+        continue;
+      assert((c.values.empty() || c.values.back() < low) &&
+             "The values must be sorted");
+      c.values.push_back(low);
+      ++c.card;
+    }
+    if (!bm.containers.empty())
+      normalize(bm.containers.back());
+    return bm;
+  }
+
+  void add(uint32_t v) {
+    uint16_t key = v >> 16, low = v & 0xFFFF;
+    auto it = std::lower_bound(
+        containers.begin(), containers.end(), key,
+        [](Container const &c, uint16_t k) { return c.key < k; });
+    if (it == containers.end() || it->key != key)
+      it = containers.insert(it, Container(key));
+    if (it->isBitmap()) {
+      uint64_t bit = (uint64_t)1 << (low & 63);
+      it->card += (it->words[low >> 6] & bit) == 0;
+      it->words[low >> 6] |= bit;
+      return;
+    }
+    auto pos = std::lower_bound(it->values.begin(), it->values.end(), low);
+    if (pos != it->values.end() && *pos == low)
+      return;
+    it->values.insert(pos, low);
+    ++(it->card);
+    normalize(*it);
+  }
+
+  bool contains(uint32_t v) const {
+    uint16_t key = v >> 16, low = v & 0xFFFF;
+    auto it = std::lower_bound(
+        containers.begin(), containers.end(), key,
+        [](Container const &c, uint16_t k) { return c.key < k; });
+    if (it == containers.end() || it->key != key)
+      return false;
+    if (it->isBitmap())
+      return bitmapHas(*it, low);
+    return std::binary_search(it->values.begin(), it->values.end(), low);
+  }
+
+  uint64_t cardinality() const {
+    uint64_t card = 0;
+    for (auto &c : containers)
+      card += c.card;
+    return card;
+  }
+
+  bool empty() const { return containers.empty(); }
+
+  /// \brief highest value (the bitmap must not be empty)
+  uint32_t maximum() const {
+    assert(!empty() && "maximum of an empty bitmap");
+    Container const &c = containers.back();
+    uint32_t high = (uint32_t)c.key << 16;
+    if (!c.isBitmap())
+      return high | c.values.back();
+    unsigned i = kBitmapWords - 1;
+    while (c.words[i] == 0)
+      --i;
+    return high | (i * 64 + 63 - __builtin_clzll(c.words[i]));
+  }
+
+  void clear() { containers.clear(); }
+
+  /// this = this & other
+  void intersectWith(CompressedBitmap const &other) {
+    combine(other, containerAnd, false, false);
+  }
+
+  /// this = this | other
+  void unionWith(CompressedBitmap const &other) {
+    combine(other, containerOr, true, true);
+  }
+
+  /// this = this & ~other
+  void subtract(CompressedBitmap const &other) {
+    combine(other, containerAndNot, true, false);
+  }
+
+  /// \brief cardinality of this & other, without computing it
+  uint64_t intersectionCardinality(CompressedBitmap const &other) const {
+    uint64_t card = 0;
+    auto it = containers.begin(), ie = containers.end();
+    auto io = other.containers.begin(), eo = other.containers.end();
+    while (it != ie && io != eo) {
+      if (it->key < io->key) {
+        ++it;
+      } else if (io->key < it->key) {
+        ++io;
+      } else {
+        card += containerAndCard(*it, *io);
+        ++it;
+        ++io;
+      }
+    }
+    return card;
+  }
+
+  bool isSubsetOf(CompressedBitmap const &other) const {
+    uint64_t card = cardinality();
+    return card <= other.cardinality() &&
+           intersectionCardinality(other) == card;
+  }
+
+  /// \brief call 'fn' on each value, in increasing order
+  void forEach(std::function<void(uint32_t)> const &fn) const {
+    for (auto &c : containers) {
+      uint32_t high = (uint32_t)c.key << 16;
+      if (c.isBitmap()) {
+        for (unsigned i = 0; i < kBitmapWords; ++i)
+          for (uint64_t w = c.words[i]; w != 0; w &= w - 1)
+            fn(high | (i * 64 + __builtin_ctzll(w)));
+      } else {
+        for (uint16_t v : c.values)
+          fn(high | v);
+      }
+    }
+  }
+
+  std::vector<uint32_t> toVector() const {
+    std::vector<uint32_t> vals;
+    vals.reserve(cardinality());
+    forEach([&vals](uint32_t v) { vals.push_back(v); });
+    return vals;
+  }
+
+  bool operator==(CompressedBitmap const &other) const {
+    return containers == other.containers;
+  }
+
+  std::size_t hash() const {
+    std::size_t h = containers.size();
+    auto mix = [&h](uint64_t v) {
+      h ^= std::hash<uint64_t>()(v) + 0x9e3779b97f4a7c15ULL + (h << 6) +
+           (h >> 2);
+    };
+    for (auto &c : containers) {
+      mix(((uint64_t)c.key << 32) | c.card);
+      if (c.isBitmap())
+        for (uint64_t w : c.words)
+          mix(w);
+      else
+        for (uint16_t v : c.values)
+          mix(v);
+    }
+    return h;
+  }
+
+  /// \brief write the bitmap (native byte order) into 'out'
+  void writeTo(std::ostream &out) const {
+    writeRaw(out, (uint32_t)containers.size());
+    for (auto &c : containers) {
+      writeRaw(out, c.key);
+      writeRaw(out, c.card);
+      if (c.isBitmap())
+        out.write(reinterpret_cast<char const *>(c.words.data()),
+                  kBitmapWords * sizeof(uint64_t));
+      else
+        out.write(reinterpret_cast<char const *>(c.values.data()),
+                  c.values.size() * sizeof(uint16_t));
+    }
+  }
+
+  /// \brief read a bitmap written with writeTo
+  bool readFrom(std::istream &in) {
+    containers.clear();
+    uint32_t num = 0;
+    readRaw(in, num);
+    for (uint32_t i = 0; i < num && in.good(); ++i) {
+      Container c;
+      readRaw(in, c.key);
+      readRaw(in, c.card);
+      if (c.card == 0 || c.card > (1 << 16) ||
+          (!containers.empty() && containers.back().key >= c.key))
+        return false;
+      if (c.card > kArrayMaxCard) {
+        c.words.resize(kBitmapWords);
+        in.read(reinterpret_cast<char *>(c.words.data()),
+                kBitmapWords * sizeof(uint64_t));
+      } else {
+        c.values.resize(c.card);
+        in.read(reinterpret_cast<char *>(c.values.data()),
+                c.card * sizeof(uint16_t));
+      }
+      containers.push_back(std::move(c));
+    }
+    return in.good();
+  }
+}; // class CompressedBitmap
+
+/// Which test kills which mutant. The mutants IDs are 1 to getNumMutants()
+/// and the tests are indexed from 0 in the order they are added.
+class KillMatrix {
+  unsigned numMutants;
+  std::vector<std::string> testNames;
+  std::unordered_map<std::string, unsigned> testIndex;
+
+  /// mutants killed by each test
+  std::vector<CompressedBitmap> killedByTest;
+  /// tests killing each mutant (indexed by mutant ID, 0 is unused)
+  std::vector<CompressedBitmap> killingTests;
+
+  static const char *getStoreMagic() { return "MARTKM01"; }
+
+  /// \brief compute the per mutant bitmaps from the per test ones
+  void buildKillingTests() {
+    std::vector<std::vector<uint32_t>> tests(numMutants + 1);
+    for (unsigned t = 0; t < killedByTest.size(); ++t)
+      killedByTest[t].forEach([&tests, t](uint32_t mid) {
+        tests[mid].push_back(t);
+      });
+    killingTests.clear();
+    killingTests.reserve(numMutants + 1);
+    for (auto &testList : tests)
+      killingTests.push_back(CompressedBitmap::fromSorted(testList));
+  }
+
+  /// \brief set 'numMutants' to at least 'minNumMutants' and the highest ID
+  /// of killed mutant, then build the per mutant bitmaps
+  bool finalizeLoad(unsigned minNumMutants, std::string const &filename) {
+    numMutants = minNumMutants;
+    for (auto &killed : killedByTest) {
+      if (killed.contains(0)) {
+        llvm::errs() << "Invalid kill matrix " << filename
+                     << ": mutant ID 0 (original program) killed\n";
+        return false;
+      }
+      if (!killed.empty())
+        numMutants = std::max(numMutants, (unsigned)killed.maximum());
+    }
+    buildKillingTests();
+    return true;
+  }
+
+  /// Mutants with the same killing tests (the subsumption is on these
+  /// classes)
+  struct KillClass {
+    CompressedBitmap tests;
+    std::vector<unsigned> mutants;
+  };
+
+  /// \brief group the killed mutants by killing tests. 'classesOfTest' gets,
+  /// for each test, the indexes of the classes it kills
+  void computeKillClasses(std::vector<KillClass> &classes,
+                          std::vector<CompressedBitmap> &classesOfTest) const {
+    std::unordered_map<std::size_t, std::vector<unsigned>> byHash;
+    for (unsigned mid = 1; mid <= numMutants; ++mid) {
+      CompressedBitmap const &tests = killingTests[mid];
+      if (tests.empty())
+        continue;
+      auto &bucket = byHash[tests.hash()];
+      bool found = false;
+      for (unsigned ci : bucket) {
+        if (classes[ci].tests == tests) {
+          classes[ci].mutants.push_back(mid);
+          found = true;
+          break;
+        }
+      }
+      if (!found) {
+        bucket.push_back(classes.size());
+        classes.push_back(KillClass());
+        classes.back().tests = tests;
+        classes.back().mutants.push_back(mid);
+      }
+    }
+    std::vector<std::vector<uint32_t>> perTest(testNames.size());
+    for (unsigned ci = 0; ci < classes.size(); ++ci)
+      classes[ci].tests.forEach(
+          [&perTest, ci](uint32_t t) { perTest[t].push_back(ci); });
+    classesOfTest.clear();
+    for (auto &classList : perTest)
+      classesOfTest.push_back(CompressedBitmap::fromSorted(classList));
+  }
+
+  /// \brief mark in 'isSubsuming' the classes that no other class subsumes
+  /// (no class is killed by a strict subset of its killing tests)
+  void
+  computeSubsumingClasses(std::vector<KillClass> const &classes,
+                          std::vector<CompressedBitmap> const &classesOfTest,
+                          std::vector<bool> &isSubsuming) const {
+    std::vector<unsigned> order(classes.size());
+    for (unsigned ci = 0; ci < classes.size(); ++ci)
+      order[ci] = ci;
+    std::stable_sort(order.begin(), order.end(),
+                     [&classes](unsigned a, unsigned b) {
+                       return classes[a].tests.cardinality() <
+                              classes[b].tests.cardinality();
+                     });
+    // A class subsumed by another is subsumed by a subsuming class, checked
+    // before it (fewer killing tests). The classes subsumed by class C are
+    // the ones killed by all the killing tests of C.
+    isSubsuming.assign(classes.size(), true);
+    for (unsigned ci : order) {
+      if (!isSubsuming[ci])
+        continue;
+      std::vector<uint32_t> tests = classes[ci].tests.toVector();
+      std::sort(tests.begin(), tests.end(),
+                [&classesOfTest](uint32_t a, uint32_t b) {
+                  return classesOfTest[a].cardinality() <
+                         classesOfTest[b].cardinality();
+                });
+      CompressedBitmap subsumed = classesOfTest[tests[0]];
+      for (unsigned i = 1; i < tests.size() && subsumed.cardinality() > 1; ++i)
+        subsumed.intersectWith(classesOfTest[tests[i]]);
+      subsumed.forEach([&isSubsuming, ci](uint32_t other) {
+        if (other != ci)
+          isSubsuming[other] = false;
+      });
+    }
+  }
+
+public:
+  KillMatrix() : numMutants(0) {}
+
+  unsigned getNumMutants() const { return numMutants; }
+  unsigned getNumTests() const { return testNames.size(); }
+  std::vector<std::string> const &getTestNames() const { return testNames; }
+
+  /// \brief index of the test 'name', or -1 if not in the matrix
+  int getTestIndex(std::string const &name) const {
+    auto it = testIndex.find(name);
+    return it == testIndex.end() ? -1 : (int)it->second;
+  }
+
+  CompressedBitmap const &getKilledMutants(unsigned test) const {
+    return killedByTest.at(test);
+  }
+  CompressedBitmap const &getKillingTests(unsigned mutantID) const {
+    return killingTests.at(mutantID);
+  }
+
+  /// \brief load the text kill matrix (see the file header). The mutants IDs
+  /// are 1 to the maximum of 'minNumMutants' and the highest killed mutant ID
+  bool loadFromText(std::string const &filename, unsigned minNumMutants = 0) {
+    clear();
+    std::ifstream in(filename);
+    if (!in.is_open()) {
+      llvm::errs() << "Unable to open kill matrix file: " << filename << "\n";
+      return false;
+    }
+    std::string line, name;
+    while (std::getline(in, line)) {
+      std::istringstream ss(line);
+      if (!(ss >> name))
+        continue;
+      if (testIndex.count(name)) {
+        llvm::errs() << "Invalid kill matrix " << filename << ": test "
+                     << name << " appears twice\n";
+        return false;
+      }
+      std::vector<uint32_t> killed;
+      unsigned long mid;
+      while (ss >> mid && mid <= UINT32_MAX)
+        killed.push_back(mid);
+      if (!ss.eof()) {
+        llvm::errs() << "Invalid kill matrix " << filename
+                     << ": bad mutant ID for test " << name << "\n";
+        return false;
+      }
+      std::sort(killed.begin(), killed.end());
+      testIndex[name] = testNames.size();
+      testNames.push_back(name);
+      killedByTest.push_back(CompressedBitmap::fromSorted(killed));
+    }
+    return finalizeLoad(minNumMutants, filename);
+  }
+
+  /// \brief check whether 'filename' is a kill matrix store
+  static bool isStoreFile(std::string const &filename) {
+    std::ifstream in(filename, std::ios::in | std::ios::binary);
+    std::string magic(std::strlen(getStoreMagic()), '\0');
+    in.read(&magic[0], magic.size());
+    return in.good() && magic == getStoreMagic();
+  }
+
+  bool loadFromStore(std::string const &filename) {
+    clear();
+    std::ifstream in(filename, std::ios::in | std::ios::binary);
+    std::string magic(std::strlen(getStoreMagic()), '\0');
+    in.read(&magic[0], magic.size());
+    if (!in.good() || magic != getStoreMagic()) {
+      llvm::errs() << "Invalid kill matrix store (bad magic): " << filename
+                   << "\n";
+      return false;
+    }
+    uint32_t nMuts = 0, nTests = 0;
+    in.read(reinterpret_cast<char *>(&nMuts), sizeof(nMuts));
+    in.read(reinterpret_cast<char *>(&nTests), sizeof(nTests));
+    for (uint32_t t = 0; t < nTests && in.good(); ++t) {
+      uint32_t len = 0;
+      in.read(reinterpret_cast<char *>(&len), sizeof(len));
+      std::string name(len, '\0');
+      in.read(&name[0], len);
+      testIndex[name] = testNames.size();
+      testNames.push_back(name);
+      killedByTest.push_back(CompressedBitmap());
+      if (!killedByTest.back().readFrom(in))
+        break;
+    }
+    if (!in.good() || testNames.size() != nTests) {
+      llvm::errs() << "Invalid kill matrix store: " << filename << "\n";
+      return false;
+    }
+    return finalizeLoad(nMuts, filename);
+  }
+
+  bool writeToStore(std::string const &filename) const {
+    std::ofstream out(filename,
+                      std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) {
+      llvm::errs() << "Unable to open kill matrix store for write: "
+                   << filename << "\n";
+      return false;
+    }
+    out.write(getStoreMagic(), std::strlen(getStoreMagic()));
+    uint32_t nMuts = numMutants, nTests = testNames.size();
+    out.write(reinterpret_cast<char const *>(&nMuts), sizeof(nMuts));
+    out.write(reinterpret_cast<char const *>(&nTests), sizeof(nTests));
+    for (unsigned t = 0; t < testNames.size(); ++t) {
+      uint32_t len = testNames[t].size();
+      out.write(reinterpret_cast<char const *>(&len), sizeof(len));
+      out.write(testNames[t].data(), len);
+      killedByTest[t].writeTo(out);
+    }
+    return out.good();
+  }
+
+  void clear() {
+    numMutants = 0;
+    testNames.clear();
+    testIndex.clear();
+    killedByTest.clear();
+    killingTests.clear();
+  }
+
+  /// \brief mutants killed by at least one of the tests 'tests'
+  CompressedBitmap getKilledMutants(std::vector<unsigned> const &tests) const {
+    CompressedBitmap killed;
+    for (unsigned t : tests)
+      killed.unionWith(killedByTest.at(t));
+    return killed;
+  }
+
+  /// \brief mutation score of the tests 'tests': ratio of the mutants killed
+  /// by them among all the mutants
+  double getMutationScore(std::vector<unsigned> const &tests) const {
+    if (numMutants == 0)
+      return 0.0;
+    return (double)getKilledMutants(tests).cardinality() / numMutants;
+  }
+
+  /// \brief compute the subsuming mutants (killed mutants that no other
+  /// killed mutant subsumes) into 'subsuming', in increasing ID order. Mutants
+  /// with the same killing tests are all subsuming or not.
+  void getSubsumingMutants(std::vector<unsigned> &subsuming) const {
+    std::vector<KillClass> classes;
+    std::vector<CompressedBitmap> classesOfTest;
+    std::vector<bool> isSubsuming;
+    computeKillClasses(classes, classesOfTest);
+    computeSubsumingClasses(classes, classesOfTest, isSubsuming);
+    subsuming.clear();
+    for (unsigned ci = 0; ci < classes.size(); ++ci)
+      if (isSubsuming[ci])
+        subsuming.insert(subsuming.end(), classes[ci].mutants.begin(),
+                         classes[ci].mutants.end());
+    std::sort(subsuming.begin(), subsuming.end());
+  }
+
+  /// \brief compute into 'tests' a minimal (greedy) set of tests killing all
+  /// the killed mutants: killing all the subsuming mutants is enough. The
+  /// test killing most of the not yet killed subsuming mutants classes (the
+  /// first one on ties) is added until all are killed.
+  void getMinimalTestSet(std::vector<unsigned> &tests) const {
+    std::vector<KillClass> classes;
+    std::vector<CompressedBitmap> classesOfTest;
+    std::vector<bool> isSubsuming;
+    computeKillClasses(classes, classesOfTest);
+    computeSubsumingClasses(classes, classesOfTest, isSubsuming);
+    std::vector<uint32_t> subsumingList;
+    for (unsigned ci = 0; ci < classes.size(); ++ci)
+      if (isSubsuming[ci])
+        subsumingList.push_back(ci);
+    CompressedBitmap subsumingClasses =
+        CompressedBitmap::fromSorted(subsumingList);
+
+    // Lazy greedy: the gain of a test only decreases as classes are covered
+    typedef std::pair<uint64_t, unsigned> GainTest;
+    auto cmp = [](GainTest const &a, GainTest const &b) {
+      return a.first < b.first || (a.first == b.first && a.second > b.second);
+    };
+    std::priority_queue<GainTest, std::vector<GainTest>, decltype(cmp)> queue(
+        cmp);
+    std::vector<CompressedBitmap> cover(testNames.size());
+    for (unsigned t = 0; t < testNames.size(); ++t) {
+      cover[t] = classesOfTest[t];
+      cover[t].intersectWith(subsumingClasses);
+      if (!cover[t].empty())
+        queue.push(GainTest(cover[t].cardinality(), t));
+    }
+    tests.clear();
+    CompressedBitmap covered;
+    uint64_t numCovered = 0;
+    while (numCovered < subsumingList.size() && !queue.empty()) {
+      GainTest top = queue.top();
+      queue.pop();
+      uint64_t gain = top.first;
+      if (numCovered > 0)
+        gain = cover[top.second].cardinality() -
+               cover[top.second].intersectionCardinality(covered);
+      if (gain == 0)
+        continue;
+      if (gain < top.first) {
+        queue.push(GainTest(gain, top.second));
+        continue;
+      }
+      tests.push_back(top.second);
+      covered.unionWith(cover[top.second]);
+      numCovered += gain;
+    }
+  }
+
+  /// \brief write the Mart-Training labels ('Y' CSV) of the mutants, one row
+  /// per mutant ID from 1: whether it is killed by a fault revealing test of
+  /// 'faultRevealing', the ratio of its killing tests that are fault
+  /// revealing (-1 if not killed), whether it is subsuming and the ratio of
+  /// the tests that kill it
+  bool writeTrainingLabels(std::string const &filename,
+                           CompressedBitmap const &faultRevealing) const {
+    std::vector<unsigned> subsuming;
+    getSubsumingMutants(subsuming);
+    std::vector<bool> isSubsuming(numMutants + 1, false);
+    for (unsigned mid : subsuming)
+      isSubsuming[mid] = true;
+    std::ofstream out(filename);
+    if (!out.is_open()) {
+      llvm::errs() << "Unable to open file for write: " << filename << "\n";
+      return false;
+    }
+    out << "isCoupled,coupling-weight,is-subsuming,killed-ratio\n";
+    for (unsigned mid = 1; mid <= numMutants; ++mid) {
+      CompressedBitmap const &tests = killingTests[mid];
+      uint64_t nKilling = tests.cardinality();
+      if (nKilling == 0) {
+        out << "0,-1,0,0\n";
+        continue;
+      }
+      uint64_t nFaultRevealing = tests.intersectionCardinality(faultRevealing);
+      out << (nFaultRevealing > 0 ? 1 : 0) << ","
+          << (float)nFaultRevealing / nKilling << ","
+          << (isSubsuming[mid] ? 1 : 0) << ","
+          << (float)nKilling / testNames.size() << "\n";
+    }
+    return out.good();
+  }
+}; // class KillMatrix
+
+} // namespace mart
+
+#endif //#ifndef KillMatrix_h__
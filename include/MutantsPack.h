@@ -0,0 +1,378 @@
+/**
+ * -==== MutantsPack.h
+ *
+ *                Mart Multi-Language LLVM Mutation Framework
+ *
+ * This file is distributed under the University of Illinois Open Source
+ * License. See LICENSE.TXT for details.
+ *
+ * \brief     Define the class MutantsPack, a content addressed store used to
+ * write all the mutants' modules into a single pack file (instead of a
+ * directory per mutant). Identical blobs are stored once, which makes the
+ * on-disk duplicate detection (fdupes) happen at write time.
+ * The pack only holds bitcode: the mutants are compiled (CompileAllMuts.sh)
+ * once unpacked with mart-pack.
+ *
+ * The pack is made of 2 files:
+ *  - The pack file: the magic string followed by the blobs' raw data.
+ *  - The index file (text), with one record per line:
+ *      N <name>                         : name of the mutants' module files
+ *      B <blobID> <offset> <size> <md5> : blob location in the pack file
+ *      F <blobID> <function name>       : separated function module (the
+ *                                         program without the function)
+ *      M <mutantID> <blobID> [<function name>] : mutant's module blob, and
+ *                                         function module to link it with
+ *      D <mutantID> <blobID>            : mutant stored as a function delta
+ *                                         against the original (mutant 0)
+ *                                         module (see ReadWriteIRObj)
+ */
+
+#ifndef MutantsPack_h__
+#define MutantsPack_h__
+
+#include <cassert>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/MD5.h"
+#include "llvm/Support/raw_ostream.h"
+
+namespace mart {
+
+class MutantsPack {
+public:
+  struct BlobInfo {
+    uint64_t offset;
+    uint64_t size;
+    std::string hash;
+    BlobInfo(uint64_t o, uint64_t s, std::string const &h)
+        : offset(o), size(s), hash(h) {}
+  };
+
+  struct MutantEntry {
+    unsigned blobID;
+    std::string funcModuleName; // empty if the mutant module is complete
+    bool isDelta; // the blob is a function delta against the original module
+    MutantEntry() : blobID(0), isDelta(false) {}
+    MutantEntry(unsigned b, std::string const &f, bool d = false)
+        : blobID(b), funcModuleName(f), isDelta(d) {}
+  };
+
+private:
+  std::string packFilename;
+  std::string indexFilename;
+  std::ofstream packOut;
+
+  /// name of the file of every mutant's module (e.g. 'prog.bc')
+  std::string moduleFileName;
+
+  std::vector<BlobInfo> blobs;
+  std::unordered_map<std::string, unsigned> blobIdOfHash;
+
+  /// function module's blob by function name
+  std::map<std::string, unsigned> funcModuleBlobs;
+
+  /// Ordered by mutant ID to have a deterministic index
+  std::map<unsigned, MutantEntry> mutants;
+
+  bool writable;
+
+  static const char *getPackMagic() { return "MARTPK01"; }
+
+  static std::string computeHash(llvm::StringRef data) {
+    llvm::MD5 hasher;
+    hasher.update(data);
+    llvm::MD5::MD5Result res;
+    hasher.final(res);
+    llvm::SmallString<32> hexStr;
+    llvm::MD5::stringifyResult(res, hexStr);
+    return hexStr.str().str();
+  }
+
+  /// \brief Add the data into the pack if no identical blob is already there.
+  /// Set 'blobID' to the ID of the blob containing data.
+  /// \return false on a hash collision or a failed write
+  bool addBlob(llvm::StringRef data, unsigned &blobID) {
+    assert(writable && "adding into a pack not opened for write");
+    std::string hash = computeHash(data);
+    auto it = blobIdOfHash.find(hash);
+    if (it != blobIdOfHash.end()) {
+      if (blobs[it->second].size != data.size()) {
+        llvm::errs() << "\nError: MD5 collision in mutants pack for hash "
+                     << hash << "\n";
+        return false;
+      }
+      blobID = it->second;
+      return true;
+    }
+    uint64_t offset = (uint64_t)packOut.tellp();
+    packOut.write(data.data(), data.size());
+    if (!packOut.good()) {
+      llvm::errs() << "\nError: failed writing into pack file " << packFilename
+                   << "\n";
+      return false;
+    }
+    blobs.emplace_back(offset, data.size(), hash);
+    blobID = blobs.size() - 1;
+    blobIdOfHash[hash] = blobID;
+    return true;
+  }
+
+public:
+  MutantsPack() : writable(false) {}
+
+  ~MutantsPack() {
+    if (packOut.is_open())
+      packOut.close();
+  }
+
+  /// \brief Open the pack for writing.
+  /// \param modFileName is the name the mutants' module files should have when
+  /// unpacked (e.g. 'prog.bc')
+  bool create(std::string const &packFile, std::string const &indexFile,
+              std::string const &modFileName) {
+    packFilename = packFile;
+    indexFilename = indexFile;
+    moduleFileName = modFileName;
+    packOut.open(packFilename, std::ios::out | std::ios::binary |
+                                   std::ios::trunc);
+    if (!packOut.is_open()) {
+      llvm::errs() << "Unable to open pack file for write: " << packFilename
+                   << "\n";
+      return false;
+    }
+    packOut.write(getPackMagic(), std::strlen(getPackMagic()));
+    writable = true;
+    return true;
+  }
+
+  /// \brief Add the module (serialized) of the mutant with ID 'mutantID'.
+  /// \param funcModuleName is the name of the function module, added with
+  /// addFunctionModule, that must be linked with the mutant's. Empty when the
+  /// mutant's module is a complete program.
+  /// \return false if the module could not be added (see addBlob)
+  bool addMutant(unsigned mutantID, llvm::StringRef data,
+                 std::string const &funcModuleName = "") {
+    assert(mutants.count(mutantID) == 0 && "Mutant added twice in the pack");
+    assert((funcModuleName.empty() || funcModuleBlobs.count(funcModuleName)) &&
+           "The function module must be added before its mutants");
+    unsigned blobID;
+    if (!addBlob(data, blobID))
+      return false;
+    mutants[mutantID] = MutantEntry(blobID, funcModuleName);
+    return true;
+  }
+
+  /// \brief Add the mutant with ID 'mutantID' as the function delta 'data'
+  /// against the original program's module (the mutant with ID 0).
+  /// \return false if the delta could not be added (see addBlob)
+  bool addDeltaMutant(unsigned mutantID, llvm::StringRef data) {
+    assert(mutantID != 0 && "The original cannot be a delta");
+    assert(mutants.count(mutantID) == 0 && "Mutant added twice in the pack");
+    unsigned blobID;
+    if (!addBlob(data, blobID))
+      return false;
+    mutants[mutantID] = MutantEntry(blobID, "", true /*isDelta*/);
+    return true;
+  }
+
+  /// \brief Add the module of the program without the mutated function
+  /// 'funcName' (see FunctionToModule::martSplitFunctionsOutOfModule)
+  /// \return false if the module could not be added (see addBlob)
+  bool addFunctionModule(std::string const &funcName, llvm::StringRef data) {
+    assert(funcModuleBlobs.count(funcName) == 0 &&
+           "Function module added twice in the pack");
+    unsigned blobID;
+    if (!addBlob(data, blobID))
+      return false;
+    funcModuleBlobs[funcName] = blobID;
+    return true;
+  }
+
+  /// \brief close the pack file and write the index and, if
+  /// 'duplicatesJsonFile' is not empty, the duplicate mutants found at write
+  /// time, in the same format as CompileAllMuts.sh's 'fdupes_duplicates.json'
+  bool finalize(std::string const &duplicatesJsonFile = "") {
+    assert(writable && "finalizing a pack not opened for write");
+    packOut.close();
+    writable = false;
+
+    std::ofstream idx(indexFilename);
+    if (!idx.is_open()) {
+      llvm::errs() << "Unable to open pack index file for write: "
+                   << indexFilename << "\n";
+      return false;
+    }
+    idx << "N " << moduleFileName << "\n";
+    for (unsigned b = 0; b < blobs.size(); ++b)
+      idx << "B " << b << " " << blobs[b].offset << " " << blobs[b].size << " "
+          << blobs[b].hash << "\n";
+    for (auto &fm : funcModuleBlobs)
+      idx << "F " << fm.second << " " << fm.first << "\n";
+    for (auto &m : mutants) {
+      if (m.second.isDelta) {
+        idx << "D " << m.first << " " << m.second.blobID << "\n";
+        continue;
+      }
+      idx << "M " << m.first << " " << m.second.blobID;
+      if (!m.second.funcModuleName.empty())
+        idx << " " << m.second.funcModuleName;
+      idx << "\n";
+    }
+    idx.close();
+
+    if (!duplicatesJsonFile.empty()) {
+      // Mutants sharing the same blob (and function module) are duplicates.
+      // The smallest ID is kept.
+      std::map<std::pair<unsigned, std::string>, std::vector<unsigned>> groups;
+      for (auto &m : mutants)
+        groups[std::make_pair(m.second.blobID, m.second.funcModuleName)]
+            .push_back(m.first);
+      std::map<unsigned, std::vector<unsigned> const *> dupsByKept;
+      for (auto &g : groups)
+        if (g.second.size() > 1)
+          dupsByKept[g.second.front()] = &(g.second);
+      std::ofstream dupjs(duplicatesJsonFile);
+      if (!dupjs.is_open()) {
+        llvm::errs() << "Unable to open file for write: " << duplicatesJsonFile
+                     << "\n";
+        return false;
+      }
+      dupjs << "{";
+      bool isFirst = true;
+      for (auto &d : dupsByKept) {
+        dupjs << (isFirst ? "\n" : ",\n") << "    \"" << d.first << "\": [";
+        isFirst = false;
+        for (unsigned i = 1; i < d.second->size(); ++i)
+          dupjs << (i > 1 ? "," : "") << "\"" << d.second->at(i) << "\"";
+        dupjs << "]";
+      }
+      dupjs << "\n}\n";
+      dupjs.close();
+    }
+    return true;
+  }
+
+  /// \brief Open an existing pack for reading.
+  bool load(std::string const &packFile, std::string const &indexFile) {
+    packFilename = packFile;
+    indexFilename = indexFile;
+    blobs.clear();
+    blobIdOfHash.clear();
+    funcModuleBlobs.clear();
+    mutants.clear();
+
+    std::ifstream packIn(packFilename, std::ios::in | std::ios::binary);
+    if (!packIn.is_open()) {
+      llvm::errs() << "Unable to open pack file: " << packFilename << "\n";
+      return false;
+    }
+    std::string magic(std::strlen(getPackMagic()), '\0');
+    packIn.read(&magic[0], magic.size());
+    if (!packIn.good() || magic != getPackMagic()) {
+      llvm::errs() << "Invalid pack file (bad magic): " << packFilename << "\n";
+      return false;
+    }
+    packIn.close();
+
+    std::ifstream idx(indexFilename);
+    if (!idx.is_open()) {
+      llvm::errs() << "Unable to open pack index file: " << indexFilename
+                   << "\n";
+      return false;
+    }
+    std::string kind;
+    while (idx >> kind) {
+      if (kind == "N") {
+        idx >> moduleFileName;
+      } else if (kind == "B") {
+        unsigned b;
+        uint64_t offset, size;
+        std::string hash;
+        idx >> b >> offset >> size >> hash;
+        assert(b == blobs.size() && "Invalid pack index: blobs out of order");
+        blobs.emplace_back(offset, size, hash);
+        blobIdOfHash[hash] = b;
+      } else if (kind == "F") {
+        unsigned b;
+        std::string fname;
+        idx >> b >> fname;
+        funcModuleBlobs[fname] = b;
+      } else if (kind == "M") {
+        unsigned mid, b;
+        idx >> mid >> b;
+        std::string rest;
+        std::getline(idx, rest);
+        llvm::StringRef fname = llvm::StringRef(rest).trim();
+        mutants[mid] = MutantEntry(b, fname.str());
+      } else if (kind == "D") {
+        unsigned mid, b;
+        idx >> mid >> b;
+        mutants[mid] = MutantEntry(b, "", true /*isDelta*/);
+      } else {
+        llvm::errs() << "Invalid pack index record kind '" << kind << "' in "
+                     << indexFilename << "\n";
+        return false;
+      }
+      if (idx.fail()) {
+        llvm::errs() << "Invalid pack index: " << indexFilename << "\n";
+        return false;
+      }
+    }
+    return true;
+  }
+
+  std::string const &getModuleFileName() const { return moduleFileName; }
+  std::map<unsigned, MutantEntry> const &getMutants() const { return mutants; }
+  std::map<std::string, unsigned> const &getFunctionModules() const {
+    return funcModuleBlobs;
+  }
+  unsigned getNumBlobs() const { return blobs.size(); }
+
+  /// \brief read the content of blob 'blobID' into 'data'
+  bool readBlob(unsigned blobID, std::string &data) const {
+    if (blobID >= blobs.size()) {
+      llvm::errs() << "Invalid blob ID " << blobID << " for pack "
+                   << packFilename << "\n";
+      return false;
+    }
+    std::ifstream packIn(packFilename, std::ios::in | std::ios::binary);
+    if (!packIn.is_open()) {
+      llvm::errs() << "Unable to open pack file: " << packFilename << "\n";
+      return false;
+    }
+    data.resize(blobs[blobID].size);
+    packIn.seekg(blobs[blobID].offset);
+    packIn.read(&data[0], data.size());
+    if (!packIn.good() || computeHash(data) != blobs[blobID].hash) {
+      llvm::errs() << "Corrupted blob " << blobID << " in pack " << packFilename
+                   << "\n";
+      return false;
+    }
+    return true;
+  }
+
+  /// \brief write the content of blob 'blobID' into the file 'filename'
+  bool extractBlob(unsigned blobID, std::string const &filename) const {
+    std::string data;
+    if (!readBlob(blobID, data))
+      return false;
+    std::ofstream out(filename, std::ios::out | std::ios::binary);
+    if (!out.is_open()) {
+      llvm::errs() << "Unable to open file for write: " << filename << "\n";
+      return false;
+    }
+    out.write(data.data(), data.size());
+    return out.good();
+  }
+}; // class MutantsPack
+
+} // namespace mart
+
+#endif //#ifndef MutantsPack_h__
@@ -2,7 +2,11 @@
 #ifndef ReadWriteIRObj_h__
 #define ReadWriteIRObj_h__
 
+#include <climits> //PATH_MAX
+#include <cstdlib> //realpath
+#include <map>
 #include <string>
+#include <sys/stat.h> //stat
 //#include <fstream>
 #include <system_error> //error_code
 
@@ -17,6 +21,9 @@
 
 #include <llvm/IR/Module.h>
 #include <llvm/IRReader/IRReader.h>
+#if (LLVM_VERSION_MAJOR >= 4)
+#include <llvm/Support/Error.h> //toString
+#endif
 #include <llvm/Support/SourceMgr.h>
 #include <llvm/Support/raw_ostream.h>
 //#include <llvm/Support/raw_os_ostream.h>
@@ -41,6 +48,18 @@
 
 #include "llvm/Transforms/Utils/Cloning.h" //for CloneModule
 
+// For the mutants' function delta (see writeFunctionDeltaToBuffer) and the
+// scoped loading (see readIRScoped)
+#include <set>
+#include <vector>
+#if (LLVM_VERSION_MAJOR <= 3) && (LLVM_VERSION_MINOR < 5)
+#include "llvm/DebugInfo.h"
+#include "llvm/Linker.h" //for Linker
+#else
+#include "llvm/IR/DebugInfo.h"
+#include "llvm/Linker/Linker.h" //for Linker
+#endif
+
 namespace mart {
 
 class ReadWriteIRObj {
@@ -50,12 +69,11 @@ public:
   ReadWriteIRObj() : mBuf(nullptr) {}
   void setToModule(llvm::Module const *module) {
     std::string data;
-    llvm::raw_string_ostream OS(data);
-    llvm::WriteBitcodeToFile(module, OS);
+    writeIRToBuffer(module, data);
 #if (LLVM_VERSION_MAJOR <= 3) && (LLVM_VERSION_MINOR < 5)
-    mBuf.reset(llvm::MemoryBuffer::getMemBufferCopy(OS.str()));
+    mBuf.reset(llvm::MemoryBuffer::getMemBufferCopy(data));
 #else
-    mBuf = llvm::MemoryBuffer::getMemBufferCopy(OS.str());
+    mBuf = llvm::MemoryBuffer::getMemBufferCopy(data);
 #endif
   }
 
@@ -68,21 +86,31 @@ public:
 #endif
   }
 
-  inline llvm::Module *readIR() // (std::unique_ptr<llvm::Module> &module)
-  {
+  /// \brief parse the buffer into a new module of 'context'. The module must
+  /// be deleted before the context
+  inline llvm::Module *readIR(llvm::LLVMContext &context) {
     llvm::SMDiagnostic SMD;
 #if (LLVM_VERSION_MAJOR <= 3) && (LLVM_VERSION_MINOR < 5)
-    return (llvm::ParseIR(mBuf.get(), SMD, llvm::getGlobalContext()));
+    return (llvm::ParseIR(mBuf.get(), SMD, context));
 #elif (LLVM_VERSION_MAJOR <= 3) && (LLVM_VERSION_MINOR < 8)
     return (llvm::parseIR(llvm::MemoryBufferRef(mBuf->getBuffer(),
                                                 mBuf->getBufferIdentifier()),
-                          SMD, llvm::getGlobalContext())
+                          SMD, context)
                 .release());
-#elif (LLVM_VERSION_MAJOR <= 3) && (LLVM_VERSION_MINOR < 9)
-    return (llvm::parseIR(*mBuf, SMD, llvm::getGlobalContext()).release());
+#else
+    return (llvm::parseIR(*mBuf, SMD, context).release());
+#endif
+  }
+
+  /// \brief parse the buffer into a module of a context that lives until the
+  /// end of the program (what it accumulates is never released)
+  inline llvm::Module *readIR() // (std::unique_ptr<llvm::Module> &module)
+  {
+#if (LLVM_VERSION_MAJOR <= 3) && (LLVM_VERSION_MINOR < 9)
+    return readIR(llvm::getGlobalContext());
 #else
     static llvm::LLVMContext getGlobalContext;
-    return (llvm::parseIR(*mBuf, SMD, getGlobalContext).release());
+    return readIR(getGlobalContext);
 #endif
   }
 
@@ -94,16 +122,112 @@ public:
 #endif
   }
 
+  /// \brief context of the modules read from files (they can be linked
+  /// together)
+  static llvm::LLVMContext &getFilesContext() {
+#if (LLVM_VERSION_MAJOR <= 3) && (LLVM_VERSION_MINOR < 9)
+    return llvm::getGlobalContext();
+#else
+    static llvm::LLVMContext getGlobalContext;
+    return getGlobalContext;
+#endif
+  }
+
+  /// \brief absolute path and modification stamp of a file, to check that a
+  /// file did not change since it was loaded (false if it does not exist)
+  static bool getFileStamp(std::string const &filename, std::string &absPath,
+                           std::pair<time_t, off_t> &stamp) {
+    char buf[PATH_MAX];
+    struct stat st;
+    if (!realpath(filename.c_str(), buf) || stat(buf, &st) != 0)
+      return false;
+    absPath.assign(buf);
+    stamp = std::make_pair(st.st_mtime, st.st_size);
+    return true;
+  }
+
+  /// Module of a file, kept resident in memory by the daemon (see
+  /// tools/Mart-Daemon.cpp), in the files context
+  struct ResidentModule {
+    std::pair<time_t, off_t> stamp;
+    std::unique_ptr<llvm::Module> module;
+  };
+
+  /// \brief resident modules, by absolute file name. The daemon runs each job
+  /// in a forked process: readIR gives away there the resident module of the
+  /// file instead of parsing it again, without changing the daemon's one
+  static std::map<std::string, ResidentModule> &getResidentModules() {
+    // The context must be destroyed after its modules
+    getFilesContext();
+    static std::map<std::string, ResidentModule> residentModules;
+    return residentModules;
+  }
+
+  /// \brief parse the file 'filename' and keep its module resident (parsed
+  /// again if the file changed since)
+  static bool loadResidentModule(std::string const &filename) {
+    std::string absPath;
+    std::pair<time_t, off_t> stamp;
+    if (!getFileStamp(filename, absPath, stamp)) {
+      llvm::errs() << "Error: cannot access the file '" << filename << "'\n";
+      return false;
+    }
+    auto &residentModules = getResidentModules();
+    auto it = residentModules.find(absPath);
+    if (it != residentModules.end() && it->second.stamp == stamp &&
+        it->second.module)
+      return true;
+    std::unique_ptr<llvm::Module> module;
+    if (!parseIRFile(absPath, module))
+      return false;
+    ResidentModule &resident = residentModules[absPath];
+    resident.stamp = stamp;
+    resident.module = std::move(module);
+    return true;
+  }
+
+  /// \brief parse again the resident modules whose file changed. Return false
+  /// if any of them failed (it is not resident anymore)
+  static bool refreshResidentModules() {
+    auto &residentModules = getResidentModules();
+    std::vector<std::string> files;
+    for (auto &resident : residentModules)
+      files.push_back(resident.first);
+    bool ok = true;
+    for (auto &file : files) {
+      if (!loadResidentModule(file)) {
+        residentModules.erase(file);
+        ok = false;
+      }
+    }
+    return ok;
+  }
+
   static bool readIR(const std::string filename,
                      std::unique_ptr<llvm::Module> &module) {
+    auto &residentModules = getResidentModules();
+    if (!residentModules.empty()) {
+      std::string absPath;
+      std::pair<time_t, off_t> stamp;
+      if (getFileStamp(filename, absPath, stamp)) {
+        auto it = residentModules.find(absPath);
+        if (it != residentModules.end() && it->second.stamp == stamp &&
+            it->second.module) {
+          module = std::move(it->second.module);
+          return true;
+        }
+      }
+    }
+    return parseIRFile(filename, module);
+  }
+
+  static bool parseIRFile(const std::string filename,
+                          std::unique_ptr<llvm::Module> &module) {
     llvm::SMDiagnostic SMD;
 #if (LLVM_VERSION_MAJOR <= 3) && (LLVM_VERSION_MINOR < 5)
-    module.reset(llvm::ParseIRFile(filename, SMD, llvm::getGlobalContext()));
-#elif (LLVM_VERSION_MAJOR <= 3) && (LLVM_VERSION_MINOR < 9)
-    module = llvm::parseIRFile(filename, SMD, llvm::getGlobalContext());
+    module.reset(llvm::ParseIRFile(filename, SMD, getFilesContext()));
 #else
-    static llvm::LLVMContext getGlobalContext;
-    module = llvm::parseIRFile(filename, SMD, getGlobalContext);
+    module = llvm::parseIRFile(filename, SMD, getFilesContext());
 #endif
 
     if (!module) {
@@ -137,8 +261,645 @@ public:
     return true;
   }
 
+  /// \brief serialize the bitcode of 'module' into 'data' (no file written)
+  static void writeIRToBuffer(const llvm::Module *module, std::string &data) {
+    data.clear();
+    llvm::raw_string_ostream OS(data);
+    llvm::WriteBitcodeToFile(module, OS);
+    OS.flush();
+  }
+
+  /// \brief parse the IR in 'data' into a new module of context 'context'
+  static llvm::Module *readIRFromBuffer(llvm::StringRef data,
+                                        llvm::LLVMContext &context) {
+    llvm::SMDiagnostic SMD;
+    llvm::Module *module;
+#if (LLVM_VERSION_MAJOR <= 3) && (LLVM_VERSION_MINOR < 5)
+    module = llvm::ParseIR(llvm::MemoryBuffer::getMemBuffer(data, "", false),
+                           SMD, context);
+#else
+    module = llvm::parseIR(llvm::MemoryBufferRef(data, ""), SMD, context)
+                 .release();
+#endif
+    if (!module) {
+      llvm::errs() << "Failed parsing IR buffer:\n";
+      SMD.print("MART", llvm::errs());
+    }
+    return module;
+  }
+
+  /// \brief Name given, in a function delta, to the declaration of the
+  /// unnamed global variable at position <index> of the original module
+  static std::string getDeltaUnnamedGlobalName(unsigned index) {
+    return "__mart_delta_unnamed_global." + std::to_string(index);
+  }
+
+  /// \brief serialize into 'data' the delta of mutant function 'mutF' against
+  /// the original module 'origM' (mutF's references are to origM's globals).
+  /// The delta is a module with only mutF's definition and the declarations
+  /// of the globals that it uses (also through its personality function,
+  /// prefix and prologue data). Debug information is stripped from it.
+  /// readIRWithDelta rebuilds the complete mutant module.
+  static void writeFunctionDeltaToBuffer(llvm::Function *mutF,
+                                         llvm::Module const *origM,
+                                         std::string &data) {
+    llvm::Module deltaM(origM->getModuleIdentifier(), mutF->getContext());
+    deltaM.setDataLayout(origM->getDataLayout());
+    deltaM.setTargetTriple(origM->getTargetTriple());
+
+    llvm::Function *newF = llvm::Function::Create(
+        mutF->getFunctionType(), llvm::GlobalValue::ExternalLinkage,
+        mutF->getName(), &deltaM);
+    newF->setAttributes(mutF->getAttributes());
+    newF->setCallingConv(mutF->getCallingConv());
+
+    llvm::ValueToValueMapTy vmap;
+
+    // Collect the globals used by mutF (also within constant expressions)
+    std::vector<llvm::Constant *> todo;
+    std::set<llvm::Constant *> done;
+    std::vector<llvm::GlobalValue *> usedGlobals;
+    for (auto &BB : *mutF)
+      for (auto &I : BB)
+        for (unsigned i = 0, e = I.getNumOperands(); i < e; ++i)
+          if (auto *C = llvm::dyn_cast<llvm::Constant>(I.getOperand(i)))
+            todo.push_back(C);
+#if (LLVM_VERSION_MAJOR > 3) || (LLVM_VERSION_MINOR >= 7)
+    if (mutF->hasPersonalityFn())
+      todo.push_back(mutF->getPersonalityFn());
+    if (mutF->hasPrefixData())
+      todo.push_back(mutF->getPrefixData());
+    if (mutF->hasPrologueData())
+      todo.push_back(mutF->getPrologueData());
+#endif
+    while (!todo.empty()) {
+      llvm::Constant *C = todo.back();
+      todo.pop_back();
+      if (!done.insert(C).second)
+        continue;
+      if (auto *GV = llvm::dyn_cast<llvm::GlobalValue>(C)) {
+        usedGlobals.push_back(GV);
+        continue;
+      }
+      for (unsigned i = 0, e = C->getNumOperands(); i < e; ++i)
+        if (auto *opC = llvm::dyn_cast<llvm::Constant>(C->getOperand(i)))
+          todo.push_back(opC);
+    }
+
+    for (auto *GV : usedGlobals) {
+      if (GV->getName() == mutF->getName()) { // recursive call
+        vmap[GV] = newF;
+        continue;
+      }
+      std::string name = GV->getName().str();
+      if (!GV->hasName()) {
+        unsigned index = 0;
+        for (auto gIt = origM->global_begin(), gE = origM->global_end();
+             gIt != gE && &*gIt != GV; ++gIt)
+          ++index;
+        if (index == origM->getGlobalList().size()) {
+          llvm::errs() << "\nError: the mutant function '" << mutF->getName()
+                       << "' uses an unnamed global that is not a variable "
+                          "of the original module.\n";
+          assert(false && "Unsupported unnamed global for function delta");
+        }
+        name = getDeltaUnnamedGlobalName(index);
+      }
+      llvm::Type *valTy = GV->getType()->getElementType();
+      if (auto *FTy = llvm::dyn_cast<llvm::FunctionType>(valTy)) {
+        llvm::Function *declF = llvm::Function::Create(
+            FTy, llvm::GlobalValue::ExternalLinkage, name, &deltaM);
+        if (auto *F = llvm::dyn_cast<llvm::Function>(GV)) {
+          declF->setAttributes(F->getAttributes());
+          declF->setCallingConv(F->getCallingConv());
+        }
+        vmap[GV] = declF;
+      } else {
+        auto *origGV = llvm::dyn_cast<llvm::GlobalVariable>(GV);
+        vmap[GV] = new llvm::GlobalVariable(
+            deltaM, valTy, origGV ? origGV->isConstant() : false,
+            llvm::GlobalValue::ExternalLinkage, nullptr, name, nullptr,
+            GV->getThreadLocalMode(), GV->getType()->getAddressSpace());
+      }
+    }
+
+    llvm::Function::arg_iterator destI = newF->arg_begin();
+#if (LLVM_VERSION_MAJOR <= 3) && (LLVM_VERSION_MINOR < 5)
+    for (auto argIt = mutF->arg_begin(), argE = mutF->arg_end();
+         argIt != argE; ++argIt)
+      vmap[&*argIt] = &*destI++;
+#else
+    for (llvm::Argument &aII : mutF->args())
+      vmap[&aII] = &*destI++;
+#endif
+    llvm::SmallVector<llvm::ReturnInst *, 8> Returns;
+    llvm::CloneFunctionInto(newF, mutF, vmap, true, Returns);
+#if (LLVM_VERSION_MAJOR > 3) || (LLVM_VERSION_MINOR >= 7)
+    // Refer to the delta's declarations (not to the globals of origM)
+    if (mutF->hasPersonalityFn())
+      newF->setPersonalityFn(llvm::MapValue(mutF->getPersonalityFn(), vmap));
+    if (mutF->hasPrefixData())
+      newF->setPrefixData(llvm::MapValue(mutF->getPrefixData(), vmap));
+    if (mutF->hasPrologueData())
+      newF->setPrologueData(llvm::MapValue(mutF->getPrologueData(), vmap));
+#endif
+
+    llvm::StripDebugInfo(deltaM);
+    writeIRToBuffer(&deltaM, data);
+  }
+
+  /// \brief rebuild into 'module' the complete mutant module from the
+  /// original module IR 'origData' and the mutant function delta 'deltaData'
+  /// (created with writeFunctionDeltaToBuffer). The function in the original
+  /// is replaced by the delta's one.
+  static bool readIRWithDelta(llvm::StringRef origData,
+                              llvm::StringRef deltaData,
+                              std::unique_ptr<llvm::Module> &module,
+                              llvm::LLVMContext &context) {
+    module.reset(readIRFromBuffer(origData, context));
+    std::unique_ptr<llvm::Module> deltaM(readIRFromBuffer(deltaData, context));
+    if (!module || !deltaM)
+      return false;
+
+    llvm::Function *mutF = nullptr;
+    for (auto &F : *deltaM)
+      if (!F.isDeclaration()) {
+        assert(!mutF && "A function delta must define a single function");
+        mutF = &F;
+      }
+    assert(mutF && "A function delta must define a function");
+    std::string funcName = mutF->getName().str();
+    llvm::Function *origF = module->getFunction(funcName);
+    if (!origF || origF->isDeclaration()) {
+      llvm::errs() << "Function delta's function '" << funcName
+                   << "' is not defined in the original module\n";
+      return false;
+    }
+
+    // Make the globals used by the delta visible to the linker: temporarily
+    // give a name to the unnamed ones and make the local ones external.
+    std::vector<std::pair<llvm::GlobalValue *, llvm::GlobalValue::LinkageTypes>>
+        localGlobals;
+    std::vector<llvm::GlobalValue *> unnamedGlobals;
+    unsigned index = 0;
+    for (auto gIt = module->global_begin(), gE = module->global_end();
+         gIt != gE; ++gIt, ++index) {
+      if (!gIt->hasName() &&
+          deltaM->getNamedValue(getDeltaUnnamedGlobalName(index))) {
+        gIt->setName(getDeltaUnnamedGlobalName(index));
+        unnamedGlobals.push_back(&*gIt);
+      }
+    }
+    for (auto &G : *deltaM) {
+      llvm::GlobalValue *GV = module->getNamedValue(G.getName());
+      if (GV && GV->hasLocalLinkage() && GV != origF) {
+        localGlobals.emplace_back(GV, GV->getLinkage());
+        GV->setLinkage(llvm::GlobalValue::ExternalLinkage);
+      }
+    }
+    for (auto gIt = deltaM->global_begin(), gE = deltaM->global_end();
+         gIt != gE; ++gIt) {
+      llvm::GlobalValue *GV = module->getNamedValue(gIt->getName());
+      if (GV && GV->hasLocalLinkage()) {
+        localGlobals.emplace_back(GV, GV->getLinkage());
+        GV->setLinkage(llvm::GlobalValue::ExternalLinkage);
+      }
+    }
+
+    // Make the original function a declaration, to be defined by the delta
+    auto origFLinkage = origF->getLinkage();
+#if (LLVM_VERSION_MAJOR <= 3) && (LLVM_VERSION_MINOR < 5)
+    origF->deleteBody();
+#else
+    origF->setComdat(nullptr);
+    origF->deleteBody();
+#endif
+
+#if (LLVM_VERSION_MAJOR <= 3) && (LLVM_VERSION_MINOR < 8)
+    llvm::Linker linker(module.get());
+    std::string ErrorMsg;
+    if (linker.linkInModule(deltaM.get(), &ErrorMsg)) {
+      llvm::errs() << "Failed to link function delta of '" << funcName
+                   << "' with the original module: " << ErrorMsg << "\n";
+      return false;
+    }
+    deltaM.reset(nullptr);
+#else
+    llvm::Linker linker(*module);
+    if (linker.linkInModule(std::move(deltaM))) {
+      llvm::errs() << "Failed to link function delta of '" << funcName
+                   << "' with the original module\n";
+      return false;
+    }
+#endif
+
+    // Restore
+    module->getFunction(funcName)->setLinkage(origFLinkage);
+    for (auto &lg : localGlobals)
+      lg.first->setLinkage(lg.second);
+    for (auto *GV : unnamedGlobals)
+      GV->setName("");
+    return true;
+  }
+
+  /// \brief replace, in 'module', the bodies of the functions 'funcNames' by
+  /// their bodies in 'srcM', a module derived from the same module (e.g. the
+  /// meta module of another mutation shard, see mart-merge). The other
+  /// globals that 'srcM' defines are taken from 'module' when it has them, and
+  /// added to 'module' otherwise.
+  static bool linkFunctionsBodies(llvm::Module &module,
+                                  std::unique_ptr<llvm::Module> srcM,
+                                  std::set<std::string> const &funcNames) {
+    // Match the unnamed global variables of both modules by position (the
+    // input module's globals come first in both): temporarily name them.
+    std::vector<llvm::GlobalValue *> unnamedGlobals;
+    unsigned index = 0;
+    for (auto gIt = module.global_begin(), gE = module.global_end(),
+              sgIt = srcM->global_begin(), sgE = srcM->global_end();
+         gIt != gE && sgIt != sgE; ++gIt, ++sgIt, ++index) {
+      if (!gIt->hasName() && !sgIt->hasName()) {
+        gIt->setName(getDeltaUnnamedGlobalName(index));
+        sgIt->setName(getDeltaUnnamedGlobalName(index));
+        unnamedGlobals.push_back(&*gIt);
+      }
+    }
+
+    auto toDeclaration = [](llvm::GlobalObject &GO) {
+#if !((LLVM_VERSION_MAJOR <= 3) && (LLVM_VERSION_MINOR < 5))
+      GO.setComdat(nullptr);
+#endif
+      if (auto *F = llvm::dyn_cast<llvm::Function>(&GO)) {
+        F->deleteBody();
+      } else {
+        auto *GV = llvm::cast<llvm::GlobalVariable>(&GO);
+        GV->setInitializer(nullptr);
+        GV->setLinkage(llvm::GlobalValue::ExternalLinkage);
+      }
+    };
+
+    // The functions to replace are declared in 'module', defined (external)
+    // in 'srcM'. (The linker replaces the declarations: restored by name)
+    std::vector<std::pair<std::string, llvm::GlobalValue::LinkageTypes>>
+        funcLinkages;
+    for (auto &name : funcNames) {
+      llvm::Function *F = module.getFunction(name);
+      llvm::Function *srcF = srcM->getFunction(name);
+      if (!F || !srcF || srcF->isDeclaration()) {
+        llvm::errs() << "Function '" << name
+                     << "' to link is not defined in the modules\n";
+        return false;
+      }
+      funcLinkages.emplace_back(name, F->getLinkage());
+      if (!F->isDeclaration())
+        toDeclaration(*F);
+#if !((LLVM_VERSION_MAJOR <= 3) && (LLVM_VERSION_MINOR < 5))
+      srcF->setComdat(nullptr);
+#endif
+      srcF->setLinkage(llvm::GlobalValue::ExternalLinkage);
+    }
+    // The other definitions of 'srcM' that 'module' has become declarations
+    for (auto &F : *srcM)
+      if (!F.isDeclaration() && !funcNames.count(F.getName().str()) &&
+          module.getNamedValue(F.getName()))
+        toDeclaration(F);
+    // (The appending globals, such as the constructors list, cannot be
+    // declarations: 'module' has them already)
+    std::vector<llvm::GlobalVariable *> srcAppendings;
+    for (auto gIt = srcM->global_begin(), gE = srcM->global_end(); gIt != gE;
+         ++gIt) {
+      if (gIt->isDeclaration() || !module.getNamedValue(gIt->getName()))
+        continue;
+      if (gIt->hasAppendingLinkage())
+        srcAppendings.push_back(&*gIt);
+      else
+        toDeclaration(*gIt);
+    }
+    for (auto *GV : srcAppendings)
+      GV->eraseFromParent();
+
+    // Make the local globals of 'module' that 'srcM' uses visible to the
+    // linker
+    std::vector<std::pair<llvm::GlobalValue *, llvm::GlobalValue::LinkageTypes>>
+        localGlobals;
+    auto exposeLocal = [&](llvm::GlobalValue const &srcGV) {
+      if (!srcGV.isDeclaration() || funcNames.count(srcGV.getName().str()))
+        return;
+      llvm::GlobalValue *GV = module.getNamedValue(srcGV.getName());
+      if (GV && GV->hasLocalLinkage()) {
+        localGlobals.emplace_back(GV, GV->getLinkage());
+        GV->setLinkage(llvm::GlobalValue::ExternalLinkage);
+      }
+    };
+    for (auto &F : *srcM)
+      exposeLocal(F);
+    for (auto gIt = srcM->global_begin(), gE = srcM->global_end(); gIt != gE;
+         ++gIt)
+      exposeLocal(*gIt);
+
+#if (LLVM_VERSION_MAJOR <= 3) && (LLVM_VERSION_MINOR < 8)
+    llvm::Linker linker(&module);
+    std::string ErrorMsg;
+    if (linker.linkInModule(srcM.get(), &ErrorMsg)) {
+      llvm::errs() << "Failed to link the functions bodies into the module: "
+                   << ErrorMsg << "\n";
+      return false;
+    }
+    srcM.reset(nullptr);
+#else
+    llvm::Linker linker(module);
+    if (linker.linkInModule(std::move(srcM))) {
+      llvm::errs() << "Failed to link the functions bodies into the module\n";
+      return false;
+    }
+#endif
+
+    // Restore
+    for (auto &fl : funcLinkages)
+      module.getFunction(fl.first)->setLinkage(fl.second);
+    for (auto &lg : localGlobals)
+      lg.first->setLinkage(lg.second);
+    for (auto *GV : unnamedGlobals)
+      GV->setName("");
+    return true;
+  }
+
+  /// \brief Name given, with scoped loading, to the unnamed global variable
+  /// at position <index> of the input module
+  static std::string getScopeUnnamedGlobalName(unsigned index) {
+    return getScopeUnnamedGlobalPrefix() + std::to_string(index);
+  }
+  static std::string getScopeUnnamedGlobalPrefix() {
+    return "__mart_scope_unnamed_global.";
+  }
+
+  /// \brief The functions out of the mutation scope, put aside by the scoped
+  /// loading (see readIRScoped) and linked back at emission (linkScopeRest)
+  struct ScopeRest {
+    /// bitcode of the input module (read once), whose functions out of
+    /// 'scopeFuncs' are only materialized at emission
+    std::string data;
+    std::string filename;
+    std::set<std::string> scopeFuncs;
+
+    /// the functions out of scope, read once from 'data' and prepared for
+    /// the linking (see prepareScopeRest), then cloned for every module of
+    /// the same context that is linked. Release it before its context is
+    /// destroyed.
+    std::unique_ptr<llvm::Module> prepared;
+    /// the functions of 'prepared' with local linkage (made external)
+    std::vector<std::pair<std::string, llvm::GlobalValue::LinkageTypes>>
+        localDefs;
+
+    void releasePrepared() {
+      prepared.reset(nullptr);
+      localDefs.clear();
+    }
+  };
+
+  /// \brief read the bitcode 'data' (of the file 'filename') into 'module'
+  /// of 'context', materializing only the bodies of the functions that are
+  /// in 'scopeFuncs' ('keepScopeBodies' true) or that are not in it
+  /// ('keepScopeBodies' false). The others are left as declarations.
+  /// Before LLVM 3.8, the whole module is read then the bodies are deleted.
+  static bool readIRPartial(llvm::StringRef data, const std::string &filename,
+                            std::set<std::string> const &scopeFuncs,
+                            bool keepScopeBodies, llvm::LLVMContext &context,
+                            std::unique_ptr<llvm::Module> &module) {
+    llvm::SMDiagnostic SMD;
+#if (LLVM_VERSION_MAJOR <= 3) && (LLVM_VERSION_MINOR < 5)
+    module.reset(llvm::ParseIR(
+        llvm::MemoryBuffer::getMemBuffer(data, filename, false), SMD, context));
+#elif (LLVM_VERSION_MAJOR <= 3) && (LLVM_VERSION_MINOR < 8)
+    module = llvm::parseIR(llvm::MemoryBufferRef(data, filename), SMD, context);
+#else
+    module = llvm::getLazyIRModule(
+        llvm::MemoryBuffer::getMemBuffer(data, filename, false), SMD, context);
+#endif
+    if (!module) {
+      llvm::errs() << "Failed parsing '" << filename << "' file:\n";
+      SMD.print("MART", llvm::errs());
+      return false;
+    }
+
+    // Name the unnamed globals the same way in all the parts of the module,
+    // so that the parts can be linked together
+    unsigned index = 0;
+    for (auto gIt = module->global_begin(), gE = module->global_end();
+         gIt != gE; ++gIt, ++index)
+      if (!gIt->hasName())
+        gIt->setName(getScopeUnnamedGlobalName(index));
+
+    for (auto &F : *module) {
+      if (F.isDeclaration())
+        continue;
+      if ((scopeFuncs.count(F.getName().str()) > 0) != keepScopeBodies) {
+        // An unmaterialized body is dropped without being read
+#if (LLVM_VERSION_MAJOR > 3) || (LLVM_VERSION_MINOR >= 5)
+        F.setComdat(nullptr);
+#endif
+        F.deleteBody();
+        continue;
+      }
+#if (LLVM_VERSION_MAJOR <= 3) && (LLVM_VERSION_MINOR < 8)
+#elif (LLVM_VERSION_MAJOR <= 3)
+      if (std::error_code EC = F.materialize()) {
+        llvm::errs() << "Failed to read function '" << F.getName()
+                     << "' from '" << filename << "': " << EC.message()
+                     << "\n";
+        return false;
+      }
+#else
+      if (llvm::Error Err = F.materialize()) {
+        llvm::errs() << "Failed to read function '" << F.getName()
+                     << "' from '" << filename
+                     << "': " << llvm::toString(std::move(Err)) << "\n";
+        return false;
+      }
+#endif
+    }
+
+    // Nothing is left to materialize, this completes the reading of the module
+#if (LLVM_VERSION_MAJOR <= 3) && (LLVM_VERSION_MINOR < 8)
+#elif (LLVM_VERSION_MAJOR <= 3)
+    if (std::error_code EC = module->materializeAll()) {
+      llvm::errs() << "Failed reading '" << filename << "': " << EC.message()
+                   << "\n";
+      return false;
+    }
+#else
+    if (llvm::Error Err = module->materializeAll()) {
+      llvm::errs() << "Failed reading '" << filename
+                   << "': " << llvm::toString(std::move(Err)) << "\n";
+      return false;
+    }
+#endif
+    return true;
+  }
+
+  /// \brief scoped loading: read into 'module' the bitcode file 'filename'
+  /// with only the bodies of the functions in 'scopeFuncs' (the functions to
+  /// mutate). The file's data is kept in 'rest', from which the other
+  /// functions' bodies are read when linked back into the modules written
+  /// (see linkScopeRest).
+  static bool readIRScoped(const std::string filename,
+                           std::set<std::string> const &scopeFuncs,
+                           std::unique_ptr<llvm::Module> &module,
+                           ScopeRest &rest) {
+#if (LLVM_VERSION_MAJOR <= 3) && (LLVM_VERSION_MINOR < 5)
+    llvm::OwningPtr<llvm::MemoryBuffer> fileBuf;
+    if (llvm::error_code EC = llvm::MemoryBuffer::getFile(filename, fileBuf)) {
+      llvm::errs() << "Failed reading '" << filename << "': " << EC.message()
+                   << "\n";
+      return false;
+    }
+#else
+    auto fileBuf = llvm::MemoryBuffer::getFile(filename);
+    if (std::error_code EC = fileBuf.getError()) {
+      llvm::errs() << "Failed reading '" << filename << "': " << EC.message()
+                   << "\n";
+      return false;
+    }
+#endif
+    rest.data.assign((*fileBuf)->getBufferStart(), (*fileBuf)->getBufferSize());
+    rest.filename = filename;
+    rest.scopeFuncs = scopeFuncs;
+    return readIRPartial(rest.data, rest.filename, rest.scopeFuncs, true,
+                         getFilesContext(), module);
+  }
+
+  /// \brief read the functions put aside by the scoped loading, from 'rest',
+  /// into 'rest.prepared' of 'context', ready to be linked: the functions with
+  /// local linkage are made external, the global variables and aliases are
+  /// declarations.
+  static bool prepareScopeRest(ScopeRest &rest, llvm::LLVMContext &context) {
+    rest.releasePrepared();
+    if (!readIRPartial(rest.data, rest.filename, rest.scopeFuncs, false,
+                       context, rest.prepared))
+      return false;
+    llvm::Module *restM = rest.prepared.get();
+
+    for (auto &F : *restM) {
+      if (!F.isDeclaration() && F.hasLocalLinkage()) {
+        rest.localDefs.emplace_back(F.getName().str(), F.getLinkage());
+        F.setLinkage(llvm::GlobalValue::ExternalLinkage);
+      }
+    }
+
+    // The global variables and aliases are defined in the linked modules.
+    // The special globals (llvm.used, llvm.global_ctors...) only refer to
+    // definitions, they are removed.
+    std::vector<llvm::GlobalVariable *> specialGlobals;
+    for (auto gIt = restM->global_begin(), gE = restM->global_end();
+         gIt != gE; ++gIt) {
+      if (gIt->getName().startswith("llvm.")) {
+        specialGlobals.push_back(&*gIt);
+      } else if (!gIt->isDeclaration()) {
+        gIt->setInitializer(nullptr);
+#if (LLVM_VERSION_MAJOR > 3) || (LLVM_VERSION_MINOR >= 5)
+        gIt->setComdat(nullptr);
+#endif
+        gIt->setLinkage(llvm::GlobalValue::ExternalLinkage);
+      }
+    }
+    for (auto *GV : specialGlobals)
+      GV->eraseFromParent();
+    std::vector<llvm::GlobalAlias *> aliases;
+    for (auto aIt = restM->alias_begin(), aE = restM->alias_end(); aIt != aE;
+         ++aIt)
+      aliases.push_back(&*aIt);
+    for (auto *GA : aliases) {
+      llvm::Type *valTy = GA->getType()->getElementType();
+      llvm::GlobalValue *declGV;
+      if (auto *FTy = llvm::dyn_cast<llvm::FunctionType>(valTy))
+        declGV = llvm::Function::Create(
+            FTy, llvm::GlobalValue::ExternalLinkage, "", restM);
+      else
+        declGV = new llvm::GlobalVariable(*restM, valTy, false,
+                                          llvm::GlobalValue::ExternalLinkage,
+                                          nullptr, "");
+      declGV->takeName(GA);
+      GA->replaceAllUsesWith(declGV);
+      GA->eraseFromParent();
+    }
+    return true;
+  }
+
+  /// \brief link the functions put aside by the scoped loading, 'rest', into
+  /// 'module' (the scoped module or a module derived from it), which then is
+  /// a complete program. The rest is read once per context (see
+  /// ScopeRest::prepared). When 'restoreLocals' is false, the functions of
+  /// 'rest' with local linkage stay external in 'module', and the unnamed
+  /// globals keep their scope names: 'module' is written apart from modules
+  /// that refer to them (e.g. the mutants' function modules).
+  static bool linkScopeRest(llvm::Module &module, ScopeRest &rest,
+                            bool restoreLocals = true) {
+    if (!rest.prepared || &rest.prepared->getContext() != &module.getContext())
+      if (!prepareScopeRest(rest, module.getContext()))
+        return false;
+    std::unique_ptr<llvm::Module> restM(
+        cloneModuleAndRelease(rest.prepared.get()));
+
+    // Make the local globals of 'module' that the rest uses visible to the
+    // linker
+    std::vector<std::pair<llvm::GlobalValue *, llvm::GlobalValue::LinkageTypes>>
+        localGlobals;
+    auto exposeLocal = [&](llvm::GlobalValue const &restGV) {
+      if (!restGV.isDeclaration())
+        return;
+      llvm::GlobalValue *GV = module.getNamedValue(restGV.getName());
+      if (GV && GV->hasLocalLinkage()) {
+        localGlobals.emplace_back(GV, GV->getLinkage());
+        GV->setLinkage(llvm::GlobalValue::ExternalLinkage);
+      }
+    };
+    for (auto &F : *restM)
+      exposeLocal(F);
+    for (auto gIt = restM->global_begin(), gE = restM->global_end();
+         gIt != gE; ++gIt)
+      exposeLocal(*gIt);
+
+#if (LLVM_VERSION_MAJOR <= 3) && (LLVM_VERSION_MINOR < 8)
+    llvm::Linker linker(&module);
+    std::string ErrorMsg;
+    if (linker.linkInModule(restM.get(), &ErrorMsg)) {
+      llvm::errs() << "Failed to link the functions out of mutation scope "
+                      "with the module: "
+                   << ErrorMsg << "\n";
+      return false;
+    }
+    restM.reset(nullptr);
+#else
+    llvm::Linker linker(module);
+    if (linker.linkInModule(std::move(restM))) {
+      llvm::errs() << "Failed to link the functions out of mutation scope "
+                      "with the module\n";
+      return false;
+    }
+#endif
+
+    // Restore
+    for (auto &lg : localGlobals)
+      lg.first->setLinkage(lg.second);
+    if (restoreLocals) {
+      for (auto &ld : rest.localDefs) {
+        llvm::GlobalValue *GV = module.getNamedValue(ld.first);
+        assert(GV && "Function out of scope missing after linking");
+        GV->setLinkage(ld.second);
+      }
+      // Unname back the globals named by readIRPartial
+      std::string const unnamedPrefix = getScopeUnnamedGlobalPrefix();
+      for (auto gIt = module.global_begin(), gE = module.global_end();
+           gIt != gE; ++gIt)
+        if (gIt->getName().startswith(unnamedPrefix))
+          gIt->setName("");
+    }
+    return true;
+  }
+
 #ifdef MART_GENMU_OBJECTFILE
-  static bool writeObj(llvm::Module *module, const std::string filename) {
+  /// \brief create the target machine of the host, and set the module's data
+  /// layout and target triple for it. Return null on error
+  static llvm::TargetMachine *createHostTargetMachine(llvm::Module *module) {
     auto TargetTriple = llvm::sys::getDefaultTargetTriple();
     llvm::InitializeAllTargetInfos();
     llvm::InitializeAllTargets();
@@ -154,7 +915,7 @@ public:
     // TargetRegistry or we have a bogus target triple.
     if (!Target) {
       llvm::errs() << Error;
-      return 1;
+      return nullptr;
     }
 
     auto CPU = std::string("generic");
@@ -163,10 +924,18 @@ public:
     llvm::TargetOptions opt;
     auto RM = llvm::Optional<llvm::Reloc::Model>();
     auto TargetMachine =
-        Target->createTargetMachine(TargetTriple, CPU, Features, opt, *RM);
+        Target->createTargetMachine(TargetTriple, CPU, Features, opt, RM);
 
     module->setDataLayout(TargetMachine->createDataLayout());
     module->setTargetTriple(TargetTriple);
+    return TargetMachine;
+  }
+
+  static bool writeObj(llvm::Module *module, const std::string filename) {
+    std::unique_ptr<llvm::TargetMachine> TargetMachine(
+        createHostTargetMachine(module));
+    if (!TargetMachine)
+      return false;
 
 #if (LLVM_VERSION_MAJOR <= 3) && (LLVM_VERSION_MINOR < 5)
     std::string estr("");
@@ -190,7 +959,7 @@ public:
 
     if (TargetMachine->addPassesToEmitFile(pass, Out, FileType)) {
       llvm::errs() << "TargetMachine can't emit a file of this type";
-      return 1;
+      return false;
     }
 
     pass.run(*module);
@@ -198,6 +967,42 @@ public:
 
     return true;
   }
+
+  /// \brief compile 'module' for the host into the object file content 'data'
+  static bool writeObjToBuffer(llvm::Module *module, std::string &data) {
+#if (LLVM_VERSION_MAJOR <= 3) && (LLVM_VERSION_MINOR < 7)
+    llvm::errs() << "Error: writing an object file in memory needs LLVM 3.7 "
+                    "or later\n";
+    return false;
+#else
+    std::unique_ptr<llvm::TargetMachine> TargetMachine(
+        createHostTargetMachine(module));
+    if (!TargetMachine)
+      return false;
+
+    llvm::SmallVector<char, 0> buffer;
+    llvm::raw_svector_ostream Out(buffer);
+    llvm::legacy::PassManager pass;
+#if (LLVM_VERSION_MAJOR < 7)
+    bool cannotEmit = TargetMachine->addPassesToEmitFile(
+        pass, Out, llvm::TargetMachine::CGFT_ObjectFile);
+#elif (LLVM_VERSION_MAJOR < 10)
+    bool cannotEmit = TargetMachine->addPassesToEmitFile(
+        pass, Out, nullptr, llvm::TargetMachine::CGFT_ObjectFile);
+#else
+    bool cannotEmit = TargetMachine->addPassesToEmitFile(
+        pass, Out, nullptr, llvm::CGFT_ObjectFile);
+#endif
+    if (cannotEmit) {
+      llvm::errs() << "TargetMachine can't emit a file of this type";
+      return false;
+    }
+
+    pass.run(*module);
+    data.assign(buffer.begin(), buffer.end());
+    return true;
+#endif
+  }
 #endif //#ifdef MART_GENMU_OBJECTFILE
 };     // class ReadWriteIRObj
 
@@ -0,0 +1,261 @@
+/**
+ * -==== TestPrioritization.h
+ *
+ *                Mart Multi-Language LLVM Mutation Framework
+ *
+ * This file is distributed under the University of Illinois Open Source
+ * License. See LICENSE.TXT for details.
+ *
+ * \brief     Define the class TestPrioritizationIndex, the persistent index of
+ * the tests that killed the mutants in the previous runs, used to order the
+ * tests to execute on each mutant so that a killing test runs first.
+ *
+ * A mutant is identified, across runs and program revisions, by the hash of
+ * its (original) function, its type and its IR position in the function. The
+ * killers are recorded for the mutant, for its IR position (site, any type)
+ * and for its type in the function. The index file (text) has one record per
+ * line:
+ *      T <runtime> <test name>                      : test runtime (seconds)
+ *      M <func hash> <type> <IR pos> <killers...>   : killers of a mutant
+ *      S <func hash> <IR pos> <killers...>          : killers at an IR site
+ *      Y <func hash> <type> <killers...>            : killers of a type
+ * The IR position is the comma separated list of the instructions indexes.
+ * The killers are ordered from the most recent one.
+ */
+
+#ifndef TestPrioritization_h__
+#define TestPrioritization_h__
+
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <limits>
+#include <map>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "llvm/Support/raw_ostream.h"
+
+namespace mart {
+
+class TestPrioritizationIndex {
+public:
+  struct MutantKey {
+    std::string funcHash;
+    std::string typeName;
+    std::vector<unsigned> irPos;
+    MutantKey() {}
+    MutantKey(std::string const &h, std::string const &t,
+              std::vector<unsigned> const &p)
+        : funcHash(h), typeName(t), irPos(p) {}
+  };
+
+  /// Number of killers kept per record
+  static const unsigned kMaxKillers = 16;
+
+private:
+  typedef std::map<std::string, std::vector<std::string>> KillersMap;
+
+  /// Ordered (as the records) to have a deterministic index file
+  std::map<std::string, double> testRuntimes;
+  KillersMap mutantKillers; // key: '<func hash> <type> <IR pos>'
+  KillersMap siteKillers;   // key: '<func hash> <IR pos>'
+  KillersMap typeKillers;   // key: '<func hash> <type>'
+
+  static std::string posToString(std::vector<unsigned> const &irPos) {
+    if (irPos.empty())
+      return "-";
+    std::string str;
+    for (unsigned pos : irPos)
+      str += (str.empty() ? "" : ",") + std::to_string(pos);
+    return str;
+  }
+
+  static std::string mutantKey(MutantKey const &key) {
+    return key.funcHash + " " + key.typeName + " " + posToString(key.irPos);
+  }
+  static std::string siteKey(MutantKey const &key) {
+    return key.funcHash + " " + posToString(key.irPos);
+  }
+  static std::string typeKey(MutantKey const &key) {
+    return key.funcHash + " " + key.typeName;
+  }
+
+  /// \brief put 'killers' first in 'list', keeping the kMaxKillers first
+  static void addKillers(std::vector<std::string> &list,
+                         std::vector<std::string> const &killers) {
+    std::vector<std::string> merged(killers);
+    for (auto &test : list)
+      if (std::find(killers.begin(), killers.end(), test) == killers.end())
+        merged.push_back(test);
+    if (merged.size() > kMaxKillers)
+      merged.resize(kMaxKillers);
+    list.swap(merged);
+  }
+
+  static std::vector<std::string> const *findKillers(KillersMap const &map,
+                                                     std::string const &key) {
+    auto it = map.find(key);
+    return it == map.end() ? nullptr : &(it->second);
+  }
+
+public:
+  /// \brief load the index file 'filename' (an absent file is an empty index)
+  bool load(std::string const &filename) {
+    testRuntimes.clear();
+    mutantKillers.clear();
+    siteKillers.clear();
+    typeKillers.clear();
+    std::ifstream in(filename);
+    if (!in.is_open())
+      return true;
+    std::string line, kind, hash, type, pos, test;
+    while (std::getline(in, line)) {
+      std::istringstream ss(line);
+      if (!(ss >> kind))
+        continue;
+      std::vector<std::string> *killers = nullptr;
+      if (kind == "T") {
+        double runtime;
+        if (ss >> runtime >> test) {
+          testRuntimes[test] = runtime;
+          continue;
+        }
+      } else if (kind == "M") {
+        if (ss >> hash >> type >> pos)
+          killers = &mutantKillers[hash + " " + type + " " + pos];
+      } else if (kind == "S") {
+        if (ss >> hash >> pos)
+          killers = &siteKillers[hash + " " + pos];
+      } else if (kind == "Y") {
+        if (ss >> hash >> type)
+          killers = &typeKillers[hash + " " + type];
+      }
+      if (killers == nullptr) {
+        llvm::errs() << "Invalid test prioritization index record in "
+                     << filename << ": " << line << "\n";
+        return false;
+      }
+      while (ss >> test)
+        killers->push_back(test);
+    }
+    return true;
+  }
+
+  bool save(std::string const &filename) const {
+    std::ofstream out(filename);
+    if (!out.is_open()) {
+      llvm::errs() << "Unable to open file for write: " << filename << "\n";
+      return false;
+    }
+    for (auto &tr : testRuntimes)
+      out << "T " << tr.second << " " << tr.first << "\n";
+    std::pair<char const *, KillersMap const *> records[] = {
+        {"M", &mutantKillers}, {"S", &siteKillers}, {"Y", &typeKillers}};
+    for (auto &rec : records) {
+      for (auto &entry : *rec.second) {
+        out << rec.first << " " << entry.first;
+        for (auto &test : entry.second)
+          out << " " << test;
+        out << "\n";
+      }
+    }
+    return out.good();
+  }
+
+  /// \brief whether 'test' can be a test name of the index (its records are
+  /// whitespace separated)
+  static bool isValidTestName(std::string const &test) {
+    if (test.empty())
+      return false;
+    for (unsigned char c : test)
+      if (std::isspace(c))
+        return false;
+    return true;
+  }
+
+  bool setTestRuntime(std::string const &test, double runtime) {
+    if (!isValidTestName(test)) {
+      llvm::errs() << "Invalid test name (empty or with whitespace): '" << test
+                   << "'\n";
+      return false;
+    }
+    testRuntimes[test] = runtime;
+    return true;
+  }
+
+  /// \brief runtime of 'test', infinity if unknown
+  double getTestRuntime(std::string const &test) const {
+    auto it = testRuntimes.find(test);
+    return it == testRuntimes.end() ? std::numeric_limits<double>::infinity()
+                                    : it->second;
+  }
+
+  /// \brief record 'killers' (tests that killed the mutant of key 'key' in
+  /// the current run) as the most recent killers of its records
+  bool recordKillers(MutantKey const &key,
+                     std::vector<std::string> const &killers) {
+    for (auto &test : killers) {
+      if (!isValidTestName(test)) {
+        llvm::errs() << "Invalid test name (empty or with whitespace): '"
+                     << test << "'\n";
+        return false;
+      }
+    }
+    if (killers.empty())
+      return true;
+    addKillers(mutantKillers[mutantKey(key)], killers);
+    addKillers(siteKillers[siteKey(key)], killers);
+    addKillers(typeKillers[typeKey(key)], killers);
+    return true;
+  }
+
+  /// \brief order the tests 'candidates' (e.g. the tests covering the
+  /// mutant) to execute on the mutant of key 'key' into 'ordered':
+  ///  1. the previous killers of the mutant,
+  ///  2. the previous killers at its IR site and of its statement siblings
+  ///     (mutants of the same statement, 'siblings'),
+  ///  3. the previous killers of its type in its function,
+  ///  4. the other candidates, fastest first.
+  void prioritize(MutantKey const &key,
+                  std::vector<MutantKey const *> const &siblings,
+                  std::vector<std::string> const &candidates,
+                  std::vector<std::string> &ordered) const {
+    // rank of each candidate: (tier, position in the tier)
+    std::unordered_map<std::string, std::pair<unsigned, unsigned>> rank;
+    for (auto &test : candidates)
+      rank[test] = std::make_pair(3u, 0u);
+    std::vector<std::pair<unsigned, std::vector<std::string> const *>> tiers;
+    tiers.emplace_back(0, findKillers(mutantKillers, mutantKey(key)));
+    tiers.emplace_back(1, findKillers(siteKillers, siteKey(key)));
+    for (auto *sibling : siblings)
+      tiers.emplace_back(1, findKillers(mutantKillers, mutantKey(*sibling)));
+    tiers.emplace_back(2, findKillers(typeKillers, typeKey(key)));
+    unsigned position = 0;
+    for (auto &tier : tiers) {
+      if (tier.second == nullptr)
+        continue;
+      for (auto &test : *tier.second) {
+        auto it = rank.find(test);
+        if (it != rank.end() && it->second.first > tier.first)
+          it->second = std::make_pair(tier.first, position++);
+      }
+    }
+    ordered = candidates;
+    std::stable_sort(ordered.begin(), ordered.end(),
+                     [&](std::string const &a, std::string const &b) {
+                       auto const &ra = rank.at(a), &rb = rank.at(b);
+                       if (ra.first != rb.first)
+                         return ra.first < rb.first;
+                       if (ra.first < 3)
+                         return ra.second < rb.second;
+                       return getTestRuntime(a) < getTestRuntime(b);
+                     });
+  }
+}; // class TestPrioritizationIndex
+
+} // namespace mart
+
+#endif //#ifndef TestPrioritization_h__
@@ -0,0 +1,201 @@
+/**
+ * -==== martlib.cpp
+ *
+ *                MART Multi-Language LLVM Mutation Framework
+ *
+ * This file is distributed under the University of Illinois Open Source
+ * License. See LICENSE.TXT for details.
+ *
+ * \brief     Implementation of the in-memory library API of the mutation (see
+ * martlib.h).
+ */
+
+#include <map>
+#include <sstream>
+#include <unordered_map>
+
+#include "ReadWriteIRObj.h"
+#include "martlib.h"
+#include "mutation.h"
+
+#include "llvm/Transforms/Utils/Cloning.h" //for CloneFunction
+
+namespace mart {
+
+namespace {
+
+/// \brief state of a run, passed to the mutants callback
+struct CollectedOutputs {
+  MutationRequest::OutputFormat format;
+  MutationResult *result;
+  /// data of the mutants, by mutant ID
+  std::map<MutantIDType, std::string> mutantsData;
+};
+
+bool emitModule(llvm::Module *mod, MutationRequest::OutputFormat format,
+                std::string &data) {
+  if (format == MutationRequest::Bitcode) {
+    ReadWriteIRObj::writeIRToBuffer(mod, data);
+    return true;
+  }
+#ifdef MART_GENMU_OBJECTFILE
+  return ReadWriteIRObj::writeObjToBuffer(mod, data);
+#else
+  llvm::errs() << "Error: object output needs MART_GENMU_OBJECTFILE\n";
+  return false;
+#endif
+}
+
+/// \brief DumpMutFunc_t keeping the modules data in memory (the mutants'
+/// modules in function mode are the original with the mutant function)
+bool collectMutantsCallback(Mutation *mutEng,
+                            std::map<unsigned, std::vector<unsigned>> *poss,
+                            std::vector<llvm::Module *> *mods,
+                            llvm::Module *wmModule, llvm::Module *covModule,
+                            std::vector<llvm::Function *> const *mutFunctions,
+                            bool firstBatch, bool lastBatch) {
+  auto *outputs =
+      static_cast<CollectedOutputs *>(mutEng->getWriteMutantsCallbackData());
+  MutationResult &result = *(outputs->result);
+  if (wmModule && !emitModule(wmModule, outputs->format, result.weakMutation))
+    return false;
+  if (covModule &&
+      !emitModule(covModule, outputs->format, result.mutantCoverage))
+    return false;
+  if (!poss || !mods)
+    return true;
+
+  if (firstBatch && !emitModule(mods->at(0), outputs->format, result.original))
+    return false;
+
+  bool ok = true;
+  // original function of each module with a mutant function set: the
+  // function in the module and its clone
+  std::unordered_map<llvm::Module *,
+                     std::pair<llvm::Function *, llvm::Function *>>
+      backedFuncsByMods;
+  for (auto &m : *poss) {
+    llvm::Module *formutsModule = mods->at(m.first);
+    MutantIDType mid = m.second.front();
+    if (mutFunctions != nullptr) {
+      llvm::Function *currFunc = mutFunctions->at(m.first);
+      llvm::Function *modFunc =
+          formutsModule->getFunction(currFunc->getName());
+      if (backedFuncsByMods.count(formutsModule) == 0) {
+        llvm::ValueToValueMapTy vmap;
+#if (LLVM_VERSION_MAJOR <= 3) && (LLVM_VERSION_MINOR < 9)
+        llvm::Function *backup =
+            llvm::CloneFunction(modFunc, vmap, true /*moduleLevelChanges*/);
+#else
+        llvm::Function *backup = llvm::CloneFunction(modFunc, vmap);
+        // not emitted with the module
+        backup->removeFromParent();
+#endif
+        backedFuncsByMods.emplace(formutsModule,
+                                  std::make_pair(modFunc, backup));
+      }
+      mutEng->setModFuncToFunction(formutsModule, currFunc, modFunc);
+    }
+    if (!emitModule(formutsModule, outputs->format,
+                    outputs->mutantsData[mid])) {
+      llvm::errs() << "Mutant " << mid << "...\n";
+      ok = false;
+      break;
+    }
+  }
+  // restore the modules' original function
+  for (auto &itt : backedFuncsByMods) {
+    mutEng->setModFuncToFunction(itt.first, itt.second.second,
+                                 itt.second.first);
+    delete itt.second.second;
+  }
+  return ok;
+}
+
+std::unique_ptr<llvm::Module> cloneOrNull(llvm::Module const *mod) {
+  if (mod == nullptr)
+    return std::unique_ptr<llvm::Module>(nullptr);
+  return std::unique_ptr<llvm::Module>(ReadWriteIRObj::cloneModuleAndRelease(
+      const_cast<llvm::Module *>(mod)));
+}
+
+} // namespace
+
+bool runMutation(llvm::Module &module, MutationRequest const &request,
+                 MutationResult &result) {
+  result.clear();
+  if (!Mutation::checkConfiguration(request.mutationConfig))
+    return false;
+  if (request.samplingRate <= 0.0 || request.samplingRate > 1.0 ||
+      !Mutation::isValidSamplingStrata(request.samplingBy)) {
+    llvm::errs() << "Error: invalid mutants sampling\n";
+    return false;
+  }
+#ifndef MART_GENMU_OBJECTFILE
+  if (request.format == MutationRequest::Object) {
+    llvm::errs() << "Error: object output needs MART_GENMU_OBJECTFILE\n";
+    return false;
+  }
+#endif
+
+  std::unique_ptr<llvm::Module> modWMLog = cloneOrNull(request.wmLogDriver);
+  std::unique_ptr<llvm::Module> modCovLog = cloneOrNull(request.covLogDriver);
+  std::unique_ptr<llvm::Module> metamutantSel =
+      cloneOrNull(request.metamutantSelector);
+
+  CollectedOutputs outputs;
+  outputs.format = request.format;
+  outputs.result = &result;
+
+  std::istringstream confStream(request.mutationConfig);
+  Mutation mut(module, confStream, collectMutantsCallback, request.scopeJson,
+               request.keepConstantPHIs, request.shardIndex,
+               request.numShards);
+  mut.setWriteMutantsCallbackData(&outputs);
+  mut.setInlineLogProbes(request.inlineLogProbes);
+  mut.setMutantsSampling(request.samplingRate, request.samplingBy,
+                         request.samplingMaxMutants, request.samplingSeed);
+  mut.setPreTCEFilter(request.preTCEFilter);
+
+  if (!mut.doMutate()) {
+    llvm::errs() << "\nMUTATION FAILED!!\n\n";
+    return false;
+  }
+
+  std::unique_ptr<llvm::Module> optMetaMu(nullptr);
+  mut.doTCE(optMetaMu, modWMLog, modCovLog, request.emitMutants,
+            request.tceFunctionMode);
+
+  MutantInfoList const &infos = mut.getMutantInfos();
+  result.mutants.reserve(infos.getMutantsNumber());
+  for (MutantIDType mid = 1; mid <= infos.getMutantsNumber(); ++mid) {
+    result.mutants.emplace_back(MutantInfoList::MutantInfo(
+        mid, infos.getMutantTypeName(mid), infos.getMutantFunction(mid),
+        infos.getMutantIrPosInFunction(mid), infos.getMutantSourceLoc(mid)));
+    auto it = outputs.mutantsData.find(mid);
+    if (it != outputs.mutantsData.end()) {
+      result.mutants.back().data.swap(it->second);
+      outputs.mutantsData.erase(it);
+    }
+  }
+  // The mutants are written with their post-TCE IDs
+  if (!outputs.mutantsData.empty()) {
+    llvm::errs() << "Error: mutant " << outputs.mutantsData.begin()->first
+                 << " written but not remaining after the TCE\n";
+    return false;
+  }
+  result.equivalentDuplicateMutants = infos.getEquivalentDuplicateMutants();
+
+  if (!emitModule(&module, request.format, result.metaMutant))
+    return false;
+  if (metamutantSel) {
+    mut.linkMetamoduleWithMutantSelection(optMetaMu, metamutantSel);
+    if (!emitModule(optMetaMu.get(), request.format,
+                    result.optimizedMetaMutant))
+      return false;
+  }
+  result.stats = mut.getMutationStats();
+  return true;
+}
+
+} // namespace mart
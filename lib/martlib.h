@@ -0,0 +1,124 @@
+/**
+ * -==== martlib.h
+ *
+ *                MART Multi-Language LLVM Mutation Framework
+ *
+ * This file is distributed under the University of Illinois Open Source
+ * License. See LICENSE.TXT for details.
+ *
+ * \brief     Define the in-memory library API of the mutation: generation,
+ * TCE and emission of the mutants, from a module and configurations in memory
+ * into bitcode (or object) buffers and mutants infos, without any file.
+ *
+ * Example:
+ *      mart::MutationRequest request;
+ *      request.mutationConfig = confText;   // content of a .mconf file
+ *      mart::MutationResult result;
+ *      if (mart::runMutation(*module, request, result))
+ *        for (auto &mutant : result.mutants)
+ *          run(mutant.info.id, mutant.data);
+ */
+
+#ifndef __MART_GENMU_martlib__
+#define __MART_GENMU_martlib__
+
+#include <string>
+#include <vector>
+
+#include <llvm/IR/Module.h>
+
+#include "typesops.h"
+
+namespace mart {
+
+/// \brief input of runMutation
+struct MutationRequest {
+  enum OutputFormat { Bitcode, Object };
+
+  /// Content of the mutation configuration (see mconf-scope)
+  std::string mutationConfig;
+  /// Content of the mutation scope JSON, empty to mutate everything. Use its
+  /// "Changed-Lines" rather than its "Patch" (a diff file)
+  std::string scopeJson;
+
+  /// Format of the mutants and meta-mutants data. The objects are for the
+  /// host and need the build option MART_GENMU_OBJECTFILE
+  OutputFormat format = Bitcode;
+  /// Whether the mutants' programs are emitted (otherwise only the infos)
+  bool emitMutants = true;
+
+  /// Modules, in the context of the input module, of the WM and coverage log
+  /// driver (useful/wmlog-driver.bc) and of the meta-mutant's mutant
+  /// selector (useful/metamutant_selector.bc). They are cloned. Each one
+  /// left null disables its output (WM, coverage, optimized meta-mutant)
+  llvm::Module const *wmLogDriver = nullptr;
+  llvm::Module const *covLogDriver = nullptr;
+  llvm::Module const *metamutantSelector = nullptr;
+
+  /// Same as the options of mart
+  bool keepConstantPHIs = false;
+  bool tceFunctionMode = false;
+  bool inlineLogProbes = false;
+  bool preTCEFilter = true;
+  unsigned shardIndex = 0;
+  unsigned numShards = 1;
+  double samplingRate = 1.0;
+  std::string samplingBy = "mutant";
+  unsigned samplingMaxMutants = 0;
+  unsigned samplingSeed = 0;
+};
+
+/// \brief output of runMutation: the mutants remaining after the TCE, with
+/// their program data, and the equivalent or duplicate mutants it removed
+struct MutationResult {
+  struct Mutant {
+    MutantInfoList::MutantInfo info;
+    /// bitcode (or object) of the mutant's program
+    std::string data;
+    Mutant(MutantInfoList::MutantInfo const &mi) : info(mi) {}
+  };
+
+  /// Every mutant remaining after the TCE, by post-TCE ID: the mutant with ID
+  /// 'i' is at position 'i-1'. Their 'data' is empty when the mutants are not
+  /// emitted ('emitMutants'). The mutants removed by the TCE are only in
+  /// 'equivalentDuplicateMutants'.
+  std::vector<Mutant> mutants;
+  /// Their 'duplicateOfID' is 0 for the equivalent mutants
+  std::vector<MutantInfoList::EquivalentDuplicateMutantInfo>
+      equivalentDuplicateMutants;
+
+  /// Post-TCE original program (mutant 0)
+  std::string original;
+  /// Post-TCE meta-mutant, and optimized meta-mutant linked with the mutant
+  /// selector (with 'metamutantSelector')
+  std::string metaMutant;
+  std::string optimizedMetaMutant;
+  /// Weak mutation and mutant coverage programs (with the log drivers)
+  std::string weakMutation;
+  std::string mutantCoverage;
+
+  /// Numbers of mutants, as printed by mart
+  std::string stats;
+
+  void clear() {
+    mutants.clear();
+    equivalentDuplicateMutants.clear();
+    original.clear();
+    metaMutant.clear();
+    optimizedMetaMutant.clear();
+    weakMutation.clear();
+    mutantCoverage.clear();
+    stats.clear();
+  }
+};
+
+/// \brief mutate 'module' as requested by 'request', remove the TCE
+/// equivalent and duplicate mutants and put the outputs into 'result'.
+/// 'module' is transformed into the post-TCE meta-mutant. Return false, with
+/// an error message printed, on error. The runs must not be concurrent.
+bool runMutation(llvm::Module &module, MutationRequest const &request,
+                 MutationResult &result);
+
+} // namespace mart
+
+#endif //__MART_GENMU_martlib__
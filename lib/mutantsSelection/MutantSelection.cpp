@@ -19,8 +19,13 @@
 #include <cstdlib> /* srand, rand */
 #include <ctime>
 #include <fstream>
+#include <map>
+#include <set>
 
 #include "llvm/Analysis/CFG.h"
+#include "llvm/IR/Instructions.h"
+
+#include "ReadWriteIRObj.h" //cloneModuleAndRelease
 
 #include "MutantSelection.h"
 
@@ -1689,10 +1694,106 @@ void MutantDependenceGraph::exportMutantFeaturesCSV(std::string filenameCSV,
 
 // class MutantSelection
 
+/**
+ * \brief clone 'subjectModule' into 'scopedModule', keeping only the bodies of
+ * the functions with mutants and of the functions up to 'callDepth' direct
+ * calls away from them (callers and callees). The other functions become
+ * declarations, which dg analyses conservatively (as external functions).
+ * The entry function of the scoped module calls each function of the scope
+ * that is not only called from the scope, with arguments loaded from fresh
+ * external globals (unknown values, pointing to unknown memory).
+ * @return the scoped module
+ */
+llvm::Module *MutantSelection::buildScopedModule(unsigned callDepth) {
+  // Direct call graph, by function name
+  std::map<std::string, std::set<std::string>> callees, callers;
+  for (auto &Func : subjectModule) {
+    for (auto &BB : Func)
+      for (auto &Inst : BB) {
+        llvm::Function *callee = nullptr;
+        if (auto *call = llvm::dyn_cast<llvm::CallInst>(&Inst))
+          callee = call->getCalledFunction();
+        else if (auto *invoke = llvm::dyn_cast<llvm::InvokeInst>(&Inst))
+          callee = invoke->getCalledFunction();
+        if (callee && !callee->isDeclaration()) {
+          callees[Func.getName().str()].insert(callee->getName().str());
+          callers[callee->getName().str()].insert(Func.getName().str());
+        }
+      }
+  }
+
+  // Functions with mutants, then their neighbourhood (BFS)
+  std::set<std::string> scope, frontier;
+  for (MutantIDType mutant_id = 1; mutant_id <= mutantInfos.getMutantsNumber();
+       ++mutant_id)
+    if (scope.insert(mutantInfos.getMutantFunction(mutant_id)).second)
+      frontier.insert(mutantInfos.getMutantFunction(mutant_id));
+  for (unsigned depth = 0; depth < callDepth && !frontier.empty(); ++depth) {
+    std::set<std::string> next;
+    for (auto &funcName : frontier)
+      for (auto *graph : {&callees, &callers}) {
+        auto it = graph->find(funcName);
+        if (it != graph->end())
+          for (auto &neighbour : it->second)
+            if (scope.insert(neighbour).second)
+              next.insert(neighbour);
+      }
+    frontier.swap(next);
+  }
+
+  scopedModule.reset(ReadWriteIRObj::cloneModuleAndRelease(&subjectModule));
+  std::vector<llvm::Function *> entries;
+  for (auto &Func : *scopedModule) {
+    if (Func.isDeclaration())
+      continue;
+    if (scope.count(Func.getName().str()) == 0) {
+      Func.deleteBody();
+      continue;
+    }
+    // Called from outside the scope, or never directly called
+    bool calledOnlyInScope = callers.count(Func.getName().str()) > 0 &&
+                             !Func.hasAddressTaken();
+    if (calledOnlyInScope)
+      for (auto &caller : callers.at(Func.getName().str()))
+        if (scope.count(caller) == 0)
+          calledOnlyInScope = false;
+    if (!calledOnlyInScope)
+      entries.push_back(&Func);
+  }
+
+  llvm::LLVMContext &ctx = scopedModule->getContext();
+  llvm::Function *entryFunc = llvm::Function::Create(
+      llvm::FunctionType::get(llvm::Type::getVoidTy(ctx), false),
+      llvm::GlobalValue::ExternalLinkage, scopeEntryFuncName,
+      scopedModule.get());
+  llvm::BasicBlock *entryBB = llvm::BasicBlock::Create(ctx, "", entryFunc);
+  for (auto *Func : entries) {
+    // (undef arguments would let the pointer analysis assume that the
+    // pointers point to nothing)
+    std::vector<llvm::Value *> args;
+    for (auto &arg : Func->args()) {
+      auto *argGlobal = new llvm::GlobalVariable(
+          *scopedModule, arg.getType(), false /*isConstant*/,
+          llvm::GlobalValue::ExternalLinkage, nullptr /*declaration*/,
+          std::string(scopeEntryFuncName) + "." + Func->getName().str() +
+              ".arg" + std::to_string(arg.getArgNo()));
+      args.push_back(new llvm::LoadInst(argGlobal, "", entryBB));
+    }
+    llvm::CallInst::Create(Func, args, "", entryBB);
+  }
+  llvm::ReturnInst::Create(ctx, entryBB);
+
+  llvm::outs() << "Mart-Selection@Progress: scoped dependence analysis on "
+               << scope.size() << " functions (" << entries.size()
+               << " entries).\n";
+  return scopedModule.get();
+}
+
 void MutantSelection::buildDependenceGraphs(std::string mutant_depend_filename,
                                             bool rerundg, bool isFlowSensitive,
                                             bool isClassicCtrlDepAlgo,
-                                            bool disable_selection) {
+                                            bool disable_selection,
+                                            int scopeCallDepth) {
   if (rerundg) {
     dg::CD_ALG cd_alg;
     if (isClassicCtrlDepAlgo)
@@ -1727,9 +1828,16 @@ void MutantSelection::buildDependenceGraphs(std::string mutant_depend_filename,
     IRDGraph.computeControlDependencies(cd_alg);
     */
 
+    // The module analysed: the whole module, or its scope
+    llvm::Module *analysedModule = &subjectModule;
+    const char *entry_func = "main";
+    if (scopeCallDepth >= 0) {
+      analysedModule = buildScopedModule(scopeCallDepth);
+      entry_func = scopeEntryFuncName;
+    }
+
     // Set options
     bool threads = false;
-    const char *entry_func = "main";
     const char *rda = "dataflow";
     dg::llvmdg::LLVMDependenceGraphOptions options;
     options.cdAlgorithm = cd_alg;
@@ -1758,14 +1866,14 @@ void MutantSelection::buildDependenceGraphs(std::string mutant_depend_filename,
     }
 
     // dg graph
-    dg::llvmdg::LLVMDependenceGraphBuilder dg_builder(&subjectModule, options);
+    dg::llvmdg::LLVMDependenceGraphBuilder dg_builder(analysedModule, options);
     
     //dg::LLVMDependenceGraph IRDGraph = dg_builder.build();
     auto IRDGraph = dg_builder.build();
 
     // Build mutant DGraph
     //mutantDGraph.build(subjectModule, &IRDGraph, mutantInfos,
-    mutantDGraph.build(subjectModule, IRDGraph.release(), mutantInfos,
+    mutantDGraph.build(*analysedModule, IRDGraph.release(), mutantInfos,
                        mutant_depend_filename, disable_selection);
   } else {
     // load from file
@@ -1776,7 +1884,8 @@ void MutantSelection::buildDependenceGraphs(std::string mutant_depend_filename,
 
 MutantIDType
 MutantSelection::pickMutant(std::unordered_set<MutantIDType> const &candidates,
-                            std::vector<double> const &scores) {
+                            std::vector<double> const &scores,
+                            SelectionRandom &prng) {
   std::vector<MutantIDType> topScored;
 
   // First see which are having the maximum score
@@ -1830,12 +1939,11 @@ MutantSelection::pickMutant(std::unordered_set<MutantIDType> const &candidates,
   }
   */
 
-  // shuflle IRs
-  std::srand(std::time(NULL) + clock()); //+ clock() because fast running
-  // program will generate same sequence
-  // with only time(NULL)
-  std::random_shuffle(choiceFinalRoundList.begin(), choiceFinalRoundList.end());
-  MutantIDType chosenMutant = choiceFinalRoundList.front();
+  // pick one randomly (in IDs order, independent of the candidates set
+  // iteration order)
+  std::sort(choiceFinalRoundList.begin(), choiceFinalRoundList.end());
+  MutantIDType chosenMutant =
+      choiceFinalRoundList[prng.below(choiceFinalRoundList.size())];
   return chosenMutant;
 }
 
@@ -1934,7 +2042,7 @@ void MutantSelection::getMachineLearningPrediction(
 void MutantSelection::smartSelectMutants(
     std::vector<MutantIDType> &selectedMutants,
     std::vector<float> &cachedPrediction, std::string trainedModelFilename,
-    bool mlOn, bool mclOn, bool defectPredOn) {
+    bool mlOn, bool mclOn, bool defectPredOn, SelectionRandom &prng) {
 
   MutantIDType mutants_number = mutantInfos.getMutantsNumber();
 
@@ -1992,13 +2100,11 @@ void MutantSelection::smartSelectMutants(
         while (*ifirst == *ilast)
           ++ilast;
         // randomize
-        std::srand(std::time(NULL) + clock()); //+ clock() because fast running
-        std::random_shuffle(ifirst, ilast - 1);
+        prng.shuffle(ifirst, ilast - 1);
         ifirst = ilast;
       } else {
         ilast = iend;
-        std::srand(std::time(NULL) + clock()); //+ clock() because fast running
-        std::random_shuffle(ifirst, ilast);
+        prng.shuffle(ifirst, ilast);
       }
     }
     // for (auto i : selectedMutants) llvm::errs() << isCoupledProbability[i-1]
@@ -2197,8 +2303,7 @@ void MutantSelection::smartSelectMutants(
   for (unsigned long cluster_id=0; cluster_id < candidate_mutants_clusters.size(); ++cluster_id) {
     clusters__.push_back(cluster_id);
   }
-  std::srand(std::time(NULL) + clock()); //+ clock() because fast running
-  std::random_shuffle(clusters__.begin(), clusters__.end());
+  prng.shuffle(clusters__.begin(), clusters__.end());
   for(auto cluster_id: clusters__) {
     auto &cluster = candidate_mutants_clusters[cluster_id];
     for (unsigned long occ=0; occ < cluster.size(); ++occ)
@@ -2208,14 +2313,13 @@ void MutantSelection::smartSelectMutants(
   //llvm::errs() << "#### " << candidate_mutants_clusters.size() << " clusters\n";
 
   // randomize with probability change the value less than to change the proba
-  std::srand(std::time(NULL) + clock()); //+ clock() because fast running
-  if (rand() % 100 < 100) {
-    std::srand(std::time(NULL) + clock()); //+ clock() because fast running
-    std::random_shuffle(clustershuffle.begin(), clustershuffle.end());
+  if (prng.below(100) < 100) {
+    prng.shuffle(clustershuffle.begin(), clustershuffle.end());
   }
 
   for (auto cid: clustershuffle) {
-    auto mutant_id = pickMutant(candidate_mutants_clusters[cid], mutant_scores);
+    auto mutant_id =
+        pickMutant(candidate_mutants_clusters[cid], mutant_scores, prng);
     //-----llvm::errs()<<candidate_mutants.size()<<"
     //"<<mutant_scores[mutant_id]<<"\n";
     // Stop if the selected mutant has a score less than the threshold
@@ -2274,7 +2378,8 @@ void MutantSelection::smartSelectMutants(
 
 void MutantSelection::randomMutants(
     std::vector<MutantIDType> &spreadSelectedMutants,
-    std::vector<MutantIDType> &dummySelectedMutants, unsigned long number) {
+    std::vector<MutantIDType> &dummySelectedMutants, unsigned long number,
+    SelectionRandom &prng) {
   MutantIDType mutants_number = mutantInfos.getMutantsNumber();
 
   assert(mutantDGraph.isBuilt() && "This function must be called after the "
@@ -2293,21 +2398,27 @@ void MutantSelection::randomMutants(
   for (auto &ir2mutset : work_map) {
     mutatedIRs.push_back(ir2mutset.first);
   }
+  // Initial order independent of the IRs addresses (reproducible): by the
+  // mutants of the IRs
+  std::unordered_map<llvm::Value const *, std::vector<MutantIDType>> irMutIDs;
+  for (auto &ir2mutset : work_map) {
+    auto &ids = irMutIDs[ir2mutset.first];
+    ids.assign(ir2mutset.second.begin(), ir2mutset.second.end());
+    std::sort(ids.begin(), ids.end());
+  }
+  std::sort(mutatedIRs.begin(), mutatedIRs.end(),
+            [&irMutIDs](llvm::Value const *a, llvm::Value const *b) {
+              return irMutIDs.at(a) < irMutIDs.at(b);
+            });
 
   bool someselected = true;
   while (someselected) {
     someselected = false;
 
     // shuflle IRs
-    std::srand(std::time(NULL) + clock()); //+ clock() because fast running
-    // program will generate same sequence
-    // with only time(NULL)
-    std::random_shuffle(mutatedIRs.begin(), mutatedIRs.end());
+    prng.shuffle(mutatedIRs.begin(), mutatedIRs.end());
 
     unsigned long numberofnulled = 0;
-    std::srand(std::time(NULL) + clock()); //+ clock() because fast running
-    // program will generate same sequence
-    // with only time(NULL)
     for (unsigned long irPos = 0, irE = mutatedIRs.size(); irPos < irE;
          ++irPos) {
       // randomly select one of its mutant
@@ -2317,7 +2428,7 @@ void MutantSelection::randomMutants(
         ++numberofnulled;
         continue;
       } else {
-        auto rnd = std::rand() % mutSet.size();
+        auto rnd = prng.below(mutSet.size());
         auto sit = mutSet.begin();
         std::advance(sit, rnd);
         auto selMut = *sit;
@@ -2330,12 +2441,10 @@ void MutantSelection::randomMutants(
     }
     // remove those that are null
     if (numberofnulled > 0) {
-      std::sort(mutatedIRs.rbegin(),
-                mutatedIRs.rend()); // reverse sort (the null are at  the end:
-                                    // the last numberofnulled values)
-      mutatedIRs.erase(mutatedIRs.begin() +
-                           (mutatedIRs.size() - numberofnulled),
-                       mutatedIRs.end());
+      // (keep the order of the others, for reproducibility)
+      mutatedIRs.erase(
+          std::remove(mutatedIRs.begin(), mutatedIRs.end(), nullptr),
+          mutatedIRs.end());
     }
   }
 
@@ -2353,10 +2462,7 @@ void MutantSelection::randomMutants(
   }
 
   // shuffle
-  std::srand(std::time(NULL) + clock()); //+ clock() because fast running
-                                         // program will generate same sequence
-  // with only time(NULL)
-  std::random_shuffle(dummySelectedMutants.begin(), dummySelectedMutants.end());
+  prng.shuffle(dummySelectedMutants.begin(), dummySelectedMutants.end());
 
   // keep only the needed number
   if (dummySelectedMutants.size() > number)
@@ -2364,7 +2470,8 @@ void MutantSelection::randomMutants(
 }
 
 void MutantSelection::randomSDLMutants(
-    std::vector<MutantIDType> &selectedMutants, unsigned long number) {
+    std::vector<MutantIDType> &selectedMutants, unsigned long number,
+    SelectionRandom &prng) {
   /// Insert all SDL mutants here, note that any two SDL spawn different IRs
   MutantIDType mutants_number = mutantInfos.getMutantsNumber();
   for (MutantIDType mutant_id = 1; mutant_id <= mutants_number; ++mutant_id) {
@@ -2374,10 +2481,7 @@ void MutantSelection::randomSDLMutants(
   }
 
   // shuffle
-  std::srand(std::time(NULL) + clock()); //+ clock() because fast running
-                                         // program will generate same sequence
-  // with only time(NULL)
-  std::random_shuffle(selectedMutants.begin(), selectedMutants.end());
+  prng.shuffle(selectedMutants.begin(), selectedMutants.end());
 
   // keep only the needed number
   if (selectedMutants.size() > number)
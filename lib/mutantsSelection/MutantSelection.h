@@ -20,6 +20,8 @@
 #ifndef __MART_GENMU_mutantsSelection_MutantSelection__
 #define __MART_GENMU_mutantsSelection_MutantSelection__
 
+#include <cstdint>
+#include <memory>
 #include <unordered_set>
 
 namespace dg {
@@ -461,6 +463,40 @@ public:
   }
 }; // class MutantDependenceGraph
 
+/**
+ * \brief Counter-based PRNG of the selections: the value number 'counter' of
+ * the stream 'stream' (a repetition of a selection) is a hash (SplitMix64
+ * finalizer) of the seed, the stream and the counter. The streams of the
+ * repetitions are independent, so the repetitions can run in any order, in
+ * parallel, and give the same selections for the same seed.
+ */
+class SelectionRandom {
+  uint64_t key;
+  uint64_t counter;
+
+  static uint64_t mix(uint64_t z) {
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+  }
+
+public:
+  SelectionRandom(uint64_t seed, uint64_t stream)
+      : key(mix(mix(seed) + stream * 0x9e3779b97f4a7c15ULL)), counter(0) {}
+
+  uint64_t next() { return mix(key + (++counter) * 0x9e3779b97f4a7c15ULL); }
+
+  /// \brief random integer in [0, n)
+  uint64_t below(uint64_t n) { return next() % n; }
+
+  /// \brief shuffle [first, last) (Fisher-Yates, independent of the
+  /// standard library implementation)
+  template <typename RandomIt> void shuffle(RandomIt first, RandomIt last) {
+    for (auto n = last - first; n > 1; --n)
+      std::swap(first[n - 1], first[below(n)]);
+  }
+}; // class SelectionRandom
+
 class MutantSelection {
 private:
   llvm::Module &subjectModule;
@@ -469,25 +505,45 @@ private:
   // dg::LLVMDependenceGraph *IRDGraph;
   MutantDependenceGraph mutantDGraph;
 
+  // With a scoped dependence analysis, the clone of 'subjectModule' analysed
+  // (see buildScopedModule), used by 'mutantDGraph'
+  std::unique_ptr<llvm::Module> scopedModule;
+
+  // Name of the entry function added to the scoped module
+  const char *scopeEntryFuncName = "martLLVM_Selection_Scope_Entry";
+
   ////
   void buildDependenceGraphs(std::string mutant_depend_filename, bool rerundg,
                              bool isFlowSensitive = false,
                              bool isClassicCtrlDepAlgo = true,
-                             bool disable_selection = false);
+                             bool disable_selection = false,
+                             int scopeCallDepth = -1);
+  llvm::Module *buildScopedModule(unsigned callDepth);
   MutantIDType pickMutant(std::unordered_set<MutantIDType> const &candidates,
-                          std::vector<double> const &scores);
+                          std::vector<double> const &scores,
+                          SelectionRandom &prng);
   void relaxMutant(MutantIDType mutant_id, std::vector<double> &scores);
   void
   getMachineLearningPrediction(std::vector<float> &couplingProbabilitiesOut,
                                std::string modelFilename, bool isDefectPrediction);
 
 public:
+  /// 'scopeCallDepth' >= 0 restricts the dependence analysis to the functions
+  /// with mutants and the functions up to 'scopeCallDepth' calls away from
+  /// them (see buildScopedModule). A negative value analyses the whole module.
   MutantSelection(llvm::Module &inMod, MutantInfoList const &mInf,
                   std::string mutant_depend_filename, bool rerundg,
-                  bool isFlowSensitive, bool disable_selection=false)
+                  bool isFlowSensitive, bool disable_selection=false,
+                  int scopeCallDepth = -1)
       : subjectModule(inMod), mutantInfos(mInf),
         mutantDGraph(mInf.getMutantsNumber()) {
-    buildDependenceGraphs(mutant_depend_filename, rerundg, isFlowSensitive, true, disable_selection);
+    buildDependenceGraphs(mutant_depend_filename, rerundg, isFlowSensitive,
+                          true, disable_selection, scopeCallDepth);
+  }
+  /// \brief write the mutant dependencies into the cache 'filename' (read
+  /// back when not 'rerundg')
+  void dumpMutantsDependencies(std::string filename) {
+    mutantDGraph.dump(filename);
   }
   void dumpMutantsFeaturesToCSV(std::string csvFilename) {
     mutantDGraph.exportMutantFeaturesCSV(csvFilename, mutantInfos, false /*isDefectPrediction*/);
@@ -495,17 +551,28 @@ public:
   void dumpStmtsFeaturesToCSV(std::string csvFilename) {
     mutantDGraph.exportMutantFeaturesCSV(csvFilename, mutantInfos, true /*isDefectPrediction*/);
   }
+  /// \brief compute the ML prediction of the model (the 'cachedPrediction' of
+  /// smartSelectMutants)
+  void getPrediction(std::vector<float> &prediction,
+                     std::string trainedModelFilename, bool defectPredOn) {
+    getMachineLearningPrediction(prediction, trainedModelFilename,
+                                 defectPredOn);
+  }
+  /// The selection functions below only read the selection data (and a non
+  /// empty 'cachedPrediction'): the repetitions can run in parallel, each
+  /// with its own 'prng'
   void smartSelectMutants(std::vector<MutantIDType> &selectedMutants,
                           // std::vector<double> &selectedScores,
                           std::vector<float> &cachedPrediction,
                           std::string trainedModelFilename, bool mlOn, bool mclOn, 
-                          bool defectPredOn);
+                          bool defectPredOn, SelectionRandom &prng);
   void randomMutants(std::vector<MutantIDType> &spreadSelectedMutants,
                      std::vector<MutantIDType> &dummySelectedMutants,
-                     unsigned long number);
+                     unsigned long number, SelectionRandom &prng);
   void
   randomSDLMutants(std::vector<MutantIDType> &selectedMutants,
-                   unsigned long number); // only statement deletion mutants
+                   unsigned long number,
+                   SelectionRandom &prng); // only statement deletion mutants
 };                                        // class MutantSelection
 
 } // namespace selection
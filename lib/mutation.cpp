@@ -9,6 +9,7 @@
  * \brief     Implementation of Mutation class
  */
 
+#include <algorithm>
 #include <fstream>
 #include <queue>
 #include <regex>
@@ -28,6 +29,7 @@
 
 #include "llvm/ADT/APInt.h"
 #include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/Hashing.h"
 #include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/ADT/SmallVector.h"
 #include "llvm/IR/Constant.h"
@@ -136,23 +138,57 @@ getWMUnsafeInstructions(llvm::BasicBlock *BB,
 }
 
 Mutation::Mutation(llvm::Module &module, std::string mutConfFile,
-                   DumpMutFunc_t writeMutsF, std::string scopeJsonFile)
+                   DumpMutFunc_t writeMutsF, std::string scopeJsonFile,
+                   bool keepConstPHIs, unsigned shardIdx, unsigned nShards)
     : forKLEESEMu(true), funcForKLEESEMu(nullptr),
-      writeMutantsCallback(writeMutsF), moduleInfo(&module, &usermaps) {
-  // tranform the PHI Node with any non-constant incoming value with reg2mem
-  preprocessVariablePhi(module);
+      keepConstantPHIs(keepConstPHIs), shardIndex(shardIdx),
+      numShards(nShards), samplingRate(1.0), samplingBy("mutant"),
+      samplingMaxMutants(0), samplingSeed(0), preTCEFilter(true),
+      numPreFilteredMuts(0), writeMutantsCallback(writeMutsF),
+      writeMutantsCallbackData(nullptr), moduleInfo(&module, &usermaps),
+      inlineLogProbes(false), stmtCoverageProbes(false) {
+  // get mutation config (operators)
+  assert(getConfiguration(mutConfFile) &&
+         "@Mutation(): getConfiguration(mutconfFile) Failed!");
+
+  // Get scope info
+  mutationScope.Initialize(module, scopeJsonFile);
+  initialize(module);
+}
+
+Mutation::Mutation(llvm::Module &module, std::istream &mutConfStream,
+                   DumpMutFunc_t writeMutsF, std::string const &scopeJsonText,
+                   bool keepConstPHIs, unsigned shardIdx, unsigned nShards)
+    : forKLEESEMu(true), funcForKLEESEMu(nullptr),
+      keepConstantPHIs(keepConstPHIs), shardIndex(shardIdx),
+      numShards(nShards), samplingRate(1.0), samplingBy("mutant"),
+      samplingMaxMutants(0), samplingSeed(0), preTCEFilter(true),
+      numPreFilteredMuts(0), writeMutantsCallback(writeMutsF),
+      writeMutantsCallbackData(nullptr), moduleInfo(&module, &usermaps),
+      inlineLogProbes(false), stmtCoverageProbes(false) {
+  // get mutation config (operators)
+  if (!parseConfiguration(mutConfStream, usermaps, configuration))
+    assert(false && "@Mutation(): parseConfiguration(mutConfStream) Failed!");
 
+  // Get scope info
+  mutationScope.InitializeFromJsonText(module, scopeJsonText);
+  initialize(module);
+}
+
+/// \brief common part of the constructors, after the configuration and the
+/// scope are known
+void Mutation::initialize(llvm::Module &module) {
   // set module
   currentInputModule = &module;
   // for now the input is transformed (mutated to become mutant)
   currentMetaMutantModule = currentInputModule;
 
-  // get mutation config (operators)
-  assert(getConfiguration(mutConfFile) &&
-         "@Mutation(): getConfiguration(mutconfFile) Failed!");
+  if (numShards > 1)
+    mutationScope.restrictToShard(module, shardIndex, numShards);
 
-  // Get scope info
-  mutationScope.Initialize(module, scopeJsonFile);
+  // tranform the PHI Node with any non-constant incoming value with reg2mem.
+  // Done after the scope is known: only the functions to mutate are changed
+  preprocessVariablePhi(module);
 
   // initialize mutantIDSelectorName
   getanothermutantIDSelectorName();
@@ -164,7 +200,9 @@ Mutation::Mutation(llvm::Module &module, std::string mutConfFile,
 
 /**
  * \brief PREPROCESSING - Remove PHI Nodes, replacing by reg2mem, for every
- * function in module
+ * function in the mutation scope. With 'keepConstantPHIs', the PHI nodes whose
+ * incoming values are all constants stay in SSA form: the mutants reach them
+ * through the proxy blocks of their incoming edges (see ProxyForPHI)
  */
 void Mutation::preprocessVariablePhi(llvm::Module &module) {
   // Replace the PHI node with memory, to avoid error with verify, as it don't
@@ -195,15 +233,12 @@ void Mutation::preprocessVariablePhi(llvm::Module &module) {
           phiNodes.push_back(phiN);
     for (auto it = phiNodes.rbegin(), ie = phiNodes.rend(); it != ie; ++it) {
       auto *phiN = *it;
-      bool hasNonConstIncVal = true; /*false;
-      for (unsigned pind=0, pe=phiN->getNumIncomingValues(); pind < pe; ++pind)
-      {
-          if (! llvm::isa<llvm::Constant>(phiN->getIncomingValue(pind)))
-          {
-              hasNonConstIncVal = true;
-              break;
-          }
-      }*/
+      bool hasNonConstIncVal = !keepConstantPHIs;
+      for (unsigned pind = 0, pe = phiN->getNumIncomingValues();
+           !hasNonConstIncVal && pind < pe; ++pind) {
+        if (!llvm::isa<llvm::Constant>(phiN->getIncomingValue(pind)))
+          hasNonConstIncVal = true;
+      }
       if (hasNonConstIncVal) {
         /***if (! AllocaInsertionPoint)
         {
@@ -498,7 +533,65 @@ inline bool Mutation::skipFunc(llvm::Function &Func) {
   return false;
 }
 
+std::map<std::string, Mutation::ResidentConfiguration>
+    Mutation::residentConfigurations;
+
+bool Mutation::loadResidentConfiguration(std::string mutConfFile) {
+  std::string absPath;
+  std::pair<time_t, off_t> stamp;
+  if (!ReadWriteIRObj::getFileStamp(mutConfFile, absPath, stamp)) {
+    llvm::errs() << "Error: cannot access the mutant configuration '"
+                 << mutConfFile << "'\n";
+    return false;
+  }
+  auto it = residentConfigurations.find(absPath);
+  if (it != residentConfigurations.end() && it->second.stamp == stamp)
+    return true;
+  UserMaps usermaps;
+  mutationConfig config;
+  if (!parseConfiguration(absPath, usermaps, config))
+    return false;
+  ResidentConfiguration &resident = residentConfigurations[absPath];
+  resident.stamp = stamp;
+  resident.config = config;
+  return true;
+}
+
+bool Mutation::checkConfiguration(std::string const &mutConfText) {
+  std::istringstream confStream(mutConfText);
+  UserMaps usermaps;
+  mutationConfig config;
+  return parseConfiguration(confStream, usermaps, config);
+}
+
 bool Mutation::getConfiguration(std::string &mutConfFile) {
+  if (!residentConfigurations.empty()) {
+    std::string absPath;
+    std::pair<time_t, off_t> stamp;
+    if (ReadWriteIRObj::getFileStamp(mutConfFile, absPath, stamp)) {
+      auto it = residentConfigurations.find(absPath);
+      if (it != residentConfigurations.end() && it->second.stamp == stamp) {
+        configuration = it->second.config;
+        return true;
+      }
+    }
+  }
+  return parseConfiguration(mutConfFile, usermaps, configuration);
+}
+
+bool Mutation::parseConfiguration(std::string &mutConfFile, UserMaps &usermaps,
+                                  mutationConfig &configuration) {
+  std::ifstream infile(mutConfFile);
+  if (!infile) {
+    llvm::errs() << "Error while opening (or empty) mutant configuration '"
+                 << mutConfFile << "'\n";
+    return false;
+  }
+  return parseConfiguration(infile, usermaps, configuration);
+}
+
+bool Mutation::parseConfiguration(std::istream &infile, UserMaps &usermaps,
+                                  mutationConfig &configuration) {
   // TODO
   std::vector<unsigned> reploprd;
   std::vector<llvmMutationOp> mutationOperations;
@@ -506,7 +599,6 @@ bool Mutation::getConfiguration(std::string &mutConfFile) {
   std::vector<enum ExpElemKeys> *correspKeysMatch;
   std::vector<enum ExpElemKeys> *correspKeysMutant;
 
-  std::ifstream infile(mutConfFile);
   if (infile) {
     std::string linei;
     std::vector<std::string> matchop_oprd;
@@ -738,8 +830,7 @@ bool Mutation::getConfiguration(std::string &mutConfFile) {
       }
     }
   } else {
-    llvm::errs() << "Error while opening (or empty) mutant configuration '"
-                 << mutConfFile << "'\n";
+    llvm::errs() << "Error while reading (or empty) mutant configuration\n";
     return false;
   }
 
@@ -773,16 +864,22 @@ void Mutation::getanotherPostMutantPointFuncName() {
 // This function takes a statement as a list of IR instruction, using the
 // mutation model specified for this class, generate a list of all possible
 // mutants
-// of the statement
+// of the statement. With 'sampler', the mutation operators only build the
+// mutants that it keeps (see MutantsOfStmt::sampleIn)
 void Mutation::getMutantsOfStmt(MatchStmtIR const &stmtIR,
                                 MutantsOfStmt &ret_mutants,
-                                ModuleUserInfos const &moduleInfo) {
+                                ModuleUserInfos const &moduleInfo,
+                                MutantsSampler *sampler) {
   assert((ret_mutants.getNumMuts() == 0) &&
          "Error (Mutation::getMutantsOfStmt): mutant list result vector is not "
          "empty!\n");
 
   WholeStmtMutationOnce iswholestmtmutated;
 
+  if (sampler != nullptr)
+    sampler->startStatement();
+  ret_mutants.sampler = sampler;
+
   for (llvmMutationOp &mutator : configuration.mutators) {
     // for (auto &mn: mutator.getMutantReplacorsList())    // DBG
     //    llvm::errs() << mn.getMutOpName() << "; ";      // DBG
@@ -828,6 +925,7 @@ void Mutation::getMutantsOfStmt(MatchStmtIR const &stmtIR,
     //}
     //}
   }
+  ret_mutants.sampler = nullptr;
 } //~Mutation::getMutantsOfStmt
 
 llvm::Function *Mutation::createKSFunc(llvm::Module &module, bool bodyOnly,
@@ -936,24 +1034,23 @@ bool Mutation::doMutate() {
   struct SourceStmtsSearchList {
     std::vector<StatementSearch *> sourceOrderedStmts;
     llvm::BasicBlock *curBB = nullptr;
+    // owns the statements of the function being searched
+    StatementSearchArena *stmtsArena = nullptr;
     StatementSearch *createNewElem(llvm::BasicBlock *bb) {
       if (bb != curBB) {
         // if (curBB != nullptr)
         sourceOrderedStmts.push_back(nullptr);
         curBB = bb;
       }
-      sourceOrderedStmts.push_back(new StatementSearch);
+      sourceOrderedStmts.push_back(stmtsArena->create());
       return sourceOrderedStmts.back();
     }
+    /// The removed statement is always the live one, last in the order. It
+    /// is only marked discarded (its memory is released with the arena)
     void remove(StatementSearch *ss) {
-      delete ss;
-      bool found = false;
-      for (long i = sourceOrderedStmts.size() - 1; i >= 0; i--)
-        if (sourceOrderedStmts[i] == ss) {
-          sourceOrderedStmts.erase(sourceOrderedStmts.begin() + i);
-          found = true;
-        }
-      assert(found && "removing a statement not inserted");
+      assert(!sourceOrderedStmts.empty() && sourceOrderedStmts.back() == ss &&
+             "removing a statement not being searched");
+      ss->discarded = true;
     }
     void appendOrder(llvm::BasicBlock *bb, StatementSearch *ss) {
       if (bb != curBB) {
@@ -965,19 +1062,20 @@ bool Mutation::doMutate() {
       sourceOrderedStmts.push_back(ss);
     }
     void doneSearch() { sourceOrderedStmts.push_back(nullptr); }
+    /// The statements are released with the arena
     void clear() {
-      std::unordered_set<StatementSearch *> stmp(sourceOrderedStmts.begin(),
-                                                 sourceOrderedStmts.end());
-      for (auto *ss : stmp)
-        if (ss)
-          delete ss;
       sourceOrderedStmts.clear();
       curBB = nullptr;
     }
     std::vector<StatementSearch *> &getSourceOrderedStmts() {
       return sourceOrderedStmts;
     }
-  } srcStmtsSearchList;
+    void setFunctionArena(StatementSearchArena *arena) {
+      assert(sourceOrderedStmts.empty() && "previous search not done");
+      stmtsArena = arena;
+      curBB = nullptr;
+    }
+  };
 
   /**
    * \brief This class create a proxy BB for each incoming BB of PHI nodes whose
@@ -1081,7 +1179,13 @@ bool Mutation::doMutate() {
         }
       }
     }
-  } phiProxy;
+  };
+
+  SourceStmtsSearchList srcStmtsSearchList;
+  // owns the statements of the function being mutated
+  StatementSearchArena stmtsArena;
+
+  ProxyForPHI phiProxy;
 
   // pos in sourceStmts of the statement spawning multiple BB. The actual
   // mutation happend only when this is empty at the end of a BB.
@@ -1091,16 +1195,58 @@ bool Mutation::doMutate() {
   // set to null after each stmt search completion
   StatementSearch *curLiveStmtSearch = nullptr;
 
+  // Removes the trivially equivalent and duplicate mutants of each statement
+  PreTCEFilter preFilter;
+
+  // Decides which mutants are generated
+  std::unique_ptr<MutantsSampler> sampler;
+  if (isSamplingMutants())
+    sampler.reset(new MutantsSampler(
+        samplingRate,
+        samplingBy == "statement"
+            ? MutantsSampler::ByStatement
+            : (samplingBy == "operator" ? MutantsSampler::ByOperator
+                                        : MutantsSampler::ByMutant),
+        samplingSeed));
+
+  // The functions to mutate, in module order. With a maximum number of
+  // mutants, each function is visited twice: the counting visits of all the
+  // functions only count the mutants that the rate sampling keeps (none is
+  // built), then the sampler chooses the ones to keep among them
+  std::vector<llvm::Function *> funcsVisits;
+  for (auto &Func : module)
+    if (!skipFunc(Func))
+      funcsVisits.push_back(&Func);
+  unsigned numCountingVisits = 0;
+  if (samplingMaxMutants > 0) {
+    numCountingVisits = funcsVisits.size();
+    std::vector<llvm::Function *> mutationVisits(funcsVisits);
+    funcsVisits.insert(funcsVisits.end(), mutationVisits.begin(),
+                       mutationVisits.end());
+    sampler->startCounting();
+  }
+  // The PHI proxies made by the counting visits, for the mutation visits
+  std::unordered_map<llvm::Function *, ProxyForPHI> countedPhiProxies;
+
   /******************************************************
    **** Search for high level statement (source level) **
    ******************************************************/
-  for (auto &Func : module) {
-
-    // Skip Function with only Declaration (External function -- no definition)
-    if (skipFunc(Func))
-      continue;
-
-    phiProxy.clear(&Func);
+  for (unsigned visit = 0; visit < funcsVisits.size(); ++visit) {
+    llvm::Function &Func = *funcsVisits[visit];
+    bool countingVisit = (visit < numCountingVisits);
+
+    // All the functions were counted: choose the mutants to keep
+    if (visit == numCountingVisits && numCountingVisits > 0)
+      sampler->keepAtMost(samplingMaxMutants);
+
+    auto countedProxiesIt = countedPhiProxies.find(&Func);
+    if (countedProxiesIt != countedPhiProxies.end()) {
+      phiProxy = std::move(countedProxiesIt->second);
+      countedPhiProxies.erase(countedProxiesIt);
+    } else {
+      phiProxy.clear(&Func);
+    }
+    srcStmtsSearchList.setFunctionArena(&stmtsArena);
 
     ///\brief This hel recording the IR's LOC: index in the function it belongs
     unsigned instructionPosInFunc = 0;
@@ -1397,22 +1543,58 @@ bool Mutation::doMutate() {
           nullptr; // The loop bellow will be executed at least once
       auto curSrcStmtIt = srcStmtsSearchList.getSourceOrderedStmts().begin();
 
-      /// Get all the mutants
+      /// Get all the mutants (a multi BB statement appears once per BB)
+      std::unordered_set<StatementSearch *> mutatedStmts;
       for (auto *sstmt : srcStmtsSearchList.getSourceOrderedStmts()) {
-        if (sstmt && sstmt->mutantStmt_list.isEmpty()) // not yet mutated
-        {
-          // Find all mutants and put into 'mutantStmt_list'
-          getMutantsOfStmt(sstmt->matchStmtIR, sstmt->mutantStmt_list,
-                           moduleInfo);
+        if (!sstmt || sstmt->discarded || !mutatedStmts.insert(sstmt).second ||
+            !mutationScope.stmtInMutationScope(sstmt->matchStmtIR.getIRList()))
+          continue;
 
-          // set the mutant IDs
+        // Find all mutants and put into 'mutantStmt_list'
+        getMutantsOfStmt(sstmt->matchStmtIR, sstmt->mutantStmt_list, moduleInfo,
+                         sampler.get());
+        if (countingVisit) {
+          assert(sstmt->mutantStmt_list.isEmpty() &&
+                 "a mutant was built while only counting the mutants");
+          continue;
+        }
+        if (preTCEFilter)
+          preFilter.filter(sstmt->matchStmtIR, sstmt->mutantStmt_list);
+
+        // set the mutant IDs
+        for (auto mind = 0; mind < sstmt->mutantStmt_list.getNumMuts();
+             mind++) {
+          sstmt->mutantStmt_list.setMutID(mind, ++curMutantID);
+          // for(auto
+          // &xx:sstmt->mutantStmt_list.getMutantStmtIR(mind).origBBToMutBB)
+          //    for(auto *bb: xx.second)
+          //        bb->dump();
+        }
+        // Record the mutants removed by the pre-TCE filter
+        for (auto &filtered : sstmt->mutantStmt_list.preFiltered) {
+          mutantsInfos.addPreFiltered(
+              sstmt->matchStmtIR.getIRList(), filtered.typeName,
+              filtered.irRelevantPos, &Func,
+              sstmt->matchStmtIR.posIRsInOrigFunc,
+              filtered.dupOfIndex < 0
+                  ? 0
+                  : sstmt->mutantStmt_list.getMutID(filtered.dupOfIndex));
+          ++numPreFilteredMuts;
+        }
+        // Record the mutants sampled out
+        for (auto &out : sstmt->mutantStmt_list.sampledOut) {
+          mutantsInfos.addSampledOut(sstmt->matchStmtIR.getIRList(),
+                                     out.typeName, out.irRelevantPos, &Func,
+                                     sstmt->matchStmtIR.posIRsInOrigFunc);
+          ++samplingCounts[out.typeName].first;
+        }
+        if (isSamplingMutants()) {
           for (auto mind = 0; mind < sstmt->mutantStmt_list.getNumMuts();
                mind++) {
-            sstmt->mutantStmt_list.setMutID(mind, ++curMutantID);
-            // for(auto
-            // &xx:sstmt->mutantStmt_list.getMutantStmtIR(mind).origBBToMutBB)
-            //    for(auto *bb: xx.second)
-            //        bb->dump();
+            auto &counts =
+                samplingCounts[sstmt->mutantStmt_list.getTypeName(mind)];
+            ++counts.first;
+            ++counts.second;
           }
         }
       }
@@ -1634,6 +1816,12 @@ bool Mutation::doMutate() {
     assert(remainMultiBBLiveStmts.empty() &&
            "Something wrong with function (missing IRs) or bug!");
 
+    stmtsArena.reset();
+    if (countingVisit) {
+      countedPhiProxies[&Func] = std::move(phiProxy);
+      continue;
+    }
+
     // repairDefinitionUseDomination(Func);  //TODO: when we want to directly
     // support cross BB use
 
@@ -1770,6 +1958,54 @@ void Mutation::getWMConditions(
       moduleInfo.getContext())})); // true (there is difference - weakly killed)
 }
 
+/// \brief get the address of the byte at 'index' in the inline probes bitmap
+static llvm::Constant *getInlineLogBitmapElem(llvm::GlobalVariable *bitmap,
+                                              uint64_t index) {
+  llvm::Type *i32Ty = llvm::Type::getInt32Ty(bitmap->getContext());
+  llvm::Constant *indices[] = {llvm::ConstantInt::get(i32Ty, 0),
+                               llvm::ConstantInt::get(i32Ty, index)};
+#if (LLVM_VERSION_MAJOR <= 3) && (LLVM_VERSION_MINOR < 7)
+  return llvm::ConstantExpr::getInBoundsGetElementPtr(bitmap, indices);
+#else
+  return llvm::ConstantExpr::getInBoundsGetElementPtr(
+      bitmap->getType()->getElementType(), bitmap, indices);
+#endif
+}
+
+/// \brief get the mutants IDs range passed as arguments to a KS function call
+static std::pair<MutantIDType, MutantIDType>
+getKSCallMutantsRange(llvm::CallInst *callI) {
+  auto *fromID = llvm::dyn_cast<llvm::ConstantInt>(callI->getArgOperand(0));
+  auto *toID = llvm::dyn_cast<llvm::ConstantInt>(callI->getArgOperand(1));
+  assert(fromID && toID && fromID->getZExtValue() <= toID->getZExtValue() &&
+         "KS function arguments must be a constant mutants IDs range");
+  return std::make_pair((MutantIDType)fromID->getZExtValue(),
+                        (MutantIDType)toID->getZExtValue());
+}
+
+/**
+ * \brief Create, in 'module' (linked with the log module), the bitmap of the
+ * inline probes: one byte per mutant ID, set to non zero by the probes. The
+ * log module's bitmap pointer is made to point to it, for the dump at exit.
+ */
+llvm::GlobalVariable *
+Mutation::createInlineLogBitmap(llvm::Module &module,
+                                unsigned highestMutantID) {
+  llvm::GlobalVariable *bitmapPtr = module.getNamedGlobal(inlineLogBitmapName);
+  assert(bitmapPtr && "Inline probes bitmap pointer absent in the module. Was "
+                      "the log module linked properly?");
+  llvm::ArrayType *bitmapTy = llvm::ArrayType::get(
+      llvm::Type::getInt8Ty(module.getContext()), highestMutantID + 1);
+  llvm::GlobalVariable *bitmap = new llvm::GlobalVariable(
+      module, bitmapTy, false, llvm::GlobalValue::InternalLinkage,
+      llvm::ConstantAggregateZero::get(bitmapTy),
+      std::string(inlineLogBitmapName) + ".data");
+  bitmapPtr->setInitializer(llvm::ConstantExpr::getPointerCast(
+      bitmap, bitmapPtr->getType()->getElementType()));
+  bitmapPtr->setConstant(true);
+  return bitmap;
+}
+
 /**
  * \brief transform non optimized meta-mutant module into weak mutation module.
  * @param cmodule is the meta mutant module. @note: it will be transformed into
@@ -1827,6 +2063,11 @@ void Mutation::computeWeakMutation(std::unique_ptr<llvm::Module> &cmodule,
       llvm::APInt(32, (uint64_t)getHighestMutantID(cmodule.get()), false)));
   constWMHighestID->setConstant(true);
 
+  llvm::GlobalVariable *inlineBitmap = nullptr;
+  if (inlineLogProbes)
+    inlineBitmap =
+        createInlineLogBitmap(*cmodule, getHighestMutantID(cmodule.get()));
+
   for (auto &Func : *cmodule) {
     if (&Func == funcWMLog || &Func == funcWMFflush)
       continue;
@@ -1950,6 +2191,17 @@ void Mutation::computeWeakMutation(std::unique_ptr<llvm::Module> &cmodule,
                         condVals[ic].front(),
                         llvm::Type::getInt8Ty(
                             moduleInfo.getContext())); // convert i1 into i8
+                    if (inlineBitmap) {
+                      // bitmap[mutant ID] |= weak kill condition
+                      llvm::Constant *elem = getInlineLogBitmapElem(
+                          inlineBitmap, mutIDConstInt->getZExtValue());
+                      sbuilders[ic].CreateStore(
+                          sbuilders[ic].CreateOr(
+                              sbuilders[ic].CreateLoad(elem),
+                              condVals[ic].front()),
+                          elem);
+                      continue;
+                    }
                     argsv.clear();
                     argsv.push_back(mutIDConstInt); // mutant ID
                     // weak kill condition
@@ -1978,9 +2230,10 @@ void Mutation::computeWeakMutation(std::unique_ptr<llvm::Module> &cmodule,
                 }
               }
 
-              // Now call fflush
+              // Now call fflush (the inline probes are dumped at exit)
               argsv.clear();
-              sbuilders.back().CreateCall(funcWMFflush, argsv);
+              if (!inlineBitmap)
+                sbuilders.back().CreateCall(funcWMFflush, argsv);
 
               for (auto *caseval : cases) {
                 llvm::SwitchInst::CaseIt cit = sw->findCaseValue(caseval);
@@ -2059,10 +2312,6 @@ void Mutation::computeMutantCoverage(std::unique_ptr<llvm::Module> &metaModule,
                       "linked properly?");
   assert(constCovHighestID && "Mutation coverage coverage Highest mutant ID absent in"
                              "Coverage Module. Was it linked properly?");
-  constCovHighestID->setInitializer(llvm::ConstantInt::get(
-      moduleInfo.getContext(),
-      llvm::APInt(32, (uint64_t)getHighestMutantID(metaModule.get()), false)));
-  constCovHighestID->setConstant(true);
 
   llvm::Function *funcForKS = metaModule->getFunction(mutantIDSelectorName_Func);
   llvm::GlobalVariable *mutantIDSelGlob =
@@ -2076,6 +2325,85 @@ void Mutation::computeMutantCoverage(std::unique_ptr<llvm::Module> &metaModule,
     cleanFunctionToMut(Func, 0/*original mutantID*/, mutantIDSelGlob, funcForKS, false/*verify*/, false/*remove ks func calls*/);
   }
 
+  // Each remaining call to KS function is the probe of a mutated statement,
+  // with the statement's mutants IDs range as arguments
+  std::vector<llvm::CallInst *> ksCalls;
+#if (LLVM_VERSION_MAJOR <= 3) && (LLVM_VERSION_MINOR < 5)
+  for (auto uit = funcForKS->use_begin(), uie = funcForKS->use_end();
+       uit != uie; ++uit) {
+    llvm::User *user = *uit;
+#else
+  for (auto *user : funcForKS->users()) {
+#endif
+    auto *callI = llvm::dyn_cast<llvm::CallInst>(user);
+    assert(callI && "KS function must only be called");
+    ksCalls.push_back(callI);
+  }
+
+  // The IDs logged are the mutants IDs, or the statements indexes with the
+  // statement probes (the statements are numbered in the order of their
+  // mutants IDs)
+  uint64_t covHighestID = getHighestMutantID(metaModule.get());
+  std::map<std::pair<MutantIDType, MutantIDType>, unsigned> rangeToStmt;
+  covStmtMutantRanges.clear();
+  if (stmtCoverageProbes) {
+    for (auto *callI : ksCalls)
+      rangeToStmt[getKSCallMutantsRange(callI)] = 0;
+    for (auto &rangeStmt : rangeToStmt) {
+      rangeStmt.second = covStmtMutantRanges.size();
+      covStmtMutantRanges.push_back(rangeStmt.first);
+    }
+    covHighestID =
+        covStmtMutantRanges.empty() ? 0 : covStmtMutantRanges.size() - 1;
+  }
+  constCovHighestID->setInitializer(llvm::ConstantInt::get(
+      moduleInfo.getContext(), llvm::APInt(32, covHighestID, false)));
+  constCovHighestID->setConstant(true);
+
+  if (inlineLogProbes) {
+    // Replace the calls to KS function by the setting of the bytes of the
+    // mutants IDs range (its arguments), or of the statement, in the bitmap
+    llvm::GlobalVariable *inlineBitmap =
+        createInlineLogBitmap(*metaModule, covHighestID);
+    for (auto *callI : ksCalls) {
+      auto range = getKSCallMutantsRange(callI);
+      llvm::IRBuilder<> builder(callI);
+      if (stmtCoverageProbes) {
+        builder.CreateStore(builder.getInt8(1),
+                            getInlineLogBitmapElem(inlineBitmap,
+                                                   rangeToStmt.at(range)));
+      } else {
+        llvm::Constant *elem = getInlineLogBitmapElem(inlineBitmap, range.first);
+        uint64_t rangeSize = range.second - range.first + 1;
+        if (rangeSize == 1)
+          builder.CreateStore(builder.getInt8(1), elem);
+        else
+          builder.CreateMemSet(elem, builder.getInt8(1), rangeSize, 1);
+      }
+      callI->eraseFromParent();
+    }
+    funcForKS->eraseFromParent();
+
+    if (mutantIDSelGlob)
+      mutantIDSelGlob->setConstant(true); // only original...
+
+    Mutation::checkModuleValidity(*metaModule,
+                                  "ERROR: Misformed Mutant Coverage Module!");
+    llvm::errs() << "Computing mutant-coverage done!\n"; ////DBG
+    return;
+  }
+
+  // The statement probes log the single ID of the statement
+  if (stmtCoverageProbes) {
+    for (auto *callI : ksCalls) {
+      unsigned stmtIndex = rangeToStmt.at(getKSCallMutantsRange(callI));
+      for (unsigned argPos = 0; argPos < 2; ++argPos)
+        callI->setArgOperand(
+            argPos, llvm::ConstantInt::get(
+                        callI->getArgOperand(argPos)->getType(), stmtIndex));
+    }
+  }
+
   // make KS function call cov log function
   funcForKS->deleteBody();
   llvm::BasicBlock *block =
@@ -2147,12 +2475,12 @@ struct DuplicateEquivalentProcessor {
   std::vector<llvm::Module *> mutModules;
   std::vector<llvm::Function *> mutFunctions;
 
-  /// \brief the key of the map is the index (staring from 0) of the function in
-  /// the original's optimized module, or -1 for any function not present in
-  /// original optimized
+  /// \brief the key of the map is the name of the function in the original's
+  /// optimized module, or "" for any function not present in original
+  /// optimized (the name, since in module mode each batch has its original)
   /// \brief the value is a vector of the ids of all the mutants (non dup) in
   /// duplicateMap for which the function is different than the orig's.
-  std::unordered_map<llvm::Function *, std::vector<MutantIDType>> diffFuncs2Muts;
+  std::unordered_map<std::string, std::vector<MutantIDType>> diffFuncs2Muts;
 
   /// \brief map to lookup the module(value) cleaned for each function (key)
   std::unordered_map<llvm::Function *, ReadWriteIRObj> inMemIRModBufByFunc;
@@ -2170,12 +2498,157 @@ struct DuplicateEquivalentProcessor {
 
   bool isTCEFunctionMode;
 
+  /// \brief Module mode: the mutant modules are processed by batches, each in
+  /// its own LLVMContext, destroyed (with all the types, constants and
+  /// metadata created in it) at the end of the batch. The original is kept
+  /// serialized between the batches. Of a non duplicate mutant, only its
+  /// mutated function is kept (see NonDupFunction): the later mutants are
+  /// compared with it, and its module is regenerated to be written.
+  std::unique_ptr<llvm::LLVMContext> batchContext;
+  llvm::Module *batchOrig = nullptr;
+  std::vector<MutantIDType> batchLoadedIDs;
+  ReadWriteIRObj origModBuf;
+
+  /// \brief Module mode: mutated function of a non duplicate mutant, as a
+  /// function delta (see ReadWriteIRObj::writeFunctionDeltaToBuffer), and the
+  /// shape hash of the function (see functionShapeHash). The delta is empty
+  /// when the optimization removed the function from the mutant.
+  struct NonDupFunction {
+    size_t hash = 0;
+    std::string delta;
+  };
+  std::unordered_map<MutantIDType, NonDupFunction> nonDupFuncs;
+
+  /// \brief Module mode: the function deltas read in the current batch
+  std::unordered_map<MutantIDType, llvm::Module *> batchDeltaModules;
+
   DuplicateEquivalentProcessor(MutantIDType highestMutID, bool is_tce_func_mode)
       : isTCEFunctionMode(is_tce_func_mode) {
     funcMutByMutID.resize(highestMutID + 1, nullptr);
     diffBBWithOrig.resize(highestMutID + 1);
   }
 
+  void setOriginal(llvm::Module *clonedOrig) {
+    duplicateMap[0]; // insert 0 into the map
+    diffFuncs2Muts[""]; // for function not in original
+    for (auto &origFunc : *clonedOrig)
+      diffFuncs2Muts[origFunc.getName().str()];
+  }
+
+  /// \brief start a new batch, with its context, and return the batch's
+  /// original module
+  llvm::Module *openBatch() {
+    assert(!batchContext && "previous batch not closed");
+    batchContext.reset(new llvm::LLVMContext());
+    batchOrig = origModBuf.readIR(*batchContext);
+    return batchOrig;
+  }
+
+  /// \brief read the module of mutant 'mid' from 'buf' into the batch
+  llvm::Module *loadInBatch(MutantIDType mid, ReadWriteIRObj &buf) {
+    assert(!mutModules.at(mid) && "mutant module already loaded");
+    mutModules[mid] = buf.readIR(*batchContext);
+    batchLoadedIDs.push_back(mid);
+    return mutModules[mid];
+  }
+
+  /// \brief free all the modules of the batch and its context
+  void closeBatch() {
+    for (MutantIDType mid : batchLoadedIDs) {
+      delete mutModules[mid];
+      mutModules[mid] = nullptr;
+    }
+    batchLoadedIDs.clear();
+    for (auto &dmIt : batchDeltaModules)
+      delete dmIt.second;
+    batchDeltaModules.clear();
+    delete batchOrig;
+    batchOrig = nullptr;
+    batchContext.reset(nullptr);
+  }
+
+  /// \brief hash of the shape of 'F': the opcodes of its instructions, in the
+  /// order of the CFG traversal from the entry block. The functions that
+  /// tce.functionDiff finds equal have the same hash.
+  static size_t functionShapeHash(llvm::Function &F) {
+    size_t hash = llvm::hash_combine(F.isVarArg(), F.arg_size());
+    std::vector<llvm::BasicBlock *> workBBs(1, &F.getEntryBlock());
+    std::set<llvm::BasicBlock *> seenBBs(workBBs.begin(), workBBs.end());
+    while (!workBBs.empty()) {
+      llvm::BasicBlock *BB = workBBs.back();
+      workBBs.pop_back();
+      for (auto &I : *BB)
+        hash = llvm::hash_combine(hash, I.getOpcode(), I.getNumOperands());
+      auto *term = BB->getTerminator();
+      for (unsigned i = 0, e = term->getNumSuccessors(); i < e; ++i)
+        if (seenBBs.insert(term->getSuccessor(i)).second)
+          workBBs.push_back(term->getSuccessor(i));
+    }
+    return hash;
+  }
+
+  /// \brief Module mode: the function of the delta of mutant 'mid', read
+  /// into the batch (once per batch)
+  llvm::Function *getDeltaFunctionInBatch(MutantIDType mid,
+                                          std::string const &delta) {
+    llvm::Module *&deltaM = batchDeltaModules[mid];
+    if (!deltaM) {
+      deltaM = ReadWriteIRObj::readIRFromBuffer(delta, *batchContext);
+      assert(deltaM && "failed to read a mutant function delta");
+    }
+    for (auto &F : *deltaM)
+      if (!F.isDeclaration())
+        return &F;
+    assert(false && "A function delta must define a function");
+    return nullptr;
+  }
+
+  /// \brief Module mode: return the ID of a mutant of 'candIDs' whose
+  /// mutated function is equal to 'subjFunc', the mutated function of mutant
+  /// 'mutant_id' (nullptr if the optimization removed it), or 0 if there is
+  /// none; in which case the function is kept into 'nonDupFuncs'.
+  /// Only the deltas of the functions of same shape hash are read and
+  /// compared (the comparison is between deltas, both with the same
+  /// declarations of globals).
+  MutantIDType findModuleModeDuplicate(MutantIDType mutant_id,
+                                       llvm::Function *subjFunc,
+                                       std::vector<MutantIDType> const &candIDs) {
+    NonDupFunction subjND;
+    llvm::Function *subjDeltaFunc = nullptr;
+    if (subjFunc) {
+      subjND.hash = functionShapeHash(*subjFunc);
+      ReadWriteIRObj::writeFunctionDeltaToBuffer(
+          subjFunc, subjFunc->getParent(), subjND.delta);
+    }
+    MutantIDType foundID = 0;
+    for (auto candID : candIDs) {
+      NonDupFunction const &candND = nonDupFuncs.at(candID);
+      if (!subjFunc || candND.delta.empty()) {
+        if (!subjFunc && candND.delta.empty()) {
+          foundID = candID;
+          break;
+        }
+        continue;
+      }
+      if (candND.hash != subjND.hash)
+        continue;
+      if (!subjDeltaFunc)
+        subjDeltaFunc = getDeltaFunctionInBatch(mutant_id, subjND.delta);
+      if (!tce.functionDiff(getDeltaFunctionInBatch(candID, candND.delta),
+                            subjDeltaFunc, nullptr)) {
+        foundID = candID;
+        break;
+      }
+    }
+    if (foundID == 0) {
+      nonDupFuncs[mutant_id] = std::move(subjND);
+    } else if (subjDeltaFunc) {
+      delete batchDeltaModules.at(mutant_id);
+      batchDeltaModules.erase(mutant_id);
+    }
+    return foundID;
+  }
+
   /// Populate dup2nondupMap using the dupliate informations from duplicateMap
   void createEqDup2NonEqDupMap() {
     assert (dup2nondupMap.empty() && "Error: dup2nondupMap must be empty here!");
@@ -2221,35 +2694,36 @@ struct DuplicateEquivalentProcessor {
 
       bool hasEq = false;
       for (auto *mF : mutatedFuncsOfMID) {
-        llvm::Function *subjFunc;
-        if (isTCEFunctionMode)
-          subjFunc = mutFunctions[mutant_id];
-        else
-          subjFunc = clonedM->getFunction(mF->getName());
-
-        for (auto candID : diffFuncs2Muts.at(mF)) {
-          llvm::Function *candFunc;
-          if (isTCEFunctionMode) {
-            // prune useless comparisons
-            if (diffBBWithOrig[mutant_id].size() !=
-                diffBBWithOrig[candID].size())
-              continue;
-            bool dbbdf = false;
-            for (unsigned dbbInd = 0, dbbe = diffBBWithOrig[mutant_id].size();
-                 dbbInd < dbbe; dbbInd++) {
-              if (diffBBWithOrig[mutant_id][dbbInd] !=
-                  diffBBWithOrig[candID][dbbInd]) {
-                dbbdf = true;
-                break;
-              }
-            }
-            if (dbbdf)
-              continue;
+        if (!isTCEFunctionMode) {
+          MutantIDType candID = findModuleModeDuplicate(
+              mutant_id, clonedM->getFunction(mF->getName()),
+              diffFuncs2Muts.at(mF->getName().str()));
+          if (candID != 0) {
+            hasEq = true;
+            duplicateMap.at(candID).push_back(mutant_id);
+          }
+          continue;
+        }
 
-            candFunc = mutFunctions[candID];
-          } else {
-            candFunc = mutModules.at(candID)->getFunction(mF->getName());
+        llvm::Function *subjFunc = mutFunctions[mutant_id];
+        for (auto candID : diffFuncs2Muts.at(mF->getName().str())) {
+          // prune useless comparisons
+          if (diffBBWithOrig[mutant_id].size() !=
+              diffBBWithOrig[candID].size())
+            continue;
+          bool dbbdf = false;
+          for (unsigned dbbInd = 0, dbbe = diffBBWithOrig[mutant_id].size();
+               dbbInd < dbbe; dbbInd++) {
+            if (diffBBWithOrig[mutant_id][dbbInd] !=
+                diffBBWithOrig[candID][dbbInd]) {
+              dbbdf = true;
+              break;
+            }
           }
+          if (dbbdf)
+            continue;
+
+          llvm::Function *candFunc = mutFunctions[candID];
 
           if (!subjFunc) {
             if (candFunc)
@@ -2273,7 +2747,7 @@ struct DuplicateEquivalentProcessor {
       if (!hasEq) {
         duplicateMap[mutant_id]; // insert id into the map
         for (auto *mF : mutatedFuncsOfMID)
-          diffFuncs2Muts.at(mF).push_back(mutant_id);
+          diffFuncs2Muts.at(mF->getName().str()).push_back(mutant_id);
       } else {
         // delete its function to free memory space
         if (isTCEFunctionMode) {
@@ -2326,42 +2800,27 @@ void Mutation::doTCE(std::unique_ptr<llvm::Module> &optMetaMu, std::unique_ptr<l
     assert(getMutant(*clonedOrig, 0, dup_eq_processor.funcMutByMutID[0],
                      'A' /*optimizeAllFunctions*/) &&
            "error: failed to get original");
+    dup_eq_processor.setOriginal(clonedOrig);
   } else {
     dup_eq_processor.mutModules.clear();
     dup_eq_processor.mutModules.resize(highestMutID + 1, nullptr);
     llvm::errs() << "Cloning...\n"; //////DBG
     computeModuleBufsByFunc(*subjModule, &dup_eq_processor.inMemIRModBufByFunc,
                             nullptr, dup_eq_processor.funcMutByMutID);
-    // Read all the mutantmodules possibly in parallel
-    /*#ifdef ENABLE_OPENMP_PARALLEL
-         omp_set_num_threads(std::min(atoi(std::getenv("OMP_NUM_THREADS")),
-    std::max(omp_get_max_threads()/2, 1)));
-         #pragma omp parallel for
-    #endif*/
-    for (MutantIDType id = 0; id <= highestMutID; id++) // id==0 is the original
-    {
-      dup_eq_processor.mutModules[id] =
-          dup_eq_processor.inMemIRModBufByFunc
-              .at(dup_eq_processor.funcMutByMutID[id])
-              .readIR();
-      if (id % 100 == 0)
-        llvm::errs() << "Cloned up to " << id << ". ";
-    }
 
-    // The original
-    clonedOrig = dup_eq_processor.mutModules[0];
-    assert(getMutant(*clonedOrig, 0, dup_eq_processor.funcMutByMutID[0],
+    // The original, optimized once and kept serialized for all the batches
+    llvm::LLVMContext origContext;
+    std::unique_ptr<llvm::Module> origM(
+        dup_eq_processor.inMemIRModBufByFunc
+            .at(dup_eq_processor.funcMutByMutID[0])
+            .readIR(origContext));
+    assert(getMutant(*origM, 0, dup_eq_processor.funcMutByMutID[0],
                      'M' /*optimizeModule*/) &&
            "error: failed to get original");
+    dup_eq_processor.origModBuf.setToModule(origM.get());
+    dup_eq_processor.setOriginal(origM.get());
   }
 
-  // The original cont.
-  dup_eq_processor.duplicateMap[0]; // insert 0 into the map
-  // initialize 'dup_eq_processor.diffFuncs2Muts'
-  dup_eq_processor.diffFuncs2Muts[nullptr]; // for function not in original
-  for (auto &origFunc : *clonedOrig)
-    dup_eq_processor.diffFuncs2Muts[&origFunc];
-
   // The mutants
 
   /// \brief since the mutants of the same function have sequential ID, we use
@@ -2545,11 +3004,19 @@ void Mutation::doTCE(std::unique_ptr<llvm::Module> &optMetaMu, std::unique_ptr<l
       }
     } else ///~ for "if (isTCEFunctionMode)"
     {
-      clonedM = dup_eq_processor.mutModules[id];
+      if (!dup_eq_processor.batchContext)
+        clonedOrig = dup_eq_processor.openBatch();
+      clonedM = dup_eq_processor.loadInBatch(
+          id, dup_eq_processor.inMemIRModBufByFunc.at(
+                  dup_eq_processor.funcMutByMutID[id]));
       assert(
           getMutant(*clonedM, id, dup_eq_processor.funcMutByMutID[id], 'M') &&
           "error: failed to get mutant");
       dup_eq_processor.update(id, clonedOrig, clonedM);
+      if (id % modModeBatchSize == 0 || id == highestMutID) {
+        dup_eq_processor.closeBatch();
+        clonedOrig = nullptr;
+      }
     }
   }
 
@@ -2761,19 +3228,49 @@ void Mutation::doTCE(std::unique_ptr<llvm::Module> &optMetaMu, std::unique_ptr<l
         assert(writeMutantsCallback(this, &dup_eq_processor.duplicateMap,
                                     &dup_eq_processor.mutModules,
                                     wmModule.get(), covModule.get(),
-                                    &dup_eq_processor.mutFunctions) &&
+                                    &dup_eq_processor.mutFunctions, true,
+                                    true) &&
                "Failed to dump mutants IRs");
         dup_eq_processor.mutModules.clear();
         dup_eq_processor.mutModules.resize(0);
       } else {
-        assert(writeMutantsCallback(this, &dup_eq_processor.duplicateMap,
-                                    &dup_eq_processor.mutModules,
-                                    wmModule.get(), covModule.get(), nullptr) &&
-               "Failed to dump mutants IRs");
+        // Write the non duplicate mutants by batches, each read (with the
+        // original at index 0) into the batch's context
+        std::map<MutantIDType, std::vector<MutantIDType>> batchDupMap;
+        auto dupMapIt = dup_eq_processor.duplicateMap.begin();
+        auto dupMapEnd = dup_eq_processor.duplicateMap.end();
+        bool firstBatch = true;
+        do {
+          dup_eq_processor.mutModules[0] = dup_eq_processor.openBatch();
+          batchDupMap.clear();
+          for (; dupMapIt != dupMapEnd && batchDupMap.size() < modModeBatchSize;
+               ++dupMapIt) {
+            batchDupMap.insert(*dupMapIt);
+            // Regenerate the mutant's module (the TCE only kept its mutated
+            // function)
+            MutantIDType mid = dupMapIt->first;
+            llvm::Module *mutM = dup_eq_processor.loadInBatch(
+                mid, dup_eq_processor.inMemIRModBufByFunc.at(
+                         dup_eq_processor.funcMutByMutID[mid]));
+            assert(getMutant(*mutM, mid, dup_eq_processor.funcMutByMutID[mid],
+                             'M') &&
+                   "error: failed to get mutant");
+          }
+          assert(writeMutantsCallback(
+                     this, &batchDupMap, &dup_eq_processor.mutModules,
+                     firstBatch ? wmModule.get() : nullptr,
+                     firstBatch ? covModule.get() : nullptr, nullptr,
+                     firstBatch, dupMapIt == dupMapEnd) &&
+                 "Failed to dump mutants IRs");
+          // the batch's original is deleted with the batch
+          dup_eq_processor.mutModules[0] = nullptr;
+          dup_eq_processor.closeBatch();
+          firstBatch = false;
+        } while (dupMapIt != dupMapEnd);
       }
     } else {
       assert(writeMutantsCallback(this, nullptr, nullptr, wmModule.get(), covModule.get(),
-                                  nullptr) &&
+                                  nullptr, true, true) &&
              "Failed to dump weak mutantion IR. (can be null)");
     }
   }
@@ -3306,7 +3803,7 @@ bool Mutation::getMutant(llvm::Module &module, unsigned mutantID,
     tce.optimize(*mutFuncInThisModule, Mutation::funcModeOptLevel);
   } else if (optimizeModFuncNone == 'M') {
     mutantIDSelGlob->setInitializer(llvm::ConstantInt::get(
-        moduleInfo.getContext(), llvm::APInt(32, (uint64_t)mutantID, false)));
+        module.getContext(), llvm::APInt(32, (uint64_t)mutantID, false)));
     mutantIDSelGlob->setConstant(true);
     tce.optimize(module, Mutation::modModeOptLevel);
   } else if (optimizeModFuncNone == 'A') // optimize all the functions
@@ -3337,11 +3834,88 @@ unsigned Mutation::getHighestMutantID(llvm::Module const *module) {
 }
 
 void Mutation::loadMutantInfos(std::string filename) {
-  mutantsInfos.loadFromJsonFile(filename);
+  mutantsInfos.loadFromFile(filename);
 }
 
-void Mutation::dumpMutantInfos(std::string filename, std::string eqdup_filename) {
+/// Write the mutants infos JSON files and, if 'bin_filename' is not empty,
+/// the binary mutants infos file (mutants and equivalent/duplicate mutants)
+void Mutation::dumpMutantInfos(std::string filename, std::string eqdup_filename,
+                               std::string bin_filename) {
   mutantsInfos.printToJsonFile(filename, eqdup_filename);
+  if (!bin_filename.empty())
+    mutantsInfos.printToBinaryFile(bin_filename);
+}
+
+/**
+ * \brief Write the table of the statement coverage probes: for each statement
+ * index logged by the probes, the range [first, last] of its mutants IDs.
+ */
+void Mutation::dumpCoverageStmtsTable(std::string filename) {
+  JsonBox::Object outJSON;
+  for (unsigned stmtIndex = 0; stmtIndex < covStmtMutantRanges.size();
+       ++stmtIndex) {
+    JsonBox::Array range;
+    range.push_back(JsonBox::Value((int)covStmtMutantRanges[stmtIndex].first));
+    range.push_back(JsonBox::Value((int)covStmtMutantRanges[stmtIndex].second));
+    outJSON[std::to_string(stmtIndex)] = range;
+  }
+  JsonBox::Value vout(outJSON);
+  vout.writeToFile(filename, true, false);
+}
+
+/**
+ * \brief Write the mutation shard description (option 'shard'), used by
+ * mart-merge: the shard index, the number of shards and the functions mutated
+ * by the shard, in module order.
+ */
+void Mutation::dumpShardInfos(std::string filename) {
+  JsonBox::Object outJSON;
+  JsonBox::Array funcs;
+  for (auto &Func : *currentMetaMutantModule)
+    if (!Func.isDeclaration() &&
+        mutationScope.functionInMutationScope(&Func))
+      funcs.push_back(JsonBox::Value(Func.getName().str()));
+  outJSON["Shard"] = JsonBox::Value((int)shardIndex);
+  outJSON["Shards"] = JsonBox::Value((int)numShards);
+  outJSON["Functions"] = funcs;
+  JsonBox::Value vout(outJSON);
+  vout.writeToFile(filename, true, false);
+}
+
+void Mutation::dumpSamplingInfos(std::string filename) {
+  JsonBox::Object outJSON;
+  JsonBox::Object types;
+  unsigned generated = 0, kept = 0;
+  for (auto &tc : samplingCounts) {
+    JsonBox::Object counts;
+    counts["Generated"] = JsonBox::Value((int)tc.second.first);
+    counts["Kept"] = JsonBox::Value((int)tc.second.second);
+    types[tc.first] = counts;
+    generated += tc.second.first;
+    kept += tc.second.second;
+  }
+  outJSON["Seed"] = JsonBox::Value((int)samplingSeed);
+  outJSON["By"] = JsonBox::Value(samplingBy);
+  outJSON["Rate"] = JsonBox::Value(samplingRate);
+  outJSON["Max-Mutants"] = JsonBox::Value((int)samplingMaxMutants);
+  outJSON["Generated"] = JsonBox::Value((int)generated);
+  outJSON["Kept"] = JsonBox::Value((int)kept);
+  outJSON["Types"] = types;
+  JsonBox::Array sampledOut;
+  for (auto &info : mutantsInfos.getSampledOutMutants()) {
+    JsonBox::Object mutant;
+    JsonBox::Array irPos;
+    for (auto pos : info.irLeveLocInFunc)
+      irPos.push_back(JsonBox::Value((int)pos));
+    mutant["Type"] = JsonBox::Value(info.typeName);
+    mutant["FuncName"] = JsonBox::Value(info.locFuncName);
+    mutant["IRPosInFunc"] = irPos;
+    mutant["SrcLoc"] = JsonBox::Value(info.srcLevelLoc);
+    sampledOut.push_back(mutant);
+  }
+  outJSON["Sampled-Out"] = sampledOut;
+  JsonBox::Value vout(outJSON);
+  vout.writeToFile(filename, true, false);
 }
 
 std::string Mutation::getMutationStats() {
@@ -3350,7 +3924,9 @@ std::string Mutation::getMutationStats() {
             std::to_string(preTCENumMuts) + ", PostTCE: " +
             std::to_string(postTCENumMuts) + ", ";
   retstr += "Equivalent: " + std::to_string(numEquivalentMuts) +
-            ", Duplicates: " + std::to_string(numDuplicateMuts) + "\n\n";
+            ", Duplicates: " + std::to_string(numDuplicateMuts) +
+            ", Pre-filtered (equivalent and duplicates, not in PreTCE): " +
+            std::to_string(numPreFilteredMuts) + "\n\n";
   return retstr;
 }
 
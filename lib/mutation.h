@@ -13,6 +13,8 @@
 #ifndef __MART_GENMU_mutation__
 #define __MART_GENMU_mutation__
 
+#include <istream>
+#include <map>
 #include <string>
 #include <vector>
 
@@ -42,6 +44,30 @@ class Mutation {
   bool forKLEESEMu;
   llvm::Function *funcForKLEESEMu;
 
+  // Keep the PHI nodes with only constant incoming values (not demoted to
+  // memory by the preprocessing)
+  bool keepConstantPHIs;
+
+  // Mutation shard (option 'shard'): only the functions of the shard
+  // 'shardIndex' of 'numShards' are mutated
+  unsigned shardIndex;
+  unsigned numShards;
+
+  // Sampling of the mutants at generation (see setMutantsSampling): rate
+  // (1.0 for no sampling), strata, maximum number of mutants (0 for no
+  // maximum) and seed of the PRNG
+  double samplingRate;
+  std::string samplingBy;
+  unsigned samplingMaxMutants;
+  unsigned samplingSeed;
+  // Number of mutants generated (kept or sampled out) and kept by the
+  // sampling, per mutant type
+  std::map<std::string, std::pair<unsigned, unsigned>> samplingCounts;
+
+  // Remove the trivially equivalent and duplicate mutants of each statement
+  // before they are inserted in the module (see PreTCEFilter in tce.h)
+  bool preTCEFilter;
+
   llvm::Module *currentInputModule;
   llvm::Module *currentMetaMutantModule;
 
@@ -54,6 +80,7 @@ class Mutation {
   unsigned postTCENumMuts;
   unsigned numDuplicateMuts;
   unsigned numEquivalentMuts;
+  unsigned numPreFilteredMuts;
 
   UserMaps usermaps;
 
@@ -73,44 +100,138 @@ class Mutation {
 
   const char *wmHighestMutantIDConst = "martLLVM_WM_Log__Highest_Mutant_ID";
 
+  // Pointer, in the log module, to the bitmap set by the inline probes (one
+  // byte per mutant ID). The bitmap is dumped when the program exits.
+  const char *inlineLogBitmapName = "martLLVM_Inline_Log__Bitmap";
+
+  // Instrument WM and coverage with inline stores into the bitmap instead of
+  // calls to the log functions
+  bool inlineLogProbes;
+
+  // Mutant coverage with one probe per mutated statement (instead of per
+  // mutant). The probes log the statement index, expanded offline into the
+  // statement's mutants using the table below.
+  bool stmtCoverageProbes;
+
+  // Mutants IDs range (first, last) of each mutated statement of the coverage
+  // module, indexed by the statement index logged by the probes
+  std::vector<std::pair<MutantIDType, MutantIDType>> covStmtMutantRanges;
+
   static const bool verifyFuncModule =
       true; // Change this to enable/disable verification after mutation
 
   static const unsigned funcModeOptLevel = 1;
   static const unsigned modModeOptLevel = 0;
 
+  // In module mode, TCE and mutants write process the mutant modules by
+  // batches of this size, each batch in its own LLVMContext
+  static const unsigned modModeBatchSize = 256;
+
 public:
+  /// The mutants may be passed by batches (module mode), in several calls:
+  /// 'firstBatch' and 'lastBatch' tell whether the call is the first and the
+  /// last of the write (both are true when written at once).
   typedef bool (*DumpMutFunc_t)(
       Mutation *mutEng, std::map<unsigned, std::vector<unsigned>> *,
       std::vector<llvm::Module *> *, llvm::Module *, llvm::Module *,
-      std::vector<llvm::Function *> const *mutFunctions);
+      std::vector<llvm::Function *> const *mutFunctions, bool firstBatch,
+      bool lastBatch);
   Mutation(llvm::Module &module, std::string mutConfFile,
-           DumpMutFunc_t writeMutsF, std::string scopeJsonFile = "");
+           DumpMutFunc_t writeMutsF, std::string scopeJsonFile = "",
+           bool keepConstPHIs = false, unsigned shardIdx = 0,
+           unsigned nShards = 1);
+  /// In memory configuration: the mutation configuration is read from
+  /// 'mutConfStream' and 'scopeJsonText' is the content of the scope JSON
+  /// (empty to mutate everything). Check the configuration first with
+  /// checkConfiguration, as this asserts that it is valid.
+  Mutation(llvm::Module &module, std::istream &mutConfStream,
+           DumpMutFunc_t writeMutsF, std::string const &scopeJsonText,
+           bool keepConstPHIs = false, unsigned shardIdx = 0,
+           unsigned nShards = 1);
   ~Mutation();
+  /// Data of the caller, for 'writeMutsF' (it gets the Mutation object)
+  void setWriteMutantsCallbackData(void *data) {
+    writeMutantsCallbackData = data;
+  }
+  void *getWriteMutantsCallbackData() const { return writeMutantsCallbackData; }
   bool doMutate(); // Transforms module
   void doTCE(std::unique_ptr<llvm::Module> &optMetaMu, std::unique_ptr<llvm::Module> &modWMLog, 
             std::unique_ptr<llvm::Module> &modCovLog, bool writeMuts = false,
             bool isTCEFunctionMode = false); // Transforms module
   void setModFuncToFunction(llvm::Module *Mod, llvm::Function *srcF,
                             llvm::Function *targetF = nullptr);
+  void setInlineLogProbes(bool inlineProbes) { inlineLogProbes = inlineProbes; }
+  void setStmtCoverageProbes(bool stmtProbes) {
+    stmtCoverageProbes = stmtProbes;
+  }
+  static bool isValidSamplingStrata(std::string const &by) {
+    return by == "mutant" || by == "statement" || by == "operator";
+  }
+  /// Sample the mutants: 'rate' of the mutants of each stratum ('by' is
+  /// "mutant" for the whole module, "statement" or "operator" (mutant type)),
+  /// decided before each mutant is built (see MutantsSampler), and at most
+  /// 'maxMutants' (0 for no maximum) of those, chosen after a first pass that
+  /// counts them. Chosen with a PRNG seeded with 'seed'. The mutants sampled
+  /// out are recorded in the mutants infos.
+  void setMutantsSampling(double rate, std::string by, unsigned maxMutants,
+                          unsigned seed) {
+    assert(rate > 0.0 && rate <= 1.0 && isValidSamplingStrata(by) &&
+           "Invalid mutants sampling");
+    samplingRate = rate;
+    samplingBy = by;
+    samplingMaxMutants = maxMutants;
+    samplingSeed = seed;
+  }
+  void setPreTCEFilter(bool enable) { preTCEFilter = enable; }
+  bool isSamplingMutants() const {
+    return samplingRate < 1.0 || samplingMaxMutants > 0;
+  }
   unsigned getHighestMutantID(llvm::Module const *module = nullptr);
 
+  MutantInfoList const &getMutantInfos() const { return mutantsInfos; }
   void loadMutantInfos(std::string filename);
-  void dumpMutantInfos(std::string filename, std::string eqdup_filename);
+  void dumpMutantInfos(std::string filename, std::string eqdup_filename,
+                       std::string bin_filename = "");
+  void dumpCoverageStmtsTable(std::string filename);
+  void dumpShardInfos(std::string filename);
+  void dumpSamplingInfos(std::string filename);
   // llvm::Module & getMetaMutantModule() {return currentMetaMutantModule;}
   std::string getMutationStats();
 
+  /// \brief parse the mutation configuration 'mutConfFile' and keep it
+  /// resident: the Mutation objects created afterward (e.g. in the jobs forked
+  /// by the daemon, see tools/Mart-Daemon.cpp) use it instead of parsing the
+  /// file again, as long as the file is not changed.
+  static bool loadResidentConfiguration(std::string mutConfFile);
+
+  /// \brief check that 'mutConfText' (content of a mutation configuration
+  /// file) is a valid mutation configuration
+  static bool checkConfiguration(std::string const &mutConfText);
+
   // Utilities
   void linkMetamoduleWithMutantSelection(
                         std::unique_ptr<llvm::Module> &optMetaMu,
                         std::unique_ptr<llvm::Module> &mutantSelectorMod);
 
 private:
+  // Resident mutation configurations, by absolute configuration file name
+  struct ResidentConfiguration {
+    std::pair<time_t, off_t> stamp;
+    mutationConfig config;
+  };
+  static std::map<std::string, ResidentConfiguration> residentConfigurations;
+
   bool getConfiguration(std::string &mutconfFile);
+  static bool parseConfiguration(std::string &mutConfFile, UserMaps &usermaps,
+                                 mutationConfig &configuration);
+  static bool parseConfiguration(std::istream &infile, UserMaps &usermaps,
+                                 mutationConfig &configuration);
+  void initialize(llvm::Module &module);
   void getanothermutantIDSelectorName();
   void getanotherPostMutantPointFuncName();
   void getMutantsOfStmt(MatchStmtIR const &stmtIR, MutantsOfStmt &ret_mutants,
-                        ModuleUserInfos const &moduleInfos);
+                        ModuleUserInfos const &moduleInfos,
+                        MutantsSampler *sampler = nullptr);
   llvm::Function *createKSFunc(llvm::Module &module, bool bodyOnly,
                                         std::string ks_func_name);
   llvm::Function *createGlobalMutIDSelector_Func(llvm::Module &module,
@@ -118,6 +239,7 @@ private:
   llvm::Function *createPostMutationPointFunc(llvm::Module &module,
                                                          bool bodyOnly);
   DumpMutFunc_t writeMutantsCallback;
+  void *writeMutantsCallbackData;
   void getWMConditions(std::vector<llvm::Instruction *> &origUnsafes,
                        std::vector<llvm::Instruction *> &mutUnsafes,
                        std::vector<std::vector<llvm::Value *>> &conditions);
@@ -127,6 +249,11 @@ private:
       std::unique_ptr<llvm::Module> &cmodule,
       std::unique_ptr<llvm::Module> &modWMLog);
 
+  // Create the bitmap of the inline probes in the module passed (linked with
+  // the log module)
+  llvm::GlobalVariable *createInlineLogBitmap(llvm::Module &module,
+                                              unsigned highestMutantID);
+
   // Compute Mutant Coverage of the module passed (pass a cloned module)
   void computeMutantCoverage(
       std::unique_ptr<llvm::Module> &cmodule,
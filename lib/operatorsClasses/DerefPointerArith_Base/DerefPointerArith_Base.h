@@ -59,10 +59,10 @@ protected:
     auto *tmp = toMatch.getIRAt(pos);
     if (tmp->hasOneUse()) {
 #if (LLVM_VERSION_MAJOR <= 3) && (LLVM_VERSION_MINOR < 5)
-      ret_pos = toMatch.depPosofPos(tmp->use_back(), pos, false);
+      ret_pos = toMatch.posOfIR(tmp->use_back());
       return tmp->use_back();
 #else
-      ret_pos = toMatch.depPosofPos(tmp->user_back(), pos, false);
+      ret_pos = toMatch.posOfIR(tmp->user_back());
       return tmp->user_back();
 #endif
     }
@@ -126,10 +126,10 @@ public:
                   continue;
 #if (LLVM_VERSION_MAJOR <= 3) && (LLVM_VERSION_MINOR < 5)
                 hloprd_reset_data.push_back(std::tuple<unsigned, unsigned>(
-                    hloprd_id, toMatch.depPosofPos(load, pos, true)));
+                    hloprd_id, toMatch.posOfIR(load)));
 #else
                 hloprd_reset_data.emplace_back(
-                    hloprd_id, toMatch.depPosofPos(load, pos, true));
+                    hloprd_id, toMatch.posOfIR(load));
 #endif
               }
             }
@@ -334,6 +334,8 @@ public:
           } else {
             for (MatchUseful const *ptr_mu = mu.first(); ptr_mu != mu.end();
                  ptr_mu = ptr_mu->next()) {
+              if (!resultMuts.sampleIn(repl, std::vector<unsigned>(1, pos)))
+                continue;
               prepareCloneIRs(toMatch, pos, *ptr_mu, repl, dru, MI);
               try {
                 dru.getOrigRelevantIRPos();
@@ -631,9 +633,11 @@ protected:
       std::vector<unsigned> relpos;
       for (auto i = 0; i < toMatch.getTotNumIRs(); i++)
         relpos.push_back(i);
-      MutantsOfStmt::MutantStmtIR toMatchMutant;
-      toMatchMutant.setToEmptyOrFixedStmtOf(toMatch, MI);
-      resultMuts.add(/*toMatch,  */ toMatchMutant, repl, relpos);
+      if (resultMuts.sampleIn(repl, relpos)) {
+        MutantsOfStmt::MutantStmtIR toMatchMutant;
+        toMatchMutant.setToEmptyOrFixedStmtOf(toMatch, MI);
+        resultMuts.add(/*toMatch,  */ toMatchMutant, repl, relpos);
+      }
       // iswholestmtmutated.setDeleted();
     } else {
       enum ExpElemKeys termDelCode = getTerminatorDeleterCode();
@@ -684,6 +688,10 @@ protected:
     std::vector<unsigned> relpos;
     for (auto i = 0; i < toMatch.getTotNumIRs(); i++)
       relpos.push_back(i);
+    if (!resultMuts.sampleIn(repl, relpos)) {
+      iswholestmtmutated.setTrapped();
+      return;
+    }
     MutantsOfStmt::MutantStmtIR toMatchMutant;
     llvm::SmallVector<llvm::Instruction *, 1> trapinst;
     llvm::Value *TrapFn =
@@ -172,7 +172,7 @@ public:
           if (checkWholeStmtAndMutate(toMatch, repl, resultMuts,
                                       iswholestmtmutated, MI)) {
             ; // Do nothing, already mutated
-          } else {
+          } else if (resultMuts.sampleIn(repl, std::vector<unsigned>({pos}))) {
             toMatchMutant.setToCloneStmtIROf(toMatch, MI);
             if (repl.getExpElemKey() == mAND || repl.getExpElemKey() == mOR ||
                 repl.getExpElemKey() == mKEEP_ONE_OPRD ||
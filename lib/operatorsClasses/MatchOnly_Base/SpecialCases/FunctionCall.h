@@ -155,6 +155,8 @@ public:
                                                // it the function to match?
             {
               for (auto i = 1; i < repl.getOprdIndexList().size(); i++) {
+                if (!resultMuts.sampleIn(repl, std::vector<unsigned>({pos})))
+                  continue;
                 toMatchMutant.clear();
                 toMatchMutant.setToCloneStmtIROf(toMatch, MI);
                 llvm::Function *repFun = MI.getModule()->getFunction(
@@ -195,6 +197,8 @@ public:
             unsigned argsNum = call->getNumArgOperands();
             std::vector<llvm::Value *> initialargsSequence;
             for (auto &argspos : combinations) {
+              if (!resultMuts.sampleIn(repl, std::vector<unsigned>({pos})))
+                continue;
               toMatchMutant.clear();
               toMatchMutant.setToCloneStmtIROf(toMatch, MI);
               llvm::CallInst *clonecall =
@@ -115,6 +115,9 @@ public:
         if (followBB != targetBB) {
           for (auto &repl : mutationOp.getMutantReplacorsList()) {
             if (isDeletion(repl.getExpElemKey())) {
+              iswholestmtmutated.setDeleted();
+              if (!resultMuts.sampleIn(repl, std::vector<unsigned>({0})))
+                continue;
               toMatchMutant.clear();
               toMatchMutant.setToCloneStmtIROf(toMatch, MI);
               llvm::dyn_cast<llvm::BranchInst>(
@@ -125,7 +128,6 @@ public:
                   /*toMatch, */ toMatchMutant, repl,
                   std::vector<unsigned>(
                       {0}) /*toMatch size here is 1 (see assert above)*/);
-              iswholestmtmutated.setDeleted();
             } else if (checkWholeStmtAndMutate(toMatch, repl, resultMuts,
                                                iswholestmtmutated, MI)) {
               ; // Do nothing, already mutated
@@ -157,6 +159,10 @@ public:
                     llvm::dyn_cast<llvm::ConstantInt>(ret->getReturnValue()))
               if (rve->equalsInt(0))
                 continue;
+            std::vector<unsigned> relpos({toMatch.getTotNumIRs() - 1});
+            iswholestmtmutated.setDeleted();
+            if (!resultMuts.sampleIn(repl, relpos))
+              continue;
             toMatchMutant.clear(); // w do not clone here, just create new ret
             // llvm::ReturnInst *newret =
             // builder.CreateRet(llvm::ConstantInt::get(retType, 0));
@@ -165,7 +171,6 @@ public:
             llvm::dyn_cast<llvm::ReturnInst>(
                 toMatchMutant.getIRAt(toMatch.getTotNumIRs() - 1) /*last inst*/)
                 ->setOperand(0, llvm::ConstantInt::get(retType, 0));
-            std::vector<unsigned> relpos({toMatch.getTotNumIRs() - 1});
             /*std::vector<unsigned> relpos;
                         for (auto i=0; i<toMatch.getTotNumIRs();i++)
                             relpos.push_back(i);*/ // Uncomment this if the deletion
@@ -175,7 +180,6 @@ public:
                                             // tmp; -- but instead: return
                                             // computation();)
             resultMuts.add(/*toMatch, */ toMatchMutant, repl, relpos);
-            iswholestmtmutated.setDeleted();
           } else if (checkWholeStmtAndMutate(toMatch, repl, resultMuts,
                                              iswholestmtmutated, MI)) {
             ; // Do nothing, already mutated
@@ -191,6 +195,11 @@ public:
                                                   // - uninitialized)
         for (auto &repl : mutationOp.getMutantReplacorsList()) {
           if (isDeletion(repl.getExpElemKey())) {
+            unsigned initialRetPos = toMatch.getTotNumIRs() - 1;
+            std::vector<unsigned> relpos({initialRetPos});
+            iswholestmtmutated.setDeleted();
+            if (!resultMuts.sampleIn(repl, relpos))
+              continue;
             toMatchMutant.clear();
             toMatchMutant.setToCloneStmtIROf(toMatch, MI);
             llvm::AllocaInst *alloca = builder.CreateAlloca(retType);
@@ -199,13 +208,11 @@ public:
             llvm::LoadInst *load = builder.CreateAlignedLoad(
                 alloca, MI.getDataLayout().getPrefTypeAlignment(retType));
             // llvm::ReturnInst *newret = builder.CreateRet(load);
-            unsigned initialRetPos = toMatch.getTotNumIRs() - 1;
             llvm::dyn_cast<llvm::ReturnInst>(
                 toMatchMutant.getIRAt(initialRetPos) /*last inst*/)
                 ->setOperand(0, load);
             toMatchMutant.insertIRAt(initialRetPos, load);
             toMatchMutant.insertIRAt(initialRetPos, alloca);
-            std::vector<unsigned> relpos({initialRetPos});
             /*std::vector<unsigned> relpos;
                         for (auto i=0; i<toMatch.size();i++)
                             relpos.push_back(i);*/ // Uncomment this if the deletion
@@ -215,7 +222,6 @@ public:
                                             // tmp; -- but instead: return
                                             // computation();)
             resultMuts.add(/*toMatch, */ toMatchMutant, repl, relpos);
-            iswholestmtmutated.setDeleted();
           } else if (checkWholeStmtAndMutate(toMatch, repl, resultMuts,
                                              iswholestmtmutated, MI)) {
             ; // Do nothing, already mutated
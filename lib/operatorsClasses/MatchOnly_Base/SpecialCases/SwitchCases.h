@@ -167,6 +167,8 @@ public:
                 continue;
 
               llvm::ConstantInt *caseval = casei.getCaseValue();
+              if (!resultMuts.sampleIn(repl, std::vector<unsigned>({pos})))
+                continue;
               toMatchMutant.clear();
               toMatchMutant.setToCloneStmtIROf(toMatch, MI);
               llvm::SwitchInst *clonesw =
@@ -195,6 +197,8 @@ public:
             unsigned succNum = sw->getNumSuccessors();
             std::vector<llvm::BasicBlock *> initialcaseSequence;
             for (auto &bbspos : combinations) {
+              if (!resultMuts.sampleIn(repl, std::vector<unsigned>({pos})))
+                continue;
               toMatchMutant.clear();
               toMatchMutant.setToCloneStmtIROf(toMatch, MI);
               llvm::SwitchInst *clonesw =
@@ -59,13 +59,11 @@ public:
       if (llvm::isa<llvm::Constant>(cmp->getOperand(0))) // first oprd
         ptr_mu->appendHLOprdsSource(pos, 0);
       else
-        ptr_mu->appendHLOprdsSource(
-            toMatch.depPosofPos(cmp->getOperand(0), pos, true));
+        ptr_mu->appendHLOprdsSource(toMatch.posOfIR(cmp->getOperand(0)));
       if (llvm::isa<llvm::Constant>(cmp->getOperand(1))) // second oprd
         ptr_mu->appendHLOprdsSource(pos, 1);
       else
-        ptr_mu->appendHLOprdsSource(
-            toMatch.depPosofPos(cmp->getOperand(1), pos, true));
+        ptr_mu->appendHLOprdsSource(toMatch.posOfIR(cmp->getOperand(1)));
       ptr_mu->appendRelevantIRPos(pos);
       ptr_mu->setHLReturningIRPos(pos);
     }
@@ -148,6 +146,8 @@ public:
           } else {
             for (MatchUseful const *ptr_mu = mu.first(); ptr_mu != mu.end();
                  ptr_mu = ptr_mu->next()) {
+              if (!resultMuts.sampleIn(repl, std::vector<unsigned>(1, pos)))
+                continue;
               prepareCloneIRs(toMatch, pos, *ptr_mu, repl, dru, MI);
               try {
                 dru.getOrigRelevantIRPos();
@@ -46,13 +46,11 @@ public:
       if (llvm::isa<llvm::Constant>(binop->getOperand(0))) // first oprd
         ptr_mu->appendHLOprdsSource(pos, 0);
       else
-        ptr_mu->appendHLOprdsSource(
-            toMatch.depPosofPos(binop->getOperand(0), pos, true));
+        ptr_mu->appendHLOprdsSource(toMatch.posOfIR(binop->getOperand(0)));
       if (llvm::isa<llvm::Constant>(binop->getOperand(1))) // second oprd
         ptr_mu->appendHLOprdsSource(pos, 1);
       else
-        ptr_mu->appendHLOprdsSource(
-            toMatch.depPosofPos(binop->getOperand(1), pos, true));
+        ptr_mu->appendHLOprdsSource(toMatch.posOfIR(binop->getOperand(1)));
       ptr_mu->appendRelevantIRPos(pos);
       ptr_mu->setHLReturningIRPos(pos);
     }
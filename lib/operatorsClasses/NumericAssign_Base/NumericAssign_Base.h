@@ -44,8 +44,7 @@ public:
         // 1)
         ptr_mu->appendHLOprdsSource(pos, 1);
         // else
-        //    ptr_mu->appendHLOprdsSource(toMatch.depPosofPos(store->getOperand(1),
-        //    pos, true));
+        //    ptr_mu->appendHLOprdsSource(toMatch.posOfIR(store->getOperand(1)));
 
         if (llvm::isa<llvm::Constant>(
                 store->getOperand(0))) // val oprd (oprd 2)
@@ -59,8 +58,7 @@ public:
             ptr_mu->appendHLOprdsSource(pos, 0);
             ptr_mu->setHLReturningIRPos(pos);
           } else {
-            unsigned valncp =
-                toMatch.depPosofPos(store->getOperand(0), pos, true);
+            unsigned valncp = toMatch.posOfIR(store->getOperand(0));
             ptr_mu->appendHLOprdsSource(valncp);
             ptr_mu->setHLReturningIRPos(pos); // valncp);  //TODO: find a way to
                                               // handle a=b=c becomes a=b+.
@@ -45,8 +45,7 @@ public:
         return false;
 
       MatchUseful *ptr_mu = MU.getNew();
-      ptr_mu->appendHLOprdsSource(
-          toMatch.depPosofPos(neg->getOperand(oprdId), pos, true));
+      ptr_mu->appendHLOprdsSource(toMatch.posOfIR(neg->getOperand(oprdId)));
       ptr_mu->appendRelevantIRPos(pos);
       ptr_mu->setHLReturningIRPos(pos);
     }
@@ -71,8 +71,8 @@ public:
           return false;
 
         int returningIRPos;
-        int loadpos = toMatch.depPosofPos(load, pos, true);
-        int modifpos = toMatch.depPosofPos(modif, pos, true);
+        int loadpos = toMatch.posOfIR(load);
+        int modifpos = toMatch.posOfIR(modif);
         assert((pos > loadpos && pos > modifpos) && "problem in IR order");
 
         // check wheter it is left or right inc-dec
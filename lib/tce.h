@@ -7,16 +7,24 @@
  * License. See LICENSE.TXT for details.
  *
  * \brief     Define the class TCE which is used to call optimizer and code diff
+ * and the class PreTCEFilter, which removes the trivially equivalent and
+ * duplicate mutants of a statement before they are inserted in the module
  */
 
 #ifndef __MART_GENMU_tce__
 #define __MART_GENMU_tce__
 
+#include <algorithm>
+#include <cstdint>
+#include <map>
+#include <string>
 #include <unordered_map>
 #include <vector>
 
 #include "llvm/ADT/SmallVector.h"
+#include "llvm/IR/Constants.h"
 #include "llvm/IR/Function.h"
+#include "llvm/IR/Instructions.h"
 #include "llvm/Pass.h"
 #include "llvm/Support/raw_ostream.h"
 #if (LLVM_VERSION_MAJOR <= 3) && (LLVM_VERSION_MINOR < 5)
@@ -30,6 +38,8 @@
 
 #include "llvm-diff/DifferenceEngine.h"
 
+#include "typesops.h"
+
 namespace mart {
 
 class TCE {
@@ -134,6 +144,360 @@ public:
   }
 }; // class TCE
 
+/**
+ * \brief Algebraic pre-filter of the mutants of a statement, applied before the
+ * mutants are inserted in the module (so before the TCE): the original and
+ * each mutant are encoded into a canonical form, where the trivial algebraic
+ * identities are simplified (x+0, x*1, x&x, x-x, ...), the commutative
+ * operands and the compare operands are ordered. A mutant with the encoding of
+ * the original is equivalent, a mutant with the encoding of a previous mutant
+ * is duplicate of it: they are removed and recorded in the statement's
+ * 'preFiltered'.
+ * The filter is conservative: only the single basic block statements whose
+ * values are not used outside the statement are filtered, and a statement or
+ * mutant with an instruction it does not know is not filtered.
+ */
+class PreTCEFilter {
+  // Interned nodes encodings (shared by the original and the mutants of a
+  // statement, an encoding is compared by its id)
+  std::map<std::string, unsigned> nodeIDs;
+
+  // Encoding of the instructions of the statement or mutant being encoded
+  std::unordered_map<llvm::Value const *, std::string> instEncoding;
+
+  // Basic block of the statement or mutant being encoded
+  llvm::BasicBlock const *selfBB;
+
+  // Number of instructions reading memory or with side effects encoded in
+  // the statement or mutant being encoded (each one has its own encoding)
+  unsigned impureIndex;
+
+  std::string intern(std::string const &node) {
+    auto it = nodeIDs.emplace(node, nodeIDs.size()).first;
+    return "#" + std::to_string(it->second);
+  }
+
+  static std::string pointerStr(void const *ptr) {
+    return "@" + std::to_string((uintptr_t)ptr);
+  }
+
+  /// \brief encoding of the operand 'val', false if it is an instruction of
+  /// the statement not yet encoded (forward reference)
+  bool encodeOperand(llvm::Value const *val, std::string &enc) {
+    auto it = instEncoding.find(val);
+    if (it != instEncoding.end()) {
+      enc = it->second;
+    } else if (val == selfBB) {
+      enc = "self";
+    } else if (auto *inst = llvm::dyn_cast<llvm::Instruction>(val)) {
+      if (inst->getParent() == selfBB || inst->getParent() == nullptr)
+        return false;
+      enc = pointerStr(val);
+    } else {
+      // Arguments, globals, constants (uniqued), other basic blocks
+      enc = pointerStr(val);
+    }
+    return true;
+  }
+
+  static bool isZeroInt(llvm::Value const *val) {
+    auto *ci = llvm::dyn_cast<llvm::ConstantInt>(val);
+    return ci && ci->isZero();
+  }
+  static bool isOneInt(llvm::Value const *val) {
+    auto *ci = llvm::dyn_cast<llvm::ConstantInt>(val);
+    return ci && ci->isOne();
+  }
+  static bool isAllOnesInt(llvm::Value const *val) {
+    auto *ci = llvm::dyn_cast<llvm::ConstantInt>(val);
+    return ci && ci->isAllOnesValue();
+  }
+
+  /// \brief whether 'val' is an instruction that may read memory or have
+  /// side effects: two of them computing the same may have different values
+  static bool isImpure(llvm::Value const *val) {
+    auto *inst = llvm::dyn_cast<llvm::Instruction>(val);
+    return inst && (inst->mayReadFromMemory() || inst->mayHaveSideEffects());
+  }
+
+  /// \brief simplify the integer binary operation with the trivial
+  /// identities. @return true if 'enc' is set to the simplified encoding
+  bool simplifyBinary(llvm::BinaryOperator const *bop,
+                      std::vector<std::string> const &ops, std::string &enc) {
+    if (!bop->getType()->isIntegerTy())
+      return false;
+    llvm::Value const *rhs = bop->getOperand(1);
+    // (only the pure operands, e.g. not 'f() - f()')
+    bool sameOps = (ops[0] == ops[1]) && !isImpure(bop->getOperand(0)) &&
+                   !isImpure(bop->getOperand(1));
+    switch (bop->getOpcode()) {
+    case llvm::Instruction::Add:
+    case llvm::Instruction::Or:
+    case llvm::Instruction::Xor:
+    case llvm::Instruction::Shl:
+    case llvm::Instruction::LShr:
+    case llvm::Instruction::AShr:
+    case llvm::Instruction::Sub:
+      if (isZeroInt(rhs)) {
+        enc = ops[0];
+        return true;
+      }
+      break;
+    case llvm::Instruction::Mul:
+    case llvm::Instruction::UDiv:
+    case llvm::Instruction::SDiv:
+      if (isOneInt(rhs)) {
+        enc = ops[0];
+        return true;
+      }
+      break;
+    case llvm::Instruction::And:
+      if (isAllOnesInt(rhs)) {
+        enc = ops[0];
+        return true;
+      }
+      break;
+    default:
+      break;
+    }
+    // The constant operand of the commutative operations may be the first
+    if (bop->isCommutative()) {
+      llvm::Value const *lhs = bop->getOperand(0);
+      switch (bop->getOpcode()) {
+      case llvm::Instruction::Add:
+      case llvm::Instruction::Or:
+      case llvm::Instruction::Xor:
+        if (isZeroInt(lhs)) {
+          enc = ops[1];
+          return true;
+        }
+        break;
+      case llvm::Instruction::Mul:
+        if (isOneInt(lhs)) {
+          enc = ops[1];
+          return true;
+        }
+        break;
+      case llvm::Instruction::And:
+        if (isAllOnesInt(lhs)) {
+          enc = ops[1];
+          return true;
+        }
+        break;
+      default:
+        break;
+      }
+    }
+    // Constant results
+    llvm::Type *ty = bop->getType();
+    switch (bop->getOpcode()) {
+    case llvm::Instruction::Mul:
+    case llvm::Instruction::And:
+      if (isZeroInt(rhs) || isZeroInt(bop->getOperand(0))) {
+        enc = pointerStr(llvm::Constant::getNullValue(ty));
+        return true;
+      }
+      if (bop->getOpcode() == llvm::Instruction::And && sameOps) {
+        enc = ops[0];
+        return true;
+      }
+      break;
+    case llvm::Instruction::Or:
+      if (isAllOnesInt(rhs) || isAllOnesInt(bop->getOperand(0))) {
+        enc = pointerStr(llvm::Constant::getAllOnesValue(ty));
+        return true;
+      }
+      if (sameOps) {
+        enc = ops[0];
+        return true;
+      }
+      break;
+    case llvm::Instruction::Sub:
+    case llvm::Instruction::Xor:
+      if (sameOps) {
+        enc = pointerStr(llvm::Constant::getNullValue(ty));
+        return true;
+      }
+      break;
+    default:
+      break;
+    }
+    return false;
+  }
+
+  /// \brief encode the instruction 'inst' (its operands are encoded).
+  /// @return false if the instruction is not supported
+  bool encodeInstruction(llvm::Instruction const *inst, std::string &enc) {
+    if (!(llvm::isa<llvm::BinaryOperator>(inst) ||
+          llvm::isa<llvm::CmpInst>(inst) || llvm::isa<llvm::CastInst>(inst) ||
+          llvm::isa<llvm::LoadInst>(inst) || llvm::isa<llvm::StoreInst>(inst) ||
+          llvm::isa<llvm::GetElementPtrInst>(inst) ||
+          llvm::isa<llvm::SelectInst>(inst) ||
+          llvm::isa<llvm::BranchInst>(inst) ||
+          llvm::isa<llvm::ReturnInst>(inst) ||
+          llvm::isa<llvm::SwitchInst>(inst) || llvm::isa<llvm::CallInst>(inst) ||
+          llvm::isa<llvm::PHINode>(inst) ||
+          llvm::isa<llvm::UnreachableInst>(inst)))
+      return false;
+
+    std::vector<std::string> ops(inst->getNumOperands());
+    for (unsigned i = 0; i < inst->getNumOperands(); ++i)
+      if (!encodeOperand(inst->getOperand(i), ops[i]))
+        return false;
+
+    std::string extra;
+    if (auto *bop = llvm::dyn_cast<llvm::BinaryOperator>(inst)) {
+      if (simplifyBinary(bop, ops, enc))
+        return true;
+      if (bop->isCommutative() && ops[1] < ops[0])
+        std::swap(ops[0], ops[1]);
+    } else if (auto *cmp = llvm::dyn_cast<llvm::CmpInst>(inst)) {
+      llvm::CmpInst::Predicate pred = cmp->getPredicate();
+      if (ops[1] < ops[0]) {
+        std::swap(ops[0], ops[1]);
+        pred = llvm::CmpInst::getSwappedPredicate(pred);
+      }
+      extra = std::to_string(pred);
+    } else if (auto *sel = llvm::dyn_cast<llvm::SelectInst>(inst)) {
+      if (ops[1] == ops[2] || isOneInt(sel->getCondition())) {
+        enc = ops[1];
+        return true;
+      }
+      if (isZeroInt(sel->getCondition())) {
+        enc = ops[2];
+        return true;
+      }
+    } else if (auto *load = llvm::dyn_cast<llvm::LoadInst>(inst)) {
+      if (load->isAtomic())
+        return false;
+      extra = std::to_string(load->isVolatile());
+    } else if (auto *store = llvm::dyn_cast<llvm::StoreInst>(inst)) {
+      if (store->isAtomic())
+        return false;
+      extra = std::to_string(store->isVolatile());
+    } else if (auto *call = llvm::dyn_cast<llvm::CallInst>(inst)) {
+      extra = std::to_string(call->getCallingConv()) + "," +
+              std::to_string(call->isTailCall());
+    } else if (auto *phi = llvm::dyn_cast<llvm::PHINode>(inst)) {
+      for (unsigned i = 0; i < phi->getNumIncomingValues(); ++i) {
+        std::string bbEnc;
+        if (!encodeOperand(phi->getIncomingBlock(i), bbEnc))
+          return false;
+        extra += bbEnc + ",";
+      }
+    }
+#if !((LLVM_VERSION_MAJOR <= 3) && (LLVM_VERSION_MINOR < 7))
+    else if (auto *gep = llvm::dyn_cast<llvm::GetElementPtrInst>(inst)) {
+      extra = pointerStr(gep->getSourceElementType());
+    }
+#endif
+    // The calls and loads are not structurally equal ('f()', 'rand()', a load
+    // after a store): identified by their position among those of the
+    // statement
+    if (isImpure(inst))
+      extra += ",impure" + std::to_string(impureIndex++);
+
+    std::string node(inst->getOpcodeName());
+    node += ":" + pointerStr(inst->getType()) + ":" +
+            std::to_string(inst->getRawSubclassOptionalData()) + ":" + extra +
+            "(";
+    for (auto &op : ops)
+      node += op + ",";
+    enc = intern(node + ")");
+    return true;
+  }
+
+  /// \brief encode the instructions 'insts' of the basic block 'bb', in
+  /// order: the encoding is the sequence of the encodings of the instructions
+  /// with side effects, that may read memory or trap, and the terminators
+  /// (the other instructions are part of the encodings of their users).
+  /// @return false if an instruction is not supported
+  template <typename InstRange>
+  bool encodeStmt(InstRange const &insts, llvm::BasicBlock const *bb,
+                  std::vector<std::string> &enc) {
+    instEncoding.clear();
+    selfBB = bb;
+    impureIndex = 0;
+    enc.clear();
+    for (auto *val : insts) {
+      auto *inst = llvm::dyn_cast<llvm::Instruction>(val);
+      if (!inst)
+        return false;
+      std::string instEnc;
+      if (!encodeInstruction(inst, instEnc))
+        return false;
+      instEncoding[inst] = instEnc;
+      if (inst->mayHaveSideEffects() || inst->mayReadFromMemory() ||
+          inst->isTerminator() ||
+          (llvm::isa<llvm::BinaryOperator>(inst) &&
+           (inst->getOpcode() == llvm::Instruction::UDiv ||
+            inst->getOpcode() == llvm::Instruction::SDiv ||
+            inst->getOpcode() == llvm::Instruction::URem ||
+            inst->getOpcode() == llvm::Instruction::SRem)))
+        enc.push_back(instEnc);
+    }
+    return true;
+  }
+
+public:
+  /**
+   * \brief remove the trivially equivalent and duplicate mutants of the
+   * statement 'stmtIR' from 'mutants' (before their IDs are set)
+   * @return the number of mutants removed
+   */
+  unsigned filter(MatchStmtIR const &stmtIR, MutantsOfStmt &mutants) {
+    if (stmtIR.getNumBB() != 1 || mutants.getNumMuts() == 0)
+      return 0;
+    llvm::BasicBlock *origBB = stmtIR.getBBAt(0);
+    for (auto *val : stmtIR.getIRList()) {
+#if (LLVM_VERSION_MAJOR <= 3) && (LLVM_VERSION_MINOR < 5)
+      for (llvm::Value::use_iterator ui = val->use_begin(),
+                                     ue = val->use_end();
+           ui != ue; ++ui) {
+        llvm::Value const *user = *ui;
+#else
+      for (auto *user : val->users()) {
+#endif
+        if (stmtIR.irPosIndex.count(user) == 0)
+          return 0;
+      }
+    }
+
+    nodeIDs.clear();
+    std::vector<std::string> origEnc;
+    if (!encodeStmt(stmtIR.getIRList(), origBB, origEnc))
+      return 0;
+
+    unsigned removed = 0;
+    std::map<std::vector<std::string>, int> keptMutants;
+    for (unsigned mind = 0; mind < mutants.results.size();) {
+      auto &origBBToMutBB = mutants.results[mind].mutantStmtIR.origBBToMutBB;
+      std::vector<std::string> mutEnc;
+      bool encoded = false;
+      if (origBBToMutBB.size() == 1 && origBBToMutBB.count(origBB) > 0 &&
+          origBBToMutBB.at(origBB).size() == 1) {
+        llvm::BasicBlock *mutBB = origBBToMutBB.at(origBB).front();
+        std::vector<llvm::Instruction *> mutInsts;
+        for (auto &inst : *mutBB)
+          mutInsts.push_back(&inst);
+        encoded = encodeStmt(mutInsts, mutBB, mutEnc);
+      }
+      if (encoded && mutEnc == origEnc) {
+        mutants.removePreFiltered(mind, -1);
+        ++removed;
+      } else if (encoded && keptMutants.count(mutEnc) > 0) {
+        mutants.removePreFiltered(mind, keptMutants.at(mutEnc));
+        ++removed;
+      } else {
+        if (encoded)
+          keptMutants[mutEnc] = mind;
+        ++mind;
+      }
+    }
+    return removed;
+  }
+}; // class PreTCEFilter
+
 } // namespace mart
 
 #endif //__MART_GENMU_tce__
@@ -12,8 +12,21 @@
 #ifndef __MART_GENMU_typesops__
 #define __MART_GENMU_typesops__
 
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <fcntl.h> //open
+#include <fstream>
+#include <map>
+#include <random>
+#include <regex>
 #include <set>
 #include <sstream>
+#include <sys/mman.h> //mmap
+#include <sys/stat.h> //fstat
+#include <unistd.h>   //close
 #include <unordered_map>
 #include <unordered_set>
 #include <vector>
@@ -24,6 +37,7 @@
 
 #include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
 
 #include "llvm/IR/LLVMContext.h" //context
 
@@ -99,6 +113,27 @@ public:
     printLoc(Loc, ross);
     return ross.str();
   }
+
+  /**
+   * \brief get the src file and line of the instruction. Return false if the
+   * instruction has no src location
+   */
+  static bool getSrcFileAndLine(llvm::Instruction const *inst,
+                                std::string &file, unsigned &line) {
+    const llvm::DebugLoc &Loc = inst->getDebugLoc();
+#if (LLVM_VERSION_MAJOR <= 3) && (LLVM_VERSION_MINOR < 5)
+    if (Loc.isUnknown())
+      return false;
+    llvm::DIScope Scope(Loc.getScope(llvm::getGlobalContext()));
+    file = Scope.getFilename();
+#else
+    if (!Loc)
+      return false;
+    file = llvm::cast<llvm::DIScope>(Loc.getScope())->getFilename().str();
+#endif
+    line = Loc.getLine();
+    return true;
+  }
 }; // class UtilsFunctions
 
 /**
@@ -330,10 +365,127 @@ private:
   std::unordered_set<llvm::Function *> funcsToMutate;
   bool initialized;
 
+  /// \brief Whether the scope is restricted to changed lines (patch scope)
+  bool patchScope;
+
+  /// \brief Changed lines (patch scope): for each source file, the disjoint
+  /// line ranges <first line, last line>, by first line
+  std::unordered_map<std::string, std::map<unsigned, unsigned>> changedLines;
+
+  void addChangedLines(std::string const &srcFile, unsigned first,
+                       unsigned last) {
+    assert(first <= last && first > 0 && "Invalid changed lines range");
+    std::string tmp;
+    if (matchOnlySrcFilePathBasename)
+      tmp.assign(getBasename(srcFile));
+    else
+      tmp.assign(srcFile);
+    auto &ranges = changedLines[tmp];
+    auto it = ranges.find(first);
+    if (it == ranges.end() || it->second < last)
+      ranges[first] = last;
+  }
+
+  /// \brief merge the overlapping or adjacent changed line ranges
+  void mergeChangedLines() {
+    for (auto &fileRanges : changedLines) {
+      auto &ranges = fileRanges.second;
+      for (auto it = ranges.begin(); it != ranges.end();) {
+        auto next = std::next(it);
+        if (next != ranges.end() && next->first <= it->second + 1) {
+          it->second = std::max(it->second, next->second);
+          ranges.erase(next);
+        } else {
+          it = next;
+        }
+      }
+    }
+  }
+
+  /**
+   * \brief Read the changed lines from the unified diff 'patchFilename': the
+   * lines added or modified in the new version of the files. A deletion
+   * changes the new version's line at its position.
+   */
+  void loadChangedLinesFromPatch(std::string const &patchFilename) {
+    std::ifstream patch(patchFilename);
+    if (!patch) {
+      llvm::errs() << "Failed to open the mutation scope patch file "
+                   << patchFilename << "\n";
+      assert(false && "Failed to open the mutation scope patch");
+    }
+    std::regex hunkHeader("^@@ -([0-9]+)(,([0-9]+))? \\+([0-9]+)(,([0-9]+))? "
+                          "@@.*");
+    std::smatch match;
+    std::string line;
+    std::string srcFile;
+    unsigned oldRemain = 0, newRemain = 0, newLine = 0;
+    while (std::getline(patch, line)) {
+      if (oldRemain > 0 || newRemain > 0) {
+        // Within a hunk
+        if (line.empty() || line[0] == ' ') {
+          --oldRemain;
+          --newRemain;
+          ++newLine;
+        } else if (line[0] == '+') {
+          if (!srcFile.empty())
+            addChangedLines(srcFile, newLine, newLine);
+          --newRemain;
+          ++newLine;
+        } else if (line[0] == '-') {
+          if (!srcFile.empty() && newLine > 0)
+            addChangedLines(srcFile, newLine, newLine);
+          --oldRemain;
+        } // else, '\' No newline at end of file
+        continue;
+      }
+      if (line.compare(0, 4, "+++ ") == 0) {
+        srcFile = line.substr(4, line.find('\t') - 4);
+        if (srcFile == "/dev/null")
+          srcFile.clear();
+        else if (srcFile.compare(0, 2, "b/") == 0)
+          srcFile.erase(0, 2);
+      } else if (std::regex_match(line, match, hunkHeader)) {
+        oldRemain = match[3].matched ? std::stoul(match[3].str()) : 1;
+        newLine = std::stoul(match[4].str());
+        newRemain = match[6].matched ? std::stoul(match[6].str()) : 1;
+        if (newRemain == 0) // Only deletions, after the line 'newLine'
+          ++newLine;
+      }
+    }
+  }
+
+  /**
+   * \brief Read the changed lines from the JSON object 'changed': for each
+   * source file, a list of line numbers or of ranges [first, last]
+   */
+  void loadChangedLinesFromJson(JsonBox::Value &changed) {
+    assert(changed.isObject() && "The Changed-Lines of the mutation scope must "
+                                 "be a JSON object (source file to lines)");
+    for (auto &fileLines : changed.getObject()) {
+      assert(fileLines.second.isArray() &&
+             "The changed lines of a source file must be a JSON array");
+      for (auto &val : fileLines.second.getArray()) {
+        if (val.isInteger()) {
+          addChangedLines(fileLines.first, val.getInteger(),
+                          val.getInteger());
+        } else {
+          assert(val.isArray() && val.getArray().size() == 2 &&
+                 val.getArray()[0].isInteger() &&
+                 val.getArray()[1].isInteger() &&
+                 "A changed lines element must be a line number or an array "
+                 "[first line, last line]");
+          addChangedLines(fileLines.first, val.getArray()[0].getInteger(),
+                          val.getArray()[1].getInteger());
+        }
+      }
+    }
+  }
+
 public:
-  MutationScope() : initialized(false) {}
+  MutationScope() : initialized(false), patchScope(false) {}
 
-  std::string getBasename(std::string const &subjStr) {
+  static std::string getBasename(std::string const &subjStr) {
     auto sep = subjStr.rfind('/');
     if (sep == std::string::npos)
       sep = subjStr.rfind('\\');
@@ -346,6 +498,8 @@ public:
 
   void Initialize(llvm::Module &module, std::string inJsonFilename = "") {
     initialized = true;
+    patchScope = false;
+    changedLines.clear();
 
     // No scope data was given, use everything
     if (inJsonFilename.empty()) {
@@ -354,13 +508,36 @@ public:
       return;
     }
 
+    JsonBox::Value inScope;
+    inScope.loadFromFile(inJsonFilename);
+    InitializeFromJson(module, inScope);
+  }
+
+  /// \brief initialize with the scope data given as JSON text 'inJsonText'
+  /// (the content of the scope JSON file) instead of a file name
+  void InitializeFromJsonText(llvm::Module &module,
+                              std::string const &inJsonText) {
+    if (inJsonText.empty()) {
+      Initialize(module);
+      return;
+    }
+    JsonBox::Value inScope;
+    inScope.loadFromString(inJsonText);
+    InitializeFromJson(module, inScope);
+  }
+
+  /// \brief initialize with the parsed scope data 'inScope'. A "Patch" is
+  /// still a diff file to read, "Changed-Lines" gives the same in memory
+  void InitializeFromJson(llvm::Module &module, JsonBox::Value &inScope) {
+    initialized = true;
+    patchScope = false;
+    changedLines.clear();
+
     std::unordered_set<std::string> specSrcFiles;
     std::unordered_set<std::string> specFuncs;
 
     std::unordered_set<std::string> seenSrcs;
 
-    JsonBox::Value inScope;
-    inScope.loadFromFile(inJsonFilename);
     if (!inScope.isNull()) {
       assert(inScope.isObject() &&
              "The JSON file data of mutation scope must be a JSON object");
@@ -414,6 +591,22 @@ public:
         }
       }
 
+      // Patch scope: only the statements on changed lines are mutated
+      if (!inScope["Patch"].isNull()) {
+        assert(inScope["Patch"].isString() &&
+               "The Patch of the mutation scope, if present, must be the "
+               "path to a unified diff file");
+        loadChangedLinesFromPatch(inScope["Patch"].getString());
+        if (changedLines.empty())
+          llvm::errs() << "Warning: the mutation scope patch changes no "
+                          "line, nothing will be mutated.\n";
+      }
+      if (!inScope["Changed-Lines"].isNull())
+        loadChangedLinesFromJson(inScope["Changed-Lines"]);
+      mergeChangedLines();
+      patchScope =
+          !inScope["Patch"].isNull() || !inScope["Changed-Lines"].isNull();
+
       /*if (! inScope[""].isNull())
       {
 
@@ -500,8 +693,99 @@ public:
         assert(seenSrcs.size() == specSrcFiles.size() &&
                "Some specified sources file are not found in the module.");
       }
+
+      // With a patch, keep only the functions with changed lines
+      if (patchScope) {
+        std::vector<llvm::Function *> candidates;
+        if (funcsToMutate.empty()) {
+          for (auto &Func : module)
+            if (!Func.isDeclaration())
+              candidates.push_back(&Func);
+        } else {
+          candidates.assign(funcsToMutate.begin(), funcsToMutate.end());
+        }
+        funcsToMutate.clear();
+        for (auto *Func : candidates) {
+          bool changed = false;
+          for (auto BBIt = Func->begin(), BBE = Func->end();
+               BBIt != BBE && !changed; ++BBIt)
+            for (auto &Inst : *BBIt)
+              if ((changed = instructionInChangedLines(&Inst)))
+                break;
+          if (changed)
+            funcsToMutate.insert(Func);
+        }
+        if (funcsToMutate.empty())
+          llvm::errs() << "Warning: no function of the mutation scope has "
+                          "changed lines, nothing will be mutated.\n";
+      }
+    }
+    mutateAllFuncs = funcsToMutate.empty() && !patchScope;
+  }
+
+  /**
+   * \brief Get, into 'funcNames', the names of the functions listed in the
+   * scope JSON file (its "Functions"). 'funcNames' is left empty when the
+   * scope does not restrict the functions to mutate (then, all the functions
+   * of the selected source files are mutated).
+   */
+  static void getScopeFunctionNames(std::string const &inJsonFilename,
+                                    std::set<std::string> &funcNames) {
+    funcNames.clear();
+    if (inJsonFilename.empty())
+      return;
+    JsonBox::Value inScope;
+    inScope.loadFromFile(inJsonFilename);
+    if (inScope.isNull() || inScope["Functions"].isNull())
+      return;
+    assert(inScope["Functions"].isArray() && "The list of Functions to "
+                                             "mutate, if present, must be "
+                                             "a JSON array of string");
+    for (auto &val : inScope["Functions"].getArray()) {
+      assert(val.isString() && "An element of the JSON array Functions "
+                               "is not a string. Functions name must be "
+                               "string.");
+      funcNames.insert(val.getString());
     }
-    mutateAllFuncs = funcsToMutate.empty();
+  }
+
+  /**
+   * \brief Restrict the scope to the shard 'shardIndex' of 'numShards' (Mart
+   * option 'shard'). The functions in scope are partitioned deterministically
+   * (the same module and scope give the same partition): by decreasing number
+   * of instructions, module order for ties, each function goes to the shard
+   * with the fewest instructions so far (the lowest index for ties).
+   */
+  void restrictToShard(llvm::Module &module, unsigned shardIndex,
+                       unsigned numShards) {
+    assert(isInitialized() && "restricting uninitialized scope object");
+    assert(shardIndex < numShards && "Invalid mutation shard");
+    std::vector<std::pair<unsigned, llvm::Function *>> candidates;
+    for (auto &Func : module) {
+      if (Func.isDeclaration() || !functionInMutationScope(&Func))
+        continue;
+      unsigned size = 0;
+      for (auto &BB : Func)
+        size += BB.size();
+      candidates.emplace_back(size, &Func);
+    }
+    std::stable_sort(candidates.begin(), candidates.end(),
+                     [](std::pair<unsigned, llvm::Function *> const &a,
+                        std::pair<unsigned, llvm::Function *> const &b) {
+                       return a.first > b.first;
+                     });
+    std::vector<uint64_t> shardSizes(numShards, 0);
+    funcsToMutate.clear();
+    for (auto &cand : candidates) {
+      unsigned target = 0;
+      for (unsigned s = 1; s < numShards; ++s)
+        if (shardSizes[s] < shardSizes[target])
+          target = s;
+      shardSizes[target] += cand.first;
+      if (target == shardIndex)
+        funcsToMutate.insert(cand.second);
+    }
+    mutateAllFuncs = false;
   }
 
   /**
@@ -517,6 +801,43 @@ public:
       return (funcsToMutate.count(F) > 0);
   }
 
+  /**
+   * \brief return true if the instruction's src location is on a changed line
+   * of the patch scope. false otherwise (or if it has no src location)
+   */
+  bool instructionInChangedLines(llvm::Instruction const *I) const {
+    std::string srcFile;
+    unsigned line;
+    if (!UtilsFunctions::getSrcFileAndLine(I, srcFile, line))
+      return false;
+    auto fit = changedLines.find(matchOnlySrcFilePathBasename
+                                     ? getBasename(srcFile)
+                                     : srcFile);
+    if (fit == changedLines.end())
+      return false;
+    auto it = fit->second.upper_bound(line);
+    if (it == fit->second.begin())
+      return false;
+    --it;
+    return line <= it->second;
+  }
+
+  /**
+   * \brief This method return true if the statement made of the IRs
+   * 'stmtIRs' is in the scope (its function must be in the scope): with a
+   * patch scope, at least one of its IRs must be on a changed line.
+   */
+  inline bool stmtInMutationScope(
+      std::vector<llvm::Value *> const &stmtIRs) const {
+    if (!patchScope)
+      return true;
+    for (auto *val : stmtIRs)
+      if (auto *I = llvm::dyn_cast<llvm::Instruction>(val))
+        if (instructionInChangedLines(I))
+          return true;
+    return false;
+  }
+
   /**
    * \brief Check wheter initialized
    */
@@ -535,12 +856,22 @@ struct MatchStmtIR {
   // Alway go together with toMatchIRs (same modifications - push, pop,...)
   std::vector<unsigned> posIRsInOrigFunc;
 
+  // Position of each IR in toMatchIRs. Alway go together with toMatchIRs
+  // (modified only through appendIR() and clear())
+  llvm::DenseMap<llvm::Value const *, unsigned> irPosIndex;
+
   friend void setToCloneStmtIROf(MatchStmtIR const &toMatch);
 
   void clear() {
     toMatchIRs.clear();
     bbStartPosToOrigBB.clear();
     posIRsInOrigFunc.clear();
+    irPosIndex.clear();
+  }
+  void appendIR(llvm::Value *ir, unsigned posInFunc) {
+    irPosIndex[ir] = toMatchIRs.size();
+    toMatchIRs.push_back(ir);
+    posIRsInOrigFunc.push_back(posInFunc);
   }
   void dumpIRs() const {
     llvm::errs() << "\n";
@@ -595,52 +926,22 @@ struct MatchStmtIR {
   }
 
   /**
-   * \brief Finds the position of an IR instruction in a list of IRs through
-   * sequential search from a starting position
+   * \brief Finds the position of an IR instruction in the statement, using
+   * the value to position index (an IR appears only once in a statement)
    * @param irinst value searched
-   * @param pos is the starting point of the search
-   * @param firstCheckBefore is the flag to decide whether we first search
-   * before (true) @param pos or after (false)
    * @return the position of the searched IR instruction
    */
-  int depPosofPos(llvm::Value const *irinst, int pos,
-                  bool firstCheckBefore = true) const {
-    int findpos;
-    if (firstCheckBefore) {
-      findpos = pos - 1;
-      for (; findpos >= 0; findpos--)
-        if (toMatchIRs[findpos] == irinst)
-          break;
-      if (findpos < 0) {
-        for (findpos = pos + 1; findpos < toMatchIRs.size(); findpos++)
-          if (toMatchIRs[findpos] == irinst)
-            break;
-        if (!(toMatchIRs.size() > findpos)) {
-          for (auto *tmpins : toMatchIRs)
-            llvm::dyn_cast<llvm::Instruction>(tmpins)->dump();
-          llvm::errs() << "Pos = " << pos << "\n";
-          /*toMatchIRs.size() > findpos*/
-          assert(false && "Impossible error (before)");
-        }
-      }
-    } else {
-      findpos = pos + 1;
-      for (; findpos < toMatchIRs.size(); findpos++)
-        if (toMatchIRs[findpos] == irinst)
-          break;
-      if (findpos >= toMatchIRs.size()) {
-        for (findpos = pos - 1; findpos >= 0; findpos--)
-          if (toMatchIRs[findpos] == irinst)
-            break;
-        if (!(findpos >= 0)) {
-          for (auto *tmpins : toMatchIRs)
-            llvm::dyn_cast<llvm::Instruction>(tmpins)->dump();
-          llvm::errs() << "Pos = " << pos << "\n";
-          assert(false /*findpos>=0*/ && "Impossible error (after)");
-        }
-      }
+  inline int posOfIR(llvm::Value const *irinst) const {
+    auto it = irPosIndex.find(irinst);
+    if (it == irPosIndex.end()) {
+      for (auto *tmpins : toMatchIRs)
+        llvm::dyn_cast<llvm::Instruction>(tmpins)->dump();
+      llvm::errs() << "\nSearched IR: ";
+      irinst->dump();
+      assert(false && "Impossible error: IR not in statement");
+      return -1;
     }
-    return findpos;
+    return it->second;
   }
 }; //~ struct MatchStmtIR
 
@@ -659,6 +960,116 @@ public:
   inline void setTrapped() { trapped = true; }
 }; // struct WholeStmtMutationOnc
 
+/**
+ * \brief Sampling of the mutants at their generation (see
+ * Mutation::setMutantsSampling), decided for each mutant before its IR is
+ * built. Each stratum (the whole module, each statement or each mutant type)
+ * keeps 'rate' of its mutants by systematic sampling with a random start: its
+ * i-th mutant (from 0) is kept when floor(start + (i+1)*rate) is greater than
+ * floor(start + i*rate), which keeps the floor or the ceiling of 'rate' times
+ * its size, without knowing its size in advance. The starts only use the raw
+ * output of the PRNG (the standard distributions are implementation defined),
+ * so that the same module, scope, configuration and seed give the same mutants
+ * on every platform.
+ * With a maximum number of mutants, the mutants are first only counted (none
+ * is kept), then the sampling restarts and keeps at most that many of the
+ * mutants that the rate keeps (see keepAtMost).
+ */
+class MutantsSampler {
+public:
+  enum Strata { ByMutant, ByStatement, ByOperator };
+
+private:
+  struct Stratum {
+    double start;
+    unsigned seen;
+  };
+
+  double rate;
+  Strata by;
+  unsigned prngSeed;
+  std::mt19937 prng;
+  // strata by mutant type (a single one, "", by mutant)
+  std::map<std::string, Stratum> strata;
+  // stratum of the current statement (by statement)
+  Stratum stmtStratum;
+
+  // number of mutants that the rate kept so far
+  unsigned rateKept = 0;
+  // only count the mutants (see startCounting)
+  bool counting = false;
+  // with a maximum number of mutants, whether each mutant that the rate keeps
+  // is kept (see keepAtMost)
+  std::vector<bool> maxKept;
+
+  Stratum newStratum() {
+    Stratum stratum = {prng() / 4294967296.0, 0};
+    return stratum;
+  }
+
+public:
+  MutantsSampler(double samplingRate, Strata samplingBy, unsigned seed)
+      : rate(samplingRate), by(samplingBy), prngSeed(seed), prng(seed) {
+    stmtStratum = {0.0, 0};
+  }
+
+  /// \brief only count the mutants that the rate keeps, keeping none, until
+  /// keepAtMost is called
+  void startCounting() { counting = true; }
+
+  /// \brief restart the sampling from the beginning, and keep at most
+  /// 'maxMutants' of the mutants that the rate keeps, out of those counted
+  /// (the same mutants must be sampled again, in the same order)
+  void keepAtMost(unsigned maxMutants) {
+    assert(counting && "the mutants must be counted first");
+    maxKept.assign(rateKept, rateKept <= maxMutants);
+    if (rateKept > maxMutants) {
+      // Choose 'maxMutants' of them
+      std::vector<unsigned> indexes(rateKept);
+      for (unsigned i = 0; i < rateKept; ++i)
+        indexes[i] = i;
+      std::mt19937 maxPrng(prngSeed);
+      for (unsigned i = 0; i < maxMutants; ++i) {
+        uint64_t j = i + (((uint64_t)maxPrng() * (rateKept - i)) >> 32);
+        std::swap(indexes[i], indexes[j]);
+        maxKept[indexes[i]] = true;
+      }
+    }
+    prng.seed(prngSeed);
+    strata.clear();
+    stmtStratum = {0.0, 0};
+    rateKept = 0;
+    counting = false;
+  }
+
+  /// \brief start the sampling of the mutants of a new statement
+  void startStatement() {
+    if (by == ByStatement)
+      stmtStratum = newStratum();
+  }
+
+  /// \brief whether the next mutant of the current statement, of type
+  /// 'typeName', is kept
+  bool keep(std::string const &typeName) {
+    Stratum *stratum = &stmtStratum;
+    if (by != ByStatement) {
+      std::string key(by == ByOperator ? typeName : "");
+      auto it = strata.find(key);
+      if (it == strata.end())
+        it = strata.emplace(key, newStratum()).first;
+      stratum = &it->second;
+    }
+    double before = std::floor(stratum->start + stratum->seen * rate);
+    ++stratum->seen;
+    if (std::floor(stratum->start + stratum->seen * rate) <= before)
+      return false;
+    unsigned index = rateKept++;
+    if (counting)
+      return false;
+    return maxKept.empty() || maxKept.at(index);
+  }
+}; //~ class MutantsSampler
+
 /**
  * \brief This class represent the list of mutants of a statement, generated by
  * mutation op, these are not yet attached to the module. Once attached, update
@@ -997,6 +1408,45 @@ struct MutantsOfStmt {
 
   std::vector<RawMutantStmt> results;
 
+  /// A mutant removed before its insertion in the module (see PreTCEFilter),
+  /// trivially equivalent to the original ('dupOfIndex' < 0) or duplicate of
+  /// the mutant at 'dupOfIndex' in 'results'
+  struct PreFilteredMutant {
+    std::string typeName;
+    std::vector<unsigned> irRelevantPos;
+    int dupOfIndex;
+  };
+
+  std::vector<PreFilteredMutant> preFiltered;
+
+  /// A mutant not generated (or removed before its insertion in the module)
+  /// by the mutants sampling
+  struct SampledOutMutant {
+    std::string typeName;
+    std::vector<unsigned> irRelevantPos;
+  };
+
+  std::vector<SampledOutMutant> sampledOut;
+
+  /// The sampler deciding which mutants are generated (null when the
+  /// mutants are not sampled)
+  MutantsSampler *sampler = nullptr;
+
+  /**
+   * \brief Decide whether the mutant of @param repl , mutating the IRs at
+   * @param relevantPos of the original statement, is generated. The mutation
+   * operators call this before they build the mutant's IR. The mutants not
+   * generated are recorded in 'sampledOut'.
+   */
+  inline bool sampleIn(llvmMutationOp::MutantReplacors const &repl,
+                       std::vector<unsigned> const &relevantPos) {
+    if (sampler == nullptr || sampler->keep(repl.getMutOpName()))
+      return true;
+    SampledOutMutant out = {repl.getMutOpName(), relevantPos};
+    sampledOut.push_back(out);
+    return false;
+  }
+
   /**
    * \brief This method add a new mutant statement.
    * \detail It computes the corresponding Weak mutation using difference
@@ -1014,7 +1464,42 @@ struct MutantsOfStmt {
     results.emplace_back(toMatchMutant, repl, relevantPos);
   }
 
-  inline void clear() { results.clear(); }
+  inline void clear() {
+    results.clear();
+    preFiltered.clear();
+    sampledOut.clear();
+  }
+
+  /// \brief remove the mutant at 'index' (before its ID is set), deleting
+  /// its basic blocks. The pre-filtered duplicates of it are removed too.
+  inline void remove(unsigned index) {
+    auto &origBBToMutBB = results[index].mutantStmtIR.origBBToMutBB;
+    // The blocks of the mutant may use each other's values: drop them first
+    for (auto &it : origBBToMutBB)
+      for (auto *bb : it.second)
+        bb->dropAllReferences();
+    results[index].mutantStmtIR.deleteContainedMutant();
+    results.erase(results.begin() + index);
+    for (auto it = preFiltered.begin(); it != preFiltered.end();) {
+      if (it->dupOfIndex == (int)index) {
+        it = preFiltered.erase(it);
+      } else {
+        if (it->dupOfIndex > (int)index)
+          --it->dupOfIndex;
+        ++it;
+      }
+    }
+  }
+
+  /// \brief remove the mutant at 'index', trivially equivalent or duplicate
+  /// of the mutant at 'dupOfIndex' (< 'index'), recording it in 'preFiltered'
+  inline void removePreFiltered(unsigned index, int dupOfIndex) {
+    assert(dupOfIndex < (int)index && "must be duplicate of a previous mutant");
+    PreFilteredMutant filtered = {results[index].typeName,
+                                  results[index].irRelevantPos, dupOfIndex};
+    remove(index);
+    preFiltered.push_back(filtered);
+  }
 
   inline unsigned getNumMuts() { return results.size(); }
 
@@ -1064,6 +1549,10 @@ struct StatementSearch {
 
   llvm::BasicBlock *lastBB;
 
+  /// \brief The statement is not to be mutated (removed from the search).
+  /// It stays in the source order list, with no mutant.
+  bool discarded;
+
   void countInc() { stmtIRcount++; }
   void countDec() { stmtIRcount--; }
   void checkCountLogic() {
@@ -1110,6 +1599,7 @@ struct StatementSearch {
     visited.clear();
     stmtIRcount = 0;
     atomicityInBB = lastBB = nullptr;
+    discarded = false;
   }
 
   bool isVisited(llvm::Value *v) { return (visited.count(v) > 0); }
@@ -1120,8 +1610,7 @@ struct StatementSearch {
 
   void appendIRToStmt(llvm::BasicBlock *bb, llvm::Value *ir,
                       unsigned posInFunc) {
-    matchStmtIR.toMatchIRs.push_back(ir);
-    matchStmtIR.posIRsInOrigFunc.push_back(posInFunc);
+    matchStmtIR.appendIR(ir, posInFunc);
     if (lastBB != bb) {
       // assert ()
       // -1 bellow because we just appendend and inst and it should be its pos
@@ -1143,6 +1632,185 @@ struct StatementSearch {
   }
 }; //~ struct StatementSearch
 
+/**
+ * \brief Arena of the StatementSearch objects (and their mutants list) of a
+ * function. The objects are allocated by chunks, have stable addresses and
+ * are all destroyed together with reset(), at the end of the function
+ * mutation, instead of one allocation and deletion per statement.
+ */
+class StatementSearchArena {
+  std::deque<StatementSearch> stmts;
+
+public:
+  StatementSearchArena() {}
+  StatementSearchArena(StatementSearchArena const &) = delete;
+  StatementSearchArena &operator=(StatementSearchArena const &) = delete;
+
+  inline StatementSearch *create() {
+    stmts.emplace_back();
+    return &stmts.back();
+  }
+  inline std::size_t size() const { return stmts.size(); }
+  inline void reset() { std::deque<StatementSearch>().swap(stmts); }
+}; //~ class StatementSearchArena
+
+/**
+ * \brief Read-only view, mapped in memory, of a mutants infos binary file
+ * (written by MutantInfoList::printToBinaryFile). The mutants infos are
+ * accessed by mutant ID without parsing the file.
+ *
+ * Layout (32 bits words in the native byte order, after the 8 bytes magic):
+ *  - header: number of mutants, of equivalent/duplicate mutants, of strings,
+ *    of IR positions, and size of the strings characters.
+ *  - records, one per mutant then per equivalent/duplicate mutant, sorted by
+ *    mutant ID: ID, type string, function string, source location string,
+ *    first IR position, number of IR positions, ID of the mutant it is
+ *    equivalent/duplicate of (0 for the original or the non dup/eq mutants).
+ *  - IR positions of all the records.
+ *  - offsets of the strings (number of strings + 1) in the characters.
+ *  - strings characters. Each distinct string is stored once.
+ */
+class MutantInfoBinaryView {
+public:
+  static const char *magic() { return "MARTMI01"; }
+  static const unsigned magicSize = 8;
+  static const unsigned headerWords = 5;
+  static const unsigned recordWords = 7;
+  enum RecordField {
+    RecID = 0,
+    RecType,
+    RecFunc,
+    RecSrcLoc,
+    RecIRPosBegin,
+    RecIRPosNum,
+    RecDupOf
+  };
+
+private:
+  void *mapAddr;
+  size_t mapSize;
+  uint32_t const *header;
+  uint32_t const *records;
+  uint32_t const *irPos;
+  uint32_t const *strOffsets;
+  char const *chars;
+
+  uint32_t const *getRecordByPos(MutantIDType pos) const {
+    return records + (size_t)pos * recordWords;
+  }
+
+public:
+  MutantInfoBinaryView()
+      : mapAddr(nullptr), mapSize(0), header(nullptr), records(nullptr),
+        irPos(nullptr), strOffsets(nullptr), chars(nullptr) {}
+  ~MutantInfoBinaryView() { close(); }
+
+  /// \brief check whether 'filename' is a mutants infos binary file
+  static bool isBinaryFile(std::string const &filename) {
+    std::ifstream in(filename, std::ios::in | std::ios::binary);
+    char buf[magicSize];
+    return in.read(buf, magicSize) && std::memcmp(buf, magic(), magicSize) == 0;
+  }
+
+  bool open(std::string const &filename) {
+    close();
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+      llvm::errs() << "Error: cannot open mutants infos file " << filename
+                   << "\n";
+      return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 ||
+        st.st_size < (off_t)(magicSize + headerWords * sizeof(uint32_t))) {
+      llvm::errs() << "Error: invalid mutants infos file " << filename << "\n";
+      ::close(fd);
+      return false;
+    }
+    mapSize = st.st_size;
+    mapAddr = mmap(nullptr, mapSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapAddr == MAP_FAILED) {
+      mapAddr = nullptr;
+      llvm::errs() << "Error: cannot map mutants infos file " << filename
+                   << "\n";
+      return false;
+    }
+    char const *base = static_cast<char const *>(mapAddr);
+    header = reinterpret_cast<uint32_t const *>(base + magicSize);
+    size_t numRecords = (size_t)header[0] + header[1];
+    records = header + headerWords;
+    irPos = records + numRecords * recordWords;
+    strOffsets = irPos + header[3];
+    chars = reinterpret_cast<char const *>(strOffsets + header[2] + 1);
+    if (std::memcmp(base, magic(), magicSize) != 0 ||
+        chars + header[4] != base + mapSize) {
+      llvm::errs() << "Error: invalid mutants infos file " << filename << "\n";
+      close();
+      return false;
+    }
+    return true;
+  }
+
+  void close() {
+    if (mapAddr)
+      munmap(mapAddr, mapSize);
+    mapAddr = nullptr;
+    header = records = irPos = strOffsets = nullptr;
+    chars = nullptr;
+  }
+
+  MutantIDType getMutantsNumber() const { return header[0]; }
+  MutantIDType getEquivalentDuplicateNumber() const { return header[1]; }
+  MutantIDType getRecordsNumber() const { return header[0] + header[1]; }
+
+  llvm::StringRef getString(uint32_t strIndex) const {
+    return llvm::StringRef(chars + strOffsets[strIndex],
+                           strOffsets[strIndex + 1] - strOffsets[strIndex]);
+  }
+
+  /// \brief get the record of the mutant 'mid', or nullptr if not in the file.
+  /// The mutants' IDs are contiguous (the record position is computed), the
+  /// records are sorted by ID otherwise
+  uint32_t const *getRecord(MutantIDType mid) const {
+    MutantIDType numRecords = getRecordsNumber();
+    if (mid >= 1 && mid <= numRecords && getRecordByPos(mid - 1)[RecID] == mid)
+      return getRecordByPos(mid - 1);
+    MutantIDType low = 0, high = numRecords;
+    while (low < high) {
+      MutantIDType mid_pos = low + (high - low) / 2;
+      if (getRecordByPos(mid_pos)[RecID] < mid)
+        low = mid_pos + 1;
+      else
+        high = mid_pos;
+    }
+    if (low < numRecords && getRecordByPos(low)[RecID] == mid)
+      return getRecordByPos(low);
+    return nullptr;
+  }
+  uint32_t const *getRecordAt(MutantIDType pos) const {
+    return getRecordByPos(pos);
+  }
+
+  llvm::StringRef getTypeName(uint32_t const *rec) const {
+    return getString(rec[RecType]);
+  }
+  llvm::StringRef getFunction(uint32_t const *rec) const {
+    return getString(rec[RecFunc]);
+  }
+  llvm::StringRef getSourceLoc(uint32_t const *rec) const {
+    return getString(rec[RecSrcLoc]);
+  }
+  void getIRPosInFunction(uint32_t const *rec,
+                          std::vector<unsigned> &ret) const {
+    ret.assign(irPos + rec[RecIRPosBegin],
+               irPos + rec[RecIRPosBegin] + rec[RecIRPosNum]);
+  }
+  MutantIDType getEquivalentDuplicateOf(uint32_t const *rec) const {
+    return rec[RecDupOf];
+  }
+}; //~ class MutantInfoBinaryView
+
 /**
  * \brief This class define the final list of all mutant and their informations.
  * @Note: This is increased after each statement mutation and modifed (reduced)
@@ -1233,6 +1901,15 @@ private:
   // After TCE, ths contains only the TCE equivalent and duplicate mutants
   std::vector<EquivalentDuplicateMutantInfo> equivalent_duplicate_mutants;
 
+  // Mutants removed by the pre-TCE filter (their ID is 0), with the pre-TCE
+  // ID of the mutant they are duplicate of (0 for equivalent). Moved into the
+  // equivalent and duplicate mutants by the TCE (postTCEUpdate)
+  std::vector<std::pair<MutantInfo, MutantIDType>> preFilteredMutants;
+
+  // Mutants not generated, or removed before their insertion in the module,
+  // by the mutants sampling (their ID is 0)
+  std::vector<MutantInfo> sampledOutMutants;
+
   void internalAdd(MutantIDType mutant_id, std::string const &type,
                    std::string const &funcName,
                    std::vector<unsigned> const &irPos,
@@ -1311,6 +1988,38 @@ public:
     containedMutsIDs.insert(mid);
   }
 
+  /**
+   * \brief add a mutant removed by the pre-TCE filter, duplicate of the
+   * mutant 'dupOfID' (0 for equivalent)
+   */
+  void addPreFiltered(std::vector<llvm::Value *> const &toMatch,
+                      std::string const &mName,
+                      std::vector<unsigned> const &relpos,
+                      llvm::Function *curFunc,
+                      std::vector<unsigned> const &toMatchIRPosInFunc,
+                      MutantIDType dupOfID) {
+    preFilteredMutants.emplace_back(
+        MutantInfo(0, toMatch, mName, relpos, curFunc, toMatchIRPosInFunc),
+        dupOfID);
+  }
+
+  /**
+   * \brief add a mutant not generated (or removed before its insertion in the
+   * module) by the mutants sampling
+   */
+  void addSampledOut(std::vector<llvm::Value *> const &toMatch,
+                     std::string const &mName,
+                     std::vector<unsigned> const &relpos,
+                     llvm::Function *curFunc,
+                     std::vector<unsigned> const &toMatchIRPosInFunc) {
+    sampledOutMutants.emplace_back(0, toMatch, mName, relpos, curFunc,
+                                   toMatchIRPosInFunc);
+  }
+
+  const std::vector<MutantInfo> &getSampledOutMutants() const {
+    return sampledOutMutants;
+  }
+
   /**
    *  \brief remove the TCE's equivalent and duplicate mutants
    */
@@ -1348,9 +2057,45 @@ public:
       containedMutsIDs.erase(1 + (*it));
       mutants.erase(mutants.begin() + (*it));
     }
+
+    // The pre-TCE filter's equivalent/duplicate mutants come next
+    for (auto &filtered : preFilteredMutants) {
+      MutantIDType dupOf = filtered.second;
+      if (dupOf != 0 && nonduplicateIDMap.count(dupOf) == 0)
+        dupOf = duplicate2nondupMap.at(dupOf); // (the TCE's eq/dup)
+      equivalent_duplicate_mutants.emplace_back(
+          filtered.first, newEqDupId++,
+          dupOf == 0 ? 0 : nonduplicateIDMap.at(dupOf).back());
+    }
+    preFilteredMutants.clear();
+  }
+
+  /**
+   * \brief append the mutants infos of the mutation shard 'shard' (see
+   * mart-merge): its mutants IDs are shifted by 'idOffset' and its
+   * equivalent/duplicate mutants IDs are renumbered from 'firstEqDupID'.
+   */
+  void appendShard(MutantInfoList const &shard, MutantIDType idOffset,
+                   MutantIDType firstEqDupID) {
+    for (auto &info : shard.mutants)
+      internalAdd(info.id + idOffset, info.typeName, info.locFuncName,
+                  info.irLeveLocInFunc, info.srcLevelLoc);
+    for (auto &eqdupinfo : shard.equivalent_duplicate_mutants)
+      equivalent_duplicate_mutants.emplace_back(
+          eqdupinfo,
+          firstEqDupID + eqdupinfo.id - shard.getMutantsNumber() - 1,
+          eqdupinfo.duplicateOfID == 0 ? 0
+                                       : eqdupinfo.duplicateOfID + idOffset);
   }
 
   MutantIDType getMutantsNumber() const { return mutants.size(); }
+  MutantIDType getEquivalentDuplicateMutantsNumber() const {
+    return equivalent_duplicate_mutants.size();
+  }
+  const std::vector<EquivalentDuplicateMutantInfo> &
+  getEquivalentDuplicateMutants() const {
+    return equivalent_duplicate_mutants;
+  }
   const std::string &getMutantTypeName(MutantIDType mutant_id) const {
     return mutants[mutant_id - 1].typeName;
   }
@@ -1377,16 +2122,178 @@ public:
     // outJSON.writeToStream(std::cout, true, true);
   }
 
+private:
+  static void writeJsonString(std::ostream &out, std::string const &str) {
+    out << '"';
+    for (unsigned char c : str) {
+      switch (c) {
+      case '"':
+        out << "\\\"";
+        break;
+      case '\\':
+        out << "\\\\";
+        break;
+      case '\n':
+        out << "\\n";
+        break;
+      case '\t':
+        out << "\\t";
+        break;
+      case '\r':
+        out << "\\r";
+        break;
+      default:
+        if (c < 0x20) {
+          char buf[8];
+          snprintf(buf, sizeof(buf), "\\u%04x", c);
+          out << buf;
+        } else {
+          out << c;
+        }
+      }
+    }
+    out << '"';
+  }
+
+  /// \brief write, as a JSON object, the infos of 'infos' (streamed, without
+  /// building the JSON document). 'dupOf' gives the mutant that each info is
+  /// equivalent/duplicate of (null for the non equivalent/duplicate mutants)
+  template <typename InfoT>
+  static bool writeJsonInfos(std::string const &filename,
+                             std::vector<InfoT> const &infos,
+                             MutantIDType (*dupOf)(InfoT const &)) {
+    std::ofstream out(filename);
+    if (!out.is_open()) {
+      llvm::errs() << "Error: Unable to open file for write: " << filename
+                   << "\n";
+      return false;
+    }
+    out << "{";
+    bool first = true;
+    for (auto &info : infos) {
+      out << (first ? "\n" : ",\n") << "\t\"" << info.id << "\": {";
+      first = false;
+      out << "\n\t\t\"Type\": ";
+      writeJsonString(out, info.typeName);
+      out << ",\n\t\t\"FuncName\": ";
+      writeJsonString(out, info.locFuncName);
+      out << ",\n\t\t\"IRPosInFunc\": [";
+      for (unsigned i = 0; i < info.irLeveLocInFunc.size(); ++i)
+        out << (i ? ", " : "") << info.irLeveLocInFunc[i];
+      out << "],\n\t\t\"SrcLoc\": ";
+      writeJsonString(out, info.srcLevelLoc);
+      if (dupOf)
+        out << ",\n\t\t\"EquivalenDuplicateOf\": \"" << dupOf(info) << "\"";
+      out << "\n\t}";
+    }
+    out << (first ? "}\n" : "\n}\n");
+    out.close();
+    return !out.fail();
+  }
+
+  static MutantIDType getDuplicateOfID(EquivalentDuplicateMutantInfo const &info) {
+    return info.duplicateOfID;
+  }
+
+public:
   void printToJsonFile(std::string filename, std::string eqdupfilename) const {
-    JsonBox::Object outJSON;
-    getJson(outJSON);
-    JsonBox::Value vout(outJSON);
-    vout.writeToFile(filename, true, false);
-
-    outJSON.clear();
-    getEqDupJson(outJSON);
-    JsonBox::Value eqdupvout(outJSON);
-    eqdupvout.writeToFile(eqdupfilename, true, false);
+    if (!writeJsonInfos<MutantInfo>(filename, mutants, nullptr) ||
+        !writeJsonInfos<EquivalentDuplicateMutantInfo>(
+            eqdupfilename, equivalent_duplicate_mutants, getDuplicateOfID))
+      assert(false && "Failed to write mutants infos JSON file");
+  }
+
+  /// \brief write the mutants and equivalent/duplicate mutants infos into the
+  /// binary file 'filename' (see MutantInfoBinaryView)
+  void printToBinaryFile(std::string filename) const {
+    std::vector<uint32_t> header(MutantInfoBinaryView::headerWords, 0);
+    std::vector<uint32_t> records, irPos, strOffsets(1, 0);
+    std::string chars;
+    std::unordered_map<std::string, uint32_t> strIndexes;
+    auto internString = [&](std::string const &str) -> uint32_t {
+      auto it = strIndexes.find(str);
+      if (it != strIndexes.end())
+        return it->second;
+      uint32_t index = strOffsets.size() - 1;
+      strIndexes.emplace(str, index);
+      chars += str;
+      strOffsets.push_back(chars.size());
+      return index;
+    };
+    auto addRecord = [&](MutantInfo const &info, MutantIDType dupOf) {
+      records.push_back(info.id);
+      records.push_back(internString(info.typeName));
+      records.push_back(internString(info.locFuncName));
+      records.push_back(internString(info.srcLevelLoc));
+      records.push_back(irPos.size());
+      records.push_back(info.irLeveLocInFunc.size());
+      records.push_back(dupOf);
+      irPos.insert(irPos.end(), info.irLeveLocInFunc.begin(),
+                   info.irLeveLocInFunc.end());
+    };
+    for (auto &info : mutants)
+      addRecord(info, 0);
+    for (auto &eqdupinfo : equivalent_duplicate_mutants)
+      addRecord(eqdupinfo, eqdupinfo.duplicateOfID);
+    header[0] = mutants.size();
+    header[1] = equivalent_duplicate_mutants.size();
+    header[2] = strOffsets.size() - 1;
+    header[3] = irPos.size();
+    header[4] = chars.size();
+
+    std::ofstream out(filename, std::ios::out | std::ios::binary);
+    if (!out.is_open()) {
+      llvm::errs() << "Error: Unable to open file for write: " << filename
+                   << "\n";
+      assert(false && "Failed to write mutants infos binary file");
+    }
+    out.write(MutantInfoBinaryView::magic(), MutantInfoBinaryView::magicSize);
+    for (auto *words : {&header, &records, &irPos, &strOffsets})
+      out.write(reinterpret_cast<char const *>(words->data()),
+                words->size() * sizeof(uint32_t));
+    out.write(chars.data(), chars.size());
+    out.close();
+    if (out.fail())
+      assert(false && "Failed to write mutants infos binary file");
+  }
+
+  /// \brief load the mutants infos from 'filename', either a binary file or a
+  /// JSON file
+  void loadFromFile(std::string filename, bool fix_missing_srclocs = false) {
+    if (MutantInfoBinaryView::isBinaryFile(filename))
+      loadFromBinaryFile(filename, fix_missing_srclocs);
+    else
+      loadFromJsonFile(filename, fix_missing_srclocs);
+  }
+
+  void loadFromBinaryFile(std::string filename,
+                          bool fix_missing_srclocs = false) {
+    MutantInfoBinaryView view;
+    if (!view.open(filename))
+      assert(false && "Failed to load mutants infos binary file");
+    std::vector<unsigned> irPos;
+    MutantIDType num_of_mutants = view.getMutantsNumber();
+    for (MutantIDType pos = 0; pos < view.getRecordsNumber(); ++pos) {
+      uint32_t const *rec = view.getRecordAt(pos);
+      view.getIRPosInFunction(rec, irPos);
+      if (pos < num_of_mutants) {
+        // The mutants ID must go from 1 continuously upto num_mutants
+        assert(rec[MutantInfoBinaryView::RecID] == pos + 1 &&
+               "Mutants IDs must be contiguous in mutants infos");
+        internalAdd(rec[MutantInfoBinaryView::RecID],
+                    view.getTypeName(rec).str(), view.getFunction(rec).str(),
+                    irPos, view.getSourceLoc(rec).str());
+      } else {
+        equivalent_duplicate_mutants.emplace_back(
+            MutantInfo(rec[MutantInfoBinaryView::RecID],
+                       view.getTypeName(rec).str(), view.getFunction(rec).str(),
+                       irPos, view.getSourceLoc(rec).str()),
+            rec[MutantInfoBinaryView::RecID],
+            view.getEquivalentDuplicateOf(rec));
+      }
+    }
+    if (fix_missing_srclocs)
+      fixMissingSrcLocs();
   }
 
   void getJson(JsonBox::Object &outJ) const {
@@ -0,0 +1,16 @@
+int g;
+volatile int v;
+
+int f()
+{
+    return ++g;
+}
+
+int main ()
+{
+    int i, j, k;
+    i = f() - f();
+    j = v - v;
+    k = g - (f(), g);
+    return i + j + k;
+}
@@ -41,6 +41,10 @@ tmpLLVM_COMPILER_PATH=$($buildDir/../tools/mart -version 2>&1 | grep "LLVM tools
 CLANGC=$tmpLLVM_COMPILER_PATH/clang-$llvmvers
 LLVM_DIS=$tmpLLVM_COMPILER_PATH/llvm-dis-$llvmvers
 test -f $LLVM_DIS || LLVM_DIS=$tmpLLVM_COMPILER_PATH/llvm-dis
+OPT=$tmpLLVM_COMPILER_PATH/opt-$llvmvers
+test -f $OPT || OPT=$tmpLLVM_COMPILER_PATH/opt
+LLVM_DIFF=$tmpLLVM_COMPILER_PATH/llvm-diff-$llvmvers
+test -f $LLVM_DIFF || LLVM_DIFF=$tmpLLVM_COMPILER_PATH/llvm-diff
 #------------------------------------
 
 ## compile
@@ -66,9 +70,87 @@ do
     ( $buildDir/../tools/mart $options $filep.bc 2>&1 ) > $filep.info || { printf "\n---\n"; cat $filep.info; echo "---"; error_exit "mutation Failed for $src. cmd: `readlink -f  $buildDir/../tools/mart` $options $(readlink -f $filep.bc) 2>&1"; }
     mv mart-out-0 $filep-out || error_exit "Failed to store output"
     mv $filep.info $filep-out || error_exit "Failed to move info to output"
+    echo -n "pre-TCE filter...   "
+    # The pre-TCE filter must only remove mutants that the TCE removes
+    ( $buildDir/../tools/mart -no-pre-tce-filter $filep.bc 2>&1 ) > $filep.nofilter.info || error_exit "mutation without pre-TCE filter Failed for $src"
+    postTCE=$(grep -o "PostTCE: [0-9]*" $filep-out/$filep.info)
+    postTCENoFilter=$(grep -o "PostTCE: [0-9]*" $filep.nofilter.info)
+    [ "$postTCE" = "$postTCENoFilter" ] || error_exit "the pre-TCE filter removed non equivalent mutants of $src ($postTCE, without the filter $postTCENoFilter)"
+    rm -rf mart-out-0 $filep.nofilter.info || error_exit "Failed to remove the output without pre-TCE filter"
     echo "llvm-dis..."
     $LLVM_DIS -o $filep-out/$filep.MetaMu.ll $filep-out/$filep.MetaMu.bc || error_exit "llvm-dis failed on $filep-out/$filep.MetaMu.bc"
     $LLVM_DIS -o $filep-out/$filep.preTCE.MetaMu.ll $filep-out/$filep.preTCE.MetaMu.bc || error_exit "llvm-dis failed on $filep-out/$filep.preTCE.MetaMu.bc"
     test -f $filep-out/$filep.WM.bc && { $LLVM_DIS -o $filep-out/$filep.WM.ll $filep-out/$filep.WM.bc || error_exit "llvm-dis failed on $filep-out/wm-$filep.bc" ; }
 done  
 
+## mutants pack with function deltas: each mutant rebuilt from its delta must
+## be the mutant written in full (apart from the debug information)
+filep=add
+echo -n "> $filep...  pack with deltas...   "
+$CLANGC -O0 -g -c -emit-llvm -o $filep.bc ../operator/$filep.c || error_exit "Failed to compile $filep.c"
+for mode in full delta
+do
+    options="-write-mutants -pack-mutants"
+    [ "$mode" = "delta" ] && options="$options -delta-mutants"
+    ( $buildDir/../tools/mart $options $filep.bc 2>&1 ) > $filep.$mode.info || error_exit "mutation Failed for $filep.c. cmd: `readlink -f  $buildDir/../tools/mart` $options $(readlink -f $filep.bc)"
+    $buildDir/../tools/mart-pack -unpack -o $filep-pack-$mode mart-out-0 > /dev/null || error_exit "mart-pack failed to unpack the $mode mutants of $filep.c"
+    rm -rf mart-out-0 $filep.$mode.info || error_exit "Failed to remove the $mode pack output"
+done
+[ "$(ls $filep-pack-full/mutants.out)" = "$(ls $filep-pack-delta/mutants.out)" ] || error_exit "the delta pack and the full pack of $filep.c have different mutants"
+echo "compare..."
+for fullbc in $filep-pack-full/mutants.out/*/$filep.bc
+do
+    deltabc=$filep-pack-delta/${fullbc#$filep-pack-full/}
+    $OPT -strip-debug -o $fullbc.nodbg.bc $fullbc || error_exit "opt failed on $fullbc"
+    $OPT -strip-debug -o $deltabc.nodbg.bc $deltabc || error_exit "opt failed on $deltabc"
+    $LLVM_DIFF $fullbc.nodbg.bc $deltabc.nodbg.bc > /dev/null 2>&1 || error_exit "the mutant rebuilt from its delta ($deltabc) differs from $fullbc"
+done
+
+## mutation shards merged with mart-merge: the merged mutants IDs must be
+## unique and contiguous (1 to the number of mutants of all the shards)
+filep=call
+echo -n "> $filep...  shards merge...   "
+$CLANGC -O0 -g -c -emit-llvm -o $filep.bc ../operator/$filep.c || error_exit "Failed to compile $filep.c"
+nShardsMutants=0
+for shard in 0 1
+do
+    ( $buildDir/../tools/mart -shard $shard/2 $filep.bc 2>&1 ) > $filep.shard$shard.info || error_exit "mutation of shard $shard/2 Failed for $filep.c"
+    mv mart-out-0 $filep-shard$shard || error_exit "Failed to store the output of shard $shard"
+    nShardsMutants=$(($nShardsMutants + $(grep -c '^\s*"[0-9]*": {' $filep-shard$shard/mutantsInfos.json)))
+done
+$buildDir/../tools/mart-merge -o $filep-merged $filep-shard0 $filep-shard1 > $filep.merge.info 2>&1 || { cat $filep.merge.info; error_exit "mart-merge failed on the shards of $filep.c"; }
+mergedIDs=$(grep -o '^\s*"[0-9]*": {' $filep-merged/mutantsInfos.json | grep -o '[0-9]*' | sort -n)
+[ $nShardsMutants -gt 0 ] || error_exit "no mutant in the shards of $filep.c"
+[ "$mergedIDs" = "$(seq 1 $nShardsMutants)" ] || error_exit "the merged mutants IDs of $filep.c are not unique and contiguous from 1 to $nShardsMutants"
+echo "done!"
+
+## mutants infos binary file: the infos loaded from it (by mart-merge of a
+## single shard) must be written as the JSON infos of the mutation
+filep=call
+echo -n "> $filep...  mutants infos binary...   "
+( $buildDir/../tools/mart -shard 0/1 $filep.bc 2>&1 ) > $filep.single.info || error_exit "mutation of the single shard Failed for $filep.c"
+mv mart-out-0 $filep-single || error_exit "Failed to store the output of the single shard"
+$buildDir/../tools/mart-merge -o $filep-single-merged $filep-single > $filep.single.merge.info 2>&1 || { cat $filep.single.merge.info; error_exit "mart-merge failed on the single shard of $filep.c"; }
+for infos in mutantsInfos.json equidup-mutantsInfos.json
+do
+    cmp -s $filep-single/$infos $filep-single-merged/$infos || error_exit "the $infos of $filep.c loaded from mutantsInfos.bin differ from the mutation's"
+done
+echo "done!"
+
+## mutants sampling: the same seed must give the same mutants, another seed
+## another selection
+filep=call
+echo -n "> $filep...  mutants sampling seed...   "
+for run in seed1 seed1-again seed2
+do
+    seed=${run%-again}
+    seed=${seed#seed}
+    ( $buildDir/../tools/mart -sample-rate 0.5 -sample-seed $seed $filep.bc 2>&1 ) > $filep.$run.info || error_exit "mutation with the sampling seed $seed Failed for $filep.c"
+    mv mart-out-0 $filep-sample-$run || error_exit "Failed to store the output of the sampling with seed $seed"
+done
+for infos in mutantsInfos.json equidup-mutantsInfos.json
+do
+    cmp -s $filep-sample-seed1/$infos $filep-sample-seed1-again/$infos || error_exit "the same sampling seed gave different $infos for $filep.c"
+done
+cmp -s $filep-sample-seed1/mutantsInfos.json $filep-sample-seed2/mutantsInfos.json && error_exit "different sampling seeds gave the same mutants for $filep.c"
+echo "done!"
@@ -295,14 +295,10 @@ SplitFunctionsOutOfModule(Module *M, const std::vector<Function *> &F,
 }*/
 
 /**
- * \brief Mart's verion of split function out of module
- * @param M is the module that will have the function F at the end
- * @param FName is the name of the function in M to split out
+ * \brief Make the functions & globals of M all external, so that they can be
+ * linked with the modules split from M (and exported by its executable)
  */
-std::unique_ptr<Module>
-martSplitFunctionsOutOfModule(Module *M, const std::string &FName) {
-  // Make sure functions & globals are all external so that linkage
-  // between the two modules will work.
+void martExternalizeModule(Module *M) {
   for (Module::iterator I = M->begin(), E = M->end(); I != E; ++I)
     I->setLinkage(GlobalValue::ExternalLinkage);
   for (Module::global_iterator I = M->global_begin(), E = M->global_end();
@@ -311,6 +307,18 @@ martSplitFunctionsOutOfModule(Module *M, const std::string &FName) {
       I->setName(I->getName().substr(1));
     I->setLinkage(GlobalValue::ExternalLinkage);
   }
+}
+
+/**
+ * \brief Mart's verion of split function out of module
+ * @param M is the module that will have the function F at the end
+ * @param FName is the name of the function in M to split out
+ */
+std::unique_ptr<Module>
+martSplitFunctionsOutOfModule(Module *M, const std::string &FName) {
+  // Make sure functions & globals are all external so that linkage
+  // between the two modules will work.
+  martExternalizeModule(M);
 
   ValueToValueMapTy NewVMap;
 #if (LLVM_VERSION_MAJOR <= 3) && (LLVM_VERSION_MINOR < 8)
@@ -0,0 +1,361 @@
+/**
+ * -==== Mart-Daemon.cpp
+ *
+ *                Mart Multi-Language LLVM Mutation Framework
+ *
+ * This file is distributed under the University of Illinois Open Source
+ * License. See LICENSE.TXT for details.
+ *
+ * \brief     Main source file of the Mart daemon: a server, on a local UNIX
+ * socket, that keeps resident in memory the parsed modules, the mutation
+ * configurations (operators) and the mutant selection analyses (dependence
+ * graphs), and runs the mutation, selection and features export jobs sent by
+ * the clients (see useful/mart_daemon_client.py).
+ *
+ * Each job runs in a forked process, with the arguments of the corresponding
+ * tool (Mart or Mart-Selection): it finds there the resident objects without
+ * parsing or computing them again, and may modify them without changing the
+ * daemon's. The jobs run concurrently.
+ *
+ * A request is a list of fields, each ended by '\0', the last field being
+ * empty: the job, the working directory of the job (except for 'stop'), then
+ * the job's arguments. The jobs are:
+ *  - load-mutation <input IR> [<mutant config>]: keep resident the module and
+ *    the mutation configuration (the default one if not specified).
+ *  - load-selection <mutation topdir>: keep resident the topdir's
+ *    preprocessed module, mutants infos and mutant dependence analysis.
+ *  - mutate <Mart arguments>
+ *  - select <Mart-Selection arguments>
+ *  - features <Mart-Selection arguments>: the mutants and statements features
+ *    export (Mart-Selection with 'dump-features' and 'no-selection').
+ *  - stop: stop the daemon.
+ * The load jobs run first in a forked process, then, if they succeeded there,
+ * in the daemon: an invalid input, on which the loading aborts, does not stop
+ * the daemon (at the price of loading twice).
+ * The reply is the output (standard output and error) of the job, streamed,
+ * followed by the line 'Mart-Daemon@Exit: <exit status>'.
+ * The resident modules whose files changed are parsed again before each job.
+ */
+
+#include <cerrno>
+#include <csignal>
+#include <cstdio> //fflush
+#include <cstring>
+#include <fcntl.h> //open
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h> //waitpid
+#include <unistd.h>   //fork, dup2
+#include <vector>
+
+#include "ReadWriteIRObj.h"
+
+using namespace mart;
+
+// Implemented in Mart.cpp and Mart-Selection.cpp (compiled for the daemon)
+bool martMutationLoadResident(char *argv0, std::string inputIRfile,
+                              std::string mutantConfigfile);
+int martMutationMain(int argc, char **argv);
+#ifdef MART_DAEMON_SELECTION
+bool martSelectionLoadResident(std::string martOutTopDir);
+int martSelectionMain(int argc, char **argv);
+#endif
+
+static const char *exitStatusTag = "Mart-Daemon@Exit: ";
+static const unsigned defaultMaxRunningJobs = 4;
+
+/// \brief read a request (see the file description) from 'fd'
+static bool readRequest(int fd, std::vector<std::string> &fields) {
+  std::string field;
+  char buf[4096];
+  while (true) {
+    ssize_t n = read(fd, buf, sizeof(buf));
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return false;
+    for (ssize_t i = 0; i < n; ++i) {
+      if (buf[i] != '\0') {
+        field.push_back(buf[i]);
+      } else if (field.empty()) {
+        // job and working directory, or 'stop'
+        return fields.size() >= 2 ||
+               (fields.size() == 1 && fields[0] == "stop");
+      } else {
+        fields.push_back(field);
+        field.clear();
+      }
+    }
+  }
+}
+
+static void writeAll(int fd, std::string const &data) {
+  size_t written = 0;
+  while (written < data.size()) {
+    ssize_t n = write(fd, data.data() + written, data.size() - written);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return;
+    written += n;
+  }
+}
+
+static void replyExitStatus(int fd, int status) {
+  writeAll(fd, std::string(exitStatusTag) + std::to_string(status) + "\n");
+}
+
+/// \brief load, in the current process, the resident objects of the load job
+/// 'fields' with its output sent to 'fd'. Return the exit status.
+static int loadResident(char *argv0, std::vector<std::string> const &fields,
+                        int fd) {
+  std::string const &job = fields[0];
+  llvm::outs().flush();
+  llvm::errs().flush();
+  int savedStdout = dup(STDOUT_FILENO);
+  int savedStderr = dup(STDERR_FILENO);
+  dup2(fd, STDOUT_FILENO);
+  dup2(fd, STDERR_FILENO);
+  // The files are relative to the job's working directory
+  int savedCwd = open(".", O_RDONLY);
+
+  bool ok = false;
+  if (chdir(fields[1].c_str()) != 0) {
+    llvm::errs() << "Mart-Daemon@Error: cannot change directory to '"
+                 << fields[1] << "'.\n";
+  } else if (job == "load-mutation" && (fields.size() == 3 || fields.size() == 4)) {
+    ok = martMutationLoadResident(argv0, fields[2],
+                                  fields.size() == 4 ? fields[3] : "");
+#ifdef MART_DAEMON_SELECTION
+  } else if (job == "load-selection" && fields.size() == 3) {
+    ok = martSelectionLoadResident(fields[2]);
+#endif
+  } else {
+    llvm::errs() << "Mart-Daemon@Error: invalid job '" << job << "' with "
+                 << (fields.size() - 2) << " arguments.\n";
+  }
+  if (ok)
+    llvm::outs() << "Mart-Daemon@Progress: loaded.\n";
+
+  llvm::outs().flush();
+  llvm::errs().flush();
+  dup2(savedStdout, STDOUT_FILENO);
+  dup2(savedStderr, STDERR_FILENO);
+  close(savedStdout);
+  close(savedStderr);
+  if (savedCwd < 0 || fchdir(savedCwd) != 0)
+    llvm::errs() << "Mart-Daemon@Warning: failed to restore the working "
+                    "directory.\n";
+  if (savedCwd >= 0)
+    close(savedCwd);
+  return ok ? 0 : 1;
+}
+
+/// \brief run the load job 'fields' with its output sent to 'fd': in a
+/// forked process, then in the daemon if it succeeded. Return the exit status.
+static int runLoadJob(char *argv0, std::vector<std::string> const &fields,
+                      int fd) {
+  llvm::outs().flush();
+  llvm::errs().flush();
+  pid_t pid = fork();
+  if (pid == 0) {
+    int ret = loadResident(argv0, fields, fd);
+    // Exit without destroying the objects just loaded (and the daemon's)
+    fflush(nullptr);
+    _exit(ret);
+  }
+  if (pid < 0) {
+    writeAll(fd, "Mart-Daemon@Error: failed to fork the job.\n");
+    return 1;
+  }
+  int wstatus;
+  while (waitpid(pid, &wstatus, 0) < 0 && errno == EINTR)
+    ;
+  if (!WIFEXITED(wstatus))
+    return 128 + WTERMSIG(wstatus);
+  if (WEXITSTATUS(wstatus) != 0)
+    return WEXITSTATUS(wstatus);
+
+  // The output was sent by the forked load
+  int nullFd = open("/dev/null", O_WRONLY);
+  int status = loadResident(argv0, fields, nullFd < 0 ? fd : nullFd);
+  if (nullFd >= 0)
+    close(nullFd);
+  if (status != 0)
+    writeAll(fd, "Mart-Daemon@Error: the load failed in the daemon.\n");
+  return status;
+}
+
+/// \brief run the tool job 'fields' in a forked process, with its output
+/// sent to 'fd'. The process runs the job in its own child and replies with
+/// the exit status, so that the daemon does not wait for it.
+static pid_t startToolJob(char *argv0, std::vector<std::string> const &fields,
+                          int fd, int listenFd) {
+  pid_t pid = fork();
+  if (pid != 0)
+    return pid;
+
+  // Job supervisor
+  close(listenFd);
+  signal(SIGPIPE, SIG_DFL);
+  std::string const &job = fields[0];
+  int (*toolMain)(int, char **) = nullptr;
+  std::vector<std::string> args(1, argv0);
+  if (job == "mutate") {
+    toolMain = martMutationMain;
+#ifdef MART_DAEMON_SELECTION
+  } else if (job == "select" || job == "features") {
+    toolMain = martSelectionMain;
+#endif
+  }
+  if (toolMain == nullptr) {
+    writeAll(fd, "Mart-Daemon@Error: invalid job '" + job + "'.\n");
+    replyExitStatus(fd, 1);
+    _exit(0);
+  }
+  args.insert(args.end(), fields.begin() + 2, fields.end());
+  if (job == "features") {
+    args.push_back("-dump-features");
+    args.push_back("-no-selection");
+  }
+
+  pid_t jobPid = fork();
+  if (jobPid == 0) {
+    // Job
+    if (chdir(fields[1].c_str()) != 0) {
+      writeAll(fd, "Mart-Daemon@Error: cannot change directory to '" +
+                       fields[1] + "'.\n");
+      _exit(1);
+    }
+    dup2(fd, STDOUT_FILENO);
+    dup2(fd, STDERR_FILENO);
+    close(fd);
+    std::vector<char *> argv;
+    for (auto &arg : args)
+      argv.push_back(const_cast<char *>(arg.c_str()));
+    argv.push_back(nullptr);
+    int ret = toolMain(argv.size() - 1, argv.data());
+    // Exit without destroying the resident objects (the daemon's)
+    llvm::outs().flush();
+    llvm::errs().flush();
+    fflush(nullptr);
+    _exit(ret);
+  }
+  int status = 0;
+  if (jobPid < 0) {
+    writeAll(fd, "Mart-Daemon@Error: failed to fork the job.\n");
+    status = 1;
+  } else {
+    int wstatus;
+    while (waitpid(jobPid, &wstatus, 0) < 0 && errno == EINTR)
+      ;
+    status = WIFEXITED(wstatus) ? WEXITSTATUS(wstatus)
+                                : 128 + WTERMSIG(wstatus);
+  }
+  replyExitStatus(fd, status);
+  _exit(0);
+}
+
+static void printUsage(char const *argv0) {
+  llvm::errs() << "Usage: " << argv0 << " [-jobs=<N>] <socket path>\n"
+               << "Run the Mart daemon on the local UNIX socket <socket "
+                  "path>, running at most N jobs concurrently (default "
+               << defaultMaxRunningJobs << ").\n";
+}
+
+int main(int argc, char **argv) {
+  // The options are parsed by hand: the command line options of the tools are
+  // parsed in the jobs
+  unsigned maxRunningJobs = defaultMaxRunningJobs;
+  std::string socketPath;
+  for (int i = 1; i < argc; ++i) {
+    llvm::StringRef arg(argv[i]);
+    if (arg.startswith("-jobs=")) {
+      if (arg.substr(6).getAsInteger(10, maxRunningJobs) ||
+          maxRunningJobs == 0) {
+        printUsage(argv[0]);
+        return 1;
+      }
+    } else if (arg.startswith("-") || !socketPath.empty()) {
+      printUsage(argv[0]);
+      return arg == "-help" || arg == "--help" ? 0 : 1;
+    } else {
+      socketPath = arg.str();
+    }
+  }
+  if (socketPath.empty()) {
+    printUsage(argv[0]);
+    return 1;
+  }
+
+  struct sockaddr_un addr;
+  if (socketPath.size() >= sizeof(addr.sun_path)) {
+    llvm::errs() << "Mart-Daemon@Error: socket path too long.\n";
+    return 1;
+  }
+  std::memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  std::strcpy(addr.sun_path, socketPath.c_str());
+  int listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+  unlink(socketPath.c_str());
+  if (listenFd < 0 ||
+      bind(listenFd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+      listen(listenFd, 64) != 0) {
+    llvm::errs() << "Mart-Daemon@Error: cannot listen on '" << socketPath
+                 << "': " << std::strerror(errno) << "\n";
+    return 1;
+  }
+  // A client leaving must not stop the daemon
+  signal(SIGPIPE, SIG_IGN);
+  llvm::outs() << "Mart-Daemon@Progress: listening on '" << socketPath
+               << "'.\n";
+  llvm::outs().flush();
+
+  unsigned runningJobs = 0;
+  bool stopping = false;
+  while (!stopping) {
+    // Reap the finished jobs, wait for one when too many are running
+    while (runningJobs > 0 &&
+           waitpid(-1, nullptr, runningJobs >= maxRunningJobs ? 0 : WNOHANG) >
+               0)
+      --runningJobs;
+
+    int fd = accept(listenFd, nullptr, nullptr);
+    if (fd < 0) {
+      if (errno == EINTR || errno == ECONNABORTED)
+        continue;
+      llvm::errs() << "Mart-Daemon@Error: accept failed: "
+                   << std::strerror(errno) << "\n";
+      break;
+    }
+    std::vector<std::string> fields;
+    if (!readRequest(fd, fields)) {
+      close(fd);
+      continue;
+    }
+    std::string const &job = fields[0];
+    if (job == "stop") {
+      replyExitStatus(fd, 0);
+      stopping = true;
+    } else if (job == "load-mutation" || job == "load-selection") {
+      replyExitStatus(fd, runLoadJob(argv[0], fields, fd));
+    } else {
+      if (!ReadWriteIRObj::refreshResidentModules())
+        llvm::errs() << "Mart-Daemon@Warning: failed to reload resident "
+                        "modules (not resident anymore).\n";
+      pid_t pid = startToolJob(argv[0], fields, fd, listenFd);
+      if (pid < 0)
+        replyExitStatus(fd, 1);
+      else
+        ++runningJobs;
+    }
+    close(fd);
+  }
+
+  close(listenFd);
+  unlink(socketPath.c_str());
+  while (runningJobs > 0 && waitpid(-1, nullptr, 0) > 0)
+    --runningJobs;
+  return 0;
+}
@@ -0,0 +1,193 @@
+/**
+ * -==== Mart-KillMatrix.cpp
+ *
+ *                Mart Multi-Language LLVM Mutation Framework
+ *
+ * This file is distributed under the University of Illinois Open Source
+ * License. See LICENSE.TXT for details.
+ *
+ * \brief     Main source file of the tool that stores the mutants execution
+ * results (kill matrix) in compressed form and computes on it the mutation
+ * score, the subsuming mutants, a minimal test set and the Mart-Training
+ * labels.
+ */
+
+#include <algorithm>
+#include <ctime>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "KillMatrix.h"
+
+#include "llvm/Support/CommandLine.h" //llvm::cl
+
+using namespace mart;
+
+#define TOOLNAME "Mart-KillMatrix"
+#include "tools_commondefs.h"
+
+/// \brief read the test names (one per line) of 'filename' into the indexes
+/// 'tests' of the kill matrix tests
+static bool readTestList(std::string const &filename, KillMatrix const &matrix,
+                         std::vector<unsigned> &tests) {
+  std::ifstream in(filename);
+  if (!in.is_open()) {
+    llvm::errs() << "Unable to open tests list file: " << filename << "\n";
+    return false;
+  }
+  std::string name;
+  while (in >> name) {
+    int index = matrix.getTestIndex(name);
+    if (index < 0) {
+      llvm::errs() << "Warning: test " << name << " of " << filename
+                   << " is not in the kill matrix\n";
+      continue;
+    }
+    tests.push_back(index);
+  }
+  return true;
+}
+
+int main(int argc, char **argv) {
+  llvm::cl::opt<std::string> inputMatrix(
+      llvm::cl::Positional, llvm::cl::Required,
+      llvm::cl::desc("<kill matrix: text file with the line '<test name> "
+                     "<killed mutants IDs...>' per test, or kill matrix "
+                     "store>"));
+  llvm::cl::opt<unsigned> mutantsNumber(
+      "mutants-number",
+      llvm::cl::desc("(Optional) Number of mutants (IDs 1 to N). Defaults to "
+                     "the highest killed mutant ID. Required with "
+                     "'training-labels'"),
+      llvm::cl::init(0));
+  llvm::cl::opt<std::string> storeFile(
+      "o", llvm::cl::desc("(Optional) Write the kill matrix store into file"),
+      llvm::cl::value_desc("filename"), llvm::cl::init(""));
+  llvm::cl::opt<std::string> scoreTestsFile(
+      "score-tests",
+      llvm::cl::desc("(Optional) Also compute the mutation score of the tests "
+                     "listed in this file (one test name per line)"),
+      llvm::cl::value_desc("filename"), llvm::cl::init(""));
+  llvm::cl::opt<std::string> subsumingOutFile(
+      "subsuming-mutants",
+      llvm::cl::desc("(Optional) Write the subsuming mutants IDs (one per "
+                     "line) into file"),
+      llvm::cl::value_desc("filename"), llvm::cl::init(""));
+  llvm::cl::opt<std::string> minimalTestsOutFile(
+      "minimal-tests",
+      llvm::cl::desc("(Optional) Write the tests of a minimal test set "
+                     "killing all the killed mutants (one per line) into "
+                     "file"),
+      llvm::cl::value_desc("filename"), llvm::cl::init(""));
+  llvm::cl::opt<std::string> trainingLabelsOutFile(
+      "training-labels",
+      llvm::cl::desc("(Optional) Write the Mart-Training labels ('Y' CSV) of "
+                     "the mutants into file"),
+      llvm::cl::value_desc("filename"), llvm::cl::init(""));
+  llvm::cl::opt<std::string> faultRevealingTestsFile(
+      "fault-revealing-tests",
+      llvm::cl::desc("(Optional) Fault revealing tests (one test name per "
+                     "line), for the coupling labels of 'training-labels'"),
+      llvm::cl::value_desc("filename"), llvm::cl::init(""));
+
+  llvm::cl::SetVersionPrinter(printVersion);
+
+  llvm::cl::ParseCommandLineOptions(argc, argv, "Mart Kill Matrix");
+
+  // The labels have a row per mutant, the never killed ones included
+  if (!trainingLabelsOutFile.empty() && mutantsNumber == 0) {
+    llvm::errs() << "Error: 'training-labels' requires 'mutants-number'\n";
+    return 1;
+  }
+
+  clock_t curClockTime = clock();
+
+  KillMatrix matrix;
+  if (KillMatrix::isStoreFile(inputMatrix)) {
+    if (!matrix.loadFromStore(inputMatrix))
+      return 1;
+    if (!trainingLabelsOutFile.empty() &&
+        mutantsNumber != matrix.getNumMutants()) {
+      llvm::errs() << "Error: the kill matrix store has "
+                   << matrix.getNumMutants() << " mutants, not "
+                   << mutantsNumber << " ('mutants-number')\n";
+      return 1;
+    }
+    if (mutantsNumber > matrix.getNumMutants())
+      llvm::errs() << "Warning: 'mutants-number' ignored for a kill matrix "
+                      "store (it has "
+                   << matrix.getNumMutants() << " mutants)\n";
+  } else if (!matrix.loadFromText(inputMatrix, mutantsNumber)) {
+    return 1;
+  }
+
+  if (!storeFile.empty() && !matrix.writeToStore(storeFile))
+    return 1;
+
+  std::vector<unsigned> allTests(matrix.getNumTests());
+  for (unsigned t = 0; t < allTests.size(); ++t)
+    allTests[t] = t;
+  uint64_t numKilled = matrix.getKilledMutants(allTests).cardinality();
+  llvm::outs() << "# " << matrix.getNumMutants() << " mutants, "
+               << matrix.getNumTests() << " tests, " << numKilled
+               << " killed mutants. Mutation score: "
+               << matrix.getMutationScore(allTests) << "\n";
+
+  if (!scoreTestsFile.empty()) {
+    std::vector<unsigned> tests;
+    if (!readTestList(scoreTestsFile, matrix, tests))
+      return 1;
+    llvm::outs() << "# Mutation score of the " << tests.size()
+                 << " tests of " << scoreTestsFile << ": "
+                 << matrix.getMutationScore(tests) << "\n";
+  }
+
+  if (!subsumingOutFile.empty()) {
+    std::vector<unsigned> subsuming;
+    matrix.getSubsumingMutants(subsuming);
+    std::ofstream out(subsumingOutFile);
+    if (!out.is_open()) {
+      llvm::errs() << "Unable to open file for write: " << subsumingOutFile
+                   << "\n";
+      return 1;
+    }
+    for (unsigned mid : subsuming)
+      out << mid << "\n";
+    llvm::outs() << "# " << subsuming.size() << " subsuming mutants.\n";
+  }
+
+  if (!minimalTestsOutFile.empty()) {
+    std::vector<unsigned> tests;
+    matrix.getMinimalTestSet(tests);
+    std::ofstream out(minimalTestsOutFile);
+    if (!out.is_open()) {
+      llvm::errs() << "Unable to open file for write: " << minimalTestsOutFile
+                   << "\n";
+      return 1;
+    }
+    for (unsigned t : tests)
+      out << matrix.getTestNames()[t] << "\n";
+    llvm::outs() << "# Minimal test set of " << tests.size() << " tests.\n";
+  }
+
+  if (!trainingLabelsOutFile.empty()) {
+    std::vector<unsigned> faultRevealing;
+    if (faultRevealingTestsFile.empty())
+      llvm::errs() << "Warning: no 'fault-revealing-tests', no mutant is "
+                      "labeled coupled.\n";
+    else if (!readTestList(faultRevealingTestsFile, matrix, faultRevealing))
+      return 1;
+    std::sort(faultRevealing.begin(), faultRevealing.end());
+    if (!matrix.writeTrainingLabels(
+            trainingLabelsOutFile,
+            CompressedBitmap::fromSorted(std::vector<uint32_t>(
+                faultRevealing.begin(), faultRevealing.end()))))
+      return 1;
+  }
+
+  llvm::outs() << "@Mart-KillMatrix: done in "
+               << (float)(clock() - curClockTime) / CLOCKS_PER_SEC
+               << " Seconds.\n";
+  return 0;
+}
@@ -0,0 +1,233 @@
+/**
+ * -==== Mart-Merge.cpp
+ *
+ *                Mart Multi-Language LLVM Mutation Framework
+ *
+ * This file is distributed under the University of Illinois Open Source
+ * License. See LICENSE.TXT for details.
+ *
+ * \brief     Main source file of the tool that merges the outputs of the
+ * mutation shards (Mart option 'shard') into one output directory.
+ *
+ * The mutants IDs of a shard are local to it: the shards are merged in shard
+ * index order, the mutants of a shard getting IDs after the ones of the
+ * previous shards, and the equivalent/duplicate mutants IDs after all the
+ * mutants. The merge is deterministic: merging the same shards outputs gives
+ * the same output directory.
+ * The merged modules (preprocessed IR, meta module and optimized meta module)
+ * are the first shard's module with the bodies of the functions mutated by
+ * each other shard taken from that shard's module, with the mutants IDs
+ * shifted.
+ */
+
+#include <cerrno>
+#include <cstring>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "llvm/Support/CommandLine.h" //llvm::cl
+
+#define TOOLNAME "Mart-Merge"
+#include "tools_commondefs.h"
+
+#include "MutationOutputsMerge.h"
+
+using namespace mart;
+
+/// Output of a mutation shard
+struct ShardOutput {
+  std::string dir;
+  unsigned index;
+  std::set<std::string> functions;
+  MutantInfoList mutantsInfos;
+  // Shift of the shard's mutants IDs in the merged output
+  MutantIDType idOffset;
+};
+
+/// \brief load the shard description and mutants infos of the shard output
+/// directory 'dir'
+static bool loadShardOutput(std::string const &dir, ShardOutput &shard,
+                            unsigned &numShards) {
+  shard.dir = dir;
+  std::string shardFile(dir + "/" + mutationShardFileName);
+  std::string infosFile(dir + "/" + mutantsInfosBinFileName);
+  if (!fileExists(shardFile) || !fileExists(infosFile)) {
+    llvm::errs() << "Error: " << dir << " is not the output of a mutation "
+                 << "shard with mutants infos (missing "
+                 << mutationShardFileName << " or " << mutantsInfosBinFileName
+                 << ")\n";
+    return false;
+  }
+  JsonBox::Value desc;
+  desc.loadFromFile(shardFile);
+  if (!desc["Shard"].isInteger() || !desc["Shards"].isInteger() ||
+      !desc["Functions"].isArray()) {
+    llvm::errs() << "Error: invalid mutation shard file " << shardFile << "\n";
+    return false;
+  }
+  shard.index = desc["Shard"].getInteger();
+  numShards = desc["Shards"].getInteger();
+  for (auto &val : desc["Functions"].getArray()) {
+    assert(val.isString() && "Function name of the shard must be string");
+    shard.functions.insert(val.getString());
+  }
+  shard.mutantsInfos.loadFromFile(infosFile);
+  return true;
+}
+
+/// \brief merge the shards' modules of file name 'fileName' into 'outFile'
+static bool mergeModules(std::vector<ShardOutput> const &shards,
+                         std::string const &fileName,
+                         std::string const &outFile,
+                         MutantIDType totalMutants) {
+  std::unique_ptr<llvm::Module> merged;
+  if (!ReadWriteIRObj::readIR(shards[0].dir + "/" + fileName, merged))
+    return false;
+  for (unsigned s = 1; s < shards.size(); ++s) {
+    std::unique_ptr<llvm::Module> shardM;
+    if (!ReadWriteIRObj::readIR(shards[s].dir + "/" + fileName, shardM))
+      return false;
+    shiftMutantIDs(*shardM, shards[s].functions, shards[s].idOffset,
+                   shards[s].mutantsInfos.getMutantsNumber());
+    if (!ReadWriteIRObj::linkFunctionsBodies(*merged, std::move(shardM),
+                                             shards[s].functions)) {
+      llvm::errs() << "Error: failed to merge " << fileName << " of shard "
+                   << shards[s].index << "\n";
+      return false;
+    }
+  }
+  setMutantIDSelectorInitialValue(*merged, totalMutants);
+  return ReadWriteIRObj::writeIR(merged.get(), outFile);
+}
+
+/// \brief name of the mutated IR files (without suffix) in the shard output
+/// directory 'dir'
+static bool getOutputIRName(std::string const &dir, std::string &irName) {
+  std::vector<std::string> files;
+  if (!listDirectory(dir, files))
+    return false;
+  std::string suffix(metaMuIRFileSuffix), preTCESuffix(preTCEMetaIRFileSuffix);
+  for (auto &file : files) {
+    if (file.size() > suffix.size() &&
+        file.compare(file.size() - suffix.size(), suffix.size(), suffix) ==
+            0 &&
+        !(file.size() > preTCESuffix.size() &&
+          file.compare(file.size() - preTCESuffix.size(), preTCESuffix.size(),
+                       preTCESuffix) == 0)) {
+      irName = file.substr(0, file.size() - suffix.size());
+      return true;
+    }
+  }
+  llvm::errs() << "Error: no meta module (" << suffix << ") in " << dir
+               << "\n";
+  return false;
+}
+
+int main(int argc, char **argv) {
+  llvm::cl::list<std::string> shardDirs(
+      llvm::cl::Positional, llvm::cl::OneOrMore,
+      llvm::cl::desc("<output directories of all the mutation shards>"));
+  llvm::cl::opt<std::string> outputDir(
+      "o", llvm::cl::Required,
+      llvm::cl::desc("Output directory of the merge (must not exist)"),
+      llvm::cl::value_desc("directory"));
+
+  llvm::cl::SetVersionPrinter(printVersion);
+
+  llvm::cl::ParseCommandLineOptions(
+      argc, argv, "Mart Merge: merge the outputs of the mutation shards");
+
+  // Load the shards, ordered by shard index
+  std::vector<ShardOutput> shards(shardDirs.size());
+  std::vector<bool> seen(shardDirs.size(), false);
+  for (auto &dir : shardDirs) {
+    ShardOutput shard;
+    unsigned numShards;
+    if (!loadShardOutput(dir, shard, numShards))
+      return 1;
+    if (numShards != shardDirs.size() || shard.index >= numShards ||
+        seen[shard.index]) {
+      llvm::errs() << "Error: the outputs of the " << shardDirs.size()
+                   << " shards are expected, each once (" << dir
+                   << " is shard " << shard.index << " of " << numShards
+                   << ")\n";
+      return 1;
+    }
+    seen[shard.index] = true;
+    shards[shard.index] = std::move(shard);
+  }
+
+  // Mutants IDs: the shards' mutants in shard order, then the shards'
+  // equivalent/duplicate mutants
+  MutantIDType totalMutants = 0;
+  for (auto &shard : shards) {
+    shard.idOffset = totalMutants;
+    totalMutants += shard.mutantsInfos.getMutantsNumber();
+  }
+  MutantInfoList mergedInfos;
+  MutantIDType firstEqDupID = totalMutants + 1;
+  for (auto &shard : shards) {
+    mergedInfos.appendShard(shard.mutantsInfos, shard.idOffset, firstEqDupID);
+    firstEqDupID += shard.mutantsInfos.getEquivalentDuplicateMutantsNumber();
+  }
+
+  std::string irName;
+  if (!getOutputIRName(shards[0].dir, irName))
+    return 1;
+  if (mkdir(outputDir.c_str(), 0777) != 0) {
+    llvm::errs() << "Error: failed to create the output directory "
+                 << outputDir << ": " << std::strerror(errno) << "\n";
+    return 1;
+  }
+
+  mergedInfos.printToJsonFile(
+      outputDir + "/" + mutantsInfosFileName,
+      outputDir + "/" + equivalentduplicate_mutantsInfosFileName);
+  mergedInfos.printToBinaryFile(outputDir + "/" + mutantsInfosBinFileName);
+
+  // Modules (present in the output of every shard)
+  for (std::string suffix : {commonIRSuffix, metaMuIRFileSuffix,
+                             optimizedMetaMuIRFileSuffix}) {
+    std::string fileName(irName + suffix);
+    bool inAll = true;
+    for (auto &shard : shards)
+      inAll = inAll && fileExists(shard.dir + "/" + fileName);
+    if (!inAll)
+      continue;
+    llvm::outs() << "Mart-Merge@Progress: merging " << fileName << "...\n";
+    if (!mergeModules(shards, fileName, outputDir + "/" + fileName,
+                      totalMutants))
+      return 1;
+  }
+
+  bool withMutantsFolders = true;
+  for (auto &shard : shards)
+    withMutantsFolders = withMutantsFolders &&
+                         fileExists(shard.dir + "/" + mutantsFolder);
+  if (withMutantsFolders) {
+    llvm::outs() << "Mart-Merge@Progress: merging " << mutantsFolder
+                 << "...\n";
+    std::vector<std::pair<std::string, MutantIDType>> outputs;
+    for (auto &shard : shards)
+      outputs.emplace_back(shard.dir, shard.idOffset);
+    if (!mergeMutantsFolders(outputs, outputDir))
+      return 1;
+  }
+
+  for (std::string suffix : {wmOutIRFileSuffix, covOutIRFileSuffix})
+    if (fileExists(shards[0].dir + "/" + irName + suffix))
+      llvm::errs() << "Warning: the shards' " << irName << suffix
+                   << " modules are not merged (run the shards with -no-WM "
+                      "-no-COV).\n";
+  if (fileExists(shards[0].dir + "/" + mutantsPackFileName))
+    llvm::errs() << "Warning: the shards' mutants packs are not merged.\n";
+  if (fileExists(shards[0].dir + "/" + irName + hotPatchHostIRFileSuffix))
+    llvm::errs() << "Warning: the shards' hot-patch mutants lists are not "
+                    "merged.\n";
+
+  llvm::outs() << "Mart-Merge@Progress: merged " << shards.size()
+               << " shards (" << totalMutants << " mutants) into "
+               << outputDir << ".\n";
+  return 0;
+}
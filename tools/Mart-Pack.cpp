@@ -0,0 +1,203 @@
+/**
+ * -==== Mart-Pack.cpp
+ *
+ *                Mart Multi-Language LLVM Mutation Framework
+ *
+ * This file is distributed under the University of Illinois Open Source
+ * License. See LICENSE.TXT for details.
+ *
+ * \brief     Main source file of the tool that lists and extracts the mutants
+ * written by Mart into a mutants pack (option 'pack-mutants').
+ */
+
+#include <fstream>
+#include <string>
+#include <sys/stat.h>  //mkdir, stat
+#include <sys/types.h> //mkdir, stat
+
+#include "MutantsPack.h"
+#include "ReadWriteIRObj.h"
+
+#include "llvm/Support/CommandLine.h" //llvm::cl
+
+using namespace mart;
+
+#define TOOLNAME "Mart-Pack"
+#include "tools_commondefs.h"
+
+static bool makeDir(std::string const &path) {
+  struct stat st;
+  if (stat(path.c_str(), &st) != -1) // already exists
+    return true;
+  if (mkdir(path.c_str(), 0777) != 0) {
+    llvm::errs() << "Failed to create directory " << path << "\n";
+    return false;
+  }
+  return true;
+}
+
+/// original (mutant 0) module's bitcode, loaded when needed to expand deltas
+static std::string originalModuleData;
+
+/// \brief write into 'filename' the module of the mutant 'entry'. A delta
+/// mutant is rebuilt as complete module from the original module.
+static bool extractMutantModule(MutantsPack const &pack,
+                                MutantsPack::MutantEntry const &entry,
+                                std::string const &filename) {
+  if (!entry.isDelta)
+    return pack.extractBlob(entry.blobID, filename);
+
+  if (originalModuleData.empty() &&
+      !pack.readBlob(pack.getMutants().at(0).blobID, originalModuleData))
+    return false;
+  std::string deltaData;
+  if (!pack.readBlob(entry.blobID, deltaData))
+    return false;
+  // Each mutant is rebuilt in its own context, released after writing it
+  llvm::LLVMContext context;
+  std::unique_ptr<llvm::Module> mutModule;
+  if (!ReadWriteIRObj::readIRWithDelta(originalModuleData, deltaData,
+                                       mutModule, context))
+    return false;
+  return ReadWriteIRObj::writeIR(mutModule.get(), filename);
+}
+
+/// \brief Write the mutant 'mid' module (and its function module if any)
+/// into 'outDir'
+static bool extractMutant(MutantsPack const &pack, unsigned mid,
+                          std::string const &outDir) {
+  auto &mutants = pack.getMutants();
+  auto it = mutants.find(mid);
+  if (it == mutants.end()) {
+    llvm::errs() << "Mutant " << mid << " is not in the pack\n";
+    return false;
+  }
+  if (!makeDir(outDir))
+    return false;
+  if (!extractMutantModule(pack, it->second,
+                           outDir + "/" + pack.getModuleFileName()))
+    return false;
+  if (!it->second.funcModuleName.empty()) {
+    std::string const &fname = it->second.funcModuleName;
+    if (!pack.extractBlob(pack.getFunctionModules().at(fname),
+                          outDir + "/" + fname + commonIRSuffix))
+      return false;
+  }
+  return true;
+}
+
+/// \brief recreate, in 'outDir', the mutants folder and the temporary
+/// function modules folder as Mart writes them without pack, so that
+/// CompileAllMuts.sh can be used on them.
+static bool unpackAll(MutantsPack const &pack, std::string const &outDir) {
+  std::string mutantsDir = outDir + "/" + mutantsFolder;
+  std::string tmpFunctionDir = outDir + "/" + tmpFuncModuleFolder;
+  if (!makeDir(outDir) || !makeDir(mutantsDir))
+    return false;
+
+  if (!pack.getFunctionModules().empty()) {
+    if (!makeDir(tmpFunctionDir))
+      return false;
+    for (auto &fm : pack.getFunctionModules())
+      if (!pack.extractBlob(fm.second, tmpFunctionDir + "/" + fm.first +
+                                           commonIRSuffix))
+        return false;
+  }
+
+  std::string mapinfo;
+  for (auto &m : pack.getMutants()) {
+    std::string relPath = mutantsFolder + "/" + std::to_string(m.first) + "/" +
+                          pack.getModuleFileName();
+    if (!makeDir(mutantsDir + "/" + std::to_string(m.first)) ||
+        !extractMutantModule(pack, m.second, outDir + "/" + relPath))
+      return false;
+    mapinfo += relPath;
+    if (!m.second.funcModuleName.empty())
+      mapinfo += " " + tmpFuncModuleFolder + "/" + m.second.funcModuleName +
+                 commonIRSuffix;
+    mapinfo += "\n";
+  }
+
+  if (!pack.getFunctionModules().empty()) {
+    std::ofstream xxx(tmpFunctionDir + "/" + "mapinfo");
+    if (!xxx.is_open()) {
+      llvm::errs() << "Unable to open file for write:" << tmpFunctionDir
+                   << "/mapinfo\n";
+      return false;
+    }
+    xxx << mapinfo;
+    xxx.close();
+  }
+  return true;
+}
+
+int main(int argc, char **argv) {
+  llvm::cl::opt<std::string> martOutTopDir(
+      llvm::cl::Positional, llvm::cl::Required,
+      llvm::cl::desc("<output topdir of mart, containing the mutants pack>"));
+  llvm::cl::opt<bool> listMutants(
+      "list", llvm::cl::desc("List the mutants in the pack, with their blob "
+                             "IDs and function modules"));
+  llvm::cl::list<unsigned> extractMutantIDs(
+      "extract", llvm::cl::desc("Extract the mutant with the given ID "
+                                "(can be repeated)"),
+      llvm::cl::value_desc("mutant ID"));
+  llvm::cl::opt<bool> unpackMutants(
+      "unpack", llvm::cl::desc("Extract all the mutants, recreating the "
+                               "mutants folder layout"));
+  llvm::cl::opt<std::string> extractDir(
+      "o",
+      llvm::cl::desc("(Optional) Output directory of the extraction. Defaults "
+                     "to the topdir for 'unpack' and to "
+                     "<topdir>/<mutants folder>/<ID> for 'extract'"),
+      llvm::cl::value_desc("directory"), llvm::cl::init(""));
+
+  llvm::cl::SetVersionPrinter(printVersion);
+
+  llvm::cl::ParseCommandLineOptions(argc, argv, "Mart Mutants Pack");
+
+  assert(llvm::sys::fs::is_directory(martOutTopDir) &&
+         "Error: the topdir given do not exist!");
+
+  MutantsPack pack;
+  if (!pack.load(martOutTopDir + "/" + mutantsPackFileName,
+                 martOutTopDir + "/" + mutantsPackIndexFileName))
+    return 1;
+
+  if (listMutants) {
+    llvm::outs() << "# " << pack.getMutants().size() << " mutants, "
+                 << pack.getNumBlobs() << " blobs\n";
+    for (auto &m : pack.getMutants()) {
+      llvm::outs() << m.first << " " << m.second.blobID;
+      if (m.second.isDelta)
+        llvm::outs() << " (delta)";
+      else if (!m.second.funcModuleName.empty())
+        llvm::outs() << " " << m.second.funcModuleName;
+      llvm::outs() << "\n";
+    }
+  }
+
+  if (!extractMutantIDs.empty()) {
+    std::string baseDir = extractDir.empty()
+                              ? martOutTopDir + "/" + mutantsFolder
+                              : extractDir.getValue();
+    if (!makeDir(baseDir))
+      return 1;
+    for (unsigned mid : extractMutantIDs) {
+      std::string outDir = baseDir;
+      if (extractDir.empty() || extractMutantIDs.size() > 1)
+        outDir += "/" + std::to_string(mid);
+      if (!extractMutant(pack, mid, outDir))
+        return 1;
+    }
+  }
+
+  if (unpackMutants) {
+    if (!unpackAll(pack, extractDir.empty() ? martOutTopDir : extractDir))
+      return 1;
+    llvm::outs() << "@Mart-Pack: unpacked " << pack.getMutants().size()
+                 << " mutants.\n";
+  }
+
+  return 0;
+}
@@ -0,0 +1,274 @@
+/**
+ * -==== Mart-Prioritize.cpp
+ *
+ *                Mart Multi-Language LLVM Mutation Framework
+ *
+ * This file is distributed under the University of Illinois Open Source
+ * License. See LICENSE.TXT for details.
+ *
+ * \brief     Main source file of the tool that orders the tests to execute on
+ * each mutant of a mutation output (strong mutation), using the tests that
+ * killed the same and the sibling mutants in the previous runs, and that
+ * records the kills of a run into the persistent prioritization index.
+ *
+ * The mutants are identified across runs by the MD5 of the text of their
+ * function (without debug information) in the preprocessed IR, their type
+ * and their IR position, so the previous revisions' kills are used for the
+ * unchanged functions. The prioritized tests are written with one line per
+ * mutant: '<mutant ID> <statement ID> <tests...>', where the mutants of the
+ * same statement (source location) have the same statement ID. The tests can
+ * be executed with 'useful/prioritized_mutants_runner.py'.
+ */
+
+#include <algorithm>
+#include <fstream>
+#include <map>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "KillMatrix.h"
+#include "ReadWriteIRObj.h"
+#include "TestPrioritization.h"
+#include "typesops.h" //MutantInfoList
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/CommandLine.h" //llvm::cl
+#include "llvm/Support/MD5.h"
+
+using namespace mart;
+
+#define TOOLNAME "Mart-Prioritize"
+#include "tools_commondefs.h"
+
+/// \brief compute into 'funcHashes' the hash of each function of 'funcNames'
+/// in the module 'module' (its debug information is stripped)
+static bool
+computeFunctionHashes(llvm::Module &module,
+                      std::set<std::string> const &funcNames,
+                      std::map<std::string, std::string> &funcHashes) {
+  llvm::StripDebugInfo(module);
+  for (auto &funcName : funcNames) {
+    llvm::Function *func = module.getFunction(funcName);
+    if (func == nullptr || func->isDeclaration()) {
+      llvm::errs() << "Error: mutated function " << funcName
+                   << " not found in the preprocessed IR\n";
+      return false;
+    }
+    std::string text;
+    llvm::raw_string_ostream os(text);
+    func->print(os);
+    os.flush();
+    llvm::MD5 hasher;
+    hasher.update(text);
+    llvm::MD5::MD5Result res;
+    hasher.final(res);
+    llvm::SmallString<32> hexStr;
+    llvm::MD5::stringifyResult(res, hexStr);
+    funcHashes[funcName] = hexStr.str().str();
+  }
+  return true;
+}
+
+/// \brief read the tests list 'filename' ('<test name> [<runtime>]' per
+/// line, the test names without whitespace) into 'tests', and the runtimes
+/// into the index
+static bool readTests(std::string const &filename,
+                      TestPrioritizationIndex &index,
+                      std::vector<std::string> &tests) {
+  std::ifstream in(filename);
+  if (!in.is_open()) {
+    llvm::errs() << "Unable to open tests list file: " << filename << "\n";
+    return false;
+  }
+  std::string line, name;
+  while (std::getline(in, line)) {
+    std::istringstream ss(line);
+    if (!(ss >> name))
+      continue;
+    tests.push_back(name);
+    double runtime;
+    std::string extra;
+    if (ss >> runtime) {
+      if (!index.setTestRuntime(name, runtime))
+        return false;
+    } else {
+      ss.clear();
+    }
+    if (ss >> extra) {
+      llvm::errs() << "Invalid tests list line in " << filename
+                   << " (the test names must not contain whitespace): "
+                   << line << "\n";
+      return false;
+    }
+  }
+  return true;
+}
+
+int main(int argc, char **argv) {
+  llvm::cl::opt<std::string> martOutTopDir(
+      llvm::cl::Positional, llvm::cl::Required,
+      llvm::cl::desc("<output topdir of mart>"));
+  llvm::cl::opt<std::string> indexFile(
+      "index", llvm::cl::Required,
+      llvm::cl::desc("Test prioritization index file (created if absent)"),
+      llvm::cl::value_desc("filename"));
+  llvm::cl::opt<std::string> recordFile(
+      "record",
+      llvm::cl::desc("(Optional) Record into the index the kills of this "
+                     "run: kill matrix (text or store, see mart-killmatrix)"),
+      llvm::cl::value_desc("filename"), llvm::cl::init(""));
+  llvm::cl::opt<std::string> testsFile(
+      "tests",
+      llvm::cl::desc("(Optional) Tests to prioritize, one per line with "
+                     "optionally its runtime: '<test name> [<seconds>]' (the "
+                     "test names without whitespace)"),
+      llvm::cl::value_desc("filename"), llvm::cl::init(""));
+  llvm::cl::opt<std::string> coverageFile(
+      "coverage",
+      llvm::cl::desc("(Optional) Mutants covered by each test, in kill matrix "
+                     "format. Only the covering tests are prioritized for a "
+                     "mutant"),
+      llvm::cl::value_desc("filename"), llvm::cl::init(""));
+  llvm::cl::opt<std::string> outputFile(
+      "o",
+      llvm::cl::desc("(Optional) Write the prioritized tests of each mutant "
+                     "(requires 'tests')"),
+      llvm::cl::value_desc("filename"), llvm::cl::init(""));
+
+  llvm::cl::SetVersionPrinter(printVersion);
+
+  llvm::cl::ParseCommandLineOptions(argc, argv, "Mart Test Prioritization");
+
+  assert(llvm::sys::fs::is_directory(martOutTopDir) &&
+         "Error: the topdir given do not exist!");
+  if (!outputFile.empty() && testsFile.empty()) {
+    llvm::errs() << "Error: the prioritization ('o') needs the 'tests'\n";
+    return 1;
+  }
+
+  MutantInfoList mutantsInfos;
+  mutantsInfos.loadFromFile(getTopdirMutantInfoFile(martOutTopDir));
+  MutantIDType numMutants = mutantsInfos.getMutantsNumber();
+
+  std::set<std::string> funcNames;
+  for (MutantIDType mid = 1; mid <= numMutants; ++mid)
+    funcNames.insert(mutantsInfos.getMutantFunction(mid));
+  std::map<std::string, std::string> funcHashes;
+  std::unique_ptr<llvm::Module> module;
+  if (!ReadWriteIRObj::readIR(getTopdirPreprocessedIRFile(martOutTopDir),
+                              module) ||
+      !computeFunctionHashes(*module, funcNames, funcHashes))
+    return 1;
+  module.reset(nullptr);
+
+  std::vector<TestPrioritizationIndex::MutantKey> keys(numMutants + 1);
+  for (MutantIDType mid = 1; mid <= numMutants; ++mid)
+    keys[mid] = TestPrioritizationIndex::MutantKey(
+        funcHashes.at(mutantsInfos.getMutantFunction(mid)),
+        mutantsInfos.getMutantTypeName(mid),
+        mutantsInfos.getMutantIrPosInFunction(mid));
+
+  TestPrioritizationIndex index;
+  if (!index.load(indexFile))
+    return 1;
+
+  std::vector<std::string> tests;
+  if (!testsFile.empty() && !readTests(testsFile, index, tests))
+    return 1;
+
+  if (!recordFile.empty()) {
+    KillMatrix kills;
+    if (KillMatrix::isStoreFile(recordFile) ? !kills.loadFromStore(recordFile)
+                                            : !kills.loadFromText(recordFile))
+      return 1;
+    if (kills.getNumMutants() > numMutants) {
+      llvm::errs() << "Error: the kill matrix " << recordFile
+                   << " has more mutants than the mutants infos\n";
+      return 1;
+    }
+    MutantIDType numKilled = 0;
+    for (MutantIDType mid = 1; mid <= kills.getNumMutants(); ++mid) {
+      std::vector<std::string> killers;
+      kills.getKillingTests(mid).forEach([&](uint32_t t) {
+        killers.push_back(kills.getTestNames()[t]);
+      });
+      if (killers.empty())
+        continue;
+      // Fastest killers first
+      std::stable_sort(killers.begin(), killers.end(),
+                       [&index](std::string const &a, std::string const &b) {
+                         return index.getTestRuntime(a) <
+                                index.getTestRuntime(b);
+                       });
+      if (!index.recordKillers(keys[mid], killers))
+        return 1;
+      ++numKilled;
+    }
+    llvm::outs() << "Mart-Prioritize@Progress: recorded the kills of "
+                 << numKilled << " mutants.\n";
+  }
+
+  if (!index.save(indexFile))
+    return 1;
+
+  if (!outputFile.empty()) {
+    KillMatrix coverage;
+    if (!coverageFile.empty() &&
+        !(KillMatrix::isStoreFile(coverageFile)
+              ? coverage.loadFromStore(coverageFile)
+              : coverage.loadFromText(coverageFile)))
+      return 1;
+    std::vector<int> coverageIndex(tests.size(), -1);
+    for (unsigned t = 0; t < tests.size(); ++t)
+      coverageIndex[t] = coverage.getTestIndex(tests[t]);
+
+    // Statements: the mutants of the same function and source location
+    std::map<std::pair<std::string, std::string>, unsigned> stmtIDs;
+    std::vector<unsigned> stmtOf(numMutants + 1, 0);
+    std::vector<std::vector<MutantIDType>> stmtMutants;
+    for (MutantIDType mid = 1; mid <= numMutants; ++mid) {
+      std::string loc = mutantsInfos.getMutantSourceLoc(mid);
+      if (loc.empty() && !keys[mid].irPos.empty())
+        loc = "IR:" + std::to_string(keys[mid].irPos.front());
+      auto ins = stmtIDs.insert(std::make_pair(
+          std::make_pair(mutantsInfos.getMutantFunction(mid), loc),
+          stmtMutants.size()));
+      if (ins.second)
+        stmtMutants.emplace_back();
+      stmtOf[mid] = ins.first->second;
+      stmtMutants[ins.first->second].push_back(mid);
+    }
+
+    std::ofstream out(outputFile);
+    if (!out.is_open()) {
+      llvm::errs() << "Unable to open file for write: " << outputFile << "\n";
+      return 1;
+    }
+    std::vector<std::string> candidates, ordered;
+    std::vector<TestPrioritizationIndex::MutantKey const *> siblings;
+    for (MutantIDType mid = 1; mid <= numMutants; ++mid) {
+      candidates.clear();
+      for (unsigned t = 0; t < tests.size(); ++t) {
+        if (coverageFile.empty() ||
+            (coverageIndex[t] >= 0 && mid <= coverage.getNumMutants() &&
+             coverage.getKilledMutants(coverageIndex[t]).contains(mid)))
+          candidates.push_back(tests[t]);
+      }
+      siblings.clear();
+      for (MutantIDType sib : stmtMutants[stmtOf[mid]])
+        if (sib != mid)
+          siblings.push_back(&keys[sib]);
+      index.prioritize(keys[mid], siblings, candidates, ordered);
+      out << mid << " " << stmtOf[mid];
+      for (auto &test : ordered)
+        out << " " << test;
+      out << "\n";
+    }
+    out.close();
+    llvm::outs() << "Mart-Prioritize@Progress: prioritized the tests of "
+                 << numMutants << " mutants into " << outputFile << ".\n";
+  }
+  return 0;
+}
@@ -0,0 +1,518 @@
+/**
+ * -==== Mart-Project.cpp
+ *
+ *                Mart Multi-Language LLVM Mutation Framework
+ *
+ * This file is distributed under the University of Illinois Open Source
+ * License. See LICENSE.TXT for details.
+ *
+ * \brief     Main source file of the tool that mutates a project made of
+ * several programs (binaries) that share translation units (TUs), given as a
+ * manifest of the bitcode modules of each binary:
+ *    {"Binaries": {"<binary>": ["<module.bc>", ...], ...},
+ *     "Functions": ["<function>", ...]}
+ * (the modules paths are relative to the manifest; "Functions", optional,
+ * restricts the functions to mutate).
+ *
+ * Each function of a TU is mutated once, by Mart on the first binary (in name
+ * order) that has it (its owner), and the project has a single mutants IDs
+ * space: the mutants of the first binary, then the ones of the second, ...,
+ * then the equivalent/duplicate mutants. Each binary gets its meta modules,
+ * with the mutants of all its functions (the ones of the functions owned by
+ * other binaries taken from those binaries' meta modules) and the list of its
+ * mutants (binaryMutants.json).
+ *
+ * The local names of the TUs that clash with names of other TUs are suffixed
+ * with '.tu<TU index>' (and the unnamed globals named), so that the functions
+ * of a TU are the same in all the binaries.
+ */
+
+#include <cerrno>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <set>
+#include <string>
+#include <sys/wait.h> //waitpid
+#include <unistd.h>   //fork, execv, chdir
+#include <vector>
+
+#include "llvm/Support/CommandLine.h" //llvm::cl
+
+#define TOOLNAME "Mart-Project"
+#include "tools_commondefs.h"
+
+#include "MutationOutputsMerge.h"
+
+using namespace mart;
+
+static const char *martExecutableName = "mart";
+static const char *metamutantSelectorFileName = "metamutant_selector.bc";
+static const char *projectScopeFileName = "projectScope.json";
+static const char *binaryMutantsFileName = "binaryMutants.json";
+static const std::string projectWorkFolder("work");
+
+/// A translation unit (input bitcode module) of the project
+struct ProjectTU {
+  std::string file;
+  std::unique_ptr<llvm::Module> module;
+  // Names of the global values (after renaming)
+  std::set<std::string> names;
+};
+
+/// A binary of the project and its mutation
+struct ProjectBinary {
+  std::string name;
+  // indexes of its TUs, in link order
+  std::vector<unsigned> tus;
+  // functions, of this binary, mutated by each binary (owner)
+  std::map<unsigned, std::set<std::string>> funcsByOwner;
+  std::string workDir;
+  // Mart's output directory, empty when the binary owns no function
+  std::string martOutDir;
+  MutantInfoList mutantsInfos;
+  MutantIDType idOffset = 0;
+};
+
+/// \brief link 'srcM' into 'module'
+static bool linkModules(llvm::Module &module,
+                        std::unique_ptr<llvm::Module> srcM) {
+#if (LLVM_VERSION_MAJOR <= 3) && (LLVM_VERSION_MINOR < 8)
+  llvm::Linker linker(&module);
+  std::string ErrorMsg;
+  if (linker.linkInModule(srcM.get(), &ErrorMsg)) {
+    llvm::errs() << "Error: linking failed: " << ErrorMsg << "\n";
+    return false;
+  }
+#else
+  llvm::Linker linker(module);
+  if (linker.linkInModule(std::move(srcM))) {
+    llvm::errs() << "Error: linking failed\n";
+    return false;
+  }
+#endif
+  return true;
+}
+
+/// \brief rename the local globals of the TUs whose names are also used by
+/// other TUs (the linker would rename them differently in each binary), and
+/// name the unnamed ones
+static void makeTUsNamesUnique(std::vector<ProjectTU> &tus) {
+  std::map<std::string, unsigned> nameUses;
+  auto forEachGlobal = [](llvm::Module &M,
+                          std::function<void(llvm::GlobalValue &)> fn) {
+    for (auto &F : M)
+      fn(F);
+    for (auto gIt = M.global_begin(), gE = M.global_end(); gIt != gE; ++gIt)
+      fn(*gIt);
+  };
+  for (auto &tu : tus)
+    forEachGlobal(*tu.module, [&](llvm::GlobalValue &GV) {
+      if (GV.hasName())
+        ++nameUses[GV.getName().str()];
+    });
+  for (unsigned t = 0; t < tus.size(); ++t) {
+    std::string suffix(".tu" + std::to_string(t));
+    unsigned unnamedIndex = 0;
+    forEachGlobal(*tus[t].module, [&](llvm::GlobalValue &GV) {
+      if (!GV.hasName())
+        GV.setName("mart.unnamed" + std::to_string(unnamedIndex++) + suffix);
+      else if (GV.hasLocalLinkage() && nameUses[GV.getName().str()] > 1)
+        GV.setName(GV.getName().str() + suffix);
+      tus[t].names.insert(GV.getName().str());
+    });
+  }
+}
+
+/// \brief TU, among the binary's TUs, whose definition of the function
+/// 'name' the linker keeps (the first strong definition, else the first one)
+static unsigned getDefiningTU(std::vector<ProjectTU> const &tus,
+                              std::vector<unsigned> const &binaryTUs,
+                              std::string const &name) {
+  unsigned firstDef = binaryTUs.size();
+  for (unsigned i = 0; i < binaryTUs.size(); ++i) {
+    llvm::Function *F = tus[binaryTUs[i]].module->getFunction(name);
+    if (!F || F->isDeclaration())
+      continue;
+    if (!F->isWeakForLinker())
+      return binaryTUs[i];
+    if (firstDef == binaryTUs.size())
+      firstDef = i;
+  }
+  assert(firstDef < binaryTUs.size() && "function defined by no TU");
+  return binaryTUs[firstDef];
+}
+
+/// \brief run Mart, with the arguments 'martArgs', on 'inputIR' in 'workDir'
+static bool runMart(std::string const &martPath, std::string const &workDir,
+                    std::vector<std::string> const &martArgs,
+                    std::string const &inputIR) {
+  std::vector<std::string> args(1, martPath);
+  args.insert(args.end(), martArgs.begin(), martArgs.end());
+  args.push_back(inputIR);
+  std::vector<char *> argv;
+  for (auto &arg : args)
+    argv.push_back(const_cast<char *>(arg.c_str()));
+  argv.push_back(nullptr);
+
+  llvm::outs().flush();
+  llvm::errs().flush();
+  pid_t pid = fork();
+  if (pid < 0) {
+    perror("fork failure");
+    return false;
+  }
+  if (pid == 0) {
+    if (chdir(workDir.c_str()) == 0)
+      execv(martPath.c_str(), argv.data());
+    perror("Error: failed to run mart");
+    _exit(127);
+  }
+  int status;
+  while (waitpid(pid, &status, 0) < 0 && errno == EINTR)
+    ;
+  if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+    llvm::errs() << "Error: mutation of " << inputIR << " failed\n";
+    return false;
+  }
+  return true;
+}
+
+/// \brief prepare the module 'srcM' of another binary, to link the functions
+/// 'funcNames' into the module 'module' (see linkFunctionsBodies): the globals
+/// that Mart added to 'srcM' get names distinct from 'module's, and the
+/// definitions of the TUs that 'module' does not have are dropped
+static void prepareSharedFunctionsModule(llvm::Module &srcM,
+                                         llvm::Module const &module,
+                                         std::set<std::string> const &funcNames,
+                                         std::set<std::string> const &tuNames,
+                                         std::string const &srcTag) {
+  std::vector<llvm::GlobalValue *> dropped;
+  unsigned unnamedIndex = 0;
+  auto prepare = [&](llvm::GlobalValue &GV) {
+    if (!GV.hasName() ||
+        (GV.hasLocalLinkage() && !tuNames.count(GV.getName().str()))) {
+      GV.setName(GV.hasName() ? GV.getName().str() + srcTag
+                              : "mart.unnamed" + std::to_string(unnamedIndex++) +
+                                    srcTag);
+    } else if (!GV.isDeclaration() && tuNames.count(GV.getName().str()) &&
+               !funcNames.count(GV.getName().str()) &&
+               !module.getNamedValue(GV.getName())) {
+      dropped.push_back(&GV);
+    }
+  };
+  for (auto &F : srcM)
+    prepare(F);
+  for (auto gIt = srcM.global_begin(), gE = srcM.global_end(); gIt != gE;
+       ++gIt)
+    prepare(*gIt);
+
+  for (auto *GV : dropped) {
+#if !((LLVM_VERSION_MAJOR <= 3) && (LLVM_VERSION_MINOR < 5))
+    llvm::cast<llvm::GlobalObject>(GV)->setComdat(nullptr);
+#endif
+    if (auto *F = llvm::dyn_cast<llvm::Function>(GV)) {
+      F->deleteBody();
+    } else {
+      auto *V = llvm::cast<llvm::GlobalVariable>(GV);
+      V->setInitializer(nullptr);
+      V->setLinkage(llvm::GlobalValue::ExternalLinkage);
+    }
+  }
+  for (auto *GV : dropped) {
+    GV->removeDeadConstantUsers();
+    if (GV->use_empty())
+      GV->eraseFromParent();
+  }
+}
+
+int main(int argc, char **argv) {
+  llvm::cl::opt<std::string> manifestFile(
+      llvm::cl::Positional, llvm::cl::Required,
+      llvm::cl::desc("<project manifest (JSON)>"));
+  llvm::cl::list<std::string> martArgs(
+      llvm::cl::ConsumeAfter,
+      llvm::cl::desc("<Mart options, applied to every binary>"));
+  llvm::cl::opt<std::string> outputDir(
+      "o", llvm::cl::Required,
+      llvm::cl::desc("Output directory of the project mutation (must not "
+                     "exist)"),
+      llvm::cl::value_desc("directory"));
+
+  llvm::cl::SetVersionPrinter(printVersion);
+
+  llvm::cl::ParseCommandLineOptions(
+      argc, argv, "Mart Project: mutate a project of several binaries sharing "
+                  "translation units, with a single mutants IDs space");
+
+  std::vector<std::string> martOptions(martArgs.begin(), martArgs.end());
+  bool noWM = false, noCOV = false;
+  for (auto &opt : martOptions) {
+    llvm::StringRef name(opt);
+    name = name.ltrim('-').split('=').first;
+    if (name == "mutant-scope" || name == "shard" ||
+        name == "no-mutant-info" || name == "scoped-loading") {
+      llvm::errs() << "Error: the Mart option '" << name
+                   << "' cannot be used with a project (restrict the "
+                      "functions to mutate in the manifest).\n";
+      return 1;
+    }
+    noWM = noWM || name == "no-WM";
+    noCOV = noCOV || name == "no-COV";
+  }
+  if (!noWM)
+    martOptions.push_back("-no-WM");
+  if (!noCOV)
+    martOptions.push_back("-no-COV");
+
+  std::string usefulDir = getUsefulAbsPath(argv[0]);
+  std::string martPath(usefulDir + "/../" + martExecutableName);
+
+  //@ Load the manifest and the TUs (each once)
+  JsonBox::Value manifest;
+  manifest.loadFromFile(manifestFile);
+  if (!manifest["Binaries"].isObject() ||
+      manifest["Binaries"].getObject().empty() ||
+      !(manifest["Functions"].isNull() || manifest["Functions"].isArray())) {
+    llvm::errs() << "Error: invalid project manifest " << manifestFile
+                 << "\n";
+    return 1;
+  }
+  std::string manifestDir;
+  auto slash = manifestFile.find_last_of('/');
+  if (slash != std::string::npos)
+    manifestDir = manifestFile.substr(0, slash + 1);
+  std::set<std::string> restrictFuncs;
+  if (manifest["Functions"].isArray())
+    for (auto &val : manifest["Functions"].getArray())
+      restrictFuncs.insert(val.getString());
+
+  std::vector<ProjectTU> tus;
+  std::map<std::string, unsigned> tuIndexes;
+  std::vector<ProjectBinary> binaries;
+  // (JsonBox objects are ordered by name)
+  for (auto &bin : manifest["Binaries"].getObject()) {
+    if (!bin.second.isArray() || bin.second.getArray().empty() ||
+        bin.first.empty() || bin.first.find('/') != std::string::npos) {
+      llvm::errs() << "Error: invalid binary '" << bin.first
+                   << "' in the manifest\n";
+      return 1;
+    }
+    binaries.emplace_back();
+    binaries.back().name = bin.first;
+    for (auto &val : bin.second.getArray()) {
+      std::string file(val.getString());
+      if (file.empty() || file[0] != '/')
+        file = manifestDir + file;
+      auto ins = tuIndexes.emplace(file, tus.size());
+      if (ins.second) {
+        tus.emplace_back();
+        tus.back().file = file;
+        if (!ReadWriteIRObj::readIR(file, tus.back().module))
+          return 1;
+      }
+      binaries.back().tus.push_back(ins.first->second);
+    }
+  }
+  makeTUsNamesUnique(tus);
+  std::set<std::string> tuNames;
+  for (auto &tu : tus)
+    tuNames.insert(tu.names.begin(), tu.names.end());
+
+  if (mkdir(outputDir.c_str(), 0777) != 0 ||
+      mkdir((outputDir + "/" + projectWorkFolder).c_str(), 0777) != 0) {
+    llvm::errs() << "Error: failed to create the output directory "
+                 << outputDir << ": " << std::strerror(errno) << "\n";
+    return 1;
+  }
+
+  //@ Functions ownership: a function of a TU is mutated by the first binary
+  // that has it
+  std::map<std::pair<unsigned, std::string>, unsigned> funcOwner;
+  for (unsigned b = 0; b < binaries.size(); ++b) {
+    auto &binary = binaries[b];
+    std::unique_ptr<llvm::Module> linked(
+        ReadWriteIRObj::cloneModuleAndRelease(tus[binary.tus[0]].module.get()));
+    for (unsigned i = 1; i < binary.tus.size(); ++i) {
+      std::unique_ptr<llvm::Module> tuM(ReadWriteIRObj::cloneModuleAndRelease(
+          tus[binary.tus[i]].module.get()));
+      if (!linkModules(*linked, std::move(tuM))) {
+        llvm::errs() << "Error: failed to link the modules of binary "
+                     << binary.name << "\n";
+        return 1;
+      }
+    }
+    for (auto &F : *linked) {
+      if (F.isDeclaration())
+        continue;
+      std::string name(F.getName().str());
+      unsigned tu = getDefiningTU(tus, binary.tus, name);
+      auto owner = funcOwner.emplace(std::make_pair(tu, name), b).first;
+      if (restrictFuncs.empty() || restrictFuncs.count(name))
+        binary.funcsByOwner[owner->second].insert(name);
+    }
+
+    binary.workDir = outputDir + "/" + projectWorkFolder + "/" + binary.name;
+    if (mkdir(binary.workDir.c_str(), 0777) != 0 ||
+        !ReadWriteIRObj::writeIR(linked.get(), binary.workDir + "/" +
+                                                   binary.name +
+                                                   commonIRSuffix)) {
+      llvm::errs() << "Error: failed to write the module of binary "
+                   << binary.name << "\n";
+      return 1;
+    }
+  }
+
+  //@ Mutate, in each binary, the functions it owns
+  for (unsigned b = 0; b < binaries.size(); ++b) {
+    auto &binary = binaries[b];
+    if (binary.funcsByOwner[b].empty())
+      continue;
+    JsonBox::Array funcs;
+    for (auto &name : binary.funcsByOwner[b])
+      funcs.push_back(JsonBox::Value(name));
+    JsonBox::Object scope;
+    scope["Functions"] = funcs;
+    JsonBox::Value(scope).writeToFile(binary.workDir + "/" +
+                                          projectScopeFileName,
+                                      true, false);
+    std::vector<std::string> args(martOptions);
+    args.push_back("-mutant-scope");
+    args.push_back(projectScopeFileName);
+    llvm::outs() << "Mart-Project@Progress: mutating binary " << binary.name
+                 << " (" << funcs.size() << " functions)...\n";
+    if (!runMart(martPath, binary.workDir, args, binary.name + commonIRSuffix))
+      return 1;
+    binary.martOutDir = binary.workDir + "/mart-out-0";
+    if (!fileExists(binary.martOutDir + "/" + mutantsInfosBinFileName)) {
+      llvm::errs() << "Error: no mutants infos in " << binary.martOutDir
+                   << "\n";
+      return 1;
+    }
+    binary.mutantsInfos.loadFromFile(binary.martOutDir + "/" +
+                                     mutantsInfosBinFileName);
+  }
+
+  //@ Mutants IDs: the binaries' mutants in binary order, then the
+  // equivalent/duplicate mutants
+  MutantIDType totalMutants = 0;
+  for (auto &binary : binaries) {
+    binary.idOffset = totalMutants;
+    totalMutants += binary.mutantsInfos.getMutantsNumber();
+  }
+  MutantInfoList mergedInfos;
+  MutantIDType firstEqDupID = totalMutants + 1;
+  for (auto &binary : binaries) {
+    mergedInfos.appendShard(binary.mutantsInfos, binary.idOffset,
+                            firstEqDupID);
+    firstEqDupID += binary.mutantsInfos.getEquivalentDuplicateMutantsNumber();
+  }
+  mergedInfos.printToJsonFile(
+      outputDir + "/" + mutantsInfosFileName,
+      outputDir + "/" + equivalentduplicate_mutantsInfosFileName);
+  mergedInfos.printToBinaryFile(outputDir + "/" + mutantsInfosBinFileName);
+
+  //@ Meta modules of each binary
+  for (unsigned b = 0; b < binaries.size(); ++b) {
+    auto &binary = binaries[b];
+    std::string binDir(outputDir + "/" + binary.name);
+    if (mkdir(binDir.c_str(), 0777) != 0) {
+      llvm::errs() << "Error: failed to create " << binDir << "\n";
+      return 1;
+    }
+    for (std::string suffix : {commonIRSuffix, metaMuIRFileSuffix,
+                               optimizedMetaMuIRFileSuffix}) {
+      std::string fileName(binary.name + suffix);
+      bool ownsFuncs = !binary.martOutDir.empty();
+      // Each binary whose mutants are in this one must have the module
+      bool inAll = !ownsFuncs || fileExists(binary.martOutDir + "/" + fileName);
+      for (auto &byOwner : binary.funcsByOwner)
+        if (byOwner.first != b && !binaries[byOwner.first].martOutDir.empty())
+          inAll = inAll && fileExists(binaries[byOwner.first].martOutDir + "/" +
+                                      binaries[byOwner.first].name + suffix);
+      if (!inAll)
+        continue;
+      llvm::outs() << "Mart-Project@Progress: building " << binary.name << "/"
+                   << fileName << "...\n";
+
+      // (the linked module when the binary mutates no function)
+      std::unique_ptr<llvm::Module> merged;
+      if (!ReadWriteIRObj::readIR(
+              ownsFuncs ? binary.martOutDir + "/" + fileName
+                        : binary.workDir + "/" + binary.name + commonIRSuffix,
+              merged))
+        return 1;
+      if (ownsFuncs) {
+        shiftMutantIDs(*merged, binary.funcsByOwner[b], binary.idOffset,
+                       binary.mutantsInfos.getMutantsNumber());
+      } else if (suffix == optimizedMetaMuIRFileSuffix) {
+        // The mutants selector (that Mart links into its optimized meta
+        // module)
+        std::unique_ptr<llvm::Module> selectorM;
+        if (!ReadWriteIRObj::readIR(usefulDir + metamutantSelectorFileName,
+                                    selectorM) ||
+            !linkModules(*merged, std::move(selectorM)))
+          return 1;
+      }
+      for (auto &byOwner : binary.funcsByOwner) {
+        auto &owner = binaries[byOwner.first];
+        if (byOwner.first == b || owner.martOutDir.empty())
+          continue;
+        std::unique_ptr<llvm::Module> ownerM;
+        if (!ReadWriteIRObj::readIR(owner.martOutDir + "/" + owner.name +
+                                        suffix,
+                                    ownerM))
+          return 1;
+        shiftMutantIDs(*ownerM, byOwner.second, owner.idOffset,
+                       owner.mutantsInfos.getMutantsNumber());
+        prepareSharedFunctionsModule(*ownerM, *merged, byOwner.second,
+                                     tuNames, ".mart." + owner.name);
+        if (!ReadWriteIRObj::linkFunctionsBodies(*merged, std::move(ownerM),
+                                                 byOwner.second)) {
+          llvm::errs() << "Error: failed to link the functions of "
+                       << owner.name << " into " << fileName << "\n";
+          return 1;
+        }
+      }
+      setMutantIDSelectorInitialValue(*merged, totalMutants);
+      if (!ReadWriteIRObj::writeIR(merged.get(), binDir + "/" + fileName))
+        return 1;
+    }
+
+    // The mutants of the binary
+    JsonBox::Array binMutants;
+    for (auto &byOwner : binary.funcsByOwner) {
+      auto &owner = binaries[byOwner.first];
+      for (MutantIDType mid = 1; mid <= owner.mutantsInfos.getMutantsNumber();
+           ++mid)
+        if (byOwner.second.count(owner.mutantsInfos.getMutantFunction(mid)))
+          binMutants.push_back(JsonBox::Value(int(mid + owner.idOffset)));
+    }
+    JsonBox::Object binMutantsObj;
+    binMutantsObj["Mutants"] = binMutants;
+    JsonBox::Value(binMutantsObj)
+        .writeToFile(binDir + "/" + binaryMutantsFileName, true, false);
+  }
+
+  //@ Mutants folders (the mutants of a function are compiled with its owner)
+  std::vector<std::pair<std::string, MutantIDType>> outputs;
+  bool withMutantsFolders = true;
+  for (auto &binary : binaries) {
+    if (binary.martOutDir.empty())
+      continue;
+    outputs.emplace_back(binary.martOutDir, binary.idOffset);
+    withMutantsFolders = withMutantsFolders &&
+                         fileExists(binary.martOutDir + "/" + mutantsFolder);
+  }
+  if (withMutantsFolders && !outputs.empty()) {
+    llvm::outs() << "Mart-Project@Progress: merging " << mutantsFolder
+                 << "...\n";
+    if (!mergeMutantsFolders(outputs, outputDir, true))
+      return 1;
+  }
+
+  llvm::outs() << "Mart-Project@Progress: mutated " << binaries.size()
+               << " binaries, " << tus.size() << " translation units ("
+               << totalMutants << " mutants) into " << outputDir << ".\n";
+  return 0;
+}
@@ -12,10 +12,18 @@
 ///
 //===----------------------------------------------------------------------===//
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <ctime>
 #include <fstream>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <sstream>
 #include <string>
+#include <thread>
 #include <sys/stat.h>  //mkdir, stat
 #include <sys/types.h> //mkdir, stat
 //#include <libgen.h> //basename
@@ -88,7 +96,202 @@ void mutantListAsJsON(std::vector<std::vector<T>> const &lists,
   }
 }
 
+/// Stream of the mutants lists of the repetitions of a selection into a JSON
+/// file (format of mutantListAsJsON): the list of a repetition is written as
+/// soon as the lists of the previous repetitions are written
+class MutantListJsonStream {
+  std::ofstream out;
+  unsigned nextRepet;
+  std::map<unsigned, std::vector<MutantIDType>> pending;
+
+  void write(unsigned repet, std::vector<MutantIDType> const &list) {
+    if (repet > 0)
+      out << ",\n";
+    out << "\t\"" << repet << "\": [";
+    bool isNotFirst = false;
+    for (MutantIDType data : list) {
+      if (isNotFirst)
+        out << ", ";
+      else
+        isNotFirst = true;
+      out << data;
+    }
+    out << "]";
+  }
+
+public:
+  MutantListJsonStream(std::string const &jsonName)
+      : out(jsonName), nextRepet(0) {
+    if (!out.is_open()) {
+      llvm::errs() << "Unable to create info file:" << jsonName << "\n";
+      assert(false);
+    }
+    out << "{\n";
+  }
+  ~MutantListJsonStream() {
+    assert(pending.empty() && "missing the lists of some repetitions");
+    out << "\n\n}\n";
+  }
+  void add(unsigned repet, std::vector<MutantIDType> &&list) {
+    pending.emplace(repet, std::move(list));
+    for (auto it = pending.begin();
+         it != pending.end() && it->first == nextRepet;
+         it = pending.erase(it), ++nextRepet)
+      write(it->first, it->second);
+  }
+};
+
+/// \brief wall time, in seconds, since 'start' (the CPU time of clock() would
+/// add up the times of the selection threads)
+static float secondsSince(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<float>(std::chrono::steady_clock::now() - start)
+      .count();
+}
+
+/// \brief run the 'numRepetitions' repetitions of a selection on 'numThreads'
+/// threads. 'selectOnce' computes the lists of a repetition (one per JSON
+/// file of 'jsonNames'), with the PRNG stream of the repetition (for 'seed'
+/// and the selection 'salt'): the lists do not depend on the number of
+/// threads. The lists are streamed to the JSON files in repetitions order.
+/// @return the size of the first list of the last repetition
+static unsigned long runSelectionRepetitions(
+    unsigned numRepetitions, unsigned numThreads, uint64_t seed, uint64_t salt,
+    std::vector<std::string> const &jsonNames,
+    std::function<void(SelectionRandom &,
+                       std::vector<std::vector<MutantIDType>> &)> const
+        &selectOnce) {
+  std::vector<std::unique_ptr<MutantListJsonStream>> streams;
+  for (auto &jsonName : jsonNames)
+    streams.emplace_back(new MutantListJsonStream(jsonName));
+  std::atomic<unsigned> nextRepet(0);
+  std::mutex streamsLock;
+  unsigned long lastListSize = 0;
+  auto worker = [&]() {
+    std::vector<std::vector<MutantIDType>> lists(jsonNames.size());
+    for (unsigned repet = nextRepet++; repet < numRepetitions;
+         repet = nextRepet++) {
+      SelectionRandom prng(seed, (salt << 32) | repet);
+      for (auto &list : lists)
+        list.clear();
+      selectOnce(prng, lists);
+      std::lock_guard<std::mutex> guard(streamsLock);
+      if (repet + 1 == numRepetitions)
+        lastListSize = lists[0].size();
+      for (unsigned i = 0; i < lists.size(); ++i)
+        streams[i]->add(repet, std::move(lists[i]));
+    }
+  };
+  if (numThreads == 0)
+    numThreads = std::max(1u, std::thread::hardware_concurrency());
+  numThreads = std::min(numThreads, std::max(1u, numRepetitions));
+  std::vector<std::thread> threads;
+  for (unsigned t = 1; t < numThreads; ++t)
+    threads.emplace_back(worker);
+  worker();
+  for (auto &thread : threads)
+    thread.join();
+  return lastListSize;
+}
+
+/// Inputs and mutant dependence analysis of a selection
+struct SelectionAnalyses {
+  std::unique_ptr<llvm::Module> module;
+  MutantInfoList mutantInfo;
+  std::unique_ptr<MutantSelection> selection;
+
+  bool load(std::string const &inputIRfile,
+            std::string const &mutantInfoFile) {
+    // Read IR into module
+    if (!ReadWriteIRObj::readIR(inputIRfile, module))
+      return false;
+    mutantInfo.loadFromFile(mutantInfoFile, true /*fix_missing_srclocs*/);
+    return true;
+  }
+};
+
+#ifdef MART_DAEMON_TOOL
+/// Selection analyses kept resident in the daemon (see Mart-Daemon.cpp), with
+/// the absolute names and stamps of their input files and the scope of their
+/// dependence analysis (see option 'dg-scope-depth')
+struct ResidentSelectionAnalyses {
+  std::string inputIRfile, mutantInfoFile;
+  std::pair<time_t, off_t> inputIRStamp, mutantInfoStamp;
+  int dgScopeDepth;
+  SelectionAnalyses analyses;
+};
+static std::vector<std::unique_ptr<ResidentSelectionAnalyses>> &
+getResidentSelections() {
+  // The context must be destroyed after the modules
+  ReadWriteIRObj::getFilesContext();
+  static std::vector<std::unique_ptr<ResidentSelectionAnalyses>>
+      residentSelections;
+  return residentSelections;
+}
+
+/// \brief get the resident analyses computed from the given inputs, if they
+/// did not change since, with the dependence analysis scope 'dgScopeDepth'
+static SelectionAnalyses *
+getResidentSelection(std::string const &inputIRfile,
+                     std::string const &mutantInfoFile, int dgScopeDepth) {
+  std::string irPath, infoPath;
+  std::pair<time_t, off_t> irStamp, infoStamp;
+  if (!ReadWriteIRObj::getFileStamp(inputIRfile, irPath, irStamp) ||
+      !ReadWriteIRObj::getFileStamp(mutantInfoFile, infoPath, infoStamp))
+    return nullptr;
+  for (auto &resident : getResidentSelections())
+    if (resident->inputIRfile == irPath &&
+        resident->mutantInfoFile == infoPath &&
+        resident->inputIRStamp == irStamp &&
+        resident->mutantInfoStamp == infoStamp &&
+        resident->dgScopeDepth == dgScopeDepth)
+      return &resident->analyses;
+  return nullptr;
+}
+
+/// \brief compute the mutant dependence analysis (of the whole program) of
+/// the mutation topdir 'martOutTopDir' and keep it resident, with its inputs,
+/// for the selection and features export jobs on that topdir
+bool martSelectionLoadResident(std::string martOutTopDir) {
+  int const dgScopeDepth = -1;
+  std::string inputIRfile = getTopdirPreprocessedIRFile(martOutTopDir);
+  std::string mutantInfoFile = getTopdirMutantInfoFile(martOutTopDir);
+  if (inputIRfile.empty() || !llvm::sys::fs::is_regular_file(mutantInfoFile)) {
+    llvm::errs() << "Error: the topdir '" << martOutTopDir
+                 << "' does not contain the preprocessed BC file and the "
+                    "mutants infos file\n";
+    return false;
+  }
+  if (getResidentSelection(inputIRfile, mutantInfoFile, dgScopeDepth))
+    return true;
+  std::unique_ptr<ResidentSelectionAnalyses> resident(
+      new ResidentSelectionAnalyses());
+  resident->dgScopeDepth = dgScopeDepth;
+  if (!ReadWriteIRObj::getFileStamp(inputIRfile, resident->inputIRfile,
+                                    resident->inputIRStamp) ||
+      !ReadWriteIRObj::getFileStamp(mutantInfoFile, resident->mutantInfoFile,
+                                    resident->mutantInfoStamp) ||
+      !resident->analyses.load(inputIRfile, mutantInfoFile))
+    return false;
+  resident->analyses.selection.reset(new MutantSelection(
+      *resident->analyses.module, resident->analyses.mutantInfo, "",
+      true /*rundg*/, false /*is flow-sensitive?*/,
+      false /*disable_selection*/, dgScopeDepth));
+  // The analyses of former versions of the inputs are not used anymore
+  auto &residentSelections = getResidentSelections();
+  for (auto it = residentSelections.begin(); it != residentSelections.end();)
+    if ((*it)->inputIRfile == resident->inputIRfile &&
+        (*it)->mutantInfoFile == resident->mutantInfoFile)
+      it = residentSelections.erase(it);
+    else
+      ++it;
+  residentSelections.push_back(std::move(resident));
+  return true;
+}
+
+int martSelectionMain(int argc, char **argv) {
+#else
 int main(int argc, char **argv) {
+#endif
 // Remove the option we don't want to display in help
 #if (LLVM_VERSION_MAJOR <= 3) && (LLVM_VERSION_MINOR < 5)
   llvm::StringMap<llvm::cl::Option *> optMap;
@@ -108,7 +311,8 @@ int main(int argc, char **argv) {
       llvm::cl::desc("<mutation topdir or out topdir>"));
   llvm::cl::opt<std::string> mutantInfoJsonfile(
       "mutant-infos",
-      llvm::cl::desc("Specify the mutants info JSON file. (useful if running "
+      llvm::cl::desc("Specify the mutants info file, JSON or binary. (useful "
+                     "if running "
                      "with topdir different that the one generated by Mart "
                      "mutation)"),
       llvm::cl::value_desc("filename"), llvm::cl::init(""));
@@ -121,6 +325,15 @@ int main(int argc, char **argv) {
   llvm::cl::opt<bool> mut_dep_cache(
       "mutant-dep-cache",
       llvm::cl::desc("Enable caching of mutant dependence computation"));
+  llvm::cl::opt<int> dgScopeDepth(
+      "dg-scope-depth",
+      llvm::cl::desc("(optional) Restrict the dependence analysis to the "
+                     "functions with mutants and the functions up to this "
+                     "number of calls away from them (callers and callees). "
+                     "The other functions are analysed as external functions "
+                     "(conservatively). -1 (default) analyses the whole "
+                     "program"),
+      llvm::cl::value_desc("depth"), llvm::cl::init(-1));
   llvm::cl::opt<unsigned> numberOfRandomSelections(
       "rand-repeat-num",
       llvm::cl::desc("(optional) Specify the number of repetitions for random "
@@ -161,6 +374,17 @@ int main(int argc, char **argv) {
       llvm::cl::desc(
           "(optional) Specify the alternative to use for prediction for hardtokill mutants"),
       llvm::cl::init(""));
+  llvm::cl::opt<unsigned> selectionSeed(
+      "selection-seed",
+      llvm::cl::desc("(optional) Seed of the selections' random choices (the "
+                     "same inputs and seed give the same selections)"),
+      llvm::cl::value_desc("seed"), llvm::cl::init(0));
+  llvm::cl::opt<unsigned> selectionThreads(
+      "selection-threads",
+      llvm::cl::desc("(optional) Number of threads running the repetitions "
+                     "of the selections (0, the default, for the number of "
+                     "cores). The selections do not depend on it"),
+      llvm::cl::value_desc("number"), llvm::cl::init(0));
   llvm::cl::opt<bool> dumpMutantsFeaturesToCSV(
       "dump-features",
       llvm::cl::desc("(optional) enable dumping features to CSV file"));
@@ -204,23 +428,28 @@ int main(int argc, char **argv) {
   llvm::cl::ParseCommandLineOptions(argc, argv, "Mart Mutant Selection");
 
   time_t totalRunTime = time(NULL);
-  clock_t curClockTime;
+  std::chrono::steady_clock::time_point curClockTime;
 
-  char *mutantDependencyJsonfile = nullptr;
+  std::string mutantDependencyJsonfile;
 
   bool rundg = true;
 
   // unsigned numberOfRandomSelections = 100;  //How many time do we repead
   // random
 
+  // The dependencies depend on the dependence analysis scope: a scoped
+  // analysis has its own cache, never loaded by another scope
   if (mut_dep_cache)
-    mutantDependencyJsonfile = "mutantDependencies.cache.json";
+    mutantDependencyJsonfile =
+        (dgScopeDepth < 0) ? std::string("mutantDependencies.cache.json")
+                           : "mutantDependencies.scope" +
+                                 std::to_string(dgScopeDepth) + ".cache.json";
 
   assert(llvm::sys::fs::is_directory(martOutTopDir) &&
          "Error: the topdir given do not exist!");
 
   if (mutantInfoJsonfile.empty()) { // try to get it from martOutTopDir
-    mutantInfoJsonfile = martOutTopDir + "/" + mutantsInfosFileName;
+    mutantInfoJsonfile = getTopdirMutantInfoFile(martOutTopDir);
     // make sure it exists
     assert(llvm::sys::fs::is_regular_file(mutantInfoJsonfile) &&
            "The specified topdir do not contain mutantInfofile and none was "
@@ -230,37 +459,8 @@ int main(int argc, char **argv) {
            "The specified mutantInfofile do not exist");
   }
   
-  // try to get it from martOutTopDir: end with .bc and is neither .WM.bc 
-  // nor .preTCE.MetaMu.bc, nor .MetaMu.bc
-  if (inputIRfile.empty()) { 
-#if (LLVM_VERSION_MAJOR <= 3) && (LLVM_VERSION_MINOR < 5)
-    llvm::error_code ec;
-    llvm::sys::fs::directory_iterator dit(martOutTopDir, ec);
-#elif (LLVM_VERSION_MAJOR <= 3) && (LLVM_VERSION_MINOR < 9)
-    std::error_code ec;
-    llvm::sys::fs::directory_iterator dit(martOutTopDir, ec);
-#else
-    std::error_code ec;
-    llvm::sys::fs::directory_iterator dit(martOutTopDir, ec,
-                                          false /*no symlink*/);
-#endif
-    llvm::sys::fs::directory_iterator de;
-    for (; dit != de; dit.increment(ec)) {
-      assert(!ec && "failed to list topdir when looking for input BC");
-      llvm::StringRef fpath = dit->path();
-      if (fpath.endswith(commonIRSuffix)) {
-        if (!fpath.endswith(wmOutIRFileSuffix) &&
-            !fpath.endswith(covOutIRFileSuffix) &&
-            !fpath.endswith(preTCEMetaIRFileSuffix) &&
-            !fpath.endswith(metaMuIRFileSuffix) &&
-            !fpath.endswith(optimizedMetaMuIRFileSuffix)) {
-          assert(inputIRfile.empty() && "multiple preprocessed IRs in the "
-                                        "specified topdir. Please specify one");
-          inputIRfile.assign(martOutTopDir + "/" +
-                             llvm::sys::path::filename(fpath).str());
-        }
-      }
-    }
+  if (inputIRfile.empty()) { // try to get it from martOutTopDir
+    inputIRfile = getTopdirPreprocessedIRFile(martOutTopDir);
     assert(llvm::sys::fs::is_regular_file(inputIRfile) &&
            "The specified topdir does not contain preprocessed BC file and "
            "none was specified");
@@ -269,19 +469,6 @@ int main(int argc, char **argv) {
            "The specified input BC file do not exist");
   }
 
-  llvm::Module *moduleM;
-  std::unique_ptr<llvm::Module> _M;
-
-  // Read IR into moduleM
-  /// llvm::LLVMContext context;
-  if (!ReadWriteIRObj::readIR(inputIRfile, _M))
-    return 1;
-  moduleM = _M.get();
-  // ~
-
-  MutantInfoList mutantInfo;
-  mutantInfo.loadFromJsonFile(mutantInfoJsonfile, true /*fix_missing_srclocs*/);
-
   std::string outDir(martOutTopDir);
   outDir = outDir + "/" + selectionFolder;
   struct stat st;
@@ -295,7 +482,7 @@ int main(int argc, char **argv) {
   }
 
   std::string mutDepCacheName;
-  if (mutantDependencyJsonfile) {
+  if (!mutantDependencyJsonfile.empty()) {
     mutDepCacheName = outDir + "/" + mutantDependencyJsonfile;
     if (stat(mutDepCacheName.c_str(), &st) != -1) // exists
     {
@@ -307,15 +494,45 @@ int main(int argc, char **argv) {
     rundg = true;
   }
 
-  llvm::outs() << "Computing mutant dependencies...\n";
-  curClockTime = clock();
-  MutantSelection selection(*moduleM, mutantInfo, mutDepCacheName, rundg,
-                            false /*is flow-sensitive?*/, disable_selection);
-  llvm::outs() << "Mart@Progress: dependencies construction took: "
-               << (float)(clock() - curClockTime) / CLOCKS_PER_SEC
-               << " Seconds.\n";
-  loginfo << "Mart@Progress: dependencies construction took: "
-          << (float)(clock() - curClockTime) / CLOCKS_PER_SEC << " Seconds.\n";
+  SelectionAnalyses localAnalyses;
+  SelectionAnalyses *analyses = nullptr;
+#ifdef MART_DAEMON_TOOL
+  // Use the analyses kept resident by the daemon, if computed from the same
+  // inputs with the same dependence analysis scope, unless the mutant
+  // dependencies are loaded from their cache ('rundg' false). They have the
+  // selection data, also computed without 'no-selection'
+  if (rundg)
+    analyses = getResidentSelection(inputIRfile, mutantInfoJsonfile,
+                                    dgScopeDepth);
+#endif
+  if (analyses == nullptr) {
+    analyses = &localAnalyses;
+    if (!analyses->load(inputIRfile, mutantInfoJsonfile))
+      return 1;
+  }
+  llvm::Module *moduleM = analyses->module.get();
+  MutantInfoList &mutantInfo = analyses->mutantInfo;
+
+  if (!analyses->selection) {
+    llvm::outs() << "Computing mutant dependencies...\n";
+    curClockTime = std::chrono::steady_clock::now();
+    analyses->selection.reset(
+        new MutantSelection(*moduleM, mutantInfo, mutDepCacheName, rundg,
+                            false /*is flow-sensitive?*/, disable_selection,
+                            dgScopeDepth));
+    llvm::outs() << "Mart@Progress: dependencies construction took: "
+                 << secondsSince(curClockTime)
+                 << " Seconds.\n";
+    loginfo << "Mart@Progress: dependencies construction took: "
+            << secondsSince(curClockTime)
+            << " Seconds.\n";
+  } else {
+    llvm::outs() << "Mart@Progress: using the resident mutant dependencies.\n";
+    loginfo << "Mart@Progress: using the resident mutant dependencies.\n";
+    if (!mutDepCacheName.empty())
+      analyses->selection->dumpMutantsDependencies(mutDepCacheName);
+  }
+  MutantSelection &selection = *analyses->selection;
 
   if (dumpMutantsFeaturesToCSV) {
     selection.dumpMutantsFeaturesToCSV(outDir + "/" + defaultFeaturesFilename);
@@ -408,51 +625,52 @@ int main(int argc, char **argv) {
 
     if (doSmart) {
       llvm::outs() << "Doing Smart Selection...\n";
-      curClockTime = clock();
-      selectedMutants1.clear();
-      selectedMutants1.resize(numberOfRandomSelections);
-      // std::vector<double> selectedScores;
-      // to make experiment faster XXX: Note to take this in consideration when
-      // measuring the algorithm time
+      curClockTime = std::chrono::steady_clock::now();
+      // (computed once, read by the repetitions)
       cachedPrediction.clear();
-      for (unsigned si = 0; si < numberOfRandomSelections; ++si) {
-        selection.smartSelectMutants(selectedMutants1[si], cachedPrediction,
-                                     smartSelectionTrainedModel,
-                                     true /*mlOn*/, true /*mclOn*/, false/*dp*/);
-      }
-      mutantListAsJsON<MutantIDType>(selectedMutants1, smartSelectionOutJson);
+      selection.getPrediction(cachedPrediction, smartSelectionTrainedModel,
+                              false /*dp*/);
+      runSelectionRepetitions(
+          numberOfRandomSelections, selectionThreads, selectionSeed,
+          1 /*salt*/, {smartSelectionOutJson},
+          [&](SelectionRandom &prng,
+              std::vector<std::vector<MutantIDType>> &lists) {
+            selection.smartSelectMutants(
+                lists[0], cachedPrediction, smartSelectionTrainedModel,
+                true /*mlOn*/, true /*mclOn*/, false /*dp*/, prng);
+          });
       llvm::outs() << "Mart@Progress: smart selection took: "
-                   << (float)(clock() - curClockTime) / CLOCKS_PER_SEC
+                   << secondsSince(curClockTime)
                    << " Seconds.\n";
       loginfo << "Mart@Progress: smart selection took: "
-              << (float)(clock() - curClockTime) / CLOCKS_PER_SEC
+              << secondsSince(curClockTime)
               << " Seconds.\n";
     }
 
 
     if (doMLOnly) {
       llvm::outs() << "Doing ML Only Selection...\n";
-      curClockTime = clock();
-      selectedMutants1.clear();
-      selectedMutants1.resize(numberOfRandomSelections);
-      // std::vector<double> selectedScores;
-      // to make experiment faster XXX: Note to take this in consideration when
-      // measuring the algorithm time
+      curClockTime = std::chrono::steady_clock::now();
+      // (computed once, read by the repetitions)
       cachedPrediction.clear();
-      for (unsigned si = 0; si < numberOfRandomSelections; ++si) {
-        selection.smartSelectMutants(selectedMutants1[si], cachedPrediction,
-                                     smartSelectionTrainedModel, 
-                                     true /*mlOn*/, false /*mclOff*/, false/*dp*/);
-      }
-      mutantListAsJsON<MutantIDType>(selectedMutants1, mlOnlySelectionOutJson);
+      selection.getPrediction(cachedPrediction, smartSelectionTrainedModel,
+                              false /*dp*/);
+      number = runSelectionRepetitions(
+          numberOfRandomSelections, selectionThreads, selectionSeed,
+          2 /*salt*/, {mlOnlySelectionOutJson},
+          [&](SelectionRandom &prng,
+              std::vector<std::vector<MutantIDType>> &lists) {
+            selection.smartSelectMutants(
+                lists[0], cachedPrediction, smartSelectionTrainedModel,
+                true /*mlOn*/, false /*mclOff*/, false /*dp*/, prng);
+          });
       llvm::outs() << "Mart@Progress: ML Only selection took: "
-                   << (float)(clock() - curClockTime) / CLOCKS_PER_SEC
+                   << secondsSince(curClockTime)
                    << " Seconds.\n";
       loginfo << "Mart@Progress: ML Only selection took: "
-              << (float)(clock() - curClockTime) / CLOCKS_PER_SEC
+              << secondsSince(curClockTime)
               << " Seconds.\n";
 
-      number = selectedMutants1.back().size();
       assert(number == mutantInfo.getMutantsNumber() &&
              "The number of mutants mismatch. Bug in Selection function!");
 
@@ -463,14 +681,16 @@ int main(int argc, char **argv) {
 
     if (doEquivalentMutants) {
       llvm::outs() << "Doing Equivalent mutants detection...\n";
-      curClockTime = clock();
+      curClockTime = std::chrono::steady_clock::now();
       cachedPrediction.clear();
 
       selectedMutants1.clear();
       selectedMutants1.resize(1);
+      SelectionRandom prng(selectionSeed, (uint64_t)7 << 32);
       selection.smartSelectMutants(selectedMutants1[0], cachedPrediction,
                                    equivalentMutantsDetectionTrainedModel,
-                                   true /*mlOn*/, false /*mclOff*/, false/*dp*/);
+                                   true /*mlOn*/, false /*mclOff*/, false/*dp*/,
+                                   prng);
 
       // XXX No need to store mutants order
       
@@ -485,14 +705,16 @@ int main(int argc, char **argv) {
 
     if (doSubsumingMutants) {
       llvm::outs() << "Doing Subsuming mutants detection...\n";
-      curClockTime = clock();
+      curClockTime = std::chrono::steady_clock::now();
       cachedPrediction.clear();
 
       selectedMutants1.clear();
       selectedMutants1.resize(1);
+      SelectionRandom prng(selectionSeed, (uint64_t)8 << 32);
       selection.smartSelectMutants(selectedMutants1[0], cachedPrediction,
                                    subsumingMutantsDetectionTrainedModel,
-                                   true /*mlOn*/, false /*mclOff*/, false/*dp*/);
+                                   true /*mlOn*/, false /*mclOff*/, false/*dp*/,
+                                   prng);
 
       // XXX No need to store mutants order
       
@@ -507,14 +729,16 @@ int main(int argc, char **argv) {
 
     if (doHardtokillMutants) {
       llvm::outs() << "Doing Hardtokill mutants detection...\n";
-      curClockTime = clock();
+      curClockTime = std::chrono::steady_clock::now();
       cachedPrediction.clear();
 
       selectedMutants1.clear();
       selectedMutants1.resize(1);
+      SelectionRandom prng(selectionSeed, (uint64_t)9 << 32);
       selection.smartSelectMutants(selectedMutants1[0], cachedPrediction,
                                    hardtokillMutantsDetectionTrainedModel,
-                                   true /*mlOn*/, false /*mclOff*/, false/*dp*/);
+                                   true /*mlOn*/, false /*mclOff*/, false/*dp*/,
+                                   prng);
 
       // XXX No need to store mutants order
       
@@ -529,133 +753,134 @@ int main(int argc, char **argv) {
 
     if (doMCLOnly) {
       llvm::outs() << "Doing MCL Only Selection...\n";
-      curClockTime = clock();
-      selectedMutants1.clear();
-      selectedMutants1.resize(numberOfRandomSelections);
-      // std::vector<double> selectedScores;
-      // to make experiment faster XXX: Note to take this in consideration when
-      // measuring the algorithm time
+      curClockTime = std::chrono::steady_clock::now();
       cachedPrediction.clear();
-      for (unsigned si = 0; si < numberOfRandomSelections; ++si) {
-        selection.smartSelectMutants(selectedMutants1[si], cachedPrediction,
-                                     smartSelectionTrainedModel, 
-                                     false /*mlOff*/, true /*mclOn*/, false/*dp*/);
-      }
-      mutantListAsJsON<MutantIDType>(selectedMutants1, mclOnlySelectionOutJson);
+      runSelectionRepetitions(
+          numberOfRandomSelections, selectionThreads, selectionSeed,
+          3 /*salt*/, {mclOnlySelectionOutJson},
+          [&](SelectionRandom &prng,
+              std::vector<std::vector<MutantIDType>> &lists) {
+            selection.smartSelectMutants(
+                lists[0], cachedPrediction, smartSelectionTrainedModel,
+                false /*mlOff*/, true /*mclOn*/, false /*dp*/, prng);
+          });
       llvm::outs() << "Mart@Progress: MCL Only selection took: "
-                   << (float)(clock() - curClockTime) / CLOCKS_PER_SEC
+                   << secondsSince(curClockTime)
                    << " Seconds.\n";
       loginfo << "Mart@Progress: MCL Only selection took: "
-              << (float)(clock() - curClockTime) / CLOCKS_PER_SEC
+              << secondsSince(curClockTime)
               << " Seconds.\n";
     }
     
     if (doISSTA2017) {
       llvm::outs() << "Doing ISSTA2017 Selection...\n";
-      curClockTime = clock();
-      selectedMutants1.clear();
-      selectedMutants1.resize(numberOfRandomSelections);
-      // std::vector<double> selectedScores;
-      // to make experiment faster XXX: Note to take this in consideration when
-      // measuring the algorithm time
+      curClockTime = std::chrono::steady_clock::now();
+      // (computed once, read by the repetitions)
       cachedPrediction.clear();
-      for (unsigned si = 0; si < numberOfRandomSelections; ++si) {
-        selection.smartSelectMutants(selectedMutants1[si], cachedPrediction,
-                                     issta2017SelectionTrainedModel, 
-                                     true /*mlOff*/, false /*mclOn*/, false/*dp*/);
-      }
-      mutantListAsJsON<MutantIDType>(selectedMutants1, issta2017SelectionOutJson);
+      selection.getPrediction(cachedPrediction, issta2017SelectionTrainedModel,
+                              false /*dp*/);
+      runSelectionRepetitions(
+          numberOfRandomSelections, selectionThreads, selectionSeed,
+          4 /*salt*/, {issta2017SelectionOutJson},
+          [&](SelectionRandom &prng,
+              std::vector<std::vector<MutantIDType>> &lists) {
+            selection.smartSelectMutants(
+                lists[0], cachedPrediction, issta2017SelectionTrainedModel,
+                true /*mlOff*/, false /*mclOn*/, false /*dp*/, prng);
+          });
       llvm::outs() << "Mart@Progress: ISSTA2017 selection took: "
-                   << (float)(clock() - curClockTime) / CLOCKS_PER_SEC
+                   << secondsSince(curClockTime)
                    << " Seconds.\n";
       loginfo << "Mart@Progress: ISSTA2017 selection took: "
-              << (float)(clock() - curClockTime) / CLOCKS_PER_SEC
+              << secondsSince(curClockTime)
               << " Seconds.\n";
     }
 
     if (doMutTypeOnly) {
       llvm::outs() << "Doing MutTypeOnly Selection...\n";
-      curClockTime = clock();
-      selectedMutants1.clear();
-      selectedMutants1.resize(numberOfRandomSelections);
-      // std::vector<double> selectedScores;
-      // to make experiment faster XXX: Note to take this in consideration when
-      // measuring the algorithm time
+      curClockTime = std::chrono::steady_clock::now();
+      // (computed once, read by the repetitions)
       cachedPrediction.clear();
-      for (unsigned si = 0; si < numberOfRandomSelections; ++si) {
-        selection.smartSelectMutants(selectedMutants1[si], cachedPrediction,
-                                     mutantTypeOnlySelectionTrainedModel,
-                                     true /*mlOn*/, false /*mclOn*/, false/*dp*/);
-      }
-      mutantListAsJsON<MutantIDType>(selectedMutants1, mutTypeOnlySelectionOutJson);
+      selection.getPrediction(cachedPrediction,
+                              mutantTypeOnlySelectionTrainedModel,
+                              false /*dp*/);
+      runSelectionRepetitions(
+          numberOfRandomSelections, selectionThreads, selectionSeed,
+          5 /*salt*/, {mutTypeOnlySelectionOutJson},
+          [&](SelectionRandom &prng,
+              std::vector<std::vector<MutantIDType>> &lists) {
+            selection.smartSelectMutants(
+                lists[0], cachedPrediction, mutantTypeOnlySelectionTrainedModel,
+                true /*mlOn*/, false /*mclOn*/, false /*dp*/, prng);
+          });
       llvm::outs() << "Mart@Progress: mutTypeOnly selection took: "
-                   << (float)(clock() - curClockTime) / CLOCKS_PER_SEC
+                   << secondsSince(curClockTime)
                    << " Seconds.\n";
       loginfo << "Mart@Progress: mutTypeOnly selection took: "
-              << (float)(clock() - curClockTime) / CLOCKS_PER_SEC
+              << secondsSince(curClockTime)
               << " Seconds.\n";
     }
 
     if (doDefectPrediction) {
       llvm::outs() << "Doing defectPrediction Selection...\n";
-      curClockTime = clock();
-      selectedMutants1.clear();
-      selectedMutants1.resize(numberOfRandomSelections);
-      // std::vector<double> selectedScores;
-      // to make experiment faster XXX: Note to take this in consideration when
-      // measuring the algorithm time
+      curClockTime = std::chrono::steady_clock::now();
+      // (computed once, read by the repetitions)
       cachedPrediction.clear();
-      for (unsigned si = 0; si < numberOfRandomSelections; ++si) {
-        selection.smartSelectMutants(selectedMutants1[si], cachedPrediction,
-                                     defectPredictionSelectionTrainedModel,
-                                     true /*mlOn*/, false /*mclOn*/, true /*dp*/);
-      }
-      mutantListAsJsON<MutantIDType>(selectedMutants1, defectPredictionSelectionOutJson);
+      selection.getPrediction(cachedPrediction,
+                              defectPredictionSelectionTrainedModel,
+                              true /*dp*/);
+      runSelectionRepetitions(
+          numberOfRandomSelections, selectionThreads, selectionSeed,
+          6 /*salt*/, {defectPredictionSelectionOutJson},
+          [&](SelectionRandom &prng,
+              std::vector<std::vector<MutantIDType>> &lists) {
+            selection.smartSelectMutants(
+                lists[0], cachedPrediction,
+                defectPredictionSelectionTrainedModel,
+                true /*mlOn*/, false /*mclOn*/, true /*dp*/, prng);
+          });
       llvm::outs() << "Mart@Progress: defectPrediction selection took: "
-                   << (float)(clock() - curClockTime) / CLOCKS_PER_SEC
+                   << secondsSince(curClockTime)
                    << " Seconds.\n";
       loginfo << "Mart@Progress: defectPrediction selection took: "
-              << (float)(clock() - curClockTime) / CLOCKS_PER_SEC
+              << secondsSince(curClockTime)
               << " Seconds.\n";
     }
 
     if (doRandom) {
       llvm::outs() << "Doing dummy and spread random selection...\n";
-      curClockTime = clock();
-      selectedMutants1.clear();
-      selectedMutants2.clear();
-      selectedMutants1.resize(numberOfRandomSelections);
-      selectedMutants2.resize(numberOfRandomSelections);
-      for (unsigned si = 0; si < numberOfRandomSelections; ++si)
-        selection.randomMutants(selectedMutants1[si], selectedMutants2[si],
-                                number);
-      mutantListAsJsON<MutantIDType>(selectedMutants1,
-                                     spreadRandomSelectionOutJson);
-      mutantListAsJsON<MutantIDType>(selectedMutants2,
-                                     dummyRandomSelectionOutJson);
+      curClockTime = std::chrono::steady_clock::now();
+      runSelectionRepetitions(
+          numberOfRandomSelections, selectionThreads, selectionSeed,
+          10 /*salt*/,
+          {spreadRandomSelectionOutJson, dummyRandomSelectionOutJson},
+          [&](SelectionRandom &prng,
+              std::vector<std::vector<MutantIDType>> &lists) {
+            selection.randomMutants(lists[0], lists[1], number, prng);
+          });
       llvm::outs() << "Mart@Progress: dummy and spread random took: "
-                   << (float)(clock() - curClockTime) / CLOCKS_PER_SEC
+                   << secondsSince(curClockTime)
                    << " Seconds. (" << numberOfRandomSelections
                    << " repetitions)\n";
       loginfo << "Mart@Progress: dummy and spread random took: "
-              << (float)(clock() - curClockTime) / CLOCKS_PER_SEC << " Seconds. ("
+              << secondsSince(curClockTime) << " Seconds. ("
               << numberOfRandomSelections << " repetitions)\n";
     }
 
     /*llvm::outs()
         << "Doing random SDL selection...\n"; // select only SDL mutants
-    curClockTime = clock();
+    curClockTime = std::chrono::steady_clock::now();
     selectedMutants1.clear();
     selectedMutants1.resize(numberOfRandomSelections);
     for (unsigned si = 0; si < numberOfRandomSelections; ++si)
       selection.randomSDLMutants(selectedMutants1[si], number);
     mutantListAsJsON<MutantIDType>(selectedMutants1, randomSDLelectionOutJson);
     llvm::outs() << "Mart@Progress: random SDL took: "
-                 << (float)(clock() - curClockTime) / CLOCKS_PER_SEC
+                 << secondsSince(curClockTime)
                  << " Seconds. (" << numberOfRandomSelections
                  << " repetitions)\n";
     loginfo << "Mart@Progress: random SDL took: "
-            << (float)(clock() - curClockTime) / CLOCKS_PER_SEC << " Seconds. ("
+            << secondsSince(curClockTime) << " Seconds. ("
             << numberOfRandomSelections << " repetitions)\n";
     */
 
@@ -13,6 +13,7 @@
 #include <ctime>
 #include <fstream>
 #include <libgen.h> //basename
+#include <set>
 #include <sstream>
 #include <string>
 #include <sys/stat.h>  //mkdir, stat
@@ -21,6 +22,8 @@
 #include <unistd.h>    // fork, execl
 
 #include "../lib/mutation.h"
+#include "AsyncFileWriter.h"
+#include "MutantsPack.h"
 #include "ReadWriteIRObj.h"
 
 #include "llvm/Support/FileSystem.h"       //for llvm::sys::fs::create_link
@@ -36,20 +39,88 @@ using namespace mart;
 #include "tools_commondefs.h"
 
 static std::string outputDir("mart-out-");
-static const std::string mutantsFolder("mutants.out");
+static const char *wmLogFuncinputIRfileName = "wmlog-driver.bc";
+static const char *metamutant_selector_inputIRfileName =
+    "metamutant_selector.bc";
+static const char *defaultMconfFile = "mconf-scope/default_allmax.mconf";
 static const std::string generalInfo("info");
 static const std::string readmefile("README.md");
 static std::stringstream loginfo;
 static std::string outFile;
-static const std::string tmpFuncModuleFolder("tmp-func-module-dir.tmp");
+/// set when the mutants are written into a pack instead of mutantsFolder
+static std::unique_ptr<MutantsPack> mutantsPack(nullptr);
+/// in pack mode, store each mutant as its function delta against the original
+static bool packMutantsAsDelta = false;
+/// set with scoped loading: the functions out of the mutation scope, linked
+/// back into the modules written
+static std::unique_ptr<ReadWriteIRObj::ScopeRest> scopeRest(nullptr);
+/// compile the mutants' functions into shared objects, run by the hot-patch
+/// host (the original with all its symbols exported)
+static bool hotPatchMutants = false;
+/// writer threads of the mutants' files, fed with the serialized modules
+static std::unique_ptr<AsyncFileWriter> mutantsFileWriter(nullptr);
 
 void insertMutSelectGetenv(llvm::Module *mod) {
   // insert getenv and atol
 }
 
+/**
+ * \brief write 'mod' into 'filename' (or into 'data' if 'filename' is empty).
+ * With scoped loading, the functions out of the scope are linked into a copy of
+ * 'mod' which is written instead. 'restoreLocals' is passed to
+ * ReadWriteIRObj::linkScopeRest: false when 'mod' is written apart from
+ * modules that refer to it (the function modules of the mutants).
+ */
+static bool writeOutputModule(llvm::Module *mod, std::string const &filename,
+                              std::string *data = nullptr,
+                              bool restoreLocals = true) {
+  std::unique_ptr<llvm::Module> completeM;
+  if (scopeRest) {
+    completeM.reset(ReadWriteIRObj::cloneModuleAndRelease(mod));
+    if (!ReadWriteIRObj::linkScopeRest(*completeM, *scopeRest, restoreLocals))
+      return false;
+    mod = completeM.get();
+  }
+  if (filename.empty()) {
+    ReadWriteIRObj::writeIRToBuffer(mod, *data);
+    return true;
+  }
+  return ReadWriteIRObj::writeIR(mod, filename);
+}
+
+/**
+ * \brief write the module of the mutant with ID 'mid', either in its own
+ * folder within 'mutantsDir' or, in pack mode, into the mutants pack.
+ * 'funcModName' is the name of the function module that the mutant module must
+ * be linked with (empty when the mutant module is a complete program).
+ * The module is serialized here, the folder and file are created by
+ * 'mutantsFileWriter' (call its drain() to wait for them).
+ */
+static bool writeMutantModule(llvm::Module *mod, unsigned mid,
+                              std::string const &mutantsDir,
+                              std::string const &funcModName) {
+  std::string data;
+  if (!funcModName.empty()) {
+    // The functions out of scope (scoped loading) are in the function module
+    ReadWriteIRObj::writeIRToBuffer(mod, data);
+  } else if (!writeOutputModule(mod, "", &data)) {
+    return false;
+  }
+  if (mutantsPack) {
+    if (!mutantsPack->addMutant(mid, data, funcModName))
+      return false;
+  } else {
+    std::string mutDirPath = mutantsDir + "/" + std::to_string(mid);
+    mutantsFileWriter->submit(mutDirPath, mutDirPath + "/" + outFile + ".bc",
+                              data);
+  }
+  return true;
+}
+
 /**
  * \brief print all the modules of mutants, sorted from mutant 0(original) to
- * mutant max
+ * mutant max. The mutants may come by batches (several calls), the original
+ * is written with the first batch.
  * XXX This function modifies the values in parameters 'mods' and 'mutFunctions'
  */
 bool dumpMutantsCallback(Mutation *mutEng,
@@ -57,13 +128,14 @@ bool dumpMutantsCallback(Mutation *mutEng,
                          std::vector<llvm::Module *> *mods,
                          llvm::Module *wmModule /*=nullptr*/,
                          llvm::Module *covModule /*=nullptr*/,
-                         std::vector<llvm::Function *> const *mutFunctions) {
+                         std::vector<llvm::Function *> const *mutFunctions,
+                         bool firstBatch, bool lastBatch) {
   clock_t curClockTime = clock();
   // weak mutation
   if (wmModule) {
     llvm::outs() << "Mart@Progress: writing weak mutation...\n";
     std::string wmFilePath = outputDir + "/" + outFile + wmOutIRFileSuffix;
-    if (!ReadWriteIRObj::writeIR(wmModule, wmFilePath)) {
+    if (!writeOutputModule(wmModule, wmFilePath)) {
       assert(false && "Failed to output weak mutation IR file");
     }
   }
@@ -71,7 +143,7 @@ bool dumpMutantsCallback(Mutation *mutEng,
   if (covModule) {
     llvm::outs() << "Mart@Progress: writing mutant coverage...\n";
     std::string covFilePath = outputDir + "/" + outFile + covOutIRFileSuffix;
-    if (!ReadWriteIRObj::writeIR(covModule, covFilePath)) {
+    if (!writeOutputModule(covModule, covFilePath)) {
       assert(false && "Failed to output mutant coverage IR file");
     }
   }
@@ -84,8 +156,16 @@ bool dumpMutantsCallback(Mutation *mutEng,
     std::unordered_map<llvm::Module *, llvm::Function *> backedFuncsByMods;
 
     std::string mutantsDir = outputDir + "/" + mutantsFolder;
-    if (mkdir(mutantsDir.c_str(), 0777) != 0)
+    if (!firstBatch) {
+      // The output was created with the first batch
+    } else if (mutantsPack) {
+      if (!mutantsPack->create(outputDir + "/" + mutantsPackFileName,
+                               outputDir + "/" + mutantsPackIndexFileName,
+                               outFile + commonIRSuffix))
+        assert(false && "Failed to create mutants pack");
+    } else if (mkdir(mutantsDir.c_str(), 0777) != 0) {
       assert(false && "Failed to create mutants output directory");
+    }
 
     std::string tmpFunctionDir = outputDir + "/" + tmpFuncModuleFolder;
 
@@ -97,33 +177,63 @@ bool dumpMutantsCallback(Mutation *mutEng,
     std::string infoFuncPathModPath;
     const std::string infoFuncPathModPath_File(tmpFunctionDir + "/" +
                                                "mapinfo");
-    if (separateFunctionModule)
+    if (firstBatch && separateFunctionModule && !mutantsPack)
       if (mkdir(tmpFunctionDir.c_str(), 0777) != 0)
         assert(false && "Failed to create function temporal directory");
 
     // original
-    if (mkdir((mutantsDir + "/0").c_str(), 0777) != 0)
-      assert(false && "Failed to create output directory for original (0)");
-    if (!ReadWriteIRObj::writeIR(formutsModule,
-                                 mutantsDir + "/0/" + outFile + ".bc")) {
-      assert(false && "Failed to output post-TCE original IR file");
+    if (firstBatch && !writeMutantModule(formutsModule, 0, mutantsDir, "")) {
+      llvm::errs() << "Failed to output post-TCE original IR file\n";
+      return false;
     }
     infoFuncPathModPath += mutantsFolder + "/0/" + outFile + ".bc\n";
 
+    // Hot-patch host, where the mutants' functions are loaded and patched in
+    if (firstBatch && hotPatchMutants && separateFunctionModule &&
+        mutFunctions != nullptr && !mutantsPack) {
+      std::unique_ptr<llvm::Module> hostM(
+          ReadWriteIRObj::cloneModuleAndRelease(formutsModule));
+      FunctionToModule::martExternalizeModule(hostM.get());
+      // Leave room, even after the small functions, for the jump to the
+      // mutant function (see useful/hotpatch_runner.c)
+      for (auto &Func : *hostM)
+        if (!Func.isDeclaration())
+#if (LLVM_VERSION_MAJOR < 10)
+          Func.setAlignment(16);
+#else
+          Func.setAlignment(llvm::MaybeAlign(16));
+#endif
+      if (!writeOutputModule(hostM.get(),
+                             outputDir + "/" + outFile +
+                                 hotPatchHostIRFileSuffix,
+                             nullptr, false))
+        assert(false && "Failed to output hot-patch host IR file");
+    }
+
     // mutants
     // this map keep information about the global constants that use a function
     // that should be replaced by mutant function during IR dumping
     std::unordered_map<llvm::Module*, llvm::Function*> functionsGlobalUsers;
     for (auto &m : *poss) {
       formutsModule = mods->at(m.first);
+      if (mutantsPack && packMutantsAsDelta) {
+        assert(mutFunctions != nullptr &&
+               "delta mutants need the mutants' functions (function mode)");
+        // Only the mutant function, with the declarations it uses, is stored
+        std::string data;
+        ReadWriteIRObj::writeFunctionDeltaToBuffer(mutFunctions->at(m.first),
+                                                   formutsModule, data);
+        if (!mutantsPack->addDeltaMutant(m.second.front(), data)) {
+          llvm::errs() << "Mutant " << m.second.front() << "...\n";
+          return false;
+        }
+        continue;
+      }
       if (mutFunctions != nullptr) {
         mid = m.second.front();
         llvm::Function *currFunc = mutFunctions->at(m.first);
         std::string funcName = currFunc->getName();
         std::string funcFile = tmpFunctionDir + "/" + funcName + ".bc";
-        std::string mutDirPath = mutantsDir + "/" + std::to_string(mid);
-        if (mkdir(mutDirPath.c_str(), 0777) != 0)
-          assert(false && "Failed to create output directory for mutant");
 
         if (backedFuncsByMods.count(formutsModule) == 0) {
           llvm::ValueToValueMapTy vmap;
@@ -133,11 +243,18 @@ bool dumpMutantsCallback(Mutation *mutEng,
             std::unique_ptr<llvm::Module> tmpM =
                 FunctionToModule::martSplitFunctionsOutOfModule(formutsModule,
                                                                 funcName);
-            // wrtite the function's Module IR in tmpFunctionDir
-            if (!ReadWriteIRObj::writeIR(tmpM.get(), funcFile)) {
-              llvm::errs() << "Function " << funcName << "...\n";
-              assert(false && "Failed to output function's module IR file");
-            }
+            // wrtite the function's Module IR in tmpFunctionDir (all its
+            // functions are external, as in the mutants' modules)
+            std::string data;
+            if (!writeOutputModule(tmpM.get(), "", &data, false))
+              assert(false && "Failed to complete function's module IR");
+            if (mutantsPack) {
+              if (!mutantsPack->addFunctionModule(funcName, data)) {
+                llvm::errs() << "Function module of " << funcName << "...\n";
+                return false;
+              }
+            } else
+              mutantsFileWriter->submit("", funcFile, data);
 
             // now 'formutsModule' contain only the function of interest, delete
             // it so that we can insert the mutants later.
@@ -213,10 +330,10 @@ bool dumpMutantsCallback(Mutation *mutEng,
           //Handle Global constant use of function (array...)
           if (functionsGlobalUsers.count(formutsModule) > 0)
             functionsGlobalUsers.at(formutsModule)->replaceAllUsesWith(currFunc);
-          if (!ReadWriteIRObj::writeIR(formutsModule,
-                                       mutDirPath + "/" + outFile + ".bc")) {
-            llvm::errs() << "Mutant " << mid << "...\n";
-            assert(false && "Failed to output post-TCE mutant IR file");
+          if (!writeMutantModule(formutsModule, mid, mutantsDir, funcName)) {
+            llvm::errs() << "Mutant " << mid
+                         << "...\nFailed to output post-TCE mutant IR file\n";
+            return false;
           }
           currFunc->setLinkage(linkageBak);
           //Handle Global constant use of function (array...)
@@ -225,33 +342,33 @@ bool dumpMutantsCallback(Mutation *mutEng,
           currFunc->removeFromParent();
         } else {
           mutEng->setModFuncToFunction(formutsModule, currFunc);
-          if (!ReadWriteIRObj::writeIR(formutsModule,
-                                       mutDirPath + "/" + outFile + ".bc")) {
-            llvm::errs() << "Mutant " << mid << "...\n";
-            assert(false && "Failed to output post-TCE mutant IR file");
+          if (!writeMutantModule(formutsModule, mid, mutantsDir, "")) {
+            llvm::errs() << "Mutant " << mid
+                         << "...\nFailed to output post-TCE mutant IR file\n";
+            return false;
           }
         }
       } else {
         mid = m.second.front();
-        if (mkdir((mutantsDir + "/" + std::to_string(mid)).c_str(), 0777) != 0)
-          assert(false && "Failed to create output directory for mutant");
-        if (!ReadWriteIRObj::writeIR(formutsModule,
-                                     mutantsDir + "/" + std::to_string(mid) +
-                                         "/" + outFile + ".bc")) {
-          llvm::errs() << "Mutant " << mid << "...\n";
-          assert(false && "Failed to output post-TCE mutant IR file");
+        if (!writeMutantModule(formutsModule, mid, mutantsDir, "")) {
+          llvm::errs() << "Mutant " << mid
+                       << "...\nFailed to output post-TCE mutant IR file\n";
+          return false;
         }
       }
     }
     if (mutFunctions != nullptr) {
       if (separateFunctionModule) {
-        std::ofstream xxx(infoFuncPathModPath_File);
-        if (xxx.is_open()) {
-          xxx << infoFuncPathModPath;
-          xxx.close();
-        } else
-          llvm::errs() << "Unable to open file for write:"
-                       << infoFuncPathModPath_File;
+        // In pack mode, the pack index records the mutants' function modules
+        if (!mutantsPack) {
+          std::ofstream xxx(infoFuncPathModPath_File);
+          if (xxx.is_open()) {
+            xxx << infoFuncPathModPath;
+            xxx.close();
+          } else
+            llvm::errs() << "Unable to open file for write:"
+                         << infoFuncPathModPath_File;
+        }
 
         // for (auto &itt: extractedFuncMod)
         //    delete itt.second;
@@ -262,7 +379,21 @@ bool dumpMutantsCallback(Mutation *mutEng,
         }
       }
     }
+    // Wait for the files of the batch to be written
+    if (!mutantsFileWriter->drain())
+      assert(false && "Failed to output post-TCE mutants IR files");
+    if (mutantsPack && lastBatch) {
+      if (!mutantsPack->finalize(outputDir + "/" + packDuplicatesFileName))
+        assert(false && "Failed to finalize the mutants pack");
+      llvm::outs() << "Mart@Progress: mutants pack has "
+                   << mutantsPack->getNumBlobs() << " distinct blobs.\n";
+      loginfo << "Mart@Progress: mutants pack has "
+              << mutantsPack->getNumBlobs() << " distinct blobs.\n";
+    }
   }
+  // The modules of a batch may be in a context deleted with the batch
+  if (scopeRest)
+    scopeRest->releasePrepared();
   llvm::outs() << "Mart@Progress: writing mutants to file took: "
                << (float)(clock() - curClockTime) / CLOCKS_PER_SEC
                << " Seconds.\n";
@@ -271,7 +402,28 @@ bool dumpMutantsCallback(Mutation *mutEng,
   return true;
 }
 
+#ifdef MART_DAEMON_TOOL
+/// \brief keep resident in the daemon (see Mart-Daemon.cpp) the input module
+/// 'inputIRfile', the mutation configuration 'mutantConfigfile' (the default
+/// one if empty) and the modules of the useful directory read by every
+/// mutation job
+bool martMutationLoadResident(char *argv0, std::string inputIRfile,
+                              std::string mutantConfigfile) {
+  std::string useful_conf_dir = getUsefulAbsPath(argv0);
+  if (mutantConfigfile.empty())
+    mutantConfigfile.assign(useful_conf_dir + defaultMconfFile);
+  return ReadWriteIRObj::loadResidentModule(inputIRfile) &&
+         ReadWriteIRObj::loadResidentModule(
+             useful_conf_dir + metamutant_selector_inputIRfileName) &&
+         ReadWriteIRObj::loadResidentModule(useful_conf_dir +
+                                            wmLogFuncinputIRfileName) &&
+         Mutation::loadResidentConfiguration(mutantConfigfile);
+}
+
+int martMutationMain(int argc, char **argv) {
+#else
 int main(int argc, char **argv) {
+#endif
 // Remove the option we don't want to display in help
 #if (LLVM_VERSION_MAJOR <= 3) && (LLVM_VERSION_MINOR < 5)
   llvm::StringMap<llvm::cl::Option *> optMap;
@@ -301,12 +453,25 @@ int main(int argc, char **argv) {
           "(Optional) Specify the mutation scope: Functions, source files."),
       llvm::cl::value_desc("filename"), llvm::cl::init(""));
 
+  llvm::cl::opt<bool> scopedLoading(
+      "scoped-loading",
+      llvm::cl::desc("Only load the bodies of the functions to mutate (the "
+                     "Functions of the mutation scope), the other functions "
+                     "are linked back into the modules written (only active "
+                     "when mutant-scope has Functions)"));
+
 llvm::cl::opt<std::string> extraLinkingFlags(
       "linking-flags",
       llvm::cl::desc(
           "(Optional) Specify extra linking flags necessary to build executable from input BC file."),
       llvm::cl::value_desc("backend linking flags"), llvm::cl::init(""));
 
+  llvm::cl::opt<bool> keepConstantPHIs(
+      "keep-constant-phis",
+      llvm::cl::desc("Keep in SSA form the PHI nodes whose incoming values "
+                     "are constants, instead of demoting them to memory "
+                     "(smaller meta module)"));
+
   llvm::cl::opt<bool> dumpPreTCEMeta(
       "print-preTCE-Meta",
       llvm::cl::desc("Enable dumping Meta module before applying TCE"));
@@ -322,10 +487,93 @@ llvm::cl::opt<std::string> extraLinkingFlags(
       "no-WM", llvm::cl::desc("Disable dumping Weak Mutation Module"));
   llvm::cl::opt<bool> disabledMutantCoverage(
       "no-COV", llvm::cl::desc("Disable dumping Mutant Coverage Module"));
+  llvm::cl::opt<bool> inlineProbes(
+      "inline-probes",
+      llvm::cl::desc("Instrument the Weak Mutation and Mutant Coverage "
+                     "modules with inline stores into a bitmap, written when "
+                     "the program exits, instead of calls to the log "
+                     "functions (much faster execution)"));
+  llvm::cl::opt<bool> stmtCoverageProbes(
+      "stmt-coverage-probes",
+      llvm::cl::desc("Instrument the Mutant Coverage module with one probe "
+                     "per mutated statement, logging the statement index. "
+                     "The statements mutants ranges are written into "
+                     "'coverageStmts-mutantsRanges.json', to expand the "
+                     "statements covered into mutants (see "
+                     "useful/expand_stmt_coverage.py)"));
   llvm::cl::opt<bool> disableDumpMutantInfos(
       "no-mutant-info",
       llvm::cl::desc("Disable dumping mutants info JSON file"));
 
+  llvm::cl::opt<bool> packMutants(
+      "pack-mutants",
+      llvm::cl::desc("Write the mutants into a single content addressed pack "
+                     "file, deduplicated at write time, instead of a "
+                     "directory per mutant (only active when enabled "
+                     "write-mutants). Use mart-pack to extract them"));
+
+  llvm::cl::opt<bool> deltaMutants(
+      "delta-mutants",
+      llvm::cl::desc("Store each mutant, in the mutants pack, as a delta "
+                     "(the mutated function only) against the original "
+                     "module (only active when enabled pack-mutants, "
+                     "requires the function mode TCE)"));
+
+  llvm::cl::opt<unsigned> writerThreads(
+      "writer-threads",
+      llvm::cl::desc("(Optional) Number of threads that create the mutants "
+                     "directories and write their files, while the next "
+                     "mutants are serialized (0 for synchronous writes)"),
+      llvm::cl::value_desc("number of threads"), llvm::cl::init(4));
+
+  llvm::cl::opt<bool> hotPatch(
+      "hot-patch-mutants",
+      llvm::cl::desc("Compile each mutant's function into a shared object, "
+                     "instead of linking an executable per mutant, and build "
+                     "the hot-patch host that runs them (only active when "
+                     "enabled write-mutants, without pack-mutants, and the "
+                     "program has several functions)"));
+
+  llvm::cl::opt<std::string> mutationShard(
+      "shard",
+      llvm::cl::desc("(Optional) Only mutate the shard i of N of the "
+                     "functions in the mutation scope, partitioned "
+                     "deterministically (the shards' outputs are merged with "
+                     "mart-merge)"),
+      llvm::cl::value_desc("i/N"), llvm::cl::init(""));
+
+  llvm::cl::opt<double> samplingRate(
+      "sample-rate",
+      llvm::cl::desc("(Optional) Only keep this fraction (in ]0, 1]) of the "
+                     "mutants, sampled before they are built (see "
+                     "sample-by)"),
+      llvm::cl::value_desc("rate"), llvm::cl::init(1.0));
+
+  llvm::cl::opt<std::string> samplingBy(
+      "sample-by",
+      llvm::cl::desc("(Optional) Strata of the mutants sampling: 'mutant' "
+                     "(the whole module), 'statement' or 'operator' (the "
+                     "sample-rate of each statement's or mutant type's "
+                     "mutants)"),
+      llvm::cl::value_desc("strata"), llvm::cl::init("mutant"));
+
+  llvm::cl::opt<unsigned> samplingMaxMutants(
+      "sample-max",
+      llvm::cl::desc("(Optional) Maximum number of mutants to keep, sampled "
+                     "after sample-rate (0 for no maximum)"),
+      llvm::cl::value_desc("number of mutants"), llvm::cl::init(0));
+
+  llvm::cl::opt<unsigned> samplingSeed(
+      "sample-seed",
+      llvm::cl::desc("(Optional) Seed of the mutants sampling PRNG (the "
+                     "same input and seed give the same mutants)"),
+      llvm::cl::value_desc("seed"), llvm::cl::init(0));
+  llvm::cl::opt<bool> noPreTCEFilter(
+      "no-pre-tce-filter",
+      llvm::cl::desc("Disable the removal of the trivially equivalent and "
+                     "duplicate mutants (algebraic identities) before they "
+                     "are inserted in the module (the TCE removes them)"));
+
   llvm::cl::opt<bool> keepMutantsBCs(
       "keep-mutants-bc",
       llvm::cl::desc("Keep the different LLVM IR module of all mutants (only "
@@ -338,9 +586,6 @@ llvm::cl::opt<std::string> extraLinkingFlags(
   time_t totalRunTime = time(NULL);
   clock_t curClockTime;
 
-  const char *wmLogFuncinputIRfileName = "wmlog-driver.bc";
-  const char *metamutant_selector_inputIRfileName = "metamutant_selector.bc";
-
   /// \brief set this to false if the module is small enough, that all mutants
   /// will fit in memory
   bool isTCEFunctionMode = true;
@@ -351,21 +596,57 @@ llvm::cl::opt<std::string> extraLinkingFlags(
 
   std::string useful_conf_dir = getUsefulAbsPath(argv[0]);
 
-  const char *defaultMconfFile = "mconf-scope/default_allmax.mconf";
-
   if (mutantConfigfile.empty())
     mutantConfigfile.assign(useful_conf_dir + defaultMconfFile);
 
   assert(!inputIRfile.empty() && "Error: No input llvm IR file passed!");
 
+  unsigned shardIndex = 0, numShards = 1;
+  if (!mutationShard.empty()) {
+    auto shardSpec = llvm::StringRef(mutationShard).split('/');
+    if (shardSpec.first.getAsInteger(10, shardIndex) ||
+        shardSpec.second.getAsInteger(10, numShards) || numShards == 0 ||
+        shardIndex >= numShards) {
+      llvm::errs() << "Error: invalid mutation shard '" << mutationShard
+                   << "', expected i/N with 0 <= i < N.\n";
+      return 1;
+    }
+  }
+  if (!(samplingRate > 0.0 && samplingRate <= 1.0) ||
+      !Mutation::isValidSamplingStrata(samplingBy)) {
+    llvm::errs() << "Error: invalid mutants sampling (sample-rate must be in "
+                    "]0, 1] and sample-by 'mutant', 'statement' or "
+                    "'operator').\n";
+    return 1;
+  }
+  if (deltaMutants && !isTCEFunctionMode) {
+    // Only the function mode TCE keeps each mutant's function apart
+    llvm::errs() << "Error: delta-mutants is only supported with the "
+                    "function mode TCE.\n";
+    return 1;
+  }
+
   llvm::Module *moduleM;
   std::unique_ptr<llvm::Module> metamutant_sel(nullptr), modWMLog(nullptr), 
                                 modCovLog(nullptr), optMetaMu(nullptr), _M;
 
   // Read IR into moduleM
   /// llvm::LLVMContext context;
-  if (!ReadWriteIRObj::readIR(inputIRfile, _M))
-    return 1;
+  std::set<std::string> scopeFuncNames;
+  if (scopedLoading)
+    MutationScope::getScopeFunctionNames(mutantScopeJsonfile, scopeFuncNames);
+  if (!scopeFuncNames.empty()) {
+    scopeRest.reset(new ReadWriteIRObj::ScopeRest());
+    if (!ReadWriteIRObj::readIRScoped(inputIRfile, scopeFuncNames, _M,
+                                      *scopeRest))
+      return 1;
+  } else {
+    if (scopedLoading)
+      llvm::errs() << "Warning: scoped loading ignored, the mutation scope "
+                      "specifies no Functions.\n";
+    if (!ReadWriteIRObj::readIR(inputIRfile, _M))
+      return 1;
+  }
   moduleM = _M.get();
   // ~
 
@@ -434,7 +715,12 @@ llvm::cl::opt<std::string> extraLinkingFlags(
 
   // @Mutation
   Mutation mut(*moduleM, mutantConfigfile, dumpMutantsCallback,
-               mutantScopeJsonfile);
+               mutantScopeJsonfile, keepConstantPHIs, shardIndex, numShards);
+  mut.setInlineLogProbes(inlineProbes);
+  mut.setStmtCoverageProbes(stmtCoverageProbes);
+  mut.setMutantsSampling(samplingRate, samplingBy, samplingMaxMutants,
+                         samplingSeed);
+  mut.setPreTCEFilter(!noPreTCEFilter);
 
 // Keep Phi2Mem-preprocessed module
 #if (LLVM_VERSION_MAJOR <= 3) && (LLVM_VERSION_MINOR < 8)
@@ -489,18 +775,25 @@ llvm::cl::opt<std::string> extraLinkingFlags(
                                            "Module Folder folder");
 
   //@ Store Phi2Mem-preprocessed module with the same name of the input file
-  if (!ReadWriteIRObj::writeIR(preProPhi2MemModule.get(),
-                               outputDir + "/" + outFile + commonIRSuffix))
+  if (!writeOutputModule(preProPhi2MemModule.get(),
+                         outputDir + "/" + outFile + commonIRSuffix))
     assert(false && "Failed to output Phi-preprocessed IR file");
 
   //@ Print pre-TCE meta-mutant
   if (dumpPreTCEMeta) {
-    if (!ReadWriteIRObj::writeIR(moduleM, outputDir + "/" + outFile +
-                                              preTCEMetaIRFileSuffix))
+    if (!writeOutputModule(moduleM,
+                           outputDir + "/" + outFile + preTCEMetaIRFileSuffix))
       assert(false && "Failed to output pre-TCE meta-mutatant IR file");
     // mut.dumpMutantInfos (outputDir+"//"+outFile+"mutantLocs-preTCE.json");
   }
 
+  if (dumpMutants && packMutants) {
+    mutantsPack.reset(new MutantsPack());
+    packMutantsAsDelta = deltaMutants;
+  }
+  mutantsFileWriter.reset(new AsyncFileWriter(writerThreads));
+  hotPatchMutants = hotPatch;
+
   //@ Remove equivalent mutants and //@ print mutants in case on
   llvm::outs() << "Mart@Progress: Removing TCE Duplicates & WM & writing "
                   "mutants IRs (with initially "
@@ -517,20 +810,35 @@ llvm::cl::opt<std::string> extraLinkingFlags(
 
   /// Mutants Infos into json
   if (!disableDumpMutantInfos)
-    mut.dumpMutantInfos(outputDir + "//" + mutantsInfosFileName, outputDir + "//" + equivalentduplicate_mutantsInfosFileName);
+    mut.dumpMutantInfos(
+        outputDir + "//" + mutantsInfosFileName,
+        outputDir + "//" + equivalentduplicate_mutantsInfosFileName,
+        outputDir + "//" + mutantsInfosBinFileName);
+
+  /// Functions mutated by the shard, to merge the shards' outputs
+  if (!mutationShard.empty())
+    mut.dumpShardInfos(outputDir + "//" + mutationShardFileName);
+
+  /// Sampling of the mutants generated
+  if (mut.isSamplingMutants())
+    mut.dumpSamplingInfos(outputDir + "//" + mutantsSamplingFileName);
+
+  /// Statements to mutants IDs ranges of the statement coverage probes
+  if (!disabledMutantCoverage && stmtCoverageProbes)
+    mut.dumpCoverageStmtsTable(outputDir + "//" + covStmtsTableFileName);
 
   //@ Print post-TCE meta-mutant
   if (!disableDumpMetaIRbc) {
-    if (!ReadWriteIRObj::writeIR(moduleM, outputDir + "/" + outFile +
-                                              metaMuIRFileSuffix))
+    if (!writeOutputModule(moduleM,
+                           outputDir + "/" + outFile + metaMuIRFileSuffix))
       assert(false && "Failed to output post-TCE meta-mutatant IR file");
   }
 
   //@ Print post-TCE optimized meta-mutant (just to run)
   if (!disableDumpOptimalMetaIRbc) {
     mut.linkMetamoduleWithMutantSelection(optMetaMu, metamutant_sel);
-    if (!ReadWriteIRObj::writeIR(optMetaMu.get(), outputDir + "/" + outFile +
-                                              optimizedMetaMuIRFileSuffix))
+    if (!writeOutputModule(optMetaMu.get(), outputDir + "/" + outFile +
+                                                optimizedMetaMuIRFileSuffix))
       assert(false && "Failed to output post-TCE meta-mutatant IR file");
   }
 
@@ -573,6 +881,8 @@ mutantsDir+"//"+std::to_string(mid)+"//"+outFile+".bc"))
 #else
     std::unique_ptr<llvm::Module> forObjModule = llvm::CloneModule(moduleM);
 #endif
+    if (scopeRest && !ReadWriteIRObj::linkScopeRest(*forObjModule, *scopeRest))
+      assert(false && "Failed to link the functions out of mutation scope");
     // TODO: insert mutant selection code into the cloned module
     if (!ReadWriteIRObj::writeObj(forObjModule.get(), outputDir + "/" +
                                                           outFile +
@@ -580,77 +890,97 @@ mutantsDir+"//"+std::to_string(mid)+"//"+outFile+".bc"))
       assert(false && "Failed to output meta-mutatant object file");
   }
 #endif //#ifdef MART_GENMU_OBJECTFILE
+  // All the modules are written (before the files context is destroyed)
+  if (scopeRest)
+    scopeRest->releasePrepared();
   // llvm::errs() << "@After Mutation->TCE\n"; moduleM->dump(); llvm::errs() <<
   // "\n";
 
-  llvm::outs() << "Mart@Progress: Compiling Mutants ...\n";
-  // curClockTime = clock();
-  time_t timer = time(NULL); // clock_t do not measure time when calling a
-                             // script
-  //tmpStr = new char[1 + std::strlen(argv[0])]; // Alocate tmpStr3
-  //std::strcpy(tmpStr, argv[0]);
-  //std::string compileMutsScript(
-  //    dirname(tmpStr)); // dirname change the contain of its parameter
-  //delete[] tmpStr;
-  //tmpStr = nullptr; // del tmpStr3
-  // llvm::errs() << ("bash " + compileMutsScript+"/useful/CompileAllMuts.sh
-  // "+outputDir+" "+tmpFuncModuleFolder+" yes").c_str() <<"\n";
-  /*******/
-  // auto sc_code = system(("bash " +
-  // compileMutsScript+"/useful/CompileAllMuts.sh "+outputDir+"
-  // "+tmpFuncModuleFolder+" yes").c_str());
-  // if (sc_code != 0)
-  //{
-  //     llvm::errs() << "\n:( ERRORS: Mutants Compile script failed (probably
-  //     not enough memory) with error: " << sc_code << "!\n\n";
-  //     assert (false);
-  //}
-
-  // using fork - exec
-  pid_t my_pid;
-  int child_status;
-  // We use vfork here instead of pure fork to avoid error due to low memory
-  // as fork will copy memory to the child process, and mutation use much memory
-  // XXX Be careful about multithreading and vfork.
-  if ((my_pid = vfork()) < 0) {
-    perror("fork failure");
-    exit(1);
+  // Join the mutants writer threads before the vfork (the child shares the
+  // memory of this process until its exec)
+  if (mutantsFileWriter) {
+    if (!mutantsFileWriter->drain())
+      assert(false && "Failed to output post-TCE mutants IR files");
+    mutantsFileWriter.reset();
   }
-  if (my_pid == 0) {
-    llvm::errs() << "## Child process: compiler\n";
-    std::string compileMutsScript(useful_conf_dir + "/CompileAllMuts.sh");
-    execl("/bin/bash", "bash",
-          compileMutsScript.c_str(),
-          //STRINGIFY(LLVM_TOOLS_BINARY_DIR), outputDir.c_str(), 
-          (LLVM_TOOLS_BINARY_DIR), outputDir.c_str(), 
-          tmpFuncModuleFolder.c_str(), keepMutantsBCs ? "no" : "yes", 
-          extraLinkingFlags.c_str(), (char *)NULL);
-    llvm::errs() << "\n:( ERRORS: Mutants Compile script failed (probably not "
-                    "enough memory)!!!"
-                 << "!\n\n";
-    assert(false && "Child's exec failed!");
+
+  if (mutantsPack) {
+    // The pack holds the mutants' bitcode only, CompileAllMuts.sh compiles
+    // the mutants once unpacked
+    llvm::outs() << "Mart@Progress: the mutants pack is not compiled (unpack "
+                    "it with mart-pack -unpack, then run CompileAllMuts.sh).\n";
   } else {
-    llvm::errs() << "### Parent process: waiting\n";
-    wait(&child_status);
-    if (WIFEXITED(child_status)) {
-      const int es = WEXITSTATUS(child_status);
-      if (es) {
-        llvm::errs() << "Compilation failed with code " << es << " !!";
+    llvm::outs() << "Mart@Progress: Compiling Mutants ...\n";
+    // curClockTime = clock();
+    time_t timer = time(NULL); // clock_t do not measure time when calling a
+                               // script
+    //tmpStr = new char[1 + std::strlen(argv[0])]; // Alocate tmpStr3
+    //std::strcpy(tmpStr, argv[0]);
+    //std::string compileMutsScript(
+    //    dirname(tmpStr)); // dirname change the contain of its parameter
+    //delete[] tmpStr;
+    //tmpStr = nullptr; // del tmpStr3
+    // llvm::errs() << ("bash " + compileMutsScript+"/useful/CompileAllMuts.sh
+    // "+outputDir+" "+tmpFuncModuleFolder+" yes").c_str() <<"\n";
+    /*******/
+    // auto sc_code = system(("bash " +
+    // compileMutsScript+"/useful/CompileAllMuts.sh "+outputDir+"
+    // "+tmpFuncModuleFolder+" yes").c_str());
+    // if (sc_code != 0)
+    //{
+    //     llvm::errs() << "\n:( ERRORS: Mutants Compile script failed (probably
+    //     not enough memory) with error: " << sc_code << "!\n\n";
+    //     assert (false);
+    //}
+
+    // using fork - exec
+    pid_t my_pid;
+    int child_status;
+    // We use vfork here instead of pure fork to avoid error due to low memory
+    // as fork will copy memory to the child process, and mutation use much
+    // memory
+    // XXX Be careful about multithreading and vfork.
+    if ((my_pid = vfork()) < 0) {
+      perror("fork failure");
+      exit(1);
+    }
+    if (my_pid == 0) {
+      llvm::errs() << "## Child process: compiler\n";
+      std::string compileMutsScript(useful_conf_dir + "/CompileAllMuts.sh");
+      execl("/bin/bash", "bash",
+            compileMutsScript.c_str(),
+            //STRINGIFY(LLVM_TOOLS_BINARY_DIR), outputDir.c_str(), 
+            (LLVM_TOOLS_BINARY_DIR), outputDir.c_str(), 
+            tmpFuncModuleFolder.c_str(), keepMutantsBCs ? "no" : "yes", 
+            extraLinkingFlags.c_str(), hotPatchMutants ? "hotpatch" : "normal",
+            (char *)NULL);
+      llvm::errs() << "\n:( ERRORS: Mutants Compile script failed (probably "
+                      "not enough memory)!!!"
+                   << "!\n\n";
+      assert(false && "Child's exec failed!");
+    } else {
+      llvm::errs() << "### Parent process: waiting\n";
+      wait(&child_status);
+      if (WIFEXITED(child_status)) {
+        const int es = WEXITSTATUS(child_status);
+        if (es) {
+          llvm::errs() << "Compilation failed with code " << es << " !!";
+          assert(false);
+        }
+      } else {
+        llvm::errs() << "Compilation failed (did not terminate)!!";
         assert(false);
       }
-    } else {
-      llvm::errs() << "Compilation failed (did not terminate)!!";
-      assert(false);
     }
+    /********/
+    // llvm::outs() << "Mart@Progress:  Compiling Mutants took: "<<
+    // (float)(clock() - curClockTime)/CLOCKS_PER_SEC <<" Seconds.\n";
+
+    llvm::outs() << "Mart@Progress:  Compiling Mutants took: "
+                 << difftime(time(NULL), timer) << " Seconds.\n";
+    loginfo << "Mart@Progress:  Compiling Mutants took: "
+            << difftime(time(NULL), timer) << " Seconds.\n";
   }
-  /********/
-  // llvm::outs() << "Mart@Progress:  Compiling Mutants took: "<<
-  // (float)(clock() - curClockTime)/CLOCKS_PER_SEC <<" Seconds.\n";
-
-  llvm::outs() << "Mart@Progress:  Compiling Mutants took: "
-               << difftime(time(NULL), timer) << " Seconds.\n";
-  loginfo << "Mart@Progress:  Compiling Mutants took: "
-          << difftime(time(NULL), timer) << " Seconds.\n";
 
   llvm::outs() << "\nMart@Progress:  TOTAL RUNTIME: "
                << (difftime(time(NULL), totalRunTime) / 60) << " min.\n";
@@ -688,6 +1018,25 @@ mutantsDir+"//"+std::to_string(mid)+"//"+outFile+".bc"))
       xxx << ind++ << ". `" << mutantsInfosFileName << "` file: contains "
           << "the description "
           << "remaining after in memory TCE redundant mutants removal.\n";
+    if (!disableDumpMutantInfos)
+      xxx << ind++ << ". `" << mutantsInfosBinFileName << "` file: contains "
+          << "the same mutants infos as `" << mutantsInfosFileName << "` and `"
+          << equivalentduplicate_mutantsInfosFileName << "`, in a compact "
+          << "binary format (strings stored once, records indexed by mutant "
+          << "ID) that is mapped in memory instead of parsed. Used by "
+          << "Mart-Selection when present and not older than `"
+          << mutantsInfosFileName << "`.\n";
+    if (!mutationShard.empty())
+      xxx << ind++ << ". `" << mutationShardFileName << "` file: the "
+          << "mutation shard (" << mutationShard << ") of this output and the "
+          << "functions it mutated. The mutants IDs are local to the shard, "
+          << "use `mart-merge` to merge the outputs of all the shards into "
+          << "one output directory with a single mutants IDs space.\n";
+    if (mut.isSamplingMutants())
+      xxx << ind++ << ". `" << mutantsSamplingFileName << "` file: the "
+          << "sampling of the mutants (seed, strata, rate, maximum) and the "
+          << "number of mutants of each type generated and kept, and the "
+          << "mutants sampled out. Only the kept mutants have an ID.\n";
     if (!disabledWeakMutation)
       xxx << ind++ << ". `" << (outFile + wmOutIRFileSuffix) << "` file: "
           << "representing the weak mutation labeled version of the program, "
@@ -720,8 +1069,31 @@ mutantsDir+"//"+std::to_string(mid)+"//"+outFile+".bc"))
           << "redundant mutats removal. The difference with the RAW "
           << "meta-mutant is that it can be used directly to execute mutants "
           << "by setting the environment variable 'MART_SELECTED_MUTANT_ID' "
-          << "to the mutant ID.\n";
-    if (dumpMutants) {
+          << "to the mutant ID. An in-process test harness can switch the "
+          << "mutant between test cases, without restarting the program, by "
+          << "calling 'martLLVM_Metamutant_set_mutant', or by writing the "
+          << "mutant ID into the control file given by the environment "
+          << "variable 'MART_SELECTED_MUTANT_ID_SHM' and calling "
+          << "'martLLVM_Metamutant_poll_mutant' (see "
+          << "useful/metamutant_selector.c).\n";
+    if (dumpMutants && packMutants) {
+      xxx << ind++ << ". `" << mutantsPackFileName << "` and `"
+          << mutantsPackIndexFileName << "` files: the pack containing the "
+          << "mutants' bitcode, where identical bitcodes are stored once, and "
+          << "its index mapping each mutant ID to its blob. Use `mart-pack` "
+          << "to list or extract the mutants (the extraction recreates the "
+          << "`" << mutantsFolder << "` folder layout).\n";
+      if (deltaMutants)
+        xxx << ind++ << ". The mutants (except the original '0') are stored "
+            << "in the pack as deltas: a module with only the mutated function "
+            << "and the declarations it uses. `mart-pack` rebuilds the "
+            << "complete mutant module, from the original, when extracting.\n";
+      xxx << ind++ << ". `" << packDuplicatesFileName << "` file: contain "
+          << "mutant ID mapping of mutants with identical bitcode, found "
+          << "when writing the pack. Each key is the ID of the mutant kept and "
+          << "the value is the list of mutants duplicate to the key. Note that "
+          << "the key that is '0' correspond to the original program.\n";
+    } else if (dumpMutants) {
       xxx << ind++ << ". `" << mutantsFolder << "` folder: contain the "
           << "separate mutant "
           << "folder. Each folder is named wih an integer representing "
@@ -733,6 +1105,16 @@ mutantsDir+"//"+std::to_string(mid)+"//"+outFile+".bc"))
           << "the value is the list of mutants duplicate to the key, and that "
           << "were removed from on disk TCE. Note that the key that is '0' "
           << "correspond to the original program.\n";
+      if (hotPatch)
+        xxx << ind++ << ". `" << outFile << ".HotPatchHost` executable and "
+            << "`hotpatch_mutants.txt` file: the mutants' folders contain "
+            << "a shared object of the mutated function instead of an "
+            << "executable (except for the original '0'). Run a test on the "
+            << "mutants listed in `hotpatch_mutants.txt` by running the host "
+            << "with the test's arguments and the environment variable "
+            << "'MART_HOTPATCH_MUTANTS' set to the list. Each mutant runs in "
+            << "a forked child, its result is written into the file given "
+            << "by 'MART_HOTPATCH_RESULTS' (see useful/hotpatch_runner.c).\n";
     }
     xxx.close();
   } else {
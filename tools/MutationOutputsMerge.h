@@ -0,0 +1,370 @@
+/**
+ * -==== MutationOutputsMerge.h
+ *
+ *                Mart Multi-Language LLVM Mutation Framework
+ *
+ * This file is distributed under the University of Illinois Open Source
+ * License. See LICENSE.TXT for details.
+ *
+ * \brief     Utilities to merge the outputs of several mutation runs into one
+ * mutants IDs space (used by mart-merge and mart-project): each run's mutants
+ * IDs are shifted by an offset.
+ */
+
+#ifndef __MART_GENMU_tools_MutationOutputsMerge__
+#define __MART_GENMU_tools_MutationOutputsMerge__
+
+#include <algorithm>
+#include <cerrno>
+#include <dirent.h> //opendir
+#include <fstream>
+#include <string>
+#include <sys/stat.h>  //mkdir, stat
+#include <sys/types.h> //mkdir, stat
+#include <unistd.h>    //link
+#include <utility>
+#include <vector>
+
+#include "ReadWriteIRObj.h"
+#include "typesops.h" //MutantInfoList
+
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Instructions.h"
+
+// Needs the files names of tools_commondefs.h
+
+namespace mart {
+
+// XXX Same as in lib/mutation.cpp
+static const char *mutantIDSelectorName = "klee_semu_GenMu_Mutant_ID_Selector";
+static const char *mutantIDSelectorFuncName =
+    "klee_semu_GenMu_Mutant_ID_Selector_Func";
+static const char *postMutationPointFuncName =
+    "klee_semu_GenMu_Post_Mutation_Point_Func";
+static const char *fdupesDuplicatesFileName = "fdupes_duplicates.json";
+
+static bool fileExists(std::string const &path) {
+  struct stat st;
+  return stat(path.c_str(), &st) == 0;
+}
+
+static bool listDirectory(std::string const &path,
+                          std::vector<std::string> &entries) {
+  DIR *dir = opendir(path.c_str());
+  if (!dir) {
+    llvm::errs() << "Error: cannot open directory " << path << "\n";
+    return false;
+  }
+  entries.clear();
+  while (struct dirent *ent = readdir(dir)) {
+    std::string name(ent->d_name);
+    if (name != "." && name != "..")
+      entries.push_back(name);
+  }
+  closedir(dir);
+  std::sort(entries.begin(), entries.end());
+  return true;
+}
+
+/// \brief copy the file 'from' into 'to' (a hard link when possible)
+static bool copyFile(std::string const &from, std::string const &to) {
+  if (link(from.c_str(), to.c_str()) == 0)
+    return true;
+  std::ifstream in(from, std::ios::binary);
+  std::ofstream out(to, std::ios::binary);
+  if (!in.is_open() || !out.is_open()) {
+    llvm::errs() << "Error: failed to copy " << from << " into " << to
+                 << "\n";
+    return false;
+  }
+  out << in.rdbuf();
+  out.close();
+  return !out.fail();
+}
+
+/// \brief shift by 'idOffset' the mutants IDs (1 to 'numMutants') in the
+/// functions 'funcNames' of the meta module 'module'. The IDs are found from
+/// the uses of the mutant ID selector: its loads are used by the mutants
+/// switches (cases), or, once optimized, by equality comparisons and by
+/// additions of a constant (lowered switches). The arguments of the mutation
+/// points functions are shifted too. Any other use of the selector in these
+/// functions is not supported (asserted).
+static void shiftMutantIDs(llvm::Module &module,
+                           std::set<std::string> const &funcNames,
+                           MutantIDType idOffset, MutantIDType numMutants) {
+  llvm::GlobalVariable *selector = module.getNamedGlobal(mutantIDSelectorName);
+  if (!selector || idOffset == 0)
+    return;
+  llvm::Function *selectorFunc = module.getFunction(mutantIDSelectorFuncName);
+  llvm::Function *postPointFunc = module.getFunction(postMutationPointFuncName);
+  auto unsupported = [](llvm::Instruction *inst) {
+    llvm::errs() << "\nError: unrecognised use of the mutant ID selector in "
+                 << "function " << inst->getParent()->getParent()->getName()
+                 << ":\n";
+    inst->print(llvm::errs());
+    llvm::errs() << "\n";
+    assert(false && "Unrecognised use of the mutant ID selector");
+  };
+  auto shifted = [&](llvm::Value *val) {
+    auto *cst = llvm::cast<llvm::ConstantInt>(val);
+    return llvm::ConstantInt::get(cst->getType(),
+                                  cst->getZExtValue() + idOffset);
+  };
+  // A mutant ID compared with the selector
+  auto shiftedID = [&](llvm::Instruction *inst, llvm::Value *val) {
+    auto *cst = llvm::dyn_cast<llvm::ConstantInt>(val);
+    if (!cst || cst->isZero() || cst->getZExtValue() > numMutants)
+      unsupported(inst);
+    return shifted(cst);
+  };
+
+  // The loads of the selector in the functions
+  std::vector<llvm::LoadInst *> idLoads;
+  std::vector<llvm::User *> selectorUsers(selector->user_begin(),
+                                          selector->user_end());
+  while (!selectorUsers.empty()) {
+    llvm::User *user = selectorUsers.back();
+    selectorUsers.pop_back();
+    if (llvm::isa<llvm::ConstantExpr>(user)) {
+      selectorUsers.insert(selectorUsers.end(), user->user_begin(),
+                           user->user_end());
+      continue;
+    }
+    auto *inst = llvm::dyn_cast<llvm::Instruction>(user);
+    if (!inst ||
+        funcNames.count(inst->getParent()->getParent()->getName().str()) == 0)
+      continue;
+    if (auto *ld = llvm::dyn_cast<llvm::LoadInst>(inst))
+      idLoads.push_back(ld);
+    else
+      unsupported(inst);
+  }
+  for (auto *ld : idLoads) {
+    for (auto *user : ld->users()) {
+      auto *inst = llvm::cast<llvm::Instruction>(user);
+      if (auto *sw = llvm::dyn_cast<llvm::SwitchInst>(inst)) {
+        if (sw->getCondition() != ld)
+          unsupported(inst);
+        for (llvm::SwitchInst::CaseIt i = sw->case_begin(), e = sw->case_end();
+             i != e; ++i) {
+#if (LLVM_VERSION_MAJOR <= 4)
+          auto *newCase = shiftedID(sw, i.getCaseValue());
+          i.setValue(newCase);
+          i.getCaseSuccessor()->setName(std::string("MART.Mutant_Mut") +
+                                        std::to_string(
+                                            newCase->getZExtValue()));
+#else
+          auto *newCase = shiftedID(sw, (*i).getCaseValue());
+          (*i).setValue(newCase);
+          (*i).getCaseSuccessor()->setName(std::string("MART.Mutant_Mut") +
+                                           std::to_string(
+                                               newCase->getZExtValue()));
+#endif
+        }
+      } else if (auto *cmp = llvm::dyn_cast<llvm::ICmpInst>(inst)) {
+        if (!cmp->isEquality())
+          unsupported(inst);
+        unsigned cstIdx = (cmp->getOperand(0) == ld) ? 1 : 0;
+        cmp->setOperand(cstIdx, shiftedID(cmp, cmp->getOperand(cstIdx)));
+      } else if (inst->getOpcode() == llvm::Instruction::Add ||
+                 inst->getOpcode() == llvm::Instruction::Sub) {
+        // 'id - c' (or 'id + -c') indexes the cases from c: index from
+        // c + idOffset
+        bool isSub = inst->getOpcode() == llvm::Instruction::Sub;
+        auto *cst = llvm::dyn_cast<llvm::ConstantInt>(inst->getOperand(1));
+        if (inst->getOperand(0) != ld || !cst)
+          unsupported(inst);
+        inst->setOperand(1, llvm::ConstantInt::get(
+                                cst->getContext(),
+                                isSub ? cst->getValue() + idOffset
+                                      : cst->getValue() - idOffset));
+      } else {
+        unsupported(inst);
+      }
+    }
+  }
+
+  std::vector<llvm::CallInst *> postPointCalls;
+  for (auto &name : funcNames) {
+    llvm::Function *F = module.getFunction(name);
+    if (!F)
+      continue;
+    for (auto &BB : *F) {
+      for (auto &Inst : BB) {
+        if (auto *call = llvm::dyn_cast<llvm::CallInst>(&Inst)) {
+          if (selectorFunc && call->getCalledFunction() == selectorFunc) {
+            call->setArgOperand(0, shifted(call->getArgOperand(0)));
+            call->setArgOperand(1, shifted(call->getArgOperand(1)));
+          } else if (postPointFunc &&
+                     call->getCalledFunction() == postPointFunc) {
+            postPointCalls.push_back(call);
+          }
+        }
+      }
+    }
+  }
+  // The post mutation point ranges may start with the original (0), which
+  // stays 0: split them
+  for (auto *call : postPointCalls) {
+    auto *from = llvm::cast<llvm::ConstantInt>(call->getArgOperand(0));
+    auto *to = llvm::cast<llvm::ConstantInt>(call->getArgOperand(1));
+    if (to->isZero())
+      continue;
+    if (from->isZero()) {
+      std::vector<llvm::Value *> argsv;
+      argsv.push_back(llvm::ConstantInt::get(from->getType(), 1 + idOffset));
+      argsv.push_back(shifted(to));
+      llvm::CallInst::Create(postPointFunc, argsv, "", call->getNextNode());
+      call->setArgOperand(1, from);
+    } else {
+      call->setArgOperand(0, shifted(from));
+      call->setArgOperand(1, shifted(to));
+    }
+  }
+}
+
+/// \brief set the initial value of the mutant ID selector of the meta module
+/// 'module' to '<Highest Mutant ID> + 1' (the original), as Mart does
+static void setMutantIDSelectorInitialValue(llvm::Module &module,
+                                            MutantIDType highestMutantID) {
+  if (auto *selector = module.getNamedGlobal(mutantIDSelectorName))
+    if (selector->hasInitializer())
+      selector->setInitializer(llvm::ConstantInt::get(
+          selector->getInitializer()->getType(), 1 + highestMutantID));
+}
+
+/// \brief copy the mutants folders of the mutation outputs 'outputs' (output
+/// directory, shift of its mutants IDs) into 'outDir', renamed with their
+/// merged IDs, and merge the on disk TCE duplicates. The original (mutant 0)
+/// is taken from the first output, or from each output with
+/// 'originalOfEach' (outputs of different programs).
+/// The function modules of the uncompiled function mode outputs are merged
+/// too, with their 'mapinfo' (mutant file, function module) renamed with the
+/// merged IDs. Two outputs with the same function module are not supported.
+static bool
+mergeMutantsFolders(std::vector<std::pair<std::string, MutantIDType>> const
+                        &outputs,
+                    std::string const &outDir, bool originalOfEach = false) {
+  std::string outMutantsDir(outDir + "/" + mutantsFolder);
+  if (mkdir(outMutantsDir.c_str(), 0777) != 0) {
+    llvm::errs() << "Error: failed to create " << outMutantsDir << "\n";
+    return false;
+  }
+  std::string outFunctionDir(outDir + "/" + tmpFuncModuleFolder);
+  bool hasFunctionModules = false;
+  std::string mergedMapinfo;
+  JsonBox::Object mergedDups;
+  for (auto &output : outputs) {
+    auto mergedID = [&](std::string const &mid) {
+      unsigned id = std::stoul(mid);
+      return std::to_string(id == 0 ? 0 : id + output.second);
+    };
+    std::string mutantsDir(output.first + "/" + mutantsFolder);
+    std::vector<std::string> mutants, files;
+    // The mapinfo lines of the output, without function modules
+    std::string mapinfo;
+    if (!listDirectory(mutantsDir, mutants))
+      return false;
+    for (auto &mid : mutants) {
+      if (mid == "0" && !originalOfEach && &output != &outputs.front())
+        continue;
+      std::string toDir(outMutantsDir + "/" + mergedID(mid));
+      if ((mkdir(toDir.c_str(), 0777) != 0 && errno != EEXIST) ||
+          !listDirectory(mutantsDir + "/" + mid, files)) {
+        llvm::errs() << "Error: failed to copy mutant " << mid << " of "
+                     << output.first << "\n";
+        return false;
+      }
+      for (auto &file : files) {
+        if (!copyFile(mutantsDir + "/" + mid + "/" + file, toDir + "/" + file))
+          return false;
+        if (llvm::StringRef(file).endswith(commonIRSuffix))
+          mapinfo += mutantsFolder + "/" + mergedID(mid) + "/" + file + "\n";
+      }
+    }
+
+    std::string functionDir(output.first + "/" + tmpFuncModuleFolder);
+    if (fileExists(functionDir)) {
+      if (!hasFunctionModules && mkdir(outFunctionDir.c_str(), 0777) != 0) {
+        llvm::errs() << "Error: failed to create " << outFunctionDir << "\n";
+        return false;
+      }
+      hasFunctionModules = true;
+      if (!listDirectory(functionDir, files))
+        return false;
+      for (auto &file : files) {
+        if (file == "mapinfo")
+          continue;
+        if (fileExists(outFunctionDir + "/" + file)) {
+          llvm::errs() << "Error: the function module " << file << " of "
+                       << output.first
+                       << " is also in another merged output\n";
+          return false;
+        }
+        if (!copyFile(functionDir + "/" + file, outFunctionDir + "/" + file))
+          return false;
+      }
+      // Rename the mutants files of the mapinfo lines:
+      // mutants.out/<ID>/<file> [<function module>]
+      std::ifstream in(functionDir + "/" + "mapinfo");
+      if (!in.is_open()) {
+        llvm::errs() << "Error: failed to read " << functionDir
+                     << "/mapinfo\n";
+        return false;
+      }
+      mapinfo.clear();
+      std::string line;
+      std::string prefix(mutantsFolder + "/");
+      while (std::getline(in, line)) {
+        if (line.empty())
+          continue;
+        size_t idEnd = line.find('/', prefix.size());
+        if (line.compare(0, prefix.size(), prefix) != 0 ||
+            idEnd == std::string::npos) {
+          llvm::errs() << "Error: invalid mapinfo line of " << output.first
+                       << ": " << line << "\n";
+          return false;
+        }
+        std::string mid(line.substr(prefix.size(), idEnd - prefix.size()));
+        if (mid == "0" && !originalOfEach && &output != &outputs.front())
+          continue;
+        mapinfo += prefix + mergedID(mid) + line.substr(idEnd) + "\n";
+      }
+    }
+    mergedMapinfo += mapinfo;
+
+    std::string dupsFile(output.first + "/" + fdupesDuplicatesFileName);
+    if (!fileExists(dupsFile))
+      continue;
+    JsonBox::Value dups;
+    dups.loadFromFile(dupsFile);
+    assert(dups.isObject() && "Invalid on disk TCE duplicates file");
+    for (auto &keptDups : dups.getObject()) {
+      JsonBox::Value &mergedKept = mergedDups[mergedID(keptDups.first)];
+      JsonBox::Array arr;
+      if (mergedKept.isArray())
+        arr = mergedKept.getArray();
+      for (auto &dup : keptDups.second.getArray())
+        arr.push_back(JsonBox::Value(mergedID(dup.getString())));
+      mergedKept = arr;
+    }
+  }
+  JsonBox::Value vout(mergedDups);
+  vout.writeToFile(outDir + "/" + fdupesDuplicatesFileName, true, false);
+
+  if (hasFunctionModules) {
+    std::ofstream xxx(outFunctionDir + "/" + "mapinfo");
+    if (!xxx.is_open()) {
+      llvm::errs() << "Unable to open file for write:" << outFunctionDir
+                   << "/mapinfo\n";
+      return false;
+    }
+    xxx << mergedMapinfo;
+    xxx.close();
+  }
+  return true;
+}
+
+} // namespace mart
+
+#endif //__MART_GENMU_tools_MutationOutputsMerge__
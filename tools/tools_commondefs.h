@@ -2,8 +2,10 @@
 #ifndef __MART_GENMU_tools_tools_commondefs__
 #define __MART_GENMU_tools_tools_commondefs__
 
+#include <cassert>
 #include <libgen.h> //dirname
 #include <string>
+#include <sys/stat.h> //stat
 
 #include "llvm/Support/FileSystem.h"
 #include "llvm/ADT/SmallString.h"
@@ -15,22 +17,34 @@
 
 static const std::string mutantsInfosFileName("mutantsInfos.json");
 static const std::string equivalentduplicate_mutantsInfosFileName("equidup-mutantsInfos.json");
+static const std::string mutantsInfosBinFileName("mutantsInfos.bin");
+static const std::string covStmtsTableFileName("coverageStmts-mutantsRanges.json");
+static const std::string mutationShardFileName("mutationShard.json");
+static const std::string mutantsSamplingFileName("mutantsSampling.json");
 static const char *wmOutIRFileSuffix = ".WM.bc";
 static const char *covOutIRFileSuffix = ".COV.bc";
 static const char *preTCEMetaIRFileSuffix = ".preTCE.MetaMu.bc";
 static const char *commonIRSuffix = ".bc";
 static const char *metaMuIRFileSuffix = ".MetaMu.bc";
 static const char *optimizedMetaMuIRFileSuffix = ".OptMetaMu.bc";
+static const char *hotPatchHostIRFileSuffix = ".HotPatchHost.bc";
 static const char *usefulFolderName = "useful";
+static const std::string mutantsFolder("mutants.out");
+static const std::string tmpFuncModuleFolder("tmp-func-module-dir.tmp");
+static const std::string mutantsPackFileName("mutants.pack");
+static const std::string mutantsPackIndexFileName("mutants.pack.idx");
+static const std::string packDuplicatesFileName("pack_duplicates.json");
 #ifdef MART_GENMU_OBJECTFILE
 static const char *metaMuObjFileSuffix = ".MetaMu.o";
 #endif
 
+// Internal linkage: several tools are linked together in the daemon (see
+// Mart-Daemon.cpp), each with its TOOLNAME
 #if (LLVM_VERSION_MAJOR < 6)
-void printVersion() {
+static inline void printVersion() {
   llvm::raw_ostream &OS = llvm::outs();
 #else
-void printVersion(llvm::raw_ostream &OS) {
+static inline void printVersion(llvm::raw_ostream &OS) {
 #endif
   OS << "\nMart (Framework for Multi-Programming Language Mutation "
                   "Testing based on LLVM)\n";
@@ -43,7 +57,7 @@ void printVersion(llvm::raw_ostream &OS) {
   OS << "\n";
 }
 
-std::string getUsefulAbsPath(char *argv0) {
+static inline std::string getUsefulAbsPath(char *argv0) {
   std::string useful_conf_dir;
 
   if (false) {
@@ -65,4 +79,62 @@ std::string getUsefulAbsPath(char *argv0) {
   return useful_conf_dir;
 }
 
+/// \brief mutants infos file of the mutation topdir (the binary one if any,
+/// unless the JSON one was modified after it)
+static inline std::string
+getTopdirMutantInfoFile(std::string const &martOutTopDir) {
+  // Prefer the binary mutants infos (no parsing)
+  std::string binFile = martOutTopDir + "/" + mutantsInfosBinFileName;
+  std::string jsonFile = martOutTopDir + "/" + mutantsInfosFileName;
+  struct stat binSt, jsonSt;
+  if (stat(binFile.c_str(), &binSt) != 0 || !S_ISREG(binSt.st_mode))
+    return jsonFile;
+  if (stat(jsonFile.c_str(), &jsonSt) == 0 &&
+      (jsonSt.st_mtim.tv_sec > binSt.st_mtim.tv_sec ||
+       (jsonSt.st_mtim.tv_sec == binSt.st_mtim.tv_sec &&
+        jsonSt.st_mtim.tv_nsec > binSt.st_mtim.tv_nsec))) {
+    llvm::errs() << "Warning: " << binFile << " is older than " << jsonFile
+                 << ", using the latter.\n";
+    return jsonFile;
+  }
+  return binFile;
+}
+
+/// \brief preprocessed IR file of the mutation topdir: end with .bc and is
+/// neither .WM.bc nor .preTCE.MetaMu.bc, nor .MetaMu.bc
+static inline std::string
+getTopdirPreprocessedIRFile(std::string const &martOutTopDir) {
+  std::string inputIRfile;
+#if (LLVM_VERSION_MAJOR <= 3) && (LLVM_VERSION_MINOR < 5)
+  llvm::error_code ec;
+  llvm::sys::fs::directory_iterator dit(martOutTopDir, ec);
+#elif (LLVM_VERSION_MAJOR <= 3) && (LLVM_VERSION_MINOR < 9)
+  std::error_code ec;
+  llvm::sys::fs::directory_iterator dit(martOutTopDir, ec);
+#else
+  std::error_code ec;
+  llvm::sys::fs::directory_iterator dit(martOutTopDir, ec,
+                                        false /*no symlink*/);
+#endif
+  llvm::sys::fs::directory_iterator de;
+  for (; dit != de; dit.increment(ec)) {
+    assert(!ec && "failed to list topdir when looking for input BC");
+    llvm::StringRef fpath = dit->path();
+    if (fpath.endswith(commonIRSuffix)) {
+      if (!fpath.endswith(wmOutIRFileSuffix) &&
+          !fpath.endswith(covOutIRFileSuffix) &&
+          !fpath.endswith(preTCEMetaIRFileSuffix) &&
+          !fpath.endswith(metaMuIRFileSuffix) &&
+          !fpath.endswith(optimizedMetaMuIRFileSuffix) &&
+          !fpath.endswith(hotPatchHostIRFileSuffix)) {
+        assert(inputIRfile.empty() && "multiple preprocessed IRs in the "
+                                      "specified topdir. Please specify one");
+        inputIRfile.assign(martOutTopDir + "/" +
+                           llvm::sys::path::filename(fpath).str());
+      }
+    }
+  }
+  return inputIRfile;
+}
+
 #endif
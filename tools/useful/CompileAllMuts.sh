@@ -13,16 +13,20 @@ error_exit()
 
 TOPDIR=$(dirname $(readlink -f $0))
 
-[ $# = 5 ] || error_exit "Expected 5 parameters, $# passed: $0 <llvmBinaryDir> <directory (mart-out-0)> <tmpFuncModuleFolder> <remove mutants' \".bc\"? yes/no> <extra linking flags>"
+[ $# = 5 -o $# = 6 ] || error_exit "Expected 5 or 6 parameters, $# passed: $0 <llvmBinaryDir> <directory (mart-out-0)> <tmpFuncModuleFolder> <remove mutants' \".bc\"? yes/no> <extra linking flags> [<mode: normal/hotpatch>]"
 
 llvm_bin_dir=$(readlink -f $1)
 Dir=$(readlink -f $2)
 tmpFuncModuleFolder=$3
 removeMutsBCs=$4
 extraLinkingFlags=$5
+compileMode=${6:-normal}
 fdupesData=$Dir/"fdupes_duplicates.txt"
 fdupesJson=$Dir/"fdupes_duplicates.json"
 mutantsFolder="mutants.out"
+mutantsPack="mutants.pack"
+hotpatchList=$Dir/"hotpatch_mutants.txt"
+hotpatchHostSuffix=".HotPatchHost.bc"
 
 ##### CONFIGURATION #####
 #llc=llc-3.4
@@ -40,10 +44,16 @@ test -d $Dir || error_exit "directory $Dir do not exist"
 entryDir=`pwd`
 cd $Dir
 
+# The mutants pack holds bitcode only, its mutants must be unpacked first
+if test -f $mutantsPack && ! test -d $mutantsFolder
+then
+    error_exit "the mutants of $Dir are in the mutants pack $mutantsPack, unpack them first (mart-pack -unpack $Dir)"
+fi
+
 #Compile the generated mutants
 CFLAGS="-lm"    #link with lm because gcc complain linking when fmod mutant is added
 CFLAGS+=" $extraLinkingFlags"
-for m in `find -maxdepth 1 -type f -name "*.bc"`
+for m in `find -maxdepth 1 -type f -name "*.bc" ! -name "*$hotpatchHostSuffix"`
 do
     $llc -O0 -filetype=obj -o ${m%.bc}.o $m || error_exit "Failed to compile bitcode $m to object (in $Dir)"
     $CC -O3 -o ${m%.bc} ${m%.bc}.o $CFLAGS || error_exit "Failed to compile object ${m%.bc}.o of bitcode $m to executable (in $Dir)"
@@ -63,19 +73,41 @@ then
     done
     
     sed -i'' 's|\.bc|.o|g' "$tmpFuncModuleFolder/mapinfo"
+    hotpatchHost=""
+    if [ "$compileMode" = "hotpatch" ]; then
+        hotpatchHost=$(find -maxdepth 1 -type f -name "*$hotpatchHostSuffix" | head -n1)
+        [ "$hotpatchHost" = "" ] && echo "# No hot-patch host (single function program?), linking the mutants"
+    fi
+    rm -f $hotpatchList.tmp
     while read in
     do 
         x_path=`printf "$in" | cut -d' ' -f1`
         x_dir=$(dirname $x_path)
         x=$(basename $x_path)
+        func_mod=`printf "$in" | cut -d' ' -f2 -s`
         cd $x_dir || error_exit "Failed to cd into x_dir ($x_dir)"
-        $llc -O0 -filetype=obj -o $x ${x%.o}.bc || error_exit "Failed to compile mutant $m to object (cmd: $llc -O0 -filetype=obj -o $x ${x%.o}.bc)"
-        cd - > /dev/null # go back from x_dir
-        $CC -O3 -o ${x_path%.o} $in $CFLAGS || error_exit "Failed to compile mutant $m to executable (cmd: $CC -O3 -o ${x_path%.o} $in $CFLAGS)"
+        if [ "$hotpatchHost" != "" -a "$func_mod" != "" ]; then
+            # Only the mutated function, loaded by the hot-patch host
+            $llc -O0 -filetype=obj -relocation-model=pic -o $x ${x%.o}.bc || error_exit "Failed to compile mutant $m to PIC object (cmd: $llc -O0 -filetype=obj -relocation-model=pic -o $x ${x%.o}.bc)"
+            cd - > /dev/null # go back from x_dir
+            $CC -shared -o ${x_path%.o}.so $x_path || error_exit "Failed to compile mutant $m to shared object (cmd: $CC -shared -o ${x_path%.o}.so $x_path)"
+            echo "$(basename $x_dir) $Dir/${x_path%.o}.so $(basename ${func_mod%.o})" >> $hotpatchList.tmp
+        else
+            $llc -O0 -filetype=obj -o $x ${x%.o}.bc || error_exit "Failed to compile mutant $m to object (cmd: $llc -O0 -filetype=obj -o $x ${x%.o}.bc)"
+            cd - > /dev/null # go back from x_dir
+            $CC -O3 -o ${x_path%.o} $in $CFLAGS || error_exit "Failed to compile mutant $m to executable (cmd: $CC -O3 -o ${x_path%.o} $in $CFLAGS)"
+        fi
         rm -f $x_path #$m
         echo "$bcCount/$nBCs ($SECONDS s) done $x_path!"   ##DEBUG
         bcCount=$((bcCount+1))
     done < "$tmpFuncModuleFolder/mapinfo"
+    if [ "$hotpatchHost" != "" ]; then
+        # The original with all its symbols exported and the runner
+        $llc -O0 -filetype=obj -relocation-model=pic -o ${hotpatchHost%.bc}.o $hotpatchHost || error_exit "Failed to compile hot-patch host $hotpatchHost to object"
+        $CC -O3 -rdynamic -o ${hotpatchHost%.bc} ${hotpatchHost%.bc}.o $TOPDIR/hotpatch_runner.bc $CFLAGS -ldl || error_exit "Failed to compile hot-patch host $hotpatchHost to executable"
+        rm -f ${hotpatchHost%.bc}.o
+        [ "$removeMutsBCs" = "yes" ] && rm -f $hotpatchHost
+    fi
     [ "$removeMutsBCs" = "yes" ] && { find $mutantsFolder -type f -name "*.bc" -exec rm -f {} + || error_exit "Failed to remove some mutants .bc files"; }
     rm -rf $tmpFuncModuleFolder || error_exit "Failed to remove temporary function module folder"
     
@@ -110,6 +142,15 @@ then
     echo >> $fdupesJson
     echo "}" >> $fdupesJson || error_exit "Failed to create fdupesJson3"
     rm -f $fdupesData
+
+    # List the hot-patch mutants kept after the on disk TCE
+    if test -f $hotpatchList.tmp; then
+        while read mid so func
+        do
+            test -f $so && echo "$mid $so $func"
+        done < $hotpatchList.tmp | sort -n > $hotpatchList
+        rm -f $hotpatchList.tmp
+    fi
 fi
 
 cd $entryDir
@@ -0,0 +1,65 @@
+#! /usr/bin/python
+
+##
+# Expand the statements covered, logged by the statement coverage probes
+# (Mart option 'stmt-coverage-probes'), into the mutants covered.
+# The statements indexes are read from the coverage log ('covlabels', one
+# index per line) and expanded using the statements mutants ranges table
+# written by Mart ('coverageStmts-mutantsRanges.json').
+# The mutants IDs covered are written one per line, as the mutant coverage log.
+##
+
+from __future__ import print_function
+
+import os, sys
+import json
+import argparse
+
+def loadStmtsTable(tableFile):
+    with open(tableFile) as fp:
+        jtable = json.load(fp)
+    table = {}
+    for stmt, mrange in jtable.items():
+        table[int(stmt)] = (int(mrange[0]), int(mrange[1]))
+    return table
+#~ def loadStmtsTable()
+
+def expandCoverage(table, covStmtsFile):
+    stmts = set()
+    with open(covStmtsFile) as fp:
+        for line in fp:
+            line = line.strip()
+            if line:
+                stmts.add(int(line))
+    mutants = []
+    for stmt in sorted(stmts):
+        if stmt not in table:
+            print("Error: statement index", stmt, "not in the table", \
+                                                            file=sys.stderr)
+            exit(1)
+        mutants += range(table[stmt][0], table[stmt][1] + 1)
+    return mutants
+#~ def expandCoverage()
+
+def main():
+    parser = argparse.ArgumentParser(description="Expand the statements "
+                                    "coverage log into the mutants coverage")
+    parser.add_argument("stmtsTable", help="statements mutants ranges table "
+                                    "(coverageStmts-mutantsRanges.json)")
+    parser.add_argument("covStmts", help="statements coverage log")
+    parser.add_argument("-o", "--output", default=None, help="output file "
+                                    "of the mutants covered (default stdout)")
+    args = parser.parse_args()
+
+    mutants = expandCoverage(loadStmtsTable(args.stmtsTable), args.covStmts)
+    if args.output is None:
+        for mid in mutants:
+            print(mid)
+    else:
+        with open(args.output, "w") as fp:
+            for mid in mutants:
+                fp.write(str(mid) + "\n")
+#~ def main()
+
+if __name__ == "__main__":
+    main()
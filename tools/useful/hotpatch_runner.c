@@ -0,0 +1,233 @@
+#define _GNU_SOURCE
+#include <dlfcn.h>
+#include <errno.h>
+#include <link.h> // ElfW
+#include <limits.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/**
+    Hot-patch mutants runner (Mart option 'hot-patch-mutants').
+    Linked into the hot-patch host: the original program, with all its symbols
+    exported. When the environment variable MART_HOTPATCH_MUTANTS is set to a
+    mutants list (lines '<mutant ID> <shared object> <function name>'), the
+    host runs, before main, each mutant in a forked child: the child loads the
+    mutant's shared object (its mutated function) and redirects the original
+    function to it with a jump written at its entry, then executes the test
+    (main) with the host's arguments. The host itself exits after the last
+    mutant, without running main.
+
+    Optional environment variables:
+    MART_HOTPATCH_RESULTS: results file (default mart.hotpatch.results), one
+        line per mutant: '<mutant ID> exit <code>', '<mutant ID> signal <sig>',
+        '<mutant ID> timeout' or '<mutant ID> error' (failed to load or patch).
+    MART_HOTPATCH_TIMEOUT: timeout of each mutant execution, in seconds.
+    MART_HOTPATCH_OUTPUT_DIR: directory where to write the standard output and
+        error of each mutant (<mutant ID>.stdout and <mutant ID>.stderr).
+    The standard input is read once and given to every mutant.
+ **/
+
+#define str(x) #x
+#define xstr(x) str(x)
+
+// The host's functions are aligned on this (by Mart), so the jump may use the
+// padding after a function smaller than the jump
+#define MARTLLVM_HOTPATCH_FUNC_ALIGN 16
+
+#if defined(__x86_64__)
+// jmp *0(%rip) followed by the absolute target address
+#define MARTLLVM_HOTPATCH_JUMP_SIZE 14
+#elif defined(__i386__)
+// jmp rel32
+#define MARTLLVM_HOTPATCH_JUMP_SIZE 5
+#endif
+
+// Overwrite the entry of 'from' with a jump to 'to'. Return 0 on success.
+static int martLLVM_HotPatch__Redirect(void *from, void *to) {
+#ifdef MARTLLVM_HOTPATCH_JUMP_SIZE
+  unsigned char jump[MARTLLVM_HOTPATCH_JUMP_SIZE];
+#if defined(__x86_64__)
+  jump[0] = 0xff;
+  jump[1] = 0x25;
+  memset(jump + 2, 0, 4);
+  memcpy(jump + 6, &to, sizeof(to));
+#else
+  int32_t rel = (int32_t)((char *)to - ((char *)from + sizeof(jump)));
+  jump[0] = 0xe9;
+  memcpy(jump + 1, &rel, sizeof(rel));
+#endif
+  // The jump must not overwrite the next function
+  Dl_info info;
+  const ElfW(Sym) *sym = (void *)0;
+  size_t slotSize = 0;
+  if (dladdr1(from, &info, (void **)&sym, RTLD_DL_SYMENT) && sym) {
+    slotSize = sym->st_size;
+    if ((uintptr_t)from % MARTLLVM_HOTPATCH_FUNC_ALIGN == 0)
+      slotSize = (slotSize + MARTLLVM_HOTPATCH_FUNC_ALIGN - 1) /
+                 MARTLLVM_HOTPATCH_FUNC_ALIGN * MARTLLVM_HOTPATCH_FUNC_ALIGN;
+  }
+  if (slotSize != 0 && slotSize < sizeof(jump)) {
+    fprintf(stderr, "[MART HOTPATCH] function %s too small to be patched\n",
+            info.dli_sname);
+    return -1;
+  }
+  long pagesize = sysconf(_SC_PAGESIZE);
+  uintptr_t start = (uintptr_t)from & ~(uintptr_t)(pagesize - 1);
+  size_t len = (uintptr_t)from + sizeof(jump) - start;
+  if (mprotect((void *)start, len, PROT_READ | PROT_WRITE | PROT_EXEC) != 0) {
+    perror("[MART HOTPATCH] mprotect");
+    return -1;
+  }
+  memcpy(from, jump, sizeof(jump));
+  mprotect((void *)start, len, PROT_READ | PROT_EXEC);
+  __builtin___clear_cache((char *)from, (char *)from + sizeof(jump));
+  return 0;
+#else
+  (void)from;
+  (void)to;
+  fprintf(stderr, "[MART HOTPATCH] architecture not supported\n");
+  return -1;
+#endif
+}
+
+// Load the mutant's shared object and redirect the host's function to it
+static int martLLVM_HotPatch__Apply(char const *soPath, char const *funcName) {
+  // Look up the original before loading the mutant, which defines it too
+  void *orig = dlsym(RTLD_DEFAULT, funcName);
+  if (!orig) {
+    fprintf(stderr, "[MART HOTPATCH] function %s not exported by the host\n",
+            funcName);
+    return -1;
+  }
+  void *handle = dlopen(soPath, RTLD_NOW | RTLD_LOCAL);
+  if (!handle) {
+    fprintf(stderr, "[MART HOTPATCH] %s\n", dlerror());
+    return -1;
+  }
+  void *mutant = dlsym(handle, funcName);
+  if (!mutant || mutant == orig) {
+    fprintf(stderr, "[MART HOTPATCH] function %s not defined in %s\n",
+            funcName, soPath);
+    return -1;
+  }
+  return martLLVM_HotPatch__Redirect(orig, mutant);
+}
+
+// Copy the standard input into a temporary file, read by every mutant
+static FILE *martLLVM_HotPatch__SaveStdin() {
+  if (isatty(STDIN_FILENO))
+    return (void *)0;
+  FILE *copy = tmpfile();
+  if (!copy)
+    return (void *)0;
+  char buf[4096];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), stdin)) > 0)
+    fwrite(buf, 1, n, copy);
+  fflush(copy);
+  return copy;
+}
+
+// In the child, set the standard streams of the mutant execution
+static void martLLVM_HotPatch__SetStreams(FILE *stdinCopy, char const *outDir,
+                                         unsigned mid) {
+  if (stdinCopy) {
+    dup2(fileno(stdinCopy), STDIN_FILENO);
+    lseek(STDIN_FILENO, 0, SEEK_SET);
+    clearerr(stdin);
+  }
+  if (outDir) {
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/%u.stdout", outDir, mid);
+    if (!freopen(path, "w", stdout))
+      perror("[MART HOTPATCH] stdout");
+    snprintf(path, sizeof(path), "%s/%u.stderr", outDir, mid);
+    if (!freopen(path, "w", stderr))
+      perror("[MART HOTPATCH] stderr");
+  }
+}
+
+// global constructor running the mutants. Returns only in the mutants'
+// children (which then execute main), or when no mutants list is given.
+__attribute__((constructor)) static void martLLVM_HotPatch__Run() {
+  char *listFile = getenv(xstr(MART_HOTPATCH_MUTANTS));
+  if (!listFile)
+    return;
+  FILE *list = fopen(listFile, "r");
+  if (!list) {
+    fprintf(stderr, "[MART HOTPATCH] cannot open mutants list (%s)\n",
+            listFile);
+    _exit(1);
+  }
+  char *resultsFile = getenv(xstr(MART_HOTPATCH_RESULTS));
+  if (!resultsFile)
+    resultsFile = "mart.hotpatch.results";
+  FILE *results = fopen(resultsFile, "a");
+  if (!results) {
+    fprintf(stderr, "[MART HOTPATCH] cannot open results file (%s)\n",
+            resultsFile);
+    _exit(1);
+  }
+  char *timeoutStr = getenv(xstr(MART_HOTPATCH_TIMEOUT));
+  unsigned timeout = timeoutStr ? (unsigned)atoi(timeoutStr) : 0;
+  char *outDir = getenv(xstr(MART_HOTPATCH_OUTPUT_DIR));
+  FILE *stdinCopy = martLLVM_HotPatch__SaveStdin();
+
+  unsigned mid;
+  char soPath[PATH_MAX], funcName[1024];
+  while (fscanf(list, "%u %4095s %1023s", &mid, soPath, funcName) == 3) {
+    int statusPipe[2];
+    if (pipe(statusPipe) != 0) {
+      perror("[MART HOTPATCH] pipe");
+      _exit(1);
+    }
+    fflush(NULL);
+    pid_t pid = fork();
+    if (pid < 0) {
+      perror("[MART HOTPATCH] fork");
+      _exit(1);
+    }
+    if (pid == 0) {
+      fclose(list);
+      fclose(results);
+      close(statusPipe[0]);
+      martLLVM_HotPatch__SetStreams(stdinCopy, outDir, mid);
+      char patched = martLLVM_HotPatch__Apply(soPath, funcName) == 0;
+      if (write(statusPipe[1], &patched, 1) != 1 || !patched) {
+        fflush(NULL);
+        _exit(1);
+      }
+      close(statusPipe[1]);
+      if (timeout)
+        alarm(timeout);
+      return; // execute the test with the mutant
+    }
+    close(statusPipe[1]);
+    char patched = 0;
+    if (read(statusPipe[0], &patched, 1) != 1)
+      patched = 0;
+    close(statusPipe[0]);
+    int status;
+    int waited;
+    while ((waited = waitpid(pid, &status, 0)) < 0 && errno == EINTR)
+      ;
+    if (!patched || waited < 0)
+      fprintf(results, "%u error\n", mid);
+    else if (WIFSIGNALED(status) && timeout && WTERMSIG(status) == SIGALRM)
+      fprintf(results, "%u timeout\n", mid);
+    else if (WIFSIGNALED(status))
+      fprintf(results, "%u signal %d\n", mid, WTERMSIG(status));
+    else
+      fprintf(results, "%u exit %d\n", mid, WEXITSTATUS(status));
+    fflush(results);
+  }
+  fclose(list);
+  fclose(results);
+  _exit(0);
+}
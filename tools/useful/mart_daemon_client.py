@@ -0,0 +1,72 @@
+#! /usr/bin/python
+
+##
+# Client of the Mart daemon (mart-daemon): send a job to the daemon listening
+# on the given UNIX socket, print the job's output as it is streamed and exit
+# with the job's exit status. The job runs in the current directory.
+# Example:
+#   mart_daemon_client.py /tmp/mart.sock load-mutation prog.bc
+#   mart_daemon_client.py /tmp/mart.sock mutate -write-mutants prog.bc
+#   mart_daemon_client.py /tmp/mart.sock load-selection mart-out-0
+#   mart_daemon_client.py /tmp/mart.sock features mart-out-0
+##
+
+from __future__ import print_function
+
+import os, sys
+import socket
+import argparse
+
+EXIT_STATUS_TAG = b"Mart-Daemon@Exit: "
+
+def runJob(socketPath, job, jobArgs):
+    sock = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+    sock.connect(socketPath)
+    fields = [job, os.getcwd()] + jobArgs
+    request = b"".join([f.encode() + b"\0" for f in fields]) + b"\0"
+    sock.sendall(request)
+
+    out = getattr(sys.stdout, "buffer", sys.stdout)
+    # Keep the last line, which may be the exit status, until the end
+    pending = b""
+    while True:
+        data = sock.recv(65536)
+        if not data:
+            break
+        pending += data
+        cut = pending.rfind(b"\n", 0, len(pending) - 1)
+        if cut >= 0:
+            out.write(pending[:cut + 1])
+            out.flush()
+            pending = pending[cut + 1:]
+    sock.close()
+
+    # The job's output may not end with a new line
+    tagPos = pending.rfind(EXIT_STATUS_TAG)
+    if tagPos < 0:
+        out.write(pending)
+        out.flush()
+        print("Error: the daemon did not reply the job's exit status", \
+                                                            file=sys.stderr)
+        return 1
+    out.write(pending[:tagPos])
+    out.flush()
+    return int(pending[tagPos + len(EXIT_STATUS_TAG):].strip())
+#~ def runJob()
+
+def main():
+    parser = argparse.ArgumentParser(description="Send a job to the Mart "
+                                                                    "daemon")
+    parser.add_argument("socket", help="UNIX socket of the daemon")
+    parser.add_argument("job", choices=["load-mutation", "load-selection", \
+                                "mutate", "select", "features", "stop"], \
+                                help="job to run")
+    parser.add_argument("jobArgs", nargs=argparse.REMAINDER, \
+                                help="arguments of the job")
+    args = parser.parse_args()
+
+    exit(runJob(args.socket, args.job, args.jobArgs))
+#~ def main()
+
+if __name__ == "__main__":
+    main()
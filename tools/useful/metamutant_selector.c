@@ -1,14 +1,80 @@
+#include <fcntl.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #define str(x) #x
 #define xstr(x) str(x)
 
+/**
+    The mutant executed by the optimized meta-mutant is selected by:
+    - MART_SELECTED_MUTANT_ID environment variable: the mutant ID, set at the
+      program start.
+    - MART_SELECTED_MUTANT_ID_SHM environment variable: (optional) file (e.g.
+      in /dev/shm) whose first 4 bytes are a control word holding the mutant
+      ID. It is read at the program start and by each call to
+      martLLVM_Metamutant_poll_mutant, so that a harness running the tests
+      in-process (persistent loop) can switch the mutant between test cases
+      without restarting the program.
+    - martLLVM_Metamutant_set_mutant: called by an in-process harness.
+    The mutants' code only reads klee_semu_GenMu_Mutant_ID_Selector (a single
+    load); the switch happens only through the calls above.
+ **/
+
 // XXX Same as in lib/mutation.cpp
 extern unsigned klee_semu_GenMu_Mutant_ID_Selector;
 
+static volatile unsigned *martLLVM_Metamutant_control_word = (void *)0;
+
+// Set the mutant executed from now on (0 for the original program)
+void martLLVM_Metamutant_set_mutant(unsigned mutant_id) {
+  klee_semu_GenMu_Mutant_ID_Selector = mutant_id;
+}
+
+// Get the mutant currently executed
+unsigned martLLVM_Metamutant_get_mutant() {
+  return klee_semu_GenMu_Mutant_ID_Selector;
+}
+
+// Set the mutant executed from the shared control word, if any. To be called
+// between test cases. Return the mutant executed from now on.
+unsigned martLLVM_Metamutant_poll_mutant() {
+  if (martLLVM_Metamutant_control_word)
+    klee_semu_GenMu_Mutant_ID_Selector = *martLLVM_Metamutant_control_word;
+  return klee_semu_GenMu_Mutant_ID_Selector;
+}
+
+static void martLLVM_Metamutant_map_control_word(char const *path) {
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    printf("[TEST HARNESS] cannot open mutant ID control file (%s)\n", path);
+    return;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(unsigned)) {
+    printf("[TEST HARNESS] mutant ID control file too small (%s)\n", path);
+    close(fd);
+    return;
+  }
+  void *addr = mmap((void *)0, sizeof(unsigned), PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (addr == MAP_FAILED) {
+    printf("[TEST HARNESS] cannot map mutant ID control file (%s)\n", path);
+    return;
+  }
+  martLLVM_Metamutant_control_word = (volatile unsigned *)addr;
+}
+
 // global constructor mutant selector
 __attribute__ ((constructor)) void martLLVM_Metamutant_mutant_selector() {
   char *MARTLLVM_mutant_id = getenv(xstr(MART_SELECTED_MUTANT_ID));
   if (MARTLLVM_mutant_id)
     klee_semu_GenMu_Mutant_ID_Selector = atoll(MARTLLVM_mutant_id);
-}
\ No newline at end of file
+  char *MARTLLVM_mutant_id_shm = getenv(xstr(MART_SELECTED_MUTANT_ID_SHM));
+  if (MARTLLVM_mutant_id_shm) {
+    martLLVM_Metamutant_map_control_word(MARTLLVM_mutant_id_shm);
+    martLLVM_Metamutant_poll_mutant();
+  }
+}
@@ -0,0 +1,111 @@
+#! /usr/bin/python
+
+##
+# Run the tests on the mutants in the order computed by mart-prioritize
+# (strong mutation), stopping at the first test that kills a mutant.
+# The mutants of a statement run one after the other, and the tests that
+# killed a mutant of the statement in this run are tried first on the others.
+# The test command is a shell command where '{mutant}' and '{test}' are
+# replaced by the mutant ID and the test name. The mutant is killed when the
+# command exits with non zero status.
+# The kills are written in kill matrix format, to record them into the
+# prioritization index (mart-prioritize -record) or analyse them with
+# mart-killmatrix.
+# Example:
+#   mart-prioritize mart-out-0 -index tests.idx -tests tests.txt -o prio.txt
+#   prioritized_mutants_runner.py prio.txt "./run_test.sh {mutant} {test}" \
+#                                                               -o kills.txt
+#   mart-prioritize mart-out-0 -index tests.idx -record kills.txt
+##
+
+from __future__ import print_function
+
+import os, sys
+import subprocess
+import argparse
+
+def loadPrioritization(filename):
+    mutants = []
+    with open(filename) as fp:
+        for line in fp:
+            fields = line.split()
+            if len(fields) < 2:
+                continue
+            mutants.append((int(fields[0]), int(fields[1]), fields[2:]))
+    # The mutants of a statement one after the other
+    mutants.sort(key=lambda m: (m[1], m[0]))
+    return mutants
+#~ def loadPrioritization()
+
+def isKilled(testCommand, mutantID, test, timeout):
+    cmd = testCommand.replace("{mutant}", str(mutantID)).replace("{test}", \
+                                                                        test)
+    if timeout is None:
+        status = subprocess.call(cmd, shell=True)
+    else:
+        status = subprocess.call(["timeout", str(timeout), "sh", "-c", cmd])
+    return status != 0
+#~ def isKilled()
+
+def main():
+    parser = argparse.ArgumentParser(description="Run the prioritized tests "
+                                    "on the mutants until they are killed")
+    parser.add_argument("prioritization", help="prioritized tests of the "
+                                    "mutants, written by mart-prioritize")
+    parser.add_argument("testCommand", help="shell command running a test "
+                                    "on a mutant ('{mutant}' and '{test}' "
+                                    "are replaced)")
+    parser.add_argument("-o", "--output", required=True, help="output kill "
+                                    "matrix file")
+    parser.add_argument("--timeout", type=float, default=None, help="test "
+                                    "timeout in seconds (a timeout kills)")
+    parser.add_argument("--all-killers", action="store_true", help="run all "
+                                    "the tests of each mutant instead of "
+                                    "stopping at the first kill")
+    args = parser.parse_args()
+
+    mutants = loadPrioritization(args.prioritization)
+
+    killedBy = {}
+    testsOrder = []
+    stmtKillers = {}
+    executions = 0
+    numKilled = 0
+    executionsToFirstKill = 0
+    for mutantID, stmt, tests in mutants:
+        testsSet = set(tests)
+        online = [t for t in stmtKillers.get(stmt, []) if t in testsSet]
+        onlineSet = set(online)
+        ordered = online + [t for t in tests if t not in onlineSet]
+        killed = False
+        for test in ordered:
+            executions += 1
+            if not isKilled(args.testCommand, mutantID, test, args.timeout):
+                continue
+            if test not in killedBy:
+                killedBy[test] = []
+                testsOrder.append(test)
+            killedBy[test].append(mutantID)
+            if not killed:
+                killed = True
+                numKilled += 1
+                executionsToFirstKill += ordered.index(test) + 1
+            stmtKillers[stmt] = [test] + [t for t in stmtKillers.get(stmt, \
+                                                            []) if t != test]
+            if not args.all_killers:
+                break
+
+    with open(args.output, "w") as fp:
+        for test in testsOrder:
+            fp.write(test + " " + " ".join([str(m) for m in \
+                                            sorted(killedBy[test])]) + "\n")
+
+    print("# Mutants:", len(mutants), "- Killed:", numKilled, \
+                                            "- Test executions:", executions)
+    if numKilled > 0:
+        print("# Mean test executions to the first kill:", \
+                                    float(executionsToFirstKill) / numKilled)
+#~ def main()
+
+if __name__ == "__main__":
+    main()
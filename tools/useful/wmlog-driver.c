@@ -89,3 +89,48 @@ void martLLVM_COV_Log__Function(unsigned idfrom, unsigned idto) {
   }
   martLLVM_WM_Log__Function_Explicit_FFlush();
 }
+
+// For the inline probes (Mart option 'inline-probes'): the instrumented
+// program sets, without any call, the byte of each weakly killed (WM) or
+// covered (COV) mutant in the bitmap. The mutation tool makes this point to
+// the bitmap, of (Highest_Mutant_ID + 1) bytes, indexed by mutant ID.
+static unsigned char *martLLVM_Inline_Log__Bitmap = (void *)0;
+
+// Write the mutants set in the bitmap and not yet written. Called at exit,
+// may also be called explicitly by the test harness.
+void martLLVM_Inline_Log__Dump() {
+  if (!martLLVM_Inline_Log__Bitmap)
+    return;
+  if (!martLLVM_WM_Log__file) {
+    char *MARTLLVM_WM_LOG_OUTPUT_file = getenv(xstr(MART_WM_LOG_OUTPUT));
+    if (!MARTLLVM_WM_LOG_OUTPUT_file)
+      MARTLLVM_WM_LOG_OUTPUT_file = "mart.defaultFileName.Inline.covlabels";
+    // In case many processes(fork).
+    // The user should make sure to delete this before run
+    martLLVM_WM_Log__file = fopen(MARTLLVM_WM_LOG_OUTPUT_file, "a");
+    if (!martLLVM_WM_Log__file) {
+      printf("[TEST HARNESS] cannot init inline probes output file (%s)\n",
+             MARTLLVM_WM_LOG_OUTPUT_file);
+      return;
+    }
+    martLLVM_WM_Log__Mutants_Weakly_Killed_Cache =
+        (char *)malloc((1 + martLLVM_WM_Log__Highest_Mutant_ID) * sizeof(char));
+    unsigned ui = 0;
+    for (; ui <= martLLVM_WM_Log__Highest_Mutant_ID; ++ui)
+      martLLVM_WM_Log__Mutants_Weakly_Killed_Cache[ui] = 0; // false
+  }
+
+  unsigned id;
+  for (id = 0; id <= martLLVM_WM_Log__Highest_Mutant_ID; ++id) {
+    if (martLLVM_Inline_Log__Bitmap[id] &&
+        martLLVM_WM_Log__Mutants_Weakly_Killed_Cache[id] == 0) {
+      fprintf(martLLVM_WM_Log__file, "%u\n", id);
+      martLLVM_WM_Log__Mutants_Weakly_Killed_Cache[id] = 1;
+    }
+  }
+  fflush(martLLVM_WM_Log__file);
+}
+
+__attribute__((destructor)) static void martLLVM_Inline_Log__AtExit() {
+  martLLVM_Inline_Log__Dump();
+}